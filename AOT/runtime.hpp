@@ -0,0 +1,119 @@
+#ifndef TEA_AOT_RUNTIME_HEADER
+#define TEA_AOT_RUNTIME_HEADER
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include "VM/cpu.hpp"
+#include "Executable/executable.hpp"
+#include "Shared/buffer.hpp"
+
+// The stack size of translated programs, the same as the VM's.
+#define AOT_STACK_SIZE 8 * 1024 * 1024 // 8MB
+
+/**
+ * @brief The runtime of a program translated by tea-aot.
+ * The translated program is a member function of this CPU, so the
+ * handlers of its instructions, which are copied from
+ * `BasicCPU::execute()`, find the registers, the stack, the syscalls
+ * and the I/O of the CPU like they do in the VM.
+ * Instructions that are not translated and guest threads
+ * are run by the interpreter of the CPU.
+ */
+struct TranslatedCPU : CPU
+{
+	// The hooks of the CPU, referred to by the copied handlers.
+	using Hooks = NoHooks;
+
+	/**
+	 * @brief A function of the program, translated by tea-aot.
+	 */
+	struct Region
+	{
+		// The offset of the first instruction of the region.
+		uint64_t start;
+
+		// Runs the translation from the instruction pointer,
+		// until control leaves the region.
+		void (TranslatedCPU::*run)();
+	};
+
+	// The regions of the program, ordered by their start.
+	// Defined by the code generated by tea-aot.
+	static const Region regions[];
+	static const size_t region_count;
+
+	using CPU::CPU;
+
+	/**
+	 * @brief Runs the translation of a region. Specialised for
+	 * every region by the code generated by tea-aot.
+	 * @tparam start The start of the region.
+	 */
+	template <uint64_t start>
+	void
+	run_region();
+
+	/**
+	 * @brief Runs the translated program until it completes.
+	 * Runs the region that contains the instruction pointer,
+	 * until the instruction pointer leaves the program.
+	 */
+	void
+	run_translated()
+	{
+		while (get_instr_ptr() < program_location + program_size)
+		{
+			uint64_t offset = get_instr_ptr() - program_location;
+
+			// The first region starts at the start of the program.
+
+			const Region *region = std::upper_bound(regions, regions + region_count, offset,
+				[](uint64_t offset, const Region &region) { return offset < region.start; });
+
+			(this->*(region - 1)->run)();
+		}
+	}
+};
+
+/**
+ * @brief Loads an executable that is embedded in a translated program
+ * and runs the translated code on it.
+ * Prints the error message and aborts if the program crashes.
+ * @param file The contents of the executable file.
+ * @param size The size of the executable file in bytes.
+ * @param file_name The name of the executable, for error messages.
+ * @returns The value of the return register when the program completes.
+ */
+int
+run_translated_executable(const uint8_t *file, size_t size, const char *file_name)
+{
+	try
+	{
+		Buffer buffer(new uint8_t[size], size);
+		memcpy(buffer.data, file, size);
+
+		Executable executable = Executable::from_buffer(buffer, file_name);
+		TranslatedCPU cpu(executable, AOT_STACK_SIZE);
+
+		cpu.run_translated();
+
+		if (cpu.bench_regions != nullptr)
+		{
+			cpu.bench_regions->write_summary(nullptr);
+		}
+
+		return cpu.regs[R_RET];
+	}
+	catch (const std::string &err_message)
+	{
+		std::cout << err_message << std::flush;
+		abort();
+	}
+}
+
+#endif
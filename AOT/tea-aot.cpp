@@ -0,0 +1,155 @@
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include <unistd.h>
+
+#include "AOT/translator.hpp"
+#include "Shared/buffer.hpp"
+#include "Shared/instruction-handlers.hpp"
+
+// The directory the runtime headers are read from, set by the Makefile.
+// It is the source tree for `make`, and the installed copy of the
+// headers for `make install`. Can be overridden with the TEA_AOT_ROOT
+// environment variable or the --root option.
+#ifndef TEA_AOT_ROOT
+#define TEA_AOT_ROOT "."
+#endif
+
+void
+print_usage()
+{
+	fprintf(stderr, "Usage: ./tea-aot [--emit-source] [--root repository_root] "
+		"[--cxx compiler] [-o output] program.teax\n");
+	exit(1);
+}
+
+/**
+ * @param arg An argument.
+ * @returns The argument, quoted for the shell.
+ */
+std::string
+shell_quote(const std::string &arg)
+{
+	std::string quoted = "'";
+
+	for (char c : arg)
+	{
+		quoted += c == '\'' ? std::string("'\\''") : std::string(1, c);
+	}
+
+	return quoted + "'";
+}
+
+int
+main(int argc, char **argv)
+{
+	const char *input_path = nullptr;
+	std::string output_path;
+	std::string root = getenv("TEA_AOT_ROOT") != nullptr ? getenv("TEA_AOT_ROOT") : TEA_AOT_ROOT;
+	std::string cxx  = getenv("CXX") != nullptr ? getenv("CXX") : "c++";
+	bool emit_source = false;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+
+		if (arg == "--emit-source")
+		{
+			emit_source = true;
+		}
+		else if (arg == "--root" || arg == "--cxx" || arg == "-o")
+		{
+			if (i + 1 == argc)
+				print_usage();
+
+			(arg == "--root" ? root : arg == "--cxx" ? cxx : output_path) = argv[++i];
+		}
+		else if (input_path == nullptr)
+		{
+			input_path = argv[i];
+		}
+		else
+		{
+			print_usage();
+		}
+	}
+
+	if (input_path == nullptr)
+	{
+		print_usage();
+	}
+
+	// By default, the output is named after the input without its extension.
+
+	if (output_path.empty())
+	{
+		output_path = input_path;
+
+		if (output_path.size() > 5 && output_path.substr(output_path.size() - 5) == ".teax")
+		{
+			output_path.resize(output_path.size() - 5);
+		}
+
+		if (emit_source)
+		{
+			output_path += ".cpp";
+		}
+	}
+
+	std::string source_path = emit_source ? output_path : output_path + ".aot.cpp";
+
+	try
+	{
+		if (access((root + "/AOT/runtime.hpp").c_str(), R_OK) != 0)
+		{
+			throw "Could not find the runtime headers in " + root
+				+ ", pass --root or set TEA_AOT_ROOT\n";
+		}
+
+		Buffer file                  = Buffer::from_file(input_path);
+		InstructionHandlers handlers = read_instruction_handlers(root + "/VM/cpu.hpp");
+		Translator translator(file, input_path, handlers);
+
+		FILE *source = fopen(source_path.c_str(), "w");
+
+		if (source == nullptr)
+		{
+			throw "Could not open " + source_path + "\n";
+		}
+
+		translator.write(source, input_path);
+		fclose(source);
+
+		printf("Translated %zu instructions, %zu are interpreted\n",
+			translator.translated_count, translator.interpreted_count);
+
+		if (emit_source)
+		{
+			printf("Wrote %s\n", source_path.c_str());
+			return 0;
+		}
+
+		// Compile the translation with the runtime into a native binary.
+
+		std::string command = shell_quote(cxx) + " -std=c++17 -O2 -I" + shell_quote(root)
+			+ " " + shell_quote(source_path) + " -o " + shell_quote(output_path)
+			+ " -ldl -pthread";
+
+		int status = system(command.c_str());
+		unlink(source_path.c_str());
+
+		if (status != 0)
+		{
+			throw "Could not compile " + output_path + ", command: " + command + "\n";
+		}
+
+		printf("Wrote %s\n", output_path.c_str());
+	}
+	catch (const std::string &err_message)
+	{
+		std::cerr << err_message << std::flush;
+		return 1;
+	}
+}
@@ -0,0 +1,567 @@
+#ifndef TEA_AOT_TRANSLATOR_HEADER
+#define TEA_AOT_TRANSLATOR_HEADER
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <regex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "Executable/byte-code.hpp"
+#include "Executable/executable.hpp"
+#include "Shared/instruction-handlers.hpp"
+
+/**
+ * @brief Translates the program of an executable into C++ that is
+ * compiled into a native binary together with `AOT/runtime.hpp`.
+ *
+ * Every instruction is translated into the body of its handler in
+ * `BasicCPU::execute()`, with its operands substituted as literals,
+ * so the translated program behaves exactly like the interpreted one.
+ *
+ * The program is split into regions, one for every function: the start
+ * of the program, the end of the initialisation, the exported functions
+ * and the targets of calls and spawned threads each start a region.
+ * Every region is translated into its own function, so the host compiler
+ * only ever compiles functions of the size of a function of the program.
+ * Jumps and calls within a region become gotos. Other changes of the
+ * instruction pointer, like returns, go through a switch over the
+ * labels of the region. Control that leaves the region returns to
+ * `TranslatedCPU::run_translated()`, which runs the region that
+ * contains the new instruction pointer.
+ * Instructions whose operands cannot be substituted are run by the
+ * interpreter of the runtime.
+ */
+struct Translator
+{
+	// The contents of the executable file, embedded in the translation.
+	Buffer &file;
+
+	// The executable.
+	Executable executable;
+
+	// The program segment of the executable.
+	const uint8_t *program;
+
+	// The size of the program segment in bytes.
+	uint64_t program_size;
+
+	// The handlers of the instructions, read from the CPU header.
+	const InstructionHandlers &handlers;
+
+	// The offsets of the instructions in the program segment.
+	std::vector<uint64_t> instructions;
+
+	// The offsets that control may be transferred to, apart from
+	// falling through. These are the start of the program, the targets
+	// of jumps and calls, the return sites and the end of the program.
+	std::set<uint64_t> labels;
+
+	// The offsets at which the regions start, see `Translator`.
+	// Every region runs up to the start of the next one,
+	// the last one up to the end of the program.
+	std::set<uint64_t> region_starts;
+
+	// The number of instructions that were translated.
+	size_t translated_count = 0;
+
+	// The number of instructions that are run by the interpreter.
+	size_t interpreted_count = 0;
+
+	/**
+	 * @brief Constructs a new Translator object.
+	 * Finds the instructions and labels of the program.
+	 * Throws an error message if the executable is invalid.
+	 * @param file The contents of the executable file.
+	 * @param file_name The name of the executable, for error messages.
+	 * @param handlers The handlers of the instructions.
+	 */
+	Translator(Buffer &file, const char *file_name, const InstructionHandlers &handlers)
+		: file(file),
+		  executable(Executable::from_buffer(file, file_name)),
+		  program(executable.data + executable.static_data_size),
+		  program_size(executable.program_size),
+		  handlers(handlers)
+	{
+		find_instructions();
+		find_labels();
+	}
+
+	/**
+	 * @param offset The offset of an instruction.
+	 * @returns The opcode of the instruction.
+	 */
+	Instruction
+	opcode_at(uint64_t offset)
+	{
+		return (Instruction) program[offset];
+	}
+
+	/**
+	 * @brief Finds the offsets of all instructions of the program.
+	 * Throws an error message if the program contains an unknown
+	 * instruction or ends in the middle of one.
+	 */
+	void
+	find_instructions()
+	{
+		uint64_t offset = 0;
+
+		while (offset < program_size)
+		{
+			if (opcode_at(offset) >= INSTRUCTION_COUNT)
+			{
+				throw "Invalid instruction at offset " + std::to_string(offset) + "\n";
+			}
+
+			instructions.push_back(offset);
+			offset += instruction_size(program + offset);
+		}
+
+		if (offset != program_size)
+		{
+			throw std::string("The last instruction runs past the end of the program\n");
+		}
+	}
+
+	/**
+	 * @param offset The offset of an instruction.
+	 * @returns The offset its relative address points to.
+	 * Only defined for instructions whose first argument is a relative address.
+	 */
+	uint64_t
+	target_of(uint64_t offset)
+	{
+		int32_t relative;
+		memcpy(&relative, program + offset + sizeof(Instruction), sizeof(relative));
+		return offset + relative;
+	}
+
+	/**
+	 * @param opcode An opcode.
+	 * @returns Whether the instruction jumps or calls to its relative address.
+	 */
+	static bool
+	transfers_control(Instruction opcode)
+	{
+		return (opcode >= JUMP && opcode <= JUMP_IF_NEQ) || opcode == CALL;
+	}
+
+	/**
+	 * @param offset An offset into the program.
+	 * @returns Whether the offset is the start of an instruction.
+	 */
+	bool
+	is_instruction(uint64_t offset)
+	{
+		return std::binary_search(instructions.begin(), instructions.end(), offset);
+	}
+
+	/**
+	 * @brief Finds the labels and the regions of the program,
+	 * see `labels` and `region_starts`.
+	 */
+	void
+	find_labels()
+	{
+		labels.insert(0);
+		labels.insert(program_size);
+		region_starts.insert(0);
+
+		if (is_instruction(executable.export_table.init_end))
+		{
+			region_starts.insert(executable.export_table.init_end);
+		}
+
+		for (const ExportedFunction &function : executable.export_table.functions)
+		{
+			region_starts.insert(function.offset);
+		}
+
+		for (uint64_t offset : instructions)
+		{
+			Instruction opcode = opcode_at(offset);
+
+			if (opcode == THREAD_SPAWN && is_instruction(target_of(offset)))
+			{
+				region_starts.insert(target_of(offset));
+			}
+
+			if (!transfers_control(opcode))
+			{
+				continue;
+			}
+
+			// Targets that are not the start of an instruction
+			// are left to the interpreter.
+
+			uint64_t target = target_of(offset);
+
+			if (target == program_size || is_instruction(target))
+			{
+				labels.insert(target);
+			}
+
+			if (opcode == CALL)
+			{
+				labels.insert(offset + instruction_size(program + offset));
+
+				if (is_instruction(target))
+				{
+					region_starts.insert(target);
+				}
+			}
+		}
+
+		// Control enters a region through the switch over its labels.
+
+		labels.insert(region_starts.begin(), region_starts.end());
+	}
+
+	/**
+	 * @param start The start of a region.
+	 * @returns The end of the region.
+	 */
+	uint64_t
+	region_end(uint64_t start)
+	{
+		auto next = region_starts.upper_bound(start);
+		return next == region_starts.end() ? program_size : *next;
+	}
+
+	/**
+	 * @param type The name of an integer type.
+	 * @returns The size of the type in bytes, or 0 if it is unknown.
+	 */
+	static size_t
+	type_size(const std::string &type)
+	{
+		if (type == "uint8_t" || type == "int8_t")
+			return 1;
+
+		if (type == "uint16_t" || type == "int16_t")
+			return 2;
+
+		if (type == "uint32_t" || type == "int32_t")
+			return 4;
+
+		if (type == "uint64_t" || type == "int64_t")
+			return 8;
+
+		return 0;
+	}
+
+	/**
+	 * @brief Copies the handler of an instruction, with every `fetch()`
+	 * of an operand replaced by the value of the operand.
+	 * Operands can only be substituted if the handler fetches all of them
+	 * unconditionally, at the top level of its body.
+	 * @param offset The offset of the instruction.
+	 * @param body The lines of the translated handler are appended to this.
+	 * @returns Whether the handler could be translated.
+	 */
+	bool
+	translate_handler(uint64_t offset, std::vector<std::string> &body)
+	{
+		static const std::regex fetch_regex("fetch<(\\w+)>\\(\\)");
+
+		auto handler = handlers.find(opcode_at(offset));
+
+		if (handler == handlers.end())
+		{
+			return false;
+		}
+
+		uint64_t end     = offset + instruction_size(program + offset);
+		uint64_t operand = offset + sizeof(Instruction);
+
+		for (std::string line : handler->second)
+		{
+			bool top_level = line.rfind("\t\t\t", 0) == 0 && line[3] != '\t';
+			std::string translated;
+			std::smatch match;
+
+			while (std::regex_search(line, match, fetch_regex))
+			{
+				size_t size = type_size(match[1]);
+
+				if (!top_level || size == 0 || operand + size > end)
+				{
+					return false;
+				}
+
+				uint64_t value = 0;
+				memcpy(&value, program + operand, size);
+				operand += size;
+
+				char literal[64];
+				snprintf(literal, sizeof(literal), "((%s) 0x%lxull)",
+					match[1].str().c_str(), value);
+
+				translated += match.prefix().str() + literal;
+				line = match.suffix();
+			}
+
+			// The handler is nested one level less deep in the translation.
+
+			translated += line;
+			body.push_back(translated.empty() ? translated : translated.substr(1));
+		}
+
+		// The trailing break is implied by falling through
+		// to the next instruction.
+
+		while (!body.empty() && body.back().empty())
+		{
+			body.pop_back();
+		}
+
+		if (!body.empty() && body.back() == "\t\tbreak;")
+		{
+			body.pop_back();
+		}
+
+		return operand == end;
+	}
+
+	/**
+	 * @param lines Lines of code.
+	 * @param words Identifiers.
+	 * @returns Whether any of the lines mentions any of the identifiers.
+	 */
+	static bool
+	mentions(const std::vector<std::string> &lines,
+		const std::vector<const char *> &words)
+	{
+		for (const std::string &line : lines)
+		{
+			for (const char *word : words)
+			{
+				if (line.find(word) != std::string::npos)
+				{
+					return true;
+				}
+			}
+		}
+
+		return false;
+	}
+
+	/**
+	 * @param lines Lines of code.
+	 * @param word An identifier.
+	 * @returns Whether any of the lines uses the identifier as a whole word.
+	 */
+	static bool
+	mentions_word(const std::vector<std::string> &lines, const std::string &word)
+	{
+		std::regex word_regex("\\b" + word + "\\b");
+
+		for (const std::string &line : lines)
+		{
+			if (std::regex_search(line, word_regex))
+			{
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	/**
+	 * @brief Writes the translation of an instruction.
+	 * @param out The output file.
+	 * @param offset The offset of the instruction.
+	 * @param start The start of the region of the instruction.
+	 * @param end The end of the region of the instruction.
+	 */
+	void
+	write_instruction(FILE *out, uint64_t offset, uint64_t start, uint64_t end)
+	{
+		Instruction opcode = opcode_at(offset);
+		uint64_t next      = offset + instruction_size(program + offset);
+
+		fprintf(out, "\t// 0x%04lx %s\n", offset, instruction_to_str(opcode));
+
+		// Comments and labels do nothing.
+
+		if (opcode == COMMENT || opcode == LABEL)
+		{
+			translated_count++;
+			return;
+		}
+
+		std::vector<std::string> body;
+
+		if (!translate_handler(offset, body))
+		{
+			interpreted_count++;
+			fprintf(out, "\tset_instr_ptr(program_location + 0x%lx);\n",
+				offset + sizeof(Instruction));
+			fprintf(out, "\tcur_instr_addr = program_location + 0x%lx;\n", offset);
+			fprintf(out, "\texecute(%s);\n", instruction_to_str(opcode));
+			fprintf(out, "\tif (get_instr_ptr() != program_location + 0x%lx) goto dispatch;\n\n",
+				next);
+			return;
+		}
+
+		translated_count++;
+
+		// The instruction pointer is only kept up to date for handlers that
+		// use it, like calls that push it as return address, and for syscalls.
+
+		bool uses_instr_ptr = opcode >= COMMENT || mentions(body,
+			{ "instr_ptr", "instr_addr", "stack_frame", "jump_instruction_p" });
+		bool moves_instr_ptr = mentions(body,
+			{ "set_instr_ptr", "pop_stack_frame", "jump_instruction_p" });
+
+		fprintf(out, "\t{\n");
+
+		if (uses_instr_ptr)
+		{
+			fprintf(out, "\t\tset_instr_ptr(program_location + 0x%lx);\n", next);
+			fprintf(out, "\t\tcur_instr_addr = program_location + 0x%lx;\n", offset);
+		}
+
+		if (mentions_word(body, "instruction"))
+		{
+			fprintf(out, "\t\tInstruction instruction = %s;\n", instruction_to_str(opcode));
+		}
+
+		// A handler that breaks out early is wrapped in a loop it can break out of.
+
+		bool breaks = mentions(body, { "break;" });
+
+		if (breaks)
+		{
+			fprintf(out, "\t\tdo\n\t\t{\n");
+		}
+
+		for (const std::string &line : body)
+		{
+			fprintf(out, breaks && !line.empty() ? "\t%s\n" : "%s\n", line.c_str());
+		}
+
+		if (breaks)
+		{
+			fprintf(out, "\t\t}\n\t\twhile (false);\n");
+		}
+
+		fprintf(out, "\t}\n");
+
+		if (transfers_control(opcode) && labels.count(target_of(offset))
+			&& target_of(offset) >= start && target_of(offset) < end)
+		{
+			fprintf(out, "\tif (get_instr_ptr() == program_location + 0x%lx) goto L_%lx;\n",
+				target_of(offset), target_of(offset));
+		}
+
+		if (moves_instr_ptr)
+		{
+			fprintf(out, "\tif (get_instr_ptr() != program_location + 0x%lx) goto dispatch;\n",
+				next);
+		}
+
+		fprintf(out, "\n");
+	}
+
+	/**
+	 * @brief Writes the translation of a region.
+	 * @param out The output file.
+	 * @param start The start of the region.
+	 */
+	void
+	write_region(FILE *out, uint64_t start)
+	{
+		uint64_t end = region_end(start);
+
+		fprintf(out, "template <>\nvoid\nTranslatedCPU::run_region<0x%lx>()\n{\n", start);
+		fprintf(out, "\tgoto dispatch;\n\n");
+
+		for (auto offset = std::lower_bound(instructions.begin(), instructions.end(), start);
+			offset != instructions.end() && *offset < end; offset++)
+		{
+			if (labels.count(*offset))
+			{
+				fprintf(out, "L_%lx:\n", *offset);
+			}
+
+			write_instruction(out, *offset, start, end);
+		}
+
+		// The last instruction falls through to the next region.
+
+		fprintf(out, "\tset_instr_ptr(program_location + 0x%lx);\n", end);
+		fprintf(out, "\treturn;\n\n");
+
+		// Control was transferred to an offset that is only known at runtime.
+		// Offsets of the region that are not labels are run by the
+		// interpreter until it reaches one.
+
+		fprintf(out, "dispatch:\n");
+		fprintf(out, "\tswitch (get_instr_ptr() - program_location)\n\t{\n");
+
+		for (auto label = labels.lower_bound(start); label != labels.end() && *label < end; label++)
+		{
+			fprintf(out, "\tcase 0x%lx: goto L_%lx;\n", *label, *label);
+		}
+
+		fprintf(out, "\t}\n\n");
+		fprintf(out, "\tif (get_instr_ptr() < program_location + 0x%lx\n", start);
+		fprintf(out, "\t\t|| get_instr_ptr() >= program_location + 0x%lx)\n", end);
+		fprintf(out, "\t\treturn;\n\n");
+		fprintf(out, "\tstep();\n");
+		fprintf(out, "\tgoto dispatch;\n");
+		fprintf(out, "}\n\n");
+	}
+
+	/**
+	 * @brief Writes the translation of the program, with the executable
+	 * file embedded in it, a table of its regions and a main function
+	 * that runs it.
+	 * @param out The output file.
+	 * @param file_name The name of the executable.
+	 */
+	void
+	write(FILE *out, const std::string &file_name)
+	{
+		fprintf(out, "// Translated from %s by tea-aot.\n\n", file_name.c_str());
+		fprintf(out, "#include \"AOT/runtime.hpp\"\n\n");
+
+		// The executable is loaded like the VM loads it, so the runtime finds
+		// the static data, the native imports and the original instructions.
+
+		fprintf(out, "static const uint8_t executable_file[] = {");
+
+		for (size_t i = 0; i < file.size; i++)
+		{
+			fprintf(out, i % 16 == 0 ? "\n\t0x%02x," : " 0x%02x,", file.data[i]);
+		}
+
+		fprintf(out, "\n};\n\n");
+
+		for (uint64_t start : region_starts)
+		{
+			write_region(out, start);
+		}
+
+		fprintf(out, "const TranslatedCPU::Region TranslatedCPU::regions[] = {\n");
+
+		for (uint64_t start : region_starts)
+		{
+			fprintf(out, "\t{ 0x%lx, &TranslatedCPU::run_region<0x%lx> },\n", start, start);
+		}
+
+		fprintf(out, "};\n\n");
+		fprintf(out, "const size_t TranslatedCPU::region_count = %zu;\n\n", region_starts.size());
+
+		fprintf(out, "int\nmain()\n{\n");
+		fprintf(out, "\treturn run_translated_executable(executable_file, sizeof(executable_file), \"%s\");\n",
+			file_name.c_str());
+		fprintf(out, "}\n");
+	}
+};
+
+#endif
@@ -9,6 +9,7 @@
 #include "Compiler/ASTNodes/WriteValue.hpp"
 #include "Compiler/ASTNodes/IdentifierExpression.hpp"
 #include "Compiler/ASTNodes/MemberExpression.hpp"
+#include "Compiler/ASTNodes/FunctionCall.hpp"
 #include "Executable/byte-code.hpp"
 #include "Compiler/code-gen/Assembler.hpp"
 #include "Compiler/type-check/TypeCheckState.hpp"
@@ -22,6 +23,10 @@ struct AssignmentExpression final : public ReadValue
 	Operator op;
 	Type::Fits type_fits;
 
+	// Whether the value is a function call that is constructed
+	// in the left hand side directly.
+	bool constructs_in_place = false;
+
 	AssignmentExpression(
 		std::unique_ptr<WriteValue> lhs_expr,
 		std::unique_ptr<ReadValue> value,
@@ -59,6 +64,17 @@ struct AssignmentExpression final : public ReadValue
 		override
 	{
 		lhs_expr->type_check(type_check_state);
+
+		// A call to a function that returns a class can construct
+		// its value in the left hand side directly.
+
+		if (op == ASSIGNMENT && value->node_type == FUNCTION_CALL)
+		{
+			FunctionCall *call    = (FunctionCall *) value.get();
+			constructs_in_place   = call->can_construct_at(type_check_state, lhs_expr->type);
+			call->has_destination = constructs_in_place;
+		}
+
 		value->type_check(type_check_state);
 		type_fits = value->type.fits(lhs_expr->type);
 
@@ -112,6 +128,16 @@ struct AssignmentExpression final : public ReadValue
 	get_value(Assembler &assembler, uint8_t result_reg)
 		const override
 	{
+		// The value of a class is its address, so the address
+		// of the left hand side is the destination of the call.
+
+		if (constructs_in_place)
+		{
+			lhs_expr->get_value(assembler, result_reg);
+			((FunctionCall *) value.get())->construct_at(assembler, result_reg);
+			return;
+		}
+
 		// Moves result into its register
 
 		value->get_value(assembler, result_reg);
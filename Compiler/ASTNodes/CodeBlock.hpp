@@ -61,6 +61,7 @@ struct CodeBlock final : public ASTNode
 	{
 		for (const std::unique_ptr<ASTNode> &statement : statements)
 		{
+			assembler.set_line(statement->accountable_token.line);
 			statement->code_gen(assembler);
 		}
 	}
@@ -97,6 +97,7 @@ struct ForStatement final : public ASTNode
 
 		// Compile code for the update expression
 
+		assembler.set_line(accountable_token.line);
 		update->code_gen(assembler);
 
 		// Jump to the start of the loop again
@@ -13,6 +13,15 @@ struct FunctionCall final : public ReadValue
 	std::vector<std::unique_ptr<ReadValue>> arguments;
 	FunctionSignature fn_signature;
 
+	// Whether the parent constructs the value of this call at its own
+	// destination with `construct_at()`, see `can_construct_at()`.
+	// Must be set before type checking.
+	bool has_destination = false;
+
+	// The temporary that holds the value of this call if it returns
+	// a class in memory and has no destination.
+	LocationData temporary;
+
 	FunctionCall(Token fn_token, std::vector<std::unique_ptr<ReadValue>> &&arguments)
 		: ReadValue(std::move(fn_token), FUNCTION_CALL),
 		  arguments(std::move(arguments)) {}
@@ -55,6 +64,14 @@ struct FunctionCall final : public ReadValue
 
 		// Validate arguments
 
+		if (fn_signature.is_extern && arguments.size() < fn_signature.parameters.size())
+		{
+			err_at_token(accountable_token, "Argument count mismatch",
+				"Extern function %s expects %ld arguments, got %ld",
+				fn_signature.id.name.c_str(), fn_signature.parameters.size(),
+				arguments.size());
+		}
+
 		if (arguments.size() != fn_signature.parameters.size())
 		{
 			warn("At %s, Argument count does not equal parameter count"
@@ -79,16 +96,110 @@ struct FunctionCall final : public ReadValue
 					i + 1, arg->type.to_str().c_str(), param_type.to_str().c_str());
 			}
 		}
+
+		// Classes that are returned in memory need a place to be constructed.
+
+		if (fn_signature.return_convention() != ReturnConvention::REGISTER && !has_destination)
+		{
+			std::string temporary_name = "return-value-" + to_hex((size_t) this);
+			type_check_state.add_var(temporary_name, type);
+
+			IdentifierKind kind = type_check_state.get_identifier_kind(temporary_name);
+			size_t offset       = kind == IdentifierKind::LOCAL
+				      ? type_check_state.get_local(temporary_name).offset
+				      : type_check_state.globals[temporary_name].offset;
+			temporary = LocationData(kind, offset);
+		}
+	}
+
+	/**
+	 * @brief Checks whether the value of this call can be constructed at
+	 * a destination with `construct_at()`, instead of in a temporary.
+	 * This is the case if the function returns a class in memory
+	 * and the destination has the same type.
+	 * Can be called before this call is type checked.
+	 * @param type_check_state The type check state.
+	 * @param destination_type The type of the destination.
+	 */
+	bool
+	can_construct_at(TypeCheckState &type_check_state, const Type &destination_type)
+		const
+	{
+		auto fn = type_check_state.functions.find(accountable_token.value);
+
+		if (fn == type_check_state.functions.end())
+		{
+			return false;
+		}
+
+		return fn->second.return_convention() != ReturnConvention::REGISTER
+			&& fn->second.id.type == destination_type;
 	}
 
 	void
 	get_value(Assembler &assembler, uint8_t result_reg)
 		const override
+	{
+		if (fn_signature.return_convention() == ReturnConvention::REGISTER)
+		{
+			code_gen_call(assembler);
+			assembler.move(R_RET, result_reg);
+			return;
+		}
+
+		// Classes that are returned in memory are constructed in the temporary,
+		// their value is its address.
+
+		assembler.move_lit(temporary.offset, result_reg);
+		assembler.add_int_64(temporary.is_at_frame_top() ? R_FRAME_PTR : R_STACK_TOP_PTR,
+			result_reg);
+		construct_at(assembler, result_reg);
+	}
+
+	/**
+	 * @brief Constructs the value of this call at a destination.
+	 * Only for functions that return a class in memory.
+	 * A value that is returned in a return slot is constructed
+	 * there directly by the function.
+	 * @param dst_ptr_reg The register that holds the address of the destination.
+	 */
+	void
+	construct_at(Assembler &assembler, uint8_t dst_ptr_reg)
+		const
+	{
+		if (fn_signature.return_convention() == ReturnConvention::SLOT)
+		{
+			code_gen_call(assembler, dst_ptr_reg);
+			return;
+		}
+
+		code_gen_call(assembler);
+		assembler.store_return_registers(dst_ptr_reg, type.byte_size());
+	}
+
+	/**
+	 * @brief Pushes the arguments and calls the function.
+	 * The return value is left in the return value registers,
+	 * or in the return slot.
+	 * @param slot_ptr_reg The register that holds the address of the return slot.
+	 * Only for functions that return in a return slot.
+	 */
+	void
+	code_gen_call(Assembler &assembler, std::optional<uint8_t> slot_ptr_reg = std::nullopt)
+		const
 	{
 		uint8_t arg_reg;
 
 		size_t args_size = 0;
 
+		// The address of the return slot is the hidden first parameter.
+
+		if (slot_ptr_reg.has_value())
+		{
+			assembler.push_reg_64(slot_ptr_reg.value());
+			args_size += 8;
+		}
+
 		if (std::min(fn_signature.parameters.size(), arguments.size()))
 			arg_reg = assembler.get_register();
 
@@ -108,15 +219,24 @@ struct FunctionCall final : public ReadValue
 
 			// Implicit type casting
 
-			Type::Fits type_fits = param_type.fits(arg_type);
+			Type::Fits type_fits = arg_type.fits(param_type);
 			if (type_fits == Type::Fits::FLT_32_TO_INT_CAST_NEEDED)
-				assembler.cast_flt_32_to_int(result_reg);
+				assembler.cast_flt_32_to_int(arg_reg);
 			else if (type_fits == Type::Fits::FLT_64_TO_INT_CAST_NEEDED)
-				assembler.cast_flt_64_to_int(result_reg);
+				assembler.cast_flt_64_to_int(arg_reg);
 			else if (type_fits == Type::Fits::INT_TO_FLT_32_CAST_NEEDED)
-				assembler.cast_int_to_flt_32(result_reg);
+				assembler.cast_int_to_flt_32(arg_reg);
 			else if (type_fits == Type::Fits::INT_TO_FLT_64_CAST_NEEDED)
-				assembler.cast_int_to_flt_64(result_reg);
+				assembler.cast_int_to_flt_64(arg_reg);
+
+			// Arguments of native functions are passed in 8-byte slots.
+
+			if (fn_signature.is_extern)
+			{
+				assembler.push_reg_64(arg_reg);
+				args_size += 8;
+				continue;
+			}
 
 			switch (byte_size)
 			{
@@ -159,8 +279,11 @@ struct FunctionCall final : public ReadValue
 		assembler.move_lit(args_size, args_size_reg);
 		assembler.push_reg_64(args_size_reg);
 		assembler.free_register(args_size_reg);
-		assembler.call(fn_signature.id.name);
-		assembler.move(R_RET, result_reg);
+
+		if (fn_signature.is_extern)
+			assembler.call_native(fn_signature.native_import());
+		else
+			assembler.call(fn_signature.id.name);
 	}
 };
 
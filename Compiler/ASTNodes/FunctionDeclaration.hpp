@@ -10,6 +10,7 @@
 #include "Compiler/ASTNodes/TypeIdentifierPair.hpp"
 #include "Compiler/ASTNodes/CodeBlock.hpp"
 #include "Compiler/ASTNodes/VariableDeclaration.hpp"
+#include "Executable/builtin-names.hpp"
 
 struct FunctionDeclaration final : public ASTNode
 {
@@ -19,6 +20,13 @@ struct FunctionDeclaration final : public ASTNode
 	FunctionSignature fn_signature;
 	uint64_t locals_size = 0;
 
+	// Whether this is an extern declaration of a native function.
+	// Extern declarations have no body.
+	bool is_extern = false;
+
+	// The shared library that contains the native function.
+	std::string library;
+
 	FunctionDeclaration(
 		std::unique_ptr<TypeIdentifierPair> type_and_id_pair,
 		std::vector<std::unique_ptr<TypeIdentifierPair>> &&params,
@@ -28,6 +36,16 @@ struct FunctionDeclaration final : public ASTNode
 		  params(std::move(params)),
 		  body(std::move(body)) {}
 
+	FunctionDeclaration(
+		std::unique_ptr<TypeIdentifierPair> type_and_id_pair,
+		std::vector<std::unique_ptr<TypeIdentifierPair>> &&params,
+		std::string library)
+		: ASTNode(type_and_id_pair->accountable_token, FUNCTION_DECLARATION),
+		  type_and_id_pair(std::move(type_and_id_pair)),
+		  params(std::move(params)),
+		  is_extern(true),
+		  library(std::move(library)) {}
+
 	void
 	dfs(std::function<void(ASTNode *, size_t)> callback, size_t depth)
 		override
@@ -39,7 +57,10 @@ struct FunctionDeclaration final : public ASTNode
 			param->dfs(callback, depth + 1);
 		}
 
-		body->dfs(callback, depth + 1);
+		if (body)
+		{
+			body->dfs(callback, depth + 1);
+		}
 
 		callback(this, depth);
 	}
@@ -48,7 +69,9 @@ struct FunctionDeclaration final : public ASTNode
 	to_str()
 		override
 	{
-		std::string s = "FunctionDeclaration {} @ ";
+		std::string s = is_extern
+			? "FunctionDeclaration { extern library = \"" + library + "\" } @ "
+			: "FunctionDeclaration {} @ ";
 		s += to_hex((size_t) this);
 		return s;
 	}
@@ -59,22 +82,63 @@ struct FunctionDeclaration final : public ASTNode
 	{
 		type_and_id_pair->type_check(type_check_state);
 
+		for (std::unique_ptr<TypeIdentifierPair> &param : params)
+		{
+			param->type_check(type_check_state);
+		}
+
+		const std::string &fn_name = type_and_id_pair->get_identifier_name();
 		Type return_type           = type_and_id_pair->type;
-		fn_signature               = FunctionSignature(
-                        type_and_id_pair->get_identifier_name(), return_type);
+		fn_signature               = FunctionSignature(fn_name, return_type);
+
+		// Builtin libc functions that are declared with an empty body
+		// are called like extern functions, they are provided by the VM.
+
+		if (is_builtin())
+		{
+			is_extern = true;
+		}
+
+		fn_signature.is_extern = is_extern;
+		fn_signature.library   = library;
+
+		if (is_extern && !FunctionSignature::is_native_compatible(return_type))
+		{
+			err_at_token(accountable_token, "Type Error",
+				"Extern function %s returns a value of type %s\n"
+				"Native functions can only return primitives and pointers",
+				fn_name.c_str(), return_type.to_str().c_str());
+		}
 
 		// Add parameters
 
 		for (std::unique_ptr<TypeIdentifierPair> &param : params)
 		{
-			param->type_check(type_check_state);
-
 			std::string param_name = param->get_identifier_name();
+
+			if (is_extern)
+			{
+				// A `v0` parameter stands for an empty parameter list.
+
+				if (param->type.byte_size() == 0)
+				{
+					continue;
+				}
+
+				if (!FunctionSignature::is_native_compatible(param->type))
+				{
+					err_at_token(param->accountable_token, "Type Error",
+						"Parameter %s of extern function %s is of type %s\n"
+						"Native functions can only take primitives and pointers",
+						param_name.c_str(), fn_name.c_str(),
+						param->type.to_str().c_str());
+				}
+			}
+
 			fn_signature.parameters.push_back(
 				IdentifierDefinition(param_name, param->type));
 		}
 
-		const std::string &fn_name = type_and_id_pair->get_identifier_name();
 		if (!type_check_state.add_function(fn_name, fn_signature))
 		{
 			err_at_token(accountable_token,
@@ -84,10 +148,94 @@ struct FunctionDeclaration final : public ASTNode
 		}
 	}
 
+	/**
+	 * @brief Checks whether this is a declaration of a builtin libc function.
+	 * This is the case if the function has an empty body, its name is one
+	 * of the builtin functions and its signature can be passed to the runtime.
+	 * Must be called after the parameters are type checked.
+	 */
+	bool
+	is_builtin() const
+	{
+		if (is_extern || !body->statements.empty())
+		{
+			return false;
+		}
+
+		auto builtin = builtin_arities.find(type_and_id_pair->get_identifier_name());
+
+		if (builtin == builtin_arities.end()
+			|| !FunctionSignature::is_native_compatible(type_and_id_pair->type))
+		{
+			return false;
+		}
+
+		size_t param_count = 0;
+
+		for (const std::unique_ptr<TypeIdentifierPair> &param : params)
+		{
+			if (param->type.byte_size() == 0)
+			{
+				continue;
+			}
+
+			if (!FunctionSignature::is_native_compatible(param->type))
+			{
+				return false;
+			}
+
+			param_count++;
+		}
+
+		return param_count == builtin->second;
+	}
+
+	/**
+	 * @brief Checks whether this function can be exported to a host
+	 * that embeds the VM. This is the case if its return value and all
+	 * of its parameters can be represented as native types.
+	 * Must be called after type checking.
+	 * @returns A boolean indicating whether this function can be exported.
+	 */
+	bool
+	is_exportable() const
+	{
+		if (is_extern || !FunctionSignature::is_native_compatible(fn_signature.id.type))
+		{
+			return false;
+		}
+
+		for (const IdentifierDefinition &param : fn_signature.parameters)
+		{
+			if (FunctionSignature::native_type(param.type) == NATIVE_VOID)
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
 	void
 	post_type_check(TypeCheckState &type_check_state)
 		override
 	{
+		// Extern functions have no body to type check.
+
+		if (is_extern)
+		{
+			return;
+		}
+
+		// Large classes are constructed in a return slot of the caller,
+		// its address is passed before the other parameters.
+
+		if (fn_signature.return_convention() == ReturnConvention::SLOT)
+		{
+			type_check_state.add_parameter(RETURN_SLOT_PARAMETER,
+				Type(Type::UNSIGNED_INTEGER, 8));
+		}
+
 		for (std::unique_ptr<TypeIdentifierPair> &param : params)
 		{
 			std::string param_name = param->get_identifier_name();
@@ -109,9 +257,28 @@ struct FunctionDeclaration final : public ASTNode
 	code_gen(Assembler &assembler)
 		const override
 	{
+		// Extern functions are called through the import table,
+		// they don't generate any code.
+
+		if (is_extern)
+		{
+			return;
+		}
+
 		const std::string &fn_name = type_and_id_pair->get_identifier_name();
 
+		assembler.set_line(accountable_token.line);
 		assembler.add_label(fn_name);
+
+		// Functions that can be called from native code
+		// can also be called by a host that embeds the VM.
+
+		if (is_exportable())
+		{
+			NativeImport signature = fn_signature.native_import();
+			assembler.add_export(fn_name, signature.return_type, signature.param_types);
+		}
+
 		if (assembler.debug)
 		{
 			assembler.label(fn_name);
@@ -119,7 +119,7 @@ struct OffsetExpression final : public WriteValue
 		uint8_t temp_reg   = assembler.get_register();
 		offset->get_value(assembler, offset_reg);
 		assembler.move_lit(pointed_type.byte_size(), temp_reg);
-		assembler.mul_int_64(offset_reg, temp_reg);
+		assembler.mul_int_64(temp_reg, offset_reg);
 		assembler.free_register(temp_reg);
 
 		// Add the offset into the pointer.
@@ -3,6 +3,7 @@
 
 #include "Compiler/ASTNodes/ASTNode.hpp"
 #include "Compiler/ASTNodes/ReadValue.hpp"
+#include "Compiler/ASTNodes/FunctionCall.hpp"
 #include "Compiler/tokeniser.hpp"
 #include "Executable/byte-code.hpp"
 #include "Compiler/util.hpp"
@@ -11,6 +12,17 @@ struct ReturnStatement final : public ASTNode
 {
 	std::unique_ptr<ReadValue> expression;
 
+	// How the function returns its value.
+	ReturnConvention return_convention = ReturnConvention::REGISTER;
+
+	// The offset of the return slot parameter, for functions
+	// that return in a return slot.
+	int64_t slot_offset;
+
+	// Whether the expression is a function call that is constructed
+	// in the return value directly.
+	bool constructs_in_place = false;
+
 	ReturnStatement(Token return_token, std::unique_ptr<ReadValue> expression)
 		: ASTNode(std::move(return_token), RETURN_STATEMENT),
 		  expression(std::move(expression)) {}
@@ -40,24 +52,94 @@ struct ReturnStatement final : public ASTNode
 		if (!expression)
 			return;
 
+		const FunctionSignature &fn_signature
+			= type_check_state.functions[type_check_state.current_function_name.value()];
+		return_convention = fn_signature.return_convention();
+
+		// A call to a function that returns the same class can construct
+		// its value in our return value directly.
+
+		if (expression->node_type == FUNCTION_CALL)
+		{
+			FunctionCall *call  = (FunctionCall *) expression.get();
+			constructs_in_place = call->can_construct_at(type_check_state, fn_signature.id.type);
+			call->has_destination = constructs_in_place;
+		}
+
 		expression->type_check(type_check_state);
 		type = expression->type;
+
+		if (return_convention == ReturnConvention::SLOT)
+		{
+			const VariableDefinition &slot = type_check_state.parameters[RETURN_SLOT_PARAMETER];
+			slot_offset = -type_check_state.parameters_size + slot.offset
+				- 8 - STACK_FRAME_SIZE;
+		}
 	}
 
 	void
 	code_gen(Assembler &assembler)
 		const override
 	{
+		if (!expression)
+		{
+			assembler.return_();
+			return;
+		}
+
 		uint8_t res_reg = assembler.get_register();
 
-		// Store value in result register.
+		switch (return_convention)
+		{
+		case ReturnConvention::REGISTER:
+		{
+			// Store value in result register.
 
-		if (expression)
 			expression->get_value(assembler, res_reg);
+			assembler.move(res_reg, R_RET);
+			break;
+		}
+
+		case ReturnConvention::REGISTERS:
+		{
+			// The call leaves the value in the return registers already.
+
+			if (constructs_in_place)
+			{
+				((FunctionCall *) expression.get())->code_gen_call(assembler);
+				break;
+			}
+
+			expression->get_value(assembler, res_reg);
+			assembler.load_return_registers(res_reg, type.byte_size());
+			break;
+		}
+
+		case ReturnConvention::SLOT:
+		{
+			// Construct the value in the return slot and return its address.
+
+			assembler.move_lit(slot_offset, res_reg);
+			assembler.add_int_64(R_FRAME_PTR, res_reg);
+			assembler.load_ptr_64(res_reg, res_reg);
+
+			if (constructs_in_place)
+			{
+				((FunctionCall *) expression.get())->construct_at(assembler, res_reg);
+			}
+			else
+			{
+				uint8_t value_reg = assembler.get_register();
+				expression->get_value(assembler, value_reg);
+				assembler.mem_copy(value_reg, res_reg, type.byte_size());
+				assembler.free_register(value_reg);
+			}
 
-		// Return value.
+			assembler.move(res_reg, R_RET);
+			break;
+		}
+		}
 
-		assembler.move(res_reg, R_RET);
 		assembler.free_register(res_reg);
 		assembler.return_();
 	}
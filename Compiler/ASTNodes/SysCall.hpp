@@ -7,7 +7,12 @@
 #include "Compiler/ASTNodes/ASTNode.hpp"
 #include "Compiler/ASTNodes/ReadValue.hpp"
 
-std::set<std::string> syscall_names = { "PRINT_CHAR", "GET_CHAR" };
+std::set<std::string> syscall_names = { "PRINT_CHAR", "GET_CHAR", "PRINT_U64", "PRINT_I64",
+	"PRINT_F64", "PRINT_HEX", "PRINT_STR", "MAP_NEW", "MAP_FREE", "MAP_PUT", "MAP_GET",
+	"MAP_HAS", "MAP_DEL", "MAP_ITER", "FILE_OPEN", "FILE_READ", "FILE_WRITE", "FILE_PREAD",
+	"FILE_SEEK", "FILE_CLOSE", "FILE_STAT", "MMAP_FILE", "MUNMAP_FILE", "AIO_SUBMIT",
+	"AIO_POLL", "THREAD_SPAWN", "THREAD_JOIN", "CHAN_NEW", "CHAN_FREE", "CHAN_SEND",
+	"CHAN_RECV", "CHAN_TRY_RECV", "BENCH_BEGIN", "BENCH_END" };
 
 struct SysCall final : public ASTNode
 {
@@ -42,10 +47,511 @@ struct SysCall final : public ASTNode
 	type_check(TypeCheckState &type_check_state)
 		override
 	{
-		for (size_t i = 0; i < arguments.size(); i++)
+		const std::string &name = accountable_token.value;
+
+		// The first argument of THREAD_SPAWN is a function, not a value.
+
+		for (size_t i = name == "THREAD_SPAWN" ? 1 : 0; i < arguments.size(); i++)
 		{
 			arguments[i]->type_check(type_check_state);
 		}
+
+		if (name == "PRINT_U64" || name == "PRINT_I64" || name == "PRINT_HEX")
+		{
+			check_argument_count(1, "an integer as argument");
+			check_integer_argument(0, "the integer to print");
+		}
+
+		else if (name == "PRINT_F64")
+		{
+			if (arguments.size() != 1 && arguments.size() != 2)
+			{
+				err_at_token(accountable_token, "Type Error",
+					"Argument count in PRINT_F64 SysCall is not equal to 1 or 2\n"
+					"Expected a float and optionally the number of digits "
+					"after the decimal point as arguments");
+			}
+
+			const Type &type = arguments[0]->type;
+
+			if (type.pointer_depth() != 0 || type != Type::FLOATING_POINT)
+			{
+				err_at_token(accountable_token, "Type Error",
+					"Argument 1 in PRINT_F64 SysCall is not a float\n"
+					"Expected a float to print");
+			}
+
+			if (arguments.size() == 2)
+			{
+				check_integer_argument(1, "the number of digits after the decimal point");
+			}
+		}
+
+		else if (name == "PRINT_STR")
+		{
+			check_argument_count(1, "a pointer to a null-terminated string as argument");
+			check_string_argument(0, "a null-terminated string");
+		}
+
+		else if (name == "MAP_NEW")
+		{
+			check_argument_count(1, "a pointer to the map handle as argument");
+			check_out_argument(0, "the map handle");
+		}
+
+		else if (name == "MAP_FREE")
+		{
+			check_argument_count(1, "a map handle as argument");
+			check_handle_argument(0, "map");
+		}
+
+		else if (name == "MAP_PUT")
+		{
+			check_argument_count(has_byte_string_key() ? 4 : 3, "a map handle, a key "
+				"(an integer, or a pointer and a length) and a value as arguments");
+			check_handle_argument(0, "map");
+			check_map_key();
+		}
+
+		else if (name == "MAP_GET")
+		{
+			check_argument_count(has_byte_string_key() ? 4 : 3, "a map handle, a key "
+				"(an integer, or a pointer and a length) and a pointer to the value "
+				"as arguments");
+			check_handle_argument(0, "map");
+			check_map_key();
+			check_out_argument(arguments.size() - 1, "the value");
+		}
+
+		else if (name == "MAP_HAS")
+		{
+			check_argument_count(has_byte_string_key() ? 4 : 3, "a map handle, a key "
+				"(an integer, or a pointer and a length) and a pointer to whether "
+				"the key is present as arguments");
+			check_handle_argument(0, "map");
+			check_map_key();
+			check_out_argument(arguments.size() - 1, "whether the key is present");
+		}
+
+		else if (name == "MAP_DEL")
+		{
+			check_argument_count(has_byte_string_key() ? 3 : 2, "a map handle and a key "
+				"(an integer, or a pointer and a length) as arguments");
+			check_handle_argument(0, "map");
+			check_map_key();
+		}
+
+		else if (name == "MAP_ITER")
+		{
+			check_argument_count(4, "a map handle and pointers to the cursor, "
+				"the key and the value as arguments");
+			check_handle_argument(0, "map");
+			check_out_argument(1, "the cursor");
+			check_out_argument(2, "the key");
+			check_out_argument(3, "the value");
+		}
+
+		else if (name == "FILE_OPEN")
+		{
+			check_argument_count(3, "a path, the mode bits and a pointer to "
+				"the file descriptor as arguments");
+			check_string_argument(0, "a null-terminated path");
+			check_integer_argument(1, "the mode bits");
+			check_out_argument(2, "the file descriptor");
+		}
+
+		else if (name == "FILE_READ" || name == "FILE_WRITE")
+		{
+			check_argument_count(4, "a file descriptor, a buffer, its size and "
+				"a pointer to the number of bytes as arguments");
+			check_integer_argument(0, "a file descriptor");
+			check_pointer_argument(1, "a buffer");
+			check_integer_argument(2, "the size of the buffer");
+			check_out_argument(3, "the number of bytes");
+		}
+
+		else if (name == "FILE_PREAD")
+		{
+			check_argument_count(5, "a file descriptor, a buffer, its size, an offset "
+				"and a pointer to the number of bytes as arguments");
+			check_integer_argument(0, "a file descriptor");
+			check_pointer_argument(1, "a buffer");
+			check_integer_argument(2, "the size of the buffer");
+			check_integer_argument(3, "an offset in the file");
+			check_out_argument(4, "the number of bytes");
+		}
+
+		else if (name == "FILE_SEEK")
+		{
+			check_argument_count(4, "a file descriptor, an offset, what the offset "
+				"is relative to and a pointer to the new position as arguments");
+			check_integer_argument(0, "a file descriptor");
+			check_integer_argument(1, "an offset");
+			check_integer_argument(2, "0 for the start, 1 for the current position "
+				"or 2 for the end of the file");
+			check_out_argument(3, "the new position");
+		}
+
+		else if (name == "FILE_CLOSE")
+		{
+			check_argument_count(2, "a file descriptor and a pointer to "
+				"the result as arguments");
+			check_integer_argument(0, "a file descriptor");
+			check_out_argument(1, "the result");
+		}
+
+		else if (name == "FILE_STAT")
+		{
+			check_argument_count(3, "a file descriptor, a pointer to three 64-bit "
+				"values and a pointer to the result as arguments");
+			check_integer_argument(0, "a file descriptor");
+			check_pointer_argument(1, "three 64-bit values");
+			check_out_argument(2, "the result");
+		}
+
+		else if (name == "MMAP_FILE")
+		{
+			check_argument_count(4, "a file descriptor, a length, an offset and "
+				"a pointer to the address as arguments");
+			check_integer_argument(0, "a file descriptor");
+			check_integer_argument(1, "the number of bytes to map");
+			check_integer_argument(2, "an offset in the file");
+			check_out_argument(3, "the address");
+		}
+
+		else if (name == "MUNMAP_FILE")
+		{
+			check_argument_count(3, "an address, a length and a pointer to "
+				"the result as arguments");
+			check_pointer_argument(0, "the address of the mapping");
+			check_integer_argument(1, "the number of mapped bytes");
+			check_out_argument(2, "the result");
+		}
+
+		else if (name == "AIO_SUBMIT")
+		{
+			check_argument_count(7, "an operation, a file descriptor, a buffer, "
+				"its size, an offset, a tag and a pointer to the result as arguments");
+			check_integer_argument(0, "0 to read or 1 to write");
+			check_integer_argument(1, "a file descriptor");
+			check_pointer_argument(2, "a buffer");
+			check_integer_argument(3, "the size of the buffer");
+			check_integer_argument(4, "an offset in the file");
+			check_integer_argument(5, "a tag");
+			check_out_argument(6, "the result");
+		}
+
+		else if (name == "AIO_POLL")
+		{
+			check_argument_count(4, "a pointer to the completions, the maximum and "
+				"minimum number of completions and a pointer to the number of "
+				"completions as arguments");
+			check_pointer_argument(0, "pairs of 64-bit tags and results");
+			check_integer_argument(1, "the maximum number of completions");
+			check_integer_argument(2, "the number of completions to wait for");
+			check_out_argument(3, "the number of completions");
+		}
+
+		else if (name == "THREAD_SPAWN")
+		{
+			check_argument_count(3, "a function, its argument and a pointer to "
+				"the thread handle as arguments");
+			check_thread_function(type_check_state);
+			check_out_argument(2, "the thread handle");
+		}
+
+		else if (name == "THREAD_JOIN")
+		{
+			check_argument_count(2, "a thread handle and a pointer to the return "
+				"value as arguments");
+			check_handle_argument(0, "thread");
+			check_out_argument(1, "the return value");
+		}
+
+		else if (name == "CHAN_NEW")
+		{
+			check_argument_count(3, "a capacity, a kind and a pointer to the channel "
+				"handle as arguments");
+			check_integer_argument(0, "the capacity of the channel");
+			check_integer_argument(1, "0 for a multi-producer multi-consumer channel "
+				"or 1 for a single-producer single-consumer channel");
+			check_out_argument(2, "the channel handle");
+		}
+
+		else if (name == "CHAN_FREE")
+		{
+			check_argument_count(1, "a channel handle as argument");
+			check_handle_argument(0, "channel");
+		}
+
+		else if (name == "CHAN_SEND")
+		{
+			check_argument_count(2, "a channel handle and a message as arguments");
+			check_handle_argument(0, "channel");
+
+			if (arguments[1]->type.byte_size() > 8)
+			{
+				err_at_token(accountable_token, "Type Error",
+					"Argument 2 in CHAN_SEND SysCall is larger than 64 bits\n"
+					"Expected an integer or a pointer as message");
+			}
+		}
+
+		else if (name == "CHAN_RECV")
+		{
+			check_argument_count(2, "a channel handle and a pointer to the message "
+				"as arguments");
+			check_handle_argument(0, "channel");
+			check_out_argument(1, "the message");
+		}
+
+		else if (name == "CHAN_TRY_RECV")
+		{
+			check_argument_count(3, "a channel handle, a pointer to the message and "
+				"a pointer to whether a message was received as arguments");
+			check_handle_argument(0, "channel");
+			check_out_argument(1, "the message");
+			check_out_argument(2, "whether a message was received");
+		}
+
+		else if (name == "BENCH_BEGIN" || name == "BENCH_END")
+		{
+			check_argument_count(1, "the id of the region as argument");
+			check_integer_argument(0, "the id of the region");
+		}
+	}
+
+	/**
+	 * @brief Checks that the first argument of THREAD_SPAWN names a function
+	 * that takes a 64-bit value and returns a value of at most 64 bits.
+	 * @param type_check_state The type check state.
+	 */
+	void
+	check_thread_function(TypeCheckState &type_check_state)
+		const
+	{
+		const ReadValue &function = *arguments[0];
+
+		if (function.node_type != IDENTIFIER_EXPRESSION
+			|| !type_check_state.functions.count(function.accountable_token.value))
+		{
+			err_at_token(accountable_token, "Type Error",
+				"Argument 1 in THREAD_SPAWN SysCall is not a function\n"
+				"Expected the name of the function to start");
+		}
+
+		const FunctionSignature &signature
+			= type_check_state.functions[function.accountable_token.value];
+
+		if (signature.is_extern || signature.parameters.size() != 1
+			|| signature.parameters[0].type.byte_size() != 8
+			|| signature.id.type.byte_size() > 8)
+		{
+			err_at_token(accountable_token, "Type Error",
+				"Function %s in THREAD_SPAWN SysCall cannot be started as a thread\n"
+				"Expected a function with one 64-bit parameter, "
+				"that returns a value of at most 64 bits",
+				function.accountable_token.value.c_str());
+		}
+
+		if (arguments[1]->type.byte_size() > 8)
+		{
+			err_at_token(accountable_token, "Type Error",
+				"Argument 2 in THREAD_SPAWN SysCall is larger than 64 bits\n"
+				"Expected an integer or a pointer as argument of the function");
+		}
+	}
+
+	/**
+	 * @returns Whether the syscall operates on files.
+	 * The last argument of these syscalls is a pointer to the result,
+	 * all other arguments are passed in registers.
+	 */
+	bool
+	is_file_syscall()
+		const
+	{
+		const std::string &name = accountable_token.value;
+		return name.compare(0, 5, "FILE_") == 0 || name.compare(0, 4, "AIO_") == 0
+			|| name == "MMAP_FILE" || name == "MUNMAP_FILE";
+	}
+
+	/**
+	 * @brief Checks the number of arguments of the syscall.
+	 * @param count The expected number of arguments.
+	 * @param expected A description of the expected arguments.
+	 */
+	void
+	check_argument_count(size_t count, const char *expected)
+		const
+	{
+		if (arguments.size() != count)
+		{
+			err_at_token(accountable_token, "Type Error",
+				"Argument count in %s SysCall is not equal to %lu\n"
+				"Expected %s",
+				accountable_token.value.c_str(), count, expected);
+		}
+	}
+
+	/**
+	 * @brief Checks that an argument is an integer.
+	 * @param i The index of the argument.
+	 * @param what A description of the argument.
+	 */
+	void
+	check_integer_argument(size_t i, const char *what)
+		const
+	{
+		const Type &type = arguments[i]->type;
+
+		if (type.pointer_depth() != 0 || !type.is_integer())
+		{
+			err_at_token(accountable_token, "Type Error",
+				"Argument %lu in %s SysCall is not an integer\n"
+				"Expected %s",
+				i + 1, accountable_token.value.c_str(), what);
+		}
+	}
+
+	/**
+	 * @brief Checks that an argument is a pointer.
+	 * @param i The index of the argument.
+	 * @param what A description of what the pointer points to.
+	 */
+	void
+	check_pointer_argument(size_t i, const char *what)
+		const
+	{
+		if (arguments[i]->type.pointer_depth() == 0)
+		{
+			err_at_token(accountable_token, "Type Error",
+				"Argument %lu in %s SysCall is not a pointer\n"
+				"Expected a pointer to %s",
+				i + 1, accountable_token.value.c_str(), what);
+		}
+	}
+
+	/**
+	 * @brief Checks that an argument is a pointer to characters.
+	 * @param i The index of the argument.
+	 * @param what A description of the string.
+	 */
+	void
+	check_string_argument(size_t i, const char *what)
+		const
+	{
+		const Type &type = arguments[i]->type;
+
+		if (type.pointer_depth() != 1 || type.pointed_type().byte_size() != 1)
+		{
+			err_at_token(accountable_token, "Type Error",
+				"Argument %lu in %s SysCall is not a pointer to characters\n"
+				"Expected a pointer to %s",
+				i + 1, accountable_token.value.c_str(), what);
+		}
+	}
+
+	/**
+	 * @brief Checks that an argument is a handle.
+	 * @param i The index of the argument.
+	 * @param what What the handle refers to.
+	 */
+	void
+	check_handle_argument(size_t i, const char *what)
+		const
+	{
+		if (arguments[i]->type.byte_size() != 8)
+		{
+			err_at_token(accountable_token, "Type Error",
+				"Argument %lu in %s SysCall is not a %s handle\n"
+				"Expected a 64-bit %s handle",
+				i + 1, accountable_token.value.c_str(), what, what);
+		}
+	}
+
+	/**
+	 * @brief Checks that an argument is a pointer to a 64-bit value,
+	 * which the syscall writes its result to.
+	 * @param i The index of the argument.
+	 * @param what A description of the result.
+	 */
+	void
+	check_out_argument(size_t i, const char *what)
+		const
+	{
+		const Type &type = arguments[i]->type;
+
+		if (type.pointer_depth() == 0 || type.pointed_type().byte_size() != 8)
+		{
+			err_at_token(accountable_token, "Type Error",
+				"Argument %lu in %s SysCall is not a pointer to a 64-bit value\n"
+				"Expected a pointer to %s",
+				i + 1, accountable_token.value.c_str(), what);
+		}
+	}
+
+	/**
+	 * @returns Whether the key of a map syscall is a byte string,
+	 * which is passed as a pointer and a length.
+	 * Otherwise the key is a single integer.
+	 */
+	bool
+	has_byte_string_key()
+		const
+	{
+		return arguments.size() >= 2 && arguments[1]->type.pointer_depth() != 0;
+	}
+
+	/**
+	 * @brief Checks the length of a byte string key of a map syscall.
+	 */
+	void
+	check_map_key()
+		const
+	{
+		if (has_byte_string_key())
+		{
+			check_integer_argument(2, "an integer as key length");
+		}
+	}
+
+	/**
+	 * @brief Loads the key of a map syscall into registers.
+	 * The key starts at the second argument.
+	 * @param assembler The assembler.
+	 * @param key_reg The destination register for the key.
+	 * @param len_reg The destination register for the key length.
+	 */
+	void
+	load_map_key(Assembler &assembler, uint8_t key_reg, uint8_t len_reg)
+		const
+	{
+		arguments[1]->get_value(assembler, key_reg);
+
+		if (!has_byte_string_key())
+		{
+			assembler.move_lit(HASH_MAP_INT_KEY, len_reg);
+			return;
+		}
+
+		arguments[2]->get_value(assembler, len_reg);
+	}
+
+	/**
+	 * @brief Stores a register through a pointer argument.
+	 * @param assembler The assembler.
+	 * @param i The index of the argument.
+	 * @param value_reg The register to store.
+	 */
+	void
+	store_to_argument(Assembler &assembler, size_t i, uint8_t value_reg)
+		const
+	{
+		uint8_t addr_reg = assembler.get_register();
+		arguments[i]->get_value(assembler, addr_reg);
+		assembler.store_ptr_64(value_reg, addr_reg);
+		assembler.free_register(addr_reg);
 	}
 
 	void
@@ -108,6 +614,310 @@ struct SysCall final : public ASTNode
 			assembler.free_register(char_reg);
 			assembler.free_register(addr_reg);
 		}
+
+		else if (accountable_token.value == "PRINT_U64"
+			|| accountable_token.value == "PRINT_I64"
+			|| accountable_token.value == "PRINT_HEX")
+		{
+			const std::unique_ptr<ReadValue> &value = arguments[0];
+			uint8_t value_reg                       = assembler.get_register();
+			uint8_t size                            = value->type.byte_size();
+
+			value->get_value(assembler, value_reg);
+
+			if (accountable_token.value == "PRINT_U64")
+				assembler.print_u64(value_reg, size);
+			else if (accountable_token.value == "PRINT_I64")
+				assembler.print_i64(value_reg, size);
+			else
+				assembler.print_hex(value_reg, size);
+
+			assembler.free_register(value_reg);
+		}
+
+		else if (accountable_token.value == "PRINT_F64")
+		{
+			// Prints 6 digits after the decimal point by default, like printf.
+
+			uint8_t value_reg     = assembler.get_register();
+			uint8_t precision_reg = assembler.get_register();
+
+			arguments[0]->get_value(assembler, value_reg);
+
+			if (arguments.size() == 2)
+				arguments[1]->get_value(assembler, precision_reg);
+			else
+				assembler.move_lit(6, precision_reg);
+
+			assembler.print_f64(value_reg, precision_reg, arguments[0]->type.byte_size());
+
+			assembler.free_register(precision_reg);
+			assembler.free_register(value_reg);
+		}
+
+		else if (accountable_token.value == "PRINT_STR")
+		{
+			uint8_t str_reg = assembler.get_register();
+			arguments[0]->get_value(assembler, str_reg);
+			assembler.print_str(str_reg);
+
+			assembler.free_register(str_reg);
+		}
+
+		else if (accountable_token.value == "MAP_NEW")
+		{
+			uint8_t map_reg = assembler.get_register();
+			assembler.map_new(map_reg);
+			store_to_argument(assembler, 0, map_reg);
+
+			assembler.free_register(map_reg);
+		}
+
+		else if (accountable_token.value == "MAP_FREE")
+		{
+			uint8_t map_reg = assembler.get_register();
+			arguments[0]->get_value(assembler, map_reg);
+			assembler.map_free(map_reg);
+
+			assembler.free_register(map_reg);
+		}
+
+		else if (accountable_token.value == "MAP_PUT")
+		{
+			uint8_t map_reg   = assembler.get_register();
+			uint8_t key_reg   = assembler.get_register();
+			uint8_t len_reg   = assembler.get_register();
+			uint8_t value_reg = assembler.get_register();
+
+			arguments[0]->get_value(assembler, map_reg);
+			load_map_key(assembler, key_reg, len_reg);
+			arguments.back()->get_value(assembler, value_reg);
+			assembler.map_put(map_reg, key_reg, len_reg, value_reg);
+
+			assembler.free_register(value_reg);
+			assembler.free_register(len_reg);
+			assembler.free_register(key_reg);
+			assembler.free_register(map_reg);
+		}
+
+		else if (accountable_token.value == "MAP_GET")
+		{
+			uint8_t map_reg   = assembler.get_register();
+			uint8_t key_reg   = assembler.get_register();
+			uint8_t len_reg   = assembler.get_register();
+			uint8_t value_reg = assembler.get_register();
+
+			arguments[0]->get_value(assembler, map_reg);
+			load_map_key(assembler, key_reg, len_reg);
+			assembler.map_get(map_reg, key_reg, len_reg, value_reg);
+			store_to_argument(assembler, arguments.size() - 1, value_reg);
+
+			assembler.free_register(value_reg);
+			assembler.free_register(len_reg);
+			assembler.free_register(key_reg);
+			assembler.free_register(map_reg);
+		}
+
+		else if (accountable_token.value == "MAP_HAS")
+		{
+			uint8_t map_reg    = assembler.get_register();
+			uint8_t key_reg    = assembler.get_register();
+			uint8_t len_reg    = assembler.get_register();
+			uint8_t result_reg = assembler.get_register();
+
+			arguments[0]->get_value(assembler, map_reg);
+			load_map_key(assembler, key_reg, len_reg);
+			assembler.map_has(map_reg, key_reg, len_reg, result_reg);
+			store_to_argument(assembler, arguments.size() - 1, result_reg);
+
+			assembler.free_register(result_reg);
+			assembler.free_register(len_reg);
+			assembler.free_register(key_reg);
+			assembler.free_register(map_reg);
+		}
+
+		else if (accountable_token.value == "MAP_DEL")
+		{
+			uint8_t map_reg = assembler.get_register();
+			uint8_t key_reg = assembler.get_register();
+			uint8_t len_reg = assembler.get_register();
+
+			arguments[0]->get_value(assembler, map_reg);
+			load_map_key(assembler, key_reg, len_reg);
+			assembler.map_del(map_reg, key_reg, len_reg);
+
+			assembler.free_register(len_reg);
+			assembler.free_register(key_reg);
+			assembler.free_register(map_reg);
+		}
+
+		else if (accountable_token.value == "MAP_ITER")
+		{
+			uint8_t map_reg    = assembler.get_register();
+			uint8_t cursor_reg = assembler.get_register();
+			uint8_t key_reg    = assembler.get_register();
+			uint8_t value_reg  = assembler.get_register();
+
+			arguments[0]->get_value(assembler, map_reg);
+			arguments[1]->get_value(assembler, cursor_reg);
+			assembler.load_ptr_64(cursor_reg, cursor_reg);
+			assembler.map_iter(map_reg, cursor_reg, key_reg, value_reg);
+			store_to_argument(assembler, 1, cursor_reg);
+			store_to_argument(assembler, 2, key_reg);
+			store_to_argument(assembler, 3, value_reg);
+
+			assembler.free_register(value_reg);
+			assembler.free_register(key_reg);
+			assembler.free_register(cursor_reg);
+			assembler.free_register(map_reg);
+		}
+
+		else if (accountable_token.value == "THREAD_SPAWN")
+		{
+			uint8_t arg_reg    = assembler.get_register();
+			uint8_t handle_reg = assembler.get_register();
+
+			arguments[1]->get_value(assembler, arg_reg);
+			assembler.thread_spawn(arguments[0]->accountable_token.value, arg_reg, handle_reg);
+			store_to_argument(assembler, 2, handle_reg);
+
+			assembler.free_register(handle_reg);
+			assembler.free_register(arg_reg);
+		}
+
+		else if (accountable_token.value == "THREAD_JOIN")
+		{
+			uint8_t handle_reg = assembler.get_register();
+			arguments[0]->get_value(assembler, handle_reg);
+			assembler.thread_join(handle_reg, handle_reg);
+			store_to_argument(assembler, 1, handle_reg);
+
+			assembler.free_register(handle_reg);
+		}
+
+		else if (accountable_token.value == "CHAN_NEW")
+		{
+			uint8_t capacity_reg = assembler.get_register();
+			uint8_t kind_reg     = assembler.get_register();
+
+			arguments[0]->get_value(assembler, capacity_reg);
+			arguments[1]->get_value(assembler, kind_reg);
+			assembler.chan_new(capacity_reg, kind_reg, capacity_reg);
+			store_to_argument(assembler, 2, capacity_reg);
+
+			assembler.free_register(kind_reg);
+			assembler.free_register(capacity_reg);
+		}
+
+		else if (accountable_token.value == "CHAN_FREE")
+		{
+			uint8_t chan_reg = assembler.get_register();
+			arguments[0]->get_value(assembler, chan_reg);
+			assembler.chan_free(chan_reg);
+
+			assembler.free_register(chan_reg);
+		}
+
+		else if (accountable_token.value == "CHAN_SEND")
+		{
+			uint8_t chan_reg  = assembler.get_register();
+			uint8_t value_reg = assembler.get_register();
+
+			arguments[0]->get_value(assembler, chan_reg);
+			arguments[1]->get_value(assembler, value_reg);
+			assembler.chan_send(chan_reg, value_reg);
+
+			assembler.free_register(value_reg);
+			assembler.free_register(chan_reg);
+		}
+
+		else if (accountable_token.value == "CHAN_RECV")
+		{
+			uint8_t chan_reg = assembler.get_register();
+			arguments[0]->get_value(assembler, chan_reg);
+			assembler.chan_recv(chan_reg, chan_reg);
+			store_to_argument(assembler, 1, chan_reg);
+
+			assembler.free_register(chan_reg);
+		}
+
+		else if (accountable_token.value == "CHAN_TRY_RECV")
+		{
+			uint8_t chan_reg = assembler.get_register();
+			uint8_t ok_reg   = assembler.get_register();
+
+			arguments[0]->get_value(assembler, chan_reg);
+			assembler.chan_try_recv(chan_reg, chan_reg, ok_reg);
+			store_to_argument(assembler, 1, chan_reg);
+			store_to_argument(assembler, 2, ok_reg);
+
+			assembler.free_register(ok_reg);
+			assembler.free_register(chan_reg);
+		}
+
+		else if (accountable_token.value == "BENCH_BEGIN")
+		{
+			uint8_t id_reg = assembler.get_register();
+			arguments[0]->get_value(assembler, id_reg);
+			assembler.bench_begin(id_reg);
+
+			assembler.free_register(id_reg);
+		}
+
+		else if (accountable_token.value == "BENCH_END")
+		{
+			uint8_t id_reg = assembler.get_register();
+			arguments[0]->get_value(assembler, id_reg);
+			assembler.bench_end(id_reg);
+
+			assembler.free_register(id_reg);
+		}
+
+		else if (is_file_syscall())
+		{
+			const std::string &name = accountable_token.value;
+			std::vector<uint8_t> regs;
+
+			for (size_t i = 0; i + 1 < arguments.size(); i++)
+			{
+				regs.push_back(assembler.get_register());
+				arguments[i]->get_value(assembler, regs.back());
+			}
+
+			uint8_t result_reg = assembler.get_register();
+
+			if (name == "FILE_OPEN")
+				assembler.file_open(regs[0], regs[1], result_reg);
+			else if (name == "FILE_READ")
+				assembler.file_read(regs[0], regs[1], regs[2], result_reg);
+			else if (name == "FILE_WRITE")
+				assembler.file_write(regs[0], regs[1], regs[2], result_reg);
+			else if (name == "FILE_PREAD")
+				assembler.file_pread(regs[0], regs[1], regs[2], regs[3], result_reg);
+			else if (name == "FILE_SEEK")
+				assembler.file_seek(regs[0], regs[1], regs[2], result_reg);
+			else if (name == "FILE_CLOSE")
+				assembler.file_close(regs[0], result_reg);
+			else if (name == "FILE_STAT")
+				assembler.file_stat(regs[0], regs[1], result_reg);
+			else if (name == "MMAP_FILE")
+				assembler.mmap_file(regs[0], regs[1], regs[2], result_reg);
+			else if (name == "MUNMAP_FILE")
+				assembler.munmap_file(regs[0], regs[1], result_reg);
+			else if (name == "AIO_SUBMIT")
+				assembler.aio_submit(regs[0], regs[1], regs[2], regs[3], regs[4],
+					regs[5], result_reg);
+			else
+				assembler.aio_poll(regs[0], regs[1], regs[2], result_reg);
+
+			store_to_argument(assembler, arguments.size() - 1, result_reg);
+			assembler.free_register(result_reg);
+
+			for (size_t i = regs.size(); i-- > 0;)
+			{
+				assembler.free_register(regs[i]);
+			}
+		}
 	}
 };
 
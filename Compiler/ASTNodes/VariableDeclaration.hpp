@@ -4,6 +4,7 @@
 #include "Compiler/ASTNodes/ASTNode.hpp"
 #include "Compiler/ASTNodes/ReadValue.hpp"
 #include "Compiler/ASTNodes/IdentifierExpression.hpp"
+#include "Compiler/ASTNodes/FunctionCall.hpp"
 #include "Compiler/tokeniser.hpp"
 #include "Executable/byte-code.hpp"
 #include "Compiler/util.hpp"
@@ -18,6 +19,10 @@ struct VariableDeclaration final : public ASTNode
 	IdentifierKind id_kind;
 	VariableDefinition variable_definition;
 
+	// Whether the initial value is a function call that is constructed
+	// in the variable directly.
+	bool constructs_in_place = false;
+
 	VariableDeclaration(std::unique_ptr<TypeIdentifierPair> type_and_id_pair,
 		std::unique_ptr<ReadValue> assignment)
 		: ASTNode(type_and_id_pair->accountable_token, VARIABLE_DECLARATION),
@@ -71,6 +76,16 @@ struct VariableDeclaration final : public ASTNode
 			return;
 		}
 
+		// A call to a function that returns a class can construct
+		// its value in the variable directly.
+
+		if (assignment->node_type == FUNCTION_CALL)
+		{
+			FunctionCall *call    = (FunctionCall *) assignment.get();
+			constructs_in_place   = call->can_construct_at(type_check_state, type);
+			call->has_destination = constructs_in_place;
+		}
+
 		assignment->type_check(type_check_state);
 
 		// Match types
@@ -118,25 +133,31 @@ struct VariableDeclaration final : public ASTNode
 	{
 		uint8_t init_value_reg;
 
-		if (type == Type::USER_DEFINED_CLASS)
+		// Array declaration
+
+		if (type.is_array())
 		{
 			return;
 		}
 
-		// Array declaration
+		if (!assignment)
+			return;
+
+		init_value_reg = assembler.get_register();
+
+		// The value of a class is its address,
+		// construct the initial value there
 
-		else if (type.is_array())
+		if (constructs_in_place)
 		{
+			id_expr.get_value(assembler, init_value_reg);
+			((FunctionCall *) assignment.get())->construct_at(assembler, init_value_reg);
+			assembler.free_register(init_value_reg);
 			return;
 		}
 
-		// Primitive type declaration
 		// Get the expression value into a register and store it in memory
 
-		if (!assignment)
-			return;
-
-		init_value_reg = assembler.get_register();
 		assignment->get_value(assembler, init_value_reg);
 		id_expr.store(assembler, init_value_reg);
 		assembler.free_register(init_value_reg);
@@ -83,6 +83,7 @@ struct WhileStatement final : public ASTNode
 
 		// Jump to the start of the loop again
 
+		assembler.set_line(accountable_token.line);
 		assembler.jump(start_label);
 
 		// Create the end label
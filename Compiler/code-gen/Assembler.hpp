@@ -1,11 +1,16 @@
 #ifndef TEA_ASSEMBLER_HEADER
 #define TEA_ASSEMBLER_HEADER
 
+#include <algorithm>
 #include <unordered_map>
 #include <stack>
 
 #include "VM/cpu.hpp"
 #include "Executable/byte-code.hpp"
+#include "Executable/native-import.hpp"
+#include "Executable/line-table.hpp"
+#include "Executable/export-table.hpp"
+#include "Executable/sections.hpp"
 #include "Compiler/code-gen/buffer-builder.hpp"
 
 /**
@@ -80,6 +85,44 @@ struct Assembler : public BufferBuilder
 	 */
 	BufferBuilder static_data;
 
+	/**
+	 * @brief The import table of the program.
+	 * Contains all native functions that are called by the program.
+	 * It is later built and appended to the program.
+	 */
+	std::vector<NativeImport> native_imports;
+
+	/**
+	 * @brief Map containing the index of each native function
+	 * in the import table. The key is the symbol name.
+	 */
+	std::unordered_map<std::string /* symbol */, uint32_t /* index */> native_import_ids;
+
+	/**
+	 * @brief The export table of the program.
+	 * Contains all functions that can be called by a host
+	 * that embeds the VM. It is appended after the import table.
+	 */
+	ExportTable export_table;
+
+	/**
+	 * @brief The line table of the program.
+	 * Only filled when debug symbols are generated.
+	 */
+	LineTable line_table;
+
+	// The source line that instructions are currently generated for.
+	// Line 0 is used for instructions that have no source line.
+	uint64_t current_line = 0;
+
+	// The size of the global variables of the program.
+	// Stored as the zero-initialised data section.
+	uint64_t zero_data_size = 0;
+
+	// The debugger symbols of the program, in the format of a
+	// debugger symbols file. Empty if they are not generated.
+	std::string debug_info;
+
 	// Whether debug symbols should be generated.
 	const bool debug;
 
@@ -135,36 +178,98 @@ struct Assembler : public BufferBuilder
 	}
 
 	/**
-	 * @brief Assembles the program into byte code.
-	 * @returns A buffer containing the byte code.
+	 * @brief Assembles the program into a sectioned executable,
+	 * see `SectionTable`.
+	 * @returns A buffer containing the executable.
 	 */
 	Buffer
 	assemble()
 	{
-		BufferBuilder executable;
+		SectionTable sections;
 		update_label_references();
 
-		// Push the size of the static data segment
-		// and the size of the program instructions.
+		sections.add(SECTION_CODE, data(), offset);
 
-		executable.push<uint64_t>(static_data.offset);
-		executable.push<uint64_t>(offset);
+		// Static data is written in reverse, see `add_static_data()`.
+		// The section holds it in memory order.
 
-		// Combine static data and program instructions.
+		if (static_data.offset)
+		{
+			std::vector<uint8_t> rodata(static_data.data(), static_data.data() + static_data.offset);
+			std::reverse(rodata.begin(), rodata.end());
+			sections.add(SECTION_RODATA, rodata.data(), rodata.size());
+		}
 
-		for (ssize_t j = static_data.offset - 1; j >= 0; j--)
+		if (zero_data_size)
 		{
-			executable.push(static_data[j]);
+			sections.add_empty(SECTION_BSS, zero_data_size);
 		}
 
-		for (size_t j = 0; j < offset; j++)
+		// Add the import table.
+		// See `NativeImport` for its layout.
+
+		if (native_imports.size())
 		{
-			executable.push(operator[](j));
+			BufferBuilder import_table;
+			import_table.push<uint64_t>(native_imports.size());
+
+			for (const NativeImport &import : native_imports)
+			{
+				import_table.push_null_terminated_string(import.library);
+				import_table.push_null_terminated_string(import.symbol);
+				import_table.push<uint8_t>(import.return_type);
+				import_table.push<uint8_t>(import.param_types.size());
+
+				for (NativeType param_type : import.param_types)
+				{
+					import_table.push<uint8_t>(param_type);
+				}
+			}
+
+			sections.add(SECTION_IMPORTS, import_table.data(), import_table.offset);
+			import_table.free_buffer();
 		}
 
-		// Create memory from the program and return it.
+		// Add the export table.
+		// See `ExportTable` for its layout.
 
-		return executable.build();
+		if (export_table.init_end != 0)
+		{
+			BufferBuilder exports;
+			exports.push<uint64_t>(export_table.init_end);
+			exports.push<uint64_t>(export_table.functions.size());
+
+			for (const ExportedFunction &function : export_table.functions)
+			{
+				exports.push_null_terminated_string(function.name);
+				exports.push<uint64_t>(function.offset);
+				exports.push<uint8_t>(function.return_type);
+				exports.push<uint8_t>(function.param_types.size());
+
+				for (NativeType param_type : function.param_types)
+				{
+					exports.push<uint8_t>(param_type);
+				}
+			}
+
+			sections.add(SECTION_EXPORTS, exports.data(), exports.offset);
+			exports.free_buffer();
+		}
+
+		// Add the debugger symbols.
+
+		if (line_table.runs.size())
+		{
+			std::string lines = line_table.to_section();
+			sections.add(SECTION_LINES, (const uint8_t *) lines.data(), lines.size());
+		}
+
+		if (debug_info.size())
+		{
+			sections.add(SECTION_DEBUG, (const uint8_t *) debug_info.data(), debug_info.size());
+		}
+
+		return sections.build();
 	}
 
 	/**
@@ -174,19 +279,53 @@ struct Assembler : public BufferBuilder
 	void
 	push_instruction(Instruction instruction)
 	{
-		push<uint16_t>(instruction);
+		if (debug)
+		{
+			line_table.add(offset, current_line);
+		}
+
+		push(instruction);
+	}
+
+	/**
+	 * @brief Sets the source line that the following
+	 * instructions are generated for.
+	 * @param line The source line, or 0 for no source line.
+	 */
+	void
+	set_line(uint64_t line)
+	{
+		current_line = line;
 	}
 
 	/**
 	 * @brief Adds a MOVE_LIT instruction to the program.
+	 * Literals that fit in a sign-extended 8-bit or 32-bit literal
+	 * use the shorter MOVE_LIT_8 or MOVE_LIT_32 instruction.
 	 * @param lit The source literal.
 	 * @param reg_id The destination register.
 	 */
 	void
 	move_lit(uint64_t lit, uint8_t reg_id)
 	{
-		push_instruction(MOVE_LIT);
-		push(lit);
+		int64_t signed_lit = lit;
+
+		if (signed_lit == (int8_t) signed_lit)
+		{
+			push_instruction(MOVE_LIT_8);
+			push<int8_t>(signed_lit);
+		}
+		else if (signed_lit == (int32_t) signed_lit)
+		{
+			push_instruction(MOVE_LIT_32);
+			push<int32_t>(signed_lit);
+		}
+		else
+		{
+			push_instruction(MOVE_LIT);
+			push(lit);
+		}
+
 		push(reg_id);
 	}
 
@@ -1328,7 +1467,7 @@ struct Assembler : public BufferBuilder
 	{
 		push_instruction(JUMP);
 		add_label_reference(label);
-		push<uint64_t>(0); // This will be updated later
+		push<int32_t>(0); // This will be updated later
 	}
 
 	/**
@@ -1340,7 +1479,7 @@ struct Assembler : public BufferBuilder
 	{
 		push_instruction(JUMP_IF_GT);
 		add_label_reference(label);
-		push<uint64_t>(0); // This will be updated later
+		push<int32_t>(0); // This will be updated later
 	}
 
 	/**
@@ -1352,7 +1491,7 @@ struct Assembler : public BufferBuilder
 	{
 		push_instruction(JUMP_IF_GEQ);
 		add_label_reference(label);
-		push<uint64_t>(0); // This will be updated later
+		push<int32_t>(0); // This will be updated later
 	}
 
 	/**
@@ -1364,7 +1503,7 @@ struct Assembler : public BufferBuilder
 	{
 		push_instruction(JUMP_IF_LT);
 		add_label_reference(label);
-		push<uint64_t>(0); // This will be updated later
+		push<int32_t>(0); // This will be updated later
 	}
 
 	/**
@@ -1376,7 +1515,7 @@ struct Assembler : public BufferBuilder
 	{
 		push_instruction(JUMP_IF_LEQ);
 		add_label_reference(label);
-		push<uint64_t>(0); // This will be updated later
+		push<int32_t>(0); // This will be updated later
 	}
 
 	/**
@@ -1388,7 +1527,7 @@ struct Assembler : public BufferBuilder
 	{
 		push_instruction(JUMP_IF_EQ);
 		add_label_reference(label);
-		push<uint64_t>(0); // This will be updated later
+		push<int32_t>(0); // This will be updated later
 	}
 
 	/**
@@ -1400,7 +1539,7 @@ struct Assembler : public BufferBuilder
 	{
 		push_instruction(JUMP_IF_NEQ);
 		add_label_reference(label);
-		push<uint64_t>(0); // This will be updated later
+		push<int32_t>(0); // This will be updated later
 	}
 
 	/**
@@ -1500,7 +1639,7 @@ struct Assembler : public BufferBuilder
 	{
 		push_instruction(CALL);
 		add_label_reference(label);
-		push<uint64_t>(0); // This will be updated later
+		push<int32_t>(0); // This will be updated later
 	}
 
 	/**
@@ -1512,6 +1651,19 @@ struct Assembler : public BufferBuilder
 		push_instruction(RETURN);
 	}
 
+	/**
+	 * @brief Adds a CALL_NATIVE instruction to the program.
+	 * The native function is added to the import table
+	 * if it was not called before.
+	 * @param import The native function to call.
+	 */
+	void
+	call_native(const NativeImport &import)
+	{
+		push_instruction(CALL_NATIVE);
+		push<uint32_t>(add_native_import(import));
+	}
+
 	/**
 	 * @brief Adds a ALLOCATE_STACK instruction to the program.
 	 * @param size The number of bytes to allocate.
@@ -1578,6 +1730,482 @@ struct Assembler : public BufferBuilder
 		push(reg_id);
 	}
 
+	/**
+	 * @brief Adds a PRINT_U64 instruction to the program.
+	 * @param reg_id The register that holds the integer.
+	 * @param size The byte size of the integer.
+	 */
+	void
+	print_u64(uint8_t reg_id, uint8_t size)
+	{
+		push_instruction(PRINT_U64);
+		push(reg_id);
+		push(size);
+	}
+
+	/**
+	 * @brief Adds a PRINT_I64 instruction to the program.
+	 * @param reg_id The register that holds the integer.
+	 * @param size The byte size of the integer.
+	 */
+	void
+	print_i64(uint8_t reg_id, uint8_t size)
+	{
+		push_instruction(PRINT_I64);
+		push(reg_id);
+		push(size);
+	}
+
+	/**
+	 * @brief Adds a PRINT_F64 instruction to the program.
+	 * @param reg_id The register that holds the float.
+	 * @param precision_reg The register that holds the number
+	 * of digits after the decimal point.
+	 * @param size The byte size of the float.
+	 */
+	void
+	print_f64(uint8_t reg_id, uint8_t precision_reg, uint8_t size)
+	{
+		push_instruction(PRINT_F64);
+		push(reg_id);
+		push(precision_reg);
+		push(size);
+	}
+
+	/**
+	 * @brief Adds a PRINT_HEX instruction to the program.
+	 * @param reg_id The register that holds the integer.
+	 * @param size The byte size of the integer.
+	 */
+	void
+	print_hex(uint8_t reg_id, uint8_t size)
+	{
+		push_instruction(PRINT_HEX);
+		push(reg_id);
+		push(size);
+	}
+
+	/**
+	 * @brief Adds a PRINT_STR instruction to the program.
+	 * @param reg_id The register that holds a pointer to the string.
+	 */
+	void
+	print_str(uint8_t reg_id)
+	{
+		push_instruction(PRINT_STR);
+		push(reg_id);
+	}
+
+	/**
+	 * @brief Adds a MAP_NEW instruction to the program.
+	 * @param reg_id The destination register for the map handle.
+	 */
+	void
+	map_new(uint8_t reg_id)
+	{
+		push_instruction(MAP_NEW);
+		push(reg_id);
+	}
+
+	/**
+	 * @brief Adds a MAP_FREE instruction to the program.
+	 * @param map_reg The register that holds the map handle.
+	 */
+	void
+	map_free(uint8_t map_reg)
+	{
+		push_instruction(MAP_FREE);
+		push(map_reg);
+	}
+
+	/**
+	 * @brief Adds a MAP_PUT instruction to the program.
+	 * @param map_reg The register that holds the map handle.
+	 * @param key_reg The register that holds the key.
+	 * @param len_reg The register that holds the key length.
+	 * @param value_reg The register that holds the value.
+	 */
+	void
+	map_put(uint8_t map_reg, uint8_t key_reg, uint8_t len_reg, uint8_t value_reg)
+	{
+		push_instruction(MAP_PUT);
+		push(map_reg);
+		push(key_reg);
+		push(len_reg);
+		push(value_reg);
+	}
+
+	/**
+	 * @brief Adds a MAP_GET instruction to the program.
+	 * @param map_reg The register that holds the map handle.
+	 * @param key_reg The register that holds the key.
+	 * @param len_reg The register that holds the key length.
+	 * @param value_reg The destination register for the value.
+	 */
+	void
+	map_get(uint8_t map_reg, uint8_t key_reg, uint8_t len_reg, uint8_t value_reg)
+	{
+		push_instruction(MAP_GET);
+		push(map_reg);
+		push(key_reg);
+		push(len_reg);
+		push(value_reg);
+	}
+
+	/**
+	 * @brief Adds a MAP_HAS instruction to the program.
+	 * @param map_reg The register that holds the map handle.
+	 * @param key_reg The register that holds the key.
+	 * @param len_reg The register that holds the key length.
+	 * @param result_reg The destination register for whether the key is present.
+	 */
+	void
+	map_has(uint8_t map_reg, uint8_t key_reg, uint8_t len_reg, uint8_t result_reg)
+	{
+		push_instruction(MAP_HAS);
+		push(map_reg);
+		push(key_reg);
+		push(len_reg);
+		push(result_reg);
+	}
+
+	/**
+	 * @brief Adds a MAP_DEL instruction to the program.
+	 * @param map_reg The register that holds the map handle.
+	 * @param key_reg The register that holds the key.
+	 * @param len_reg The register that holds the key length.
+	 */
+	void
+	map_del(uint8_t map_reg, uint8_t key_reg, uint8_t len_reg)
+	{
+		push_instruction(MAP_DEL);
+		push(map_reg);
+		push(key_reg);
+		push(len_reg);
+	}
+
+	/**
+	 * @brief Adds a MAP_ITER instruction to the program.
+	 * @param map_reg The register that holds the map handle.
+	 * @param cursor_reg The register that holds the cursor, is updated.
+	 * @param key_reg The destination register for the key.
+	 * @param value_reg The destination register for the value.
+	 */
+	void
+	map_iter(uint8_t map_reg, uint8_t cursor_reg, uint8_t key_reg, uint8_t value_reg)
+	{
+		push_instruction(MAP_ITER);
+		push(map_reg);
+		push(cursor_reg);
+		push(key_reg);
+		push(value_reg);
+	}
+
+	/**
+	 * @brief Adds a FILE_OPEN instruction to the program.
+	 * @param path_reg The register that holds a pointer to the path.
+	 * @param mode_reg The register that holds the FILE_MODE_* bits.
+	 * @param result_reg The destination register for the file descriptor.
+	 */
+	void
+	file_open(uint8_t path_reg, uint8_t mode_reg, uint8_t result_reg)
+	{
+		push_instruction(FILE_OPEN);
+		push(path_reg);
+		push(mode_reg);
+		push(result_reg);
+	}
+
+	/**
+	 * @brief Adds a FILE_READ instruction to the program.
+	 * @param fd_reg The register that holds the file descriptor.
+	 * @param buf_reg The register that holds a pointer to the buffer.
+	 * @param len_reg The register that holds the size of the buffer.
+	 * @param result_reg The destination register for the number of read bytes.
+	 */
+	void
+	file_read(uint8_t fd_reg, uint8_t buf_reg, uint8_t len_reg, uint8_t result_reg)
+	{
+		push_instruction(FILE_READ);
+		push(fd_reg);
+		push(buf_reg);
+		push(len_reg);
+		push(result_reg);
+	}
+
+	/**
+	 * @brief Adds a FILE_WRITE instruction to the program.
+	 * @param fd_reg The register that holds the file descriptor.
+	 * @param buf_reg The register that holds a pointer to the bytes.
+	 * @param len_reg The register that holds the number of bytes.
+	 * @param result_reg The destination register for the number of written bytes.
+	 */
+	void
+	file_write(uint8_t fd_reg, uint8_t buf_reg, uint8_t len_reg, uint8_t result_reg)
+	{
+		push_instruction(FILE_WRITE);
+		push(fd_reg);
+		push(buf_reg);
+		push(len_reg);
+		push(result_reg);
+	}
+
+	/**
+	 * @brief Adds a FILE_PREAD instruction to the program.
+	 * @param fd_reg The register that holds the file descriptor.
+	 * @param buf_reg The register that holds a pointer to the buffer.
+	 * @param len_reg The register that holds the size of the buffer.
+	 * @param offset_reg The register that holds the offset in the file.
+	 * @param result_reg The destination register for the number of read bytes.
+	 */
+	void
+	file_pread(uint8_t fd_reg, uint8_t buf_reg, uint8_t len_reg, uint8_t offset_reg,
+		uint8_t result_reg)
+	{
+		push_instruction(FILE_PREAD);
+		push(fd_reg);
+		push(buf_reg);
+		push(len_reg);
+		push(offset_reg);
+		push(result_reg);
+	}
+
+	/**
+	 * @brief Adds a FILE_SEEK instruction to the program.
+	 * @param fd_reg The register that holds the file descriptor.
+	 * @param offset_reg The register that holds the offset.
+	 * @param whence_reg The register that holds what the offset is relative to.
+	 * @param result_reg The destination register for the new position.
+	 */
+	void
+	file_seek(uint8_t fd_reg, uint8_t offset_reg, uint8_t whence_reg, uint8_t result_reg)
+	{
+		push_instruction(FILE_SEEK);
+		push(fd_reg);
+		push(offset_reg);
+		push(whence_reg);
+		push(result_reg);
+	}
+
+	/**
+	 * @brief Adds a FILE_CLOSE instruction to the program.
+	 * @param fd_reg The register that holds the file descriptor.
+	 * @param result_reg The destination register for the result.
+	 */
+	void
+	file_close(uint8_t fd_reg, uint8_t result_reg)
+	{
+		push_instruction(FILE_CLOSE);
+		push(fd_reg);
+		push(result_reg);
+	}
+
+	/**
+	 * @brief Adds a FILE_STAT instruction to the program.
+	 * @param fd_reg The register that holds the file descriptor.
+	 * @param stat_reg The register that holds a pointer to the output values.
+	 * @param result_reg The destination register for the result.
+	 */
+	void
+	file_stat(uint8_t fd_reg, uint8_t stat_reg, uint8_t result_reg)
+	{
+		push_instruction(FILE_STAT);
+		push(fd_reg);
+		push(stat_reg);
+		push(result_reg);
+	}
+
+	/**
+	 * @brief Adds a MMAP_FILE instruction to the program.
+	 * @param fd_reg The register that holds the file descriptor.
+	 * @param len_reg The register that holds the number of bytes to map.
+	 * @param offset_reg The register that holds the offset in the file.
+	 * @param result_reg The destination register for the address.
+	 */
+	void
+	mmap_file(uint8_t fd_reg, uint8_t len_reg, uint8_t offset_reg, uint8_t result_reg)
+	{
+		push_instruction(MMAP_FILE);
+		push(fd_reg);
+		push(len_reg);
+		push(offset_reg);
+		push(result_reg);
+	}
+
+	/**
+	 * @brief Adds a MUNMAP_FILE instruction to the program.
+	 * @param addr_reg The register that holds the address of the mapping.
+	 * @param len_reg The register that holds the number of mapped bytes.
+	 * @param result_reg The destination register for the result.
+	 */
+	void
+	munmap_file(uint8_t addr_reg, uint8_t len_reg, uint8_t result_reg)
+	{
+		push_instruction(MUNMAP_FILE);
+		push(addr_reg);
+		push(len_reg);
+		push(result_reg);
+	}
+
+	/**
+	 * @brief Adds an AIO_SUBMIT instruction to the program.
+	 * @param op_reg The register that holds the operation.
+	 * @param fd_reg The register that holds the file descriptor.
+	 * @param buf_reg The register that holds a pointer to the buffer.
+	 * @param len_reg The register that holds the number of bytes.
+	 * @param offset_reg The register that holds the offset in the file.
+	 * @param tag_reg The register that holds the tag of the request.
+	 * @param result_reg The destination register for the result.
+	 */
+	void
+	aio_submit(uint8_t op_reg, uint8_t fd_reg, uint8_t buf_reg, uint8_t len_reg,
+		uint8_t offset_reg, uint8_t tag_reg, uint8_t result_reg)
+	{
+		push_instruction(AIO_SUBMIT);
+		push(op_reg);
+		push(fd_reg);
+		push(buf_reg);
+		push(len_reg);
+		push(offset_reg);
+		push(tag_reg);
+		push(result_reg);
+	}
+
+	/**
+	 * @brief Adds an AIO_POLL instruction to the program.
+	 * @param out_reg The register that holds a pointer to the completions.
+	 * @param max_reg The register that holds the maximum number of completions.
+	 * @param min_reg The register that holds the number of completions to wait for.
+	 * @param result_reg The destination register for the number of completions.
+	 */
+	void
+	aio_poll(uint8_t out_reg, uint8_t max_reg, uint8_t min_reg, uint8_t result_reg)
+	{
+		push_instruction(AIO_POLL);
+		push(out_reg);
+		push(max_reg);
+		push(min_reg);
+		push(result_reg);
+	}
+
+	/**
+	 * @brief Adds a THREAD_SPAWN instruction to the program.
+	 * @param label The label of the function to start.
+	 * @param arg_reg The register that holds the argument of the function.
+	 * @param handle_reg The destination register for the thread handle.
+	 */
+	void
+	thread_spawn(const std::string &label, uint8_t arg_reg, uint8_t handle_reg)
+	{
+		push_instruction(THREAD_SPAWN);
+		add_label_reference(label);
+		push<int32_t>(0); // This will be updated later
+		push(arg_reg);
+		push(handle_reg);
+	}
+
+	/**
+	 * @brief Adds a THREAD_JOIN instruction to the program.
+	 * @param handle_reg The register that holds the thread handle.
+	 * @param result_reg The destination register for the return value.
+	 */
+	void
+	thread_join(uint8_t handle_reg, uint8_t result_reg)
+	{
+		push_instruction(THREAD_JOIN);
+		push(handle_reg);
+		push(result_reg);
+	}
+
+	/**
+	 * @brief Adds a CHAN_NEW instruction to the program.
+	 * @param capacity_reg The register that holds the capacity.
+	 * @param kind_reg The register that holds the kind of channel.
+	 * @param handle_reg The destination register for the channel handle.
+	 */
+	void
+	chan_new(uint8_t capacity_reg, uint8_t kind_reg, uint8_t handle_reg)
+	{
+		push_instruction(CHAN_NEW);
+		push(capacity_reg);
+		push(kind_reg);
+		push(handle_reg);
+	}
+
+	/**
+	 * @brief Adds a CHAN_FREE instruction to the program.
+	 * @param chan_reg The register that holds the channel handle.
+	 */
+	void
+	chan_free(uint8_t chan_reg)
+	{
+		push_instruction(CHAN_FREE);
+		push(chan_reg);
+	}
+
+	/**
+	 * @brief Adds a CHAN_SEND instruction to the program.
+	 * @param chan_reg The register that holds the channel handle.
+	 * @param value_reg The register that holds the message.
+	 */
+	void
+	chan_send(uint8_t chan_reg, uint8_t value_reg)
+	{
+		push_instruction(CHAN_SEND);
+		push(chan_reg);
+		push(value_reg);
+	}
+
+	/**
+	 * @brief Adds a CHAN_RECV instruction to the program.
+	 * @param chan_reg The register that holds the channel handle.
+	 * @param value_reg The destination register for the message.
+	 */
+	void
+	chan_recv(uint8_t chan_reg, uint8_t value_reg)
+	{
+		push_instruction(CHAN_RECV);
+		push(chan_reg);
+		push(value_reg);
+	}
+
+	/**
+	 * @brief Adds a CHAN_TRY_RECV instruction to the program.
+	 * @param chan_reg The register that holds the channel handle.
+	 * @param value_reg The destination register for the message.
+	 * @param ok_reg The destination register for whether a message was received.
+	 */
+	void
+	chan_try_recv(uint8_t chan_reg, uint8_t value_reg, uint8_t ok_reg)
+	{
+		push_instruction(CHAN_TRY_RECV);
+		push(chan_reg);
+		push(value_reg);
+		push(ok_reg);
+	}
+
+	/**
+	 * @brief Adds a BENCH_BEGIN instruction to the program.
+	 * @param id_reg The register that holds the id of the region.
+	 */
+	void
+	bench_begin(uint8_t id_reg)
+	{
+		push_instruction(BENCH_BEGIN);
+		push(id_reg);
+	}
+
+	/**
+	 * @brief Adds a BENCH_END instruction to the program.
+	 * @param id_reg The register that holds the id of the region.
+	 */
+	void
+	bench_end(uint8_t id_reg)
+	{
+		push_instruction(BENCH_END);
+		push(id_reg);
+	}
+
 	/**
 	 * @brief Adds a label to the program.
 	 * The label can later be referred to using the
@@ -1596,6 +2224,30 @@ struct Assembler : public BufferBuilder
 		labels[id] = offset;
 	}
 
+	/**
+	 * @brief Marks the current offset as the end of the
+	 * initialisation of the global variables.
+	 */
+	void
+	mark_init_end()
+	{
+		export_table.init_end = offset;
+	}
+
+	/**
+	 * @brief Adds a function to the export table.
+	 * The function starts at the current offset.
+	 * @param name The name of the function.
+	 * @param return_type The return type of the function.
+	 * @param param_types The types of the parameters of the function.
+	 */
+	void
+	add_export(const std::string &name, NativeType return_type,
+		const std::vector<NativeType> &param_types)
+	{
+		export_table.functions.push_back({ name, offset, return_type, param_types });
+	}
+
 	/**
 	 * @brief Adds a reference to a label to the program.
 	 * The label must have been previously added using the
@@ -1631,19 +2283,206 @@ struct Assembler : public BufferBuilder
 			uint64_t label_location = labels[label];
 
 			// Update all label references.
-			// Label references are relative to the location of the label.
+			// Label references are relative to the start of the instruction
+			// that holds them, and must fit in 32 bits.
 
 			for (size_t j = 0; j < reference_points.size(); j++)
 			{
 				uint64_t reference_location         = reference_points[j];
-				int64_t relative_reference_location = label_location - reference_location + 2;
-				int64_t *reference_point            = (int64_t *) (data() + reference_points[j]);
+				int64_t relative_reference_location = label_location - reference_location
+					+ sizeof(Instruction);
+
+				if (relative_reference_location != (int32_t) relative_reference_location)
+				{
+					p_warn(stderr, "ProgramBuilder error: label %s is out of range\n",
+						label.c_str());
+					abort();
+				}
+
+				int32_t relative = relative_reference_location;
+				memcpy(buffer + reference_location, &relative, sizeof(relative));
+			}
+		}
+	}
+
+	/**
+	 * @brief Adds a LOAD_PTR instruction of a given size to the program.
+	 * @param size The number of bytes to load: 1, 2, 4 or 8.
+	 * @param reg_id_1 The source register that holds a pointer.
+	 * @param reg_id_2 The destination register.
+	 */
+	void
+	load_ptr(size_t size, uint8_t reg_id_1, uint8_t reg_id_2)
+	{
+		switch (size)
+		{
+		case 1:
+			load_ptr_8(reg_id_1, reg_id_2);
+			break;
+
+		case 2:
+			load_ptr_16(reg_id_1, reg_id_2);
+			break;
+
+		case 4:
+			load_ptr_32(reg_id_1, reg_id_2);
+			break;
+
+		default:
+			load_ptr_64(reg_id_1, reg_id_2);
+			break;
+		}
+	}
+
+	/**
+	 * @brief Adds a STORE_PTR instruction of a given size to the program.
+	 * @param size The number of bytes to store: 1, 2, 4 or 8.
+	 * @param reg_id_1 The source register.
+	 * @param reg_id_2 The destination register that holds a pointer.
+	 */
+	void
+	store_ptr(size_t size, uint8_t reg_id_1, uint8_t reg_id_2)
+	{
+		switch (size)
+		{
+		case 1:
+			store_ptr_8(reg_id_1, reg_id_2);
+			break;
+
+		case 2:
+			store_ptr_16(reg_id_1, reg_id_2);
+			break;
 
-				*reference_point = relative_reference_location;
+		case 4:
+			store_ptr_32(reg_id_1, reg_id_2);
+			break;
+
+		default:
+			store_ptr_64(reg_id_1, reg_id_2);
+			break;
+		}
+	}
+
+	/**
+	 * @brief Splits a value that is returned in registers into the
+	 * largest loads and stores that don't cross a word or the end
+	 * of the value, so no memory past the value is touched.
+	 * @param size The size of the value in bytes.
+	 * @param part Called with the offset and the size of every part.
+	 */
+	template <typename PartHandler>
+	static void
+	for_each_return_part(size_t size, PartHandler part)
+	{
+		for (size_t offset = 0; offset < size;)
+		{
+			size_t part_size = 8;
+
+			while (part_size > size - offset)
+			{
+				part_size /= 2;
 			}
+
+			part(offset, part_size);
+			offset += part_size;
 		}
 	}
 
+	/**
+	 * @brief Loads a value from memory into the return value registers,
+	 * word by word, see `ReturnConvention::REGISTERS`.
+	 * @param ptr_reg The register that holds the address of the value.
+	 * Is left unchanged.
+	 * @param size The size of the value in bytes.
+	 * At most `RETURN_REGISTER_COUNT` words.
+	 */
+	void
+	load_return_registers(uint8_t ptr_reg, size_t size)
+	{
+		uint8_t addr_reg = get_register();
+		uint8_t step_reg = get_register();
+		uint8_t part_reg = get_register();
+		size_t addr      = 0;
+
+		move(ptr_reg, addr_reg);
+
+		for_each_return_part(size, [&](size_t offset, size_t part_size)
+		{
+			uint8_t ret_reg = R_RET + offset / 8;
+
+			if (offset != addr)
+			{
+				move_lit(offset - addr, step_reg);
+				add_int_64(step_reg, addr_reg);
+				addr = offset;
+			}
+
+			// The first part of a word is loaded into its register,
+			// the other parts are shifted into place.
+
+			if (offset % 8 == 0)
+			{
+				load_ptr(part_size, addr_reg, ret_reg);
+				return;
+			}
+
+			load_ptr(part_size, addr_reg, part_reg);
+			move_lit(offset % 8 * 8, step_reg);
+			shl_int_64(step_reg, part_reg);
+			or_int_64(part_reg, ret_reg);
+		});
+
+		free_register(part_reg);
+		free_register(step_reg);
+		free_register(addr_reg);
+	}
+
+	/**
+	 * @brief Stores the return value registers into memory,
+	 * word by word, see `ReturnConvention::REGISTERS`.
+	 * @param ptr_reg The register that holds the address to store the value at.
+	 * Is left unchanged.
+	 * @param size The size of the value in bytes.
+	 * At most `RETURN_REGISTER_COUNT` words.
+	 */
+	void
+	store_return_registers(uint8_t ptr_reg, size_t size)
+	{
+		uint8_t addr_reg = get_register();
+		uint8_t step_reg = get_register();
+		uint8_t part_reg = get_register();
+		size_t addr      = 0;
+
+		move(ptr_reg, addr_reg);
+
+		for_each_return_part(size, [&](size_t offset, size_t part_size)
+		{
+			uint8_t ret_reg = R_RET + offset / 8;
+
+			if (offset != addr)
+			{
+				move_lit(offset - addr, step_reg);
+				add_int_64(step_reg, addr_reg);
+				addr = offset;
+			}
+
+			if (offset % 8 == 0)
+			{
+				store_ptr(part_size, ret_reg, addr_reg);
+				return;
+			}
+
+			move(ret_reg, part_reg);
+			move_lit(offset % 8 * 8, step_reg);
+			shr_int_64(step_reg, part_reg);
+			store_ptr(part_size, part_reg, addr_reg);
+		});
+
+		free_register(part_reg);
+		free_register(step_reg);
+		free_register(addr_reg);
+	}
+
 	/**
 	 * @brief Generates a label name that can be used to jump to.
 	 * @param type The type of label to generate.
@@ -1681,6 +2520,28 @@ struct Assembler : public BufferBuilder
 		loop_labels.pop();
 	}
 
+	/**
+	 * @brief Adds a native function to the import table,
+	 * if it is not already present.
+	 * @param import The native function to import.
+	 * @returns The index of the native function in the import table.
+	 */
+	uint32_t
+	add_native_import(const NativeImport &import)
+	{
+		auto it = native_import_ids.find(import.symbol);
+
+		if (it != native_import_ids.end())
+		{
+			return it->second;
+		}
+
+		uint32_t id                      = native_imports.size();
+		native_import_ids[import.symbol] = id;
+		native_imports.push_back(import);
+		return id;
+	}
+
 	/**
 	 * @brief Adds a chunk of static data to the program.
 	 * @param data A pointer to the data. The data is copied.
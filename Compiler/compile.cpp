@@ -16,5 +16,14 @@ main(int argc, char **argv)
 	bool debug = _debug = debug_flag == "--debug" || debug_flag == "-d";
 
 	Compiler compiler(input_file_name, output_file_name, debug);
-	compiler.compile();
+
+	try
+	{
+		compiler.compile();
+	}
+	catch (const std::string &err_message)
+	{
+		std::cerr << err_message << std::flush;
+		return 1;
+	}
 }
\ No newline at end of file
@@ -9,6 +9,7 @@
 #define CALLGRIND_STOP_INSTRUMENTATION
 #endif
 #include <chrono>
+#include <sstream>
 #include "Compiler/ASTNodes/ClassDeclaration.hpp"
 #include "Compiler/util.hpp"
 #include "Compiler/tokeniser.hpp"
@@ -16,6 +17,7 @@
 #include "Compiler/type-check/TypeCheckState.hpp"
 #include "debugger-symbols.hpp"
 #include "Compiler/code-gen/Assembler.hpp"
+#include "Executable/builtin-names.hpp"
 #include "ASTNodes/VariableDeclaration.hpp"
 
 #ifdef MEASURE_MEM
@@ -38,6 +40,10 @@ struct Compiler
 	// A file pointer to the source file.
 	FILE *input_file;
 
+	// The absolute path of the source file.
+	// Recorded in the debugger symbols for source line lookups.
+	std::string source_file_path;
+
 	// The output file name.
 	// Will contain the byte code after compilation.
 	char *output_file_name;
@@ -65,6 +71,10 @@ struct Compiler
 		{
 			err("Input file %s does not exist", input_file_name);
 		}
+
+		char *absolute_path = realpath(input_file_name, nullptr);
+		source_file_path    = absolute_path;
+		free(absolute_path);
 	}
 
 	/**
@@ -134,6 +144,42 @@ struct Compiler
 		p_trace(stdout, "\n/// AST ///\n");
 	}
 
+	/**
+	 * @brief Calls a builtin that returns one of the program arguments
+	 * and pushes its result as an argument of main.
+	 * @param symbol The name of the builtin, see `BUILTIN_ARGC`.
+	 * @param return_type The return type of the builtin.
+	 * @param param_type The type of the parameter of main.
+	 */
+	void
+	push_program_arg(const char *symbol, NativeType return_type, const Type &param_type)
+	{
+		uint8_t args_size_reg = assembler.get_register();
+		assembler.move_lit(0, args_size_reg);
+		assembler.push_reg_64(args_size_reg);
+		assembler.free_register(args_size_reg);
+		assembler.call_native(NativeImport { "", symbol, return_type, {} });
+
+		switch (param_type.byte_size())
+		{
+		case 1:
+			assembler.push_reg_8(R_RET);
+			break;
+
+		case 2:
+			assembler.push_reg_16(R_RET);
+			break;
+
+		case 4:
+			assembler.push_reg_32(R_RET);
+			break;
+
+		default:
+			assembler.push_reg_64(R_RET);
+			break;
+		}
+	}
+
 	/**
 	 * @brief Compiles the source file into a byte code file.
 	 * Tokenises the source file,
@@ -201,13 +247,31 @@ struct Compiler
 
 		for (VariableDeclaration *decl : global_var_decls)
 		{
+			assembler.set_line(decl->accountable_token.line);
 			decl->code_gen(assembler);
 		}
 
-		// Push parameter count and call main.
+		assembler.set_line(0);
+		assembler.mark_init_end();
+
+		// Push the arguments and their size, and call main.
+		// A main that takes argc and argv gets them from the runtime.
+
+		size_t main_args_size = 0;
+		auto main_signature   = type_check_state.functions.find("main");
+
+		if (main_signature != type_check_state.functions.end()
+			&& main_signature->second.parameters.size() == 2)
+		{
+			const std::vector<IdentifierDefinition> &params = main_signature->second.parameters;
+
+			push_program_arg(BUILTIN_ARGC, NATIVE_I64, params[0].type);
+			push_program_arg(BUILTIN_ARGV, NATIVE_PTR, params[1].type);
+			main_args_size = params[0].type.byte_size() + params[1].type.byte_size();
+		}
 
 		uint8_t main_param_cnt_reg = assembler.get_register();
-		assembler.move_lit(0, main_param_cnt_reg);
+		assembler.move_lit(main_args_size, main_param_cnt_reg);
 		assembler.push_reg_64(main_param_cnt_reg);
 		assembler.free_register(main_param_cnt_reg);
 		assembler.call("main");
@@ -245,17 +309,23 @@ struct Compiler
 		p_warn(stdout, "Type checking took %lld micros\n", duration1);
 		p_warn(stdout, "Code generation took %lld micros\n", duration2);
 
-		// Write the byte code to the output file.
-
-		Buffer executable = assembler.assemble();
-		executable.write_to_file(output_file_name);
-
-		// Create debugger symbols
+		// Embed the debugger symbols in the executable.
+		// The line table gets a section of its own.
 
 		if (type_check_state.debug)
 		{
-			type_check_state.debugger_symbols.build(output_file_name);
+			std::ostringstream debug_info;
+			type_check_state.debugger_symbols.write(debug_info);
+
+			assembler.debug_info             = debug_info.str();
+			assembler.line_table.source_file = source_file_path;
 		}
+
+		// Write the byte code to the output file.
+
+		assembler.zero_data_size = type_check_state.globals_size;
+		Buffer executable        = assembler.assemble();
+		executable.write_to_file(output_file_name);
 	}
 };
 
@@ -4,8 +4,14 @@
 #include <functional>
 #include <map>
 #include <fstream>
+#include <optional>
+#include <sstream>
 
 #include "Compiler/util.hpp"
+#include "Executable/line-table.hpp"
+#include "Executable/sections.hpp"
+#include "Executable/upgrader.hpp"
+#include "Shared/buffer.hpp"
 
 /**
  * @brief Structure that holds information about a line
@@ -139,18 +145,18 @@ struct IndentFileRootNode : public IndentFileNode
  */
 struct IndentFileParser
 {
-	// The file stream of the debugger symbols file.
-	std::ifstream stream;
+	// The stream of the debugger symbols.
+	std::istream &stream;
 
 	// The current depth of the nodes.
 	ssize_t depth = -1;
 
 	/**
 	 * @brief Constructs a new indent file parser.
-	 * @param file The file to parse.
+	 * @param stream The stream to parse.
 	 */
-	IndentFileParser(const std::string &file_name)
-		: stream(file_name) {}
+	IndentFileParser(std::istream &stream)
+		: stream(stream) {}
 
 	/**
 	 * @brief Parses the file.
@@ -426,6 +432,9 @@ struct DebuggerSymbols
 	// A list containing the class debugger symbols.
 	std::map<std::string, DebuggerClass> classes;
 
+	// The table that maps program offsets to source lines.
+	LineTable lines;
+
 	/**
 	 * @brief Adds a class to the debugger symbols.
 	 */
@@ -457,16 +466,13 @@ struct DebuggerSymbols
 	}
 
 	/**
-	 * @brief Builds the debugger symbols and writes them to
+	 * @brief Writes the debugger symbols in the format of
 	 * a debugger symbols file.
-	 * @param exec_file_name The name of the executable.
-	 * The symbols file will be named after the executable with
-	 * the extension `.debug`.
+	 * @param stream The stream to write to.
 	 */
 	void
-	build(const std::string &exec_file_name)
+	write(std::ostream &stream)
 	{
-		std::ofstream stream(exec_file_name + ".debug");
 
 		// Classes
 
@@ -549,7 +555,14 @@ struct DebuggerSymbols
 			stream << '\t' << global.to_str() << '\n';
 		}
 
-		stream.close();
+		// Line table
+
+		if (lines.runs.size())
+		{
+			stream << "lines\n";
+			stream << "\tsource " << lines.source_file << '\n';
+			stream << "\truns " << lines.encode() << '\n';
+		}
 	}
 
 	static void
@@ -639,15 +652,34 @@ struct DebuggerSymbols
 		}
 	}
 
+	static void
+	scan_lines(IndentFileNode *section, DebuggerSymbols &debugger_symbols)
+	{
+		for (IndentFileNode *entry : section->children)
+		{
+			const std::string &entry_str = entry->line;
+
+			if (entry_str.rfind("source ", 0) == 0)
+			{
+				debugger_symbols.lines.source_file = entry_str.substr(7);
+			}
+			else if (entry_str.rfind("runs ", 0) == 0)
+			{
+				debugger_symbols.lines.decode(entry_str.substr(5));
+			}
+		}
+	}
+
 	/**
-	 * @brief Parses a debugger symbols file.
-	 * @param file_name The file name of the symbols file.
+	 * @brief Parses debugger symbols in the format of
+	 * a debugger symbols file.
+	 * @param stream The stream to parse.
 	 * @returns The parsed debugger symbols.
 	 */
 	static DebuggerSymbols
-	parse(const std::string &file_name)
+	parse(std::istream &stream)
 	{
-		IndentFileParser parser(file_name);
+		IndentFileParser parser(stream);
 		IndentFileNode file = parser.parse();
 		DebuggerSymbols debugger_symbols;
 
@@ -673,6 +705,67 @@ struct DebuggerSymbols
 			{
 				scan_globals(section, debugger_symbols);
 			}
+
+			// Scan the line table
+
+			else if (section->line == "lines")
+			{
+				scan_lines(section, debugger_symbols);
+			}
+		}
+
+		return debugger_symbols;
+	}
+
+	/**
+	 * @brief Loads the debugger symbols of an executable.
+	 * Sectioned executables hold them in their debug and lines sections,
+	 * executables of version 1 have none. The line table of an executable
+	 * of version 2 is moved to its upgraded program, see `CodeUpgrader`.
+	 * Throws an error message if the executable cannot be read.
+	 * @param exec_file_name The path of the executable.
+	 * @returns The debugger symbols, or nothing if the executable has none.
+	 */
+	static std::optional<DebuggerSymbols>
+	load(const std::string &exec_file_name)
+	{
+		Buffer buffer = Buffer::from_file(exec_file_name.c_str());
+
+		if (!SectionTable::is_sectioned(buffer))
+		{
+			return std::nullopt;
+		}
+
+		SectionTable table           = SectionTable::read(buffer);
+		const Section *debug_section = table.find(SECTION_DEBUG);
+		const Section *lines_section = table.find(SECTION_LINES);
+
+		if (debug_section == nullptr && lines_section == nullptr)
+		{
+			return std::nullopt;
+		}
+
+		DebuggerSymbols debugger_symbols;
+
+		if (debug_section != nullptr)
+		{
+			std::istringstream stream(std::string(
+				(const char *) buffer.data + debug_section->offset, debug_section->size));
+			debugger_symbols = parse(stream);
+		}
+
+		if (lines_section != nullptr)
+		{
+			debugger_symbols.lines = LineTable::from_section(std::string(
+				(const char *) buffer.data + lines_section->offset, lines_section->size));
+
+			const Section *code_section = table.find(SECTION_CODE);
+
+			if (table.version < EXECUTABLE_VERSION && code_section != nullptr)
+			{
+				CodeUpgrader::upgrade_line_table(buffer.data + code_section->offset,
+					code_section->size, table.version, debugger_symbols.lines);
+			}
 		}
 
 		return debugger_symbols;
@@ -535,6 +535,11 @@ struct Parser
 				return scan_syscall();
 			}
 
+			if (token.value == "extern")
+			{
+				return scan_extern_declaration();
+			}
+
 			if (token.value == "break")
 			{
 				return scan_break_statement();
@@ -1059,6 +1064,24 @@ struct Parser
 	std::unique_ptr<FunctionDeclaration>
 	scan_function_declaration(
 		std::unique_ptr<TypeIdentifierPair> type_id_pair)
+	{
+		std::vector<std::unique_ptr<TypeIdentifierPair>> params = scan_parameter_list();
+
+		// Scan the function body.
+
+		std::unique_ptr<CodeBlock> code_block = scan_code_block();
+
+		return std::make_unique<FunctionDeclaration>(
+			std::move(type_id_pair), std::move(params), std::move(code_block));
+	}
+
+	/**
+	 * Scans the parameter list of a function declaration.
+	 * The left parenthesis was already consumed.
+	 * <type_id_pair>, <type_id_pair>, ...)
+	 */
+	std::vector<std::unique_ptr<TypeIdentifierPair>>
+	scan_parameter_list()
 	{
 		std::vector<std::unique_ptr<TypeIdentifierPair>> params;
 		Token next = get_token();
@@ -1099,12 +1122,49 @@ struct Parser
 
 	end_parameters:
 
-		// Scan the function body.
+		return params;
+	}
 
-		std::unique_ptr<CodeBlock> code_block = scan_code_block();
+	/**
+	 * Scans an extern function declaration.
+	 * "extern" (optional <literal_string>) <type_id_pair>(<parameter_list>)
+	 *
+	 * The optional string is the shared library that contains the function.
+	 * If it is omitted, the function is looked up in the VM process itself.
+	 */
+	std::unique_ptr<FunctionDeclaration>
+	scan_extern_declaration()
+	{
+		// Consume the "extern" keyword.
+
+		Token extern_token = next_token();
+		assert_token_type(extern_token, KEYWORD);
+		assert_token_value(extern_token, "extern");
+
+		// Scan the optional library name.
+
+		std::string library;
+		Token maybe_library = get_token();
+
+		if (maybe_library.type == LITERAL_STRING)
+		{
+			library = maybe_library.value;
+			i++;
+		}
+
+		// Scan the signature.
+
+		std::unique_ptr<TypeIdentifierPair> type_id_pair = scan_type_identifier_pair();
+
+		Token left_parenthesis = next_token();
+		assert_token_type(left_parenthesis, SPECIAL_CHARACTER);
+		assert_token_value(left_parenthesis, "(");
+
+		std::vector<std::unique_ptr<TypeIdentifierPair>> params = scan_parameter_list();
+		expect_statement_terminator();
 
 		return std::make_unique<FunctionDeclaration>(
-			std::move(type_id_pair), std::move(params), std::move(code_block));
+			std::move(type_id_pair), std::move(params), std::move(library));
 	}
 
 	/**
@@ -149,7 +149,7 @@ std::unordered_set<std::string> types = {
 // A set of all keywords in the Tea language.
 std::unordered_set<std::string> keywords = {
 	"if", "else", "return", "while", "for", "break", "continue", "goto",
-	"class", "syscall"
+	"class", "syscall", "extern"
 };
 
 /**
@@ -8,6 +8,7 @@
 #include "VM/cpu.hpp"
 #include "Compiler/debugger-symbols.hpp"
 #include "Compiler/type.hpp"
+#include "Executable/native-import.hpp"
 
 /**
  * @brief Enum for the different types of identifiers:
@@ -63,6 +64,28 @@ struct VariableDefinition
 		  id(name, type) {}
 };
 
+/**
+ * @brief Enum for the ways a function can return its value.
+ */
+enum struct ReturnConvention
+{
+	// The value is returned in R_RET. Used for primitives, pointers
+	// and classes of 1, 2, 4 or 8 bytes, which are held by value.
+	REGISTER,
+
+	// The words of the value are returned in R_RET, R_RET_1, ...
+	// Used for other classes of up to RETURN_REGISTER_COUNT words.
+	REGISTERS,
+
+	// The value is constructed in a return slot, whose address is passed
+	// by the caller as a hidden first parameter. Used for larger classes.
+	SLOT,
+};
+
+// The name of the hidden parameter that holds the address of the return slot.
+// It is not a valid identifier, so it cannot clash with a parameter.
+#define RETURN_SLOT_PARAMETER "return-slot"
+
 /**
  * @brief Structure for a function signature.
  * Contains the name and return type, as well as the parameter identifiers.
@@ -75,10 +98,141 @@ struct FunctionSignature
 	// Holds the identifiers of the parameters of this function.
 	std::vector<IdentifierDefinition> parameters;
 
+	// Whether this function is an extern function,
+	// which lives in a native shared library.
+	bool is_extern = false;
+
+	// The shared library of an extern function.
+	// Empty if the function lives in the VM process itself.
+	std::string library;
+
 	FunctionSignature() {}
 	FunctionSignature(const std::string &fn_name, Type &return_type)
 		: id(fn_name, return_type) {}
 
+	/**
+	 * @brief Converts a type to the type that is used to pass it
+	 * to a native function.
+	 * @param type The type to convert.
+	 * @returns The native type, or `NATIVE_VOID` if the type
+	 * cannot be passed to a native function.
+	 */
+	static NativeType
+	native_type(const Type &type)
+	{
+		if (type.pointer_depth())
+			return NATIVE_PTR;
+
+		switch (type.value)
+		{
+		case Type::UNSIGNED_INTEGER:
+			switch (type.size)
+			{
+			case 1:
+				return NATIVE_U8;
+			case 2:
+				return NATIVE_U16;
+			case 4:
+				return NATIVE_U32;
+			case 8:
+				return NATIVE_U64;
+			}
+			break;
+
+		case Type::SIGNED_INTEGER:
+			switch (type.size)
+			{
+			case 1:
+				return NATIVE_I8;
+			case 2:
+				return NATIVE_I16;
+			case 4:
+				return NATIVE_I32;
+			case 8:
+				return NATIVE_I64;
+			}
+			break;
+
+		case Type::FLOATING_POINT:
+			return type.size == 4 ? NATIVE_F32 : NATIVE_F64;
+
+		default:
+			break;
+		}
+
+		return NATIVE_VOID;
+	}
+
+	/**
+	 * @brief Checks whether a value of a type can be passed
+	 * to or returned from a native function.
+	 * @param type The type to check.
+	 * @returns True if the type is `v0`, a primitive or a pointer.
+	 */
+	static bool
+	is_native_compatible(const Type &type)
+	{
+		return type.byte_size() == 0 || native_type(type) != NATIVE_VOID;
+	}
+
+	/**
+	 * @param type The return type of a function.
+	 * @returns How a function returns a value of the type.
+	 */
+	static ReturnConvention
+	return_convention(const Type &type)
+	{
+		if (!type.is_class())
+		{
+			return ReturnConvention::REGISTER;
+		}
+
+		switch (type.byte_size())
+		{
+		case 0:
+		case 1:
+		case 2:
+		case 4:
+		case 8:
+			return ReturnConvention::REGISTER;
+		}
+
+		if (type.byte_size() <= RETURN_REGISTER_COUNT * 8)
+		{
+			return ReturnConvention::REGISTERS;
+		}
+
+		return ReturnConvention::SLOT;
+	}
+
+	/**
+	 * @returns How this function returns its value.
+	 */
+	ReturnConvention
+	return_convention() const
+	{
+		return return_convention(id.type);
+	}
+
+	/**
+	 * @returns The import table entry of this extern function.
+	 */
+	NativeImport
+	native_import() const
+	{
+		NativeImport import;
+		import.library     = library;
+		import.symbol      = id.name;
+		import.return_type = native_type(id.type);
+
+		for (const IdentifierDefinition &param : parameters)
+		{
+			import.param_types.push_back(native_type(param.type));
+		}
+
+		return import;
+	}
+
 	/**
 	 * @brief Adds a parameter to this function.
 	 * @param param_name The name of the parameter.
@@ -1,7 +1,3 @@
-#include <sys/stat.h>
-
-#define RESTORE_INSTRUCTION_POINTER_ON_THROW
-
 #include "Shared/ansi.hpp"
 #include "VM/cpu.hpp"
 #include "VM/memory.hpp"
@@ -40,16 +36,52 @@ struct VarEntry : public DebuggerSymbol
 		: DebuggerSymbol(sym), addr(addr) {}
 };
 
+struct Shell;
+
+/**
+ * @brief The hooks of the CPU of the debugger.
+ * Keeps the call stack of the shell up to date, and moves the
+ * instruction pointer back to an instruction that throws,
+ * so the user can inspect the state in which it failed.
+ */
+struct DebuggerHooks : NoHooks
+{
+	static constexpr bool HANDLES_TRAPS          = true;
+	static constexpr bool USES_SUPERINSTRUCTIONS = false;
+
+	// The shell to report calls and returns to, or nullptr.
+	Shell *shell = nullptr;
+
+	template <typename CPU>
+	void
+	on_call(CPU &cpu, uint8_t *function);
+
+	template <typename CPU>
+	void
+	on_return(CPU &cpu);
+
+	template <typename CPU>
+	void
+	on_trap(CPU &cpu, const std::string &err_message)
+	{
+		cpu.set_instr_ptr(cpu.cur_instr_addr);
+	}
+};
+
+// The CPU of the debugger.
+using DebuggedCPU = BasicCPU<DebuggerHooks>;
+
 struct Shell
 {
 	const char *file_path;
-	CPU *cpu = nullptr;
+	DebuggedCPU *cpu = nullptr;
 	PtrSet breakpoints;
 	std::vector<CallStackEntry> call_stack;
 	std::vector<std::vector<VarEntry>> locals;
 	std::vector<VarEntry> globals;
 	DebuggerSymbols debugger_symbols;
 	bool debugger_symbols_found = false;
+	std::vector<std::string> source;
 
 	void
 	collect_fn_call_arg_details(CallStackEntry &entry,
@@ -168,73 +200,71 @@ struct Shell
 		locals.push_back(new_fn_locals);
 	}
 
+	/**
+	 * @brief Adds the function that was just called to the call stack.
+	 */
 	void
-	exec_instruction()
+	enter_call()
 	{
-		// Get the next instruction.
-
-		Instruction instruction = cpu->step();
-
-		switch (instruction)
-		{
-		case CALL:
-		{
-			// Add this function call to call stack.
+		Instruction next_instruction = memory::get<Instruction>(cpu->get_instr_ptr());
 
-			Instruction next_instruction = (Instruction) memory::get<uint16_t>(
-				cpu->get_instr_ptr());
+		std::stringstream ss;
 
-			std::stringstream ss;
+		// If the function has a debug label, push its name.
 
-			// If the function has a debug label, push its name.
+		if (next_instruction == LABEL)
+		{
+			uint8_t *label_offset = cpu->get_instr_ptr() + sizeof(Instruction);
+			char c;
 
-			if (next_instruction == LABEL)
+			while (true)
 			{
-				uint8_t *label_offset = cpu->get_instr_ptr() + 2;
-				char c;
-
-				while (true)
-				{
-					c = memory::get<char>(label_offset++);
-					if (c == '\0')
-						break;
-					ss << c;
-				}
+				c = memory::get<char>(label_offset++);
+				if (c == '\0')
+					break;
+				ss << c;
 			}
+		}
 
-			// Else, push its address.
-
-			else
-			{
-				ss << "0x" << std::hex << cpu->get_instr_ptr();
-			}
+		// Else, push its address.
 
-			// Create a call stack entry.
+		else
+		{
+			ss << "0x" << std::hex << cpu->get_instr_ptr();
+		}
 
-			CallStackEntry entry;
-			entry.fn_name = ss.str();
+		// Create a call stack entry.
 
-			// Check if there are debugger symbols.
+		CallStackEntry entry;
+		entry.fn_name = ss.str();
 
-			if (debugger_symbols.functions.count(entry.fn_name))
-			{
-				collect_fn_call_details(entry);
-			}
+		// Check if there are debugger symbols.
 
-			call_stack.push_back(entry);
-			break;
+		if (debugger_symbols.functions.count(entry.fn_name))
+		{
+			collect_fn_call_details(entry);
 		}
 
-		case RETURN:
-		{
-			// Pop from the call stack and the locals.
+		call_stack.push_back(entry);
+	}
 
-			call_stack.pop_back();
-			locals.pop_back();
-		}
+	/**
+	 * @brief Pops the function that just returned from the call stack and the locals.
+	 */
+	void
+	leave_call()
+	{
+		call_stack.pop_back();
+		locals.pop_back();
+	}
 
-		default:;
-		}
+	void
+	exec_instruction()
+	{
+		// Execute the next instruction.
+		// The call stack is updated by the hooks of the CPU.
+
+		cpu->step();
 	}
 
 	void
@@ -253,6 +283,8 @@ struct Shell
 				printf(ANSI_RED "The VM encountered an error:\n" ANSI_BRIGHT_RED "%s",
 					err_message.c_str());
 			}
+
+			print_source_location();
 		}
 		else
 		{
@@ -260,6 +292,27 @@ struct Shell
 		}
 	}
 
+	/**
+	 * @brief Prints the source line of the next instruction,
+	 * if it is known from the line table.
+	 */
+	void
+	print_source_location()
+	{
+		uint64_t offset = cpu->get_instr_ptr() - cpu->program_location;
+		uint64_t line   = debugger_symbols.lines.line_of(offset);
+
+		if (line == 0)
+		{
+			return;
+		}
+
+		std::string text = LineTable::source_text(source, line);
+
+		printf(ANSI_BRIGHT_BLACK "at line " ANSI_BRIGHT_BLUE "%lu" ANSI_RESET "    %s\n",
+			line, text.c_str());
+	}
+
 	void
 	run()
 	{
@@ -275,6 +328,7 @@ struct Shell
 			{
 				printf(ANSI_RED "The VM encountered an error:\n" ANSI_BRIGHT_RED "%s",
 					err_message.c_str());
+				print_source_location();
 				return;
 			}
 		}
@@ -285,6 +339,7 @@ struct Shell
 		{
 			if (breakpoints.count(cpu->get_instr_ptr()))
 			{
+				print_source_location();
 				return;
 			}
 
@@ -296,6 +351,7 @@ struct Shell
 			{
 				printf(ANSI_RED "The VM encountered an error:\n" ANSI_BRIGHT_RED "%s",
 					err_message.c_str());
+				print_source_location();
 				return;
 			}
 		}
@@ -486,24 +542,31 @@ struct Shell
 				stack_size = atoi(stack_size_flag.c_str());
 			}
 
-			Executable executable = Executable::from_file(file_path);
-			cpu                   = new CPU(executable, stack_size);
+			try
+			{
+				Executable executable = Executable::from_file(file_path);
+				cpu                   = new DebuggedCPU(executable, stack_size);
+				cpu->hooks.shell      = this;
+			}
+			catch (const std::string &err_message)
+			{
+				printf(ANSI_RED "Could not load executable:\n" ANSI_BRIGHT_RED "%s",
+					err_message.c_str());
+				goto shell;
+			}
 
 			printf(ANSI_BRIGHT_MAGENTA "Loaded executable" ANSI_RESET "\n");
 
-			std::string debug_symbols_filename;
-			debug_symbols_filename += file_path;
-			debug_symbols_filename += ".debug";
-
-			struct stat file_stats;
-
 			// Read debugger symbols if found.
 
-			if (stat(debug_symbols_filename.c_str(), &file_stats) == 0)
+			std::optional<DebuggerSymbols> loaded_symbols = DebuggerSymbols::load(file_path);
+
+			if (loaded_symbols.has_value())
 			{
 				printf(ANSI_BRIGHT_MAGENTA "Found debugger symbols" ANSI_RESET "\n");
-				debugger_symbols       = DebuggerSymbols::parse(debug_symbols_filename);
+				debugger_symbols       = std::move(loaded_symbols.value());
 				debugger_symbols_found = true;
+				source                 = debugger_symbols.lines.read_source();
 			}
 			else
 			{
@@ -983,6 +1046,27 @@ struct Shell
 	}
 };
 
+template <typename CPU>
+void
+DebuggerHooks::on_call(CPU &cpu, uint8_t *function)
+{
+	if (shell != nullptr)
+	{
+		shell->enter_call();
+	}
+}
+
+template <typename CPU>
+void
+DebuggerHooks::on_return(CPU &cpu)
+{
+	if (shell != nullptr)
+	{
+		shell->leave_call();
+	}
+}
+
+
 int
 main(int argc, char **argv)
 {
@@ -107,11 +107,11 @@ struct InstructionLister
 	{
 		// Read the next instruction and print it
 
-		Instruction instruction        = (Instruction) reader.read<uint16_t>();
+		Instruction instruction        = reader.read<Instruction>();
 		const char *instruction_str    = instruction_to_str(instruction);
 		std::vector<ArgumentType> args = instruction_arg_types(instruction);
 
-		instr_addr = reader.addr - 2;
+		instr_addr = reader.addr - sizeof(Instruction);
 		print_instruction(instruction_str, breakpoints);
 
 		// Print the arguments
@@ -125,11 +125,11 @@ struct InstructionLister
 				break;
 
 			case REL_ADDR:
-				print_arg_rel_address(reader.read<int64_t>());
+				print_arg_rel_address(reader.read<int32_t>());
 				break;
 
 			case LIT_8:
-				print_arg_literal_number(reader.read<uint8_t>());
+				print_arg_literal_number(reader.read<int8_t>());
 				break;
 
 			case LIT_16:
@@ -137,7 +137,7 @@ struct InstructionLister
 				break;
 
 			case LIT_32:
-				print_arg_literal_number(reader.read<uint32_t>());
+				print_arg_literal_number(reader.read<int32_t>());
 				break;
 
 			case LIT_64:
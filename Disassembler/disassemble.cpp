@@ -1,8 +1,10 @@
 #include <cstdio>
+#include <iostream>
 
 #include "disassembler.hpp"
 #include "Executable/byte-code.hpp"
 #include "Disassembler/file-reader.hpp"
+#include "Compiler/debugger-symbols.hpp"
 
 int
 main(int argc, char **argv)
@@ -14,11 +16,45 @@ main(int argc, char **argv)
 	}
 
 	char *file_in_name = argv[1];
-	FILE *file_in      = fopen(file_in_name, "r");
-	FileReader reader(file_in);
 
-	Disassembler disassembler(file_in, stdout);
-	disassembler.disassemble();
+	try
+	{
+		Buffer file      = Buffer::from_file(file_in_name);
+		uint32_t version = Disassembler::version_of(file);
+
+		// Executables in an older encoding are disassembled
+		// the way the VM runs them, after upgrading them.
+
+		if (version < EXECUTABLE_VERSION)
+		{
+			printf("Version %u is upgraded to version %u\n\n", version, EXECUTABLE_VERSION);
+		}
+
+		Buffer executable = version < EXECUTABLE_VERSION
+			? Disassembler::upgrade(file, file_in_name)
+			: std::move(file);
+
+		FILE *file_in = fmemopen(executable.data, executable.size, "r");
+		Disassembler disassembler(file_in, stdout);
+
+		// Annotate the instructions with source lines,
+		// if debugger symbols were found.
 
-	fclose(file_in);
+		std::optional<DebuggerSymbols> debugger_symbols = DebuggerSymbols::load(file_in_name);
+
+		if (debugger_symbols.has_value())
+		{
+			disassembler.lines  = std::move(debugger_symbols->lines);
+			disassembler.source = disassembler.lines.read_source();
+		}
+
+		disassembler.disassemble();
+
+		fclose(file_in);
+	}
+	catch (const std::string &err_message)
+	{
+		std::cerr << err_message << std::flush;
+		return 1;
+	}
 }
\ No newline at end of file
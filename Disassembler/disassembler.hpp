@@ -1,9 +1,16 @@
 #ifndef TEA_DISASSEMBLER_HEADER
 #define TEA_DISASSEMBLER_HEADER
 
+#include <cinttypes>
+
 #include "Disassembler/file-reader.hpp"
 #include "Shared/ansi.hpp"
+#include "Executable/builtin-names.hpp"
 #include "Executable/byte-code.hpp"
+#include "Executable/executable.hpp"
+#include "Executable/native-import.hpp"
+#include "Executable/line-table.hpp"
+#include "Executable/sections.hpp"
 #include "VM/cpu.hpp"
 
 /**
@@ -25,6 +32,13 @@ struct Disassembler
 	// Used to calculate the absolute address of relative addresses.
 	uint64_t instr_addr;
 
+	// The line table of the program.
+	// Empty if no debugger symbols were found.
+	LineTable lines;
+
+	// The lines of the source file.
+	std::vector<std::string> source;
+
 	/**
 	 * @brief Constructs a new Disassembler object.
 	 * Initialises the file reader and the output file.
@@ -45,7 +59,7 @@ struct Disassembler
 		// Print address in green.
 
 		fprintf(file_out,
-			ANSI_GREEN "0x" ANSI_BRIGHT_GREEN "%04llx" ANSI_RESET "    ",
+			ANSI_GREEN "0x" ANSI_BRIGHT_GREEN "%04" PRIx64 ANSI_RESET "    ",
 			instr_addr);
 
 		// Print instruction in orange.
@@ -86,11 +100,11 @@ struct Disassembler
 			break;
 
 		case REL_ADDR:
-			print_arg_rel_address(file_reader.read<int64_t>());
+			print_arg_rel_address(file_reader.read<int32_t>());
 			break;
 
 		case LIT_8:
-			print_arg_literal_number(file_reader.read<uint8_t>());
+			print_arg_literal_number(file_reader.read<int8_t>());
 			break;
 
 		case LIT_16:
@@ -98,7 +112,7 @@ struct Disassembler
 			break;
 
 		case LIT_32:
-			print_arg_literal_number(file_reader.read<uint32_t>());
+			print_arg_literal_number(file_reader.read<int32_t>());
 			break;
 
 		case LIT_64:
@@ -143,7 +157,7 @@ struct Disassembler
 	void
 	print_arg_literal_number(uint64_t num)
 	{
-		fprintf(file_out, ANSI_YELLOW "%lld" ANSI_RESET, num);
+		fprintf(file_out, ANSI_YELLOW "%" PRId64 ANSI_RESET, (int64_t) num);
 	}
 
 	/**
@@ -155,9 +169,9 @@ struct Disassembler
 	print_arg_rel_address(int64_t rel_address)
 	{
 		uint64_t addr = instr_addr + rel_address;
-		fprintf(file_out, ANSI_YELLOW "%lld " ANSI_RESET, rel_address);
+		fprintf(file_out, ANSI_YELLOW "%" PRId64 " " ANSI_RESET, rel_address);
 		fprintf(file_out,
-			"(" ANSI_GREEN "0x" ANSI_BRIGHT_GREEN "%llx" ANSI_RESET ")",
+			"(" ANSI_GREEN "0x" ANSI_BRIGHT_GREEN "%" PRIx64 ANSI_RESET ")",
 			addr);
 	}
 
@@ -184,42 +198,328 @@ struct Disassembler
 	/**
 	 * @brief Disassembles the bytecode file.
 	 * The instructions are printed to the output file.
+	 * Executables of versions 1 and 2 are upgraded first, see `upgrade()`.
 	 */
 	void
 	disassemble()
 	{
-		uint64_t static_data_size = file_reader.read<uint64_t>();
-		uint64_t program_size     = file_reader.read<uint64_t>();
+		uint64_t magic = file_reader.read<uint64_t>();
+
+		if (magic != EXECUTABLE_MAGIC)
+		{
+			fprintf(file_out, "Not an executable of version %u\n", EXECUTABLE_VERSION);
+			return;
+		}
+
+		disassemble_sections();
+	}
+
+	/**
+	 * @param file The contents of an executable file.
+	 * @returns The version of the executable. Executables of version 1
+	 * have no header, see `Executable::from_buffer()`.
+	 */
+	static uint32_t
+	version_of(const Buffer &file)
+	{
+		uint32_t version = 1;
+
+		if (SectionTable::is_sectioned(file) && file.size >= 12)
+		{
+			memcpy(&version, file.data + 8, sizeof(version));
+		}
+
+		return version;
+	}
+
+	/**
+	 * @brief Re-encodes an executable of version 1 or 2 as an executable
+	 * of the current version, the way the VM upgrades it when it loads it.
+	 * The offsets of the export table are moved along, the other sections
+	 * are copied. Throws an error message if the executable is invalid.
+	 * @param file The contents of the executable file.
+	 * @param file_name The name of the executable, for error messages.
+	 * @returns The contents of the upgraded executable.
+	 */
+	static Buffer
+	upgrade(Buffer &file, const char *file_name)
+	{
+		Executable executable = Executable::from_buffer(file, file_name);
+		SectionTable new_sections;
+
+		if (executable.static_data_size != 0)
+		{
+			new_sections.add(SECTION_RODATA, executable.data, executable.static_data_size);
+		}
+
+		new_sections.add(SECTION_CODE, executable.data + executable.static_data_size,
+			executable.program_size);
+
+		if (!SectionTable::is_sectioned(file))
+		{
+			return new_sections.build();
+		}
+
+		for (const Section &section : SectionTable::read(file).sections)
+		{
+			switch (section.type)
+			{
+			case SECTION_RODATA:
+			case SECTION_CODE:
+				break;
+
+			case SECTION_EXPORTS:
+			{
+				std::vector<uint8_t> exports = executable.export_table.to_section();
+				new_sections.add(SECTION_EXPORTS, exports.data(), exports.size());
+				break;
+			}
+
+			case SECTION_BSS:
+				new_sections.add_empty(SECTION_BSS, section.size);
+				break;
+
+			default:
+				new_sections.add((SectionType) section.type,
+					file.data + section.offset, section.size);
+				break;
+			}
+		}
+
+		return new_sections.build();
+	}
+
+	/**
+	 * @brief Disassembles a sectioned executable, see `SectionTable`.
+	 * Prints the section table, followed by the contents of the sections.
+	 * The lines and debug sections are not printed, the line table
+	 * is used to annotate the instructions instead.
+	 */
+	void
+	disassemble_sections()
+	{
+		uint32_t version       = file_reader.read<uint32_t>();
+		uint32_t section_count = file_reader.read<uint32_t>();
+
+		fprintf(file_out, "Sections (version = %u, count = %u)\n\n", version, section_count);
+
+		if (version != EXECUTABLE_VERSION)
+		{
+			fprintf(file_out, "Unsupported version\n");
+			return;
+		}
 
-		// Print static data.
+		std::vector<Section> sections;
 
-		fprintf(file_out, "Static data (size = %llu)\n\n", static_data_size);
+		for (uint32_t i = 0; i < section_count; i++)
+		{
+			Section section;
+			section.type   = file_reader.read<uint32_t>();
+			section.flags  = file_reader.read<uint32_t>();
+			section.offset = file_reader.read<uint64_t>();
+			section.size   = file_reader.read<uint64_t>();
+			sections.push_back(section);
+
+			fprintf(file_out, "%-12s offset = 0x%06" PRIx64 "    size = %" PRIu64 "\n",
+				section_type_to_str(section.type), section.offset, section.size);
+		}
+
+		for (const Section &section : sections)
+		{
+			file_reader.seek(section.offset);
+
+			switch (section.type)
+			{
+			case SECTION_RODATA:
+				print_static_data(section.size);
+				break;
+
+			case SECTION_CODE:
+				print_program(section.size);
+				break;
+
+			case SECTION_IMPORTS:
+				print_imports();
+				break;
+
+			case SECTION_EXPORTS:
+				print_exports();
+				break;
+			}
+		}
+	}
+
+	/**
+	 * @brief Prints the static data segment, which starts at the
+	 * current offset of the file.
+	 * @param static_data_size The size of the static data segment.
+	 */
+	void
+	print_static_data(uint64_t static_data_size)
+	{
+		fprintf(file_out, "\nStatic data (size = %" PRIu64 ")\n\n", static_data_size);
 
 		for (size_t i = 0; i < static_data_size; i++)
 		{
 			uint8_t byte = file_reader.read<uint8_t>();
 
-			fprintf(file_out, "0x%04lx    0x%02hhx    %03hhu    '%c'\n",
+			fprintf(file_out, "0x%04zx    0x%02hhx    %03hhu    '%c'\n",
 				i, byte, byte, byte);
 		}
+	}
 
-		// Print the program.
-
-		fprintf(file_out, "\nProgram (size = %llu)\n\n", program_size);
+	/**
+	 * @brief Disassembles the program segment, which starts at the
+	 * current offset of the file.
+	 * @param program_size The size of the program segment.
+	 */
+	void
+	print_program(uint64_t program_size)
+	{
+		fprintf(file_out, "\nProgram (size = %" PRIu64 ")\n\n", program_size);
 
 		Instruction instruction;
+		uint64_t prev_line     = 0;
+		uint64_t program_start = file_reader.read_bytes;
 
-		while (
-			(instruction = (Instruction) file_reader.read<uint16_t>())
-			!= (1 << 16) - 1)
+		while (file_reader.read_bytes < program_start + program_size
+			&& (instruction = (Instruction) file_reader.read<uint8_t>()) != (uint8_t) EOF)
 		{
 			const char *instruction_str    = instruction_to_str(instruction);
 			std::vector<ArgumentType> args = instruction_arg_types(instruction);
 
-			instr_addr = file_reader.read_bytes - 18;
+			instr_addr = file_reader.read_bytes - program_start - sizeof(Instruction);
+
+			// Print the source line the following instructions belong to.
+
+			uint64_t line = lines.line_of(instr_addr);
+
+			if (line != prev_line && line != 0)
+			{
+				print_source_line(line);
+			}
+
+			prev_line = line;
 			print_instruction(instruction_str, args);
 		}
 	}
+
+	/**
+	 * @brief Prints the import table, which starts at the
+	 * current offset of the file.
+	 * @returns Whether the file has an import table.
+	 */
+	bool
+	print_imports()
+	{
+		uint64_t import_count = file_reader.read<uint64_t>();
+
+		if (import_count == (uint64_t) EOF)
+		{
+			return false;
+		}
+
+		fprintf(file_out, "\nImports (count = %" PRIu64 ")\n\n", import_count);
+
+		for (uint64_t i = 0; i < import_count; i++)
+		{
+			std::string library = read_null_terminated_string();
+			std::string symbol  = read_null_terminated_string();
+			NativeType ret_type = (NativeType) file_reader.read<uint8_t>();
+			uint8_t param_count = file_reader.read<uint8_t>();
+
+			fprintf(file_out, "0x%04" PRIx64 "    " ANSI_YELLOW "%s " ANSI_RESET "%s(",
+				i, native_type_to_str(ret_type), symbol.c_str());
+
+			for (uint8_t j = 0; j < param_count; j++)
+			{
+				NativeType param_type = (NativeType) file_reader.read<uint8_t>();
+				fprintf(file_out, j ? ", " ANSI_YELLOW "%s" ANSI_RESET
+						    : ANSI_YELLOW "%s" ANSI_RESET,
+					native_type_to_str(param_type));
+			}
+
+			fprintf(file_out, ")    " ANSI_BRIGHT_BLACK "/* %s */" ANSI_RESET "\n",
+				!library.empty()                 ? library.c_str()
+				: builtin_arities.count(symbol) ? "builtin"
+								  : "host process");
+		}
+
+		return true;
+	}
+
+	/**
+	 * @brief Prints the export table, which starts at the
+	 * current offset of the file, if there is one.
+	 */
+	void
+	print_exports()
+	{
+		uint64_t init_end = file_reader.read<uint64_t>();
+
+		if (init_end == (uint64_t) EOF)
+		{
+			return;
+		}
+
+		uint64_t export_count = file_reader.read<uint64_t>();
+
+		fprintf(file_out, "\nExports (count = %" PRIu64 ", initialisation ends at 0x%04" PRIx64 ")\n\n",
+			export_count, init_end);
+
+		for (uint64_t i = 0; i < export_count; i++)
+		{
+			std::string name    = read_null_terminated_string();
+			uint64_t offset     = file_reader.read<uint64_t>();
+			NativeType ret_type = (NativeType) file_reader.read<uint8_t>();
+			uint8_t param_count = file_reader.read<uint8_t>();
+
+			fprintf(file_out, ANSI_GREEN "0x" ANSI_BRIGHT_GREEN "%04" PRIx64 ANSI_RESET
+				"    " ANSI_YELLOW "%s " ANSI_RESET "%s(",
+				offset, native_type_to_str(ret_type), name.c_str());
+
+			for (uint8_t j = 0; j < param_count; j++)
+			{
+				NativeType param_type = (NativeType) file_reader.read<uint8_t>();
+				fprintf(file_out, j ? ", " ANSI_YELLOW "%s" ANSI_RESET
+						    : ANSI_YELLOW "%s" ANSI_RESET,
+					native_type_to_str(param_type));
+			}
+
+			fprintf(file_out, ")\n");
+		}
+	}
+
+	/**
+	 * @brief Pretty-prints a source line to the output file.
+	 * @param line The number of the source line.
+	 */
+	void
+	print_source_line(uint64_t line)
+	{
+		std::string text = LineTable::source_text(source, line);
+
+		fprintf(file_out, ANSI_BRIGHT_BLACK "\n; line %" PRIu64 ": %s" ANSI_RESET "\n",
+			line, text.c_str());
+	}
+
+	/**
+	 * @brief Reads a null-terminated string from the bytecode file.
+	 * @returns The string, without the null terminator.
+	 */
+	std::string
+	read_null_terminated_string()
+	{
+		std::string str;
+		char c;
+
+		while ((c = file_reader.read<char>()) != '\0' && c != EOF)
+		{
+			str += c;
+		}
+
+		return str;
+	}
 };
 
 #endif
\ No newline at end of file
@@ -48,6 +48,17 @@ struct FileReader
 		read_bytes += sizeof(intx_t);
 		return value;
 	}
+
+	/**
+	 * @brief Moves to an offset in the file.
+	 * @param offset The offset to read from next.
+	 */
+	void
+	seek(size_t offset)
+	{
+		fseek(file, offset, SEEK_SET);
+		read_bytes = offset;
+	}
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,70 @@
+#ifndef TEA_BUILTIN_NAMES_HEADER
+#define TEA_BUILTIN_NAMES_HEADER
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+// The builtins that return the argc and argv of the program.
+// The compiler calls them to pass them to a main that takes parameters.
+#define BUILTIN_ARGC "$I___tea_argc"
+#define BUILTIN_ARGV "$I___tea_argv"
+
+/**
+ * @brief The curated set of libc functions that are provided by the
+ * VM runtime, with their number of parameters. The keys are the names
+ * that transpiled programs use. A function that is declared with one of
+ * these names and an empty body is compiled to a call to the runtime
+ * implementation, see `builtin_addresses` in `VM/builtins.hpp`.
+ */
+std::unordered_map<std::string, uint8_t> builtin_arities = {
+	{ "$I_malloc", 1 },
+	{ "$I_calloc", 2 },
+	{ "$I_realloc", 2 },
+	{ "$I_free", 1 },
+	{ "$I_memcpy", 3 },
+	{ "$I_memmove", 3 },
+	{ "$I_memset", 3 },
+	{ "$I_memcmp", 3 },
+	{ "$I_memchr", 3 },
+	{ "$I_strlen", 1 },
+	{ "$I_strnlen", 2 },
+	{ "$I_strcmp", 2 },
+	{ "$I_strncmp", 3 },
+	{ "$I_strcpy", 2 },
+	{ "$I_strncpy", 3 },
+	{ "$I_strcat", 2 },
+	{ "$I_strncat", 3 },
+	{ "$I_strchr", 2 },
+	{ "$I_strrchr", 2 },
+	{ "$I_strstr", 2 },
+	{ "$I_strdup", 1 },
+	{ "$I_strndup", 2 },
+	{ "$I_strtol", 3 },
+	{ "$I_strtoll", 3 },
+	{ "$I_strtoul", 3 },
+	{ "$I_strtoull", 3 },
+	{ "$I_atoi", 1 },
+	{ "$I_atol", 1 },
+	{ "$I_abs", 1 },
+	{ "$I_labs", 1 },
+	{ "$I_getenv", 1 },
+	{ "$I___errno_location", 0 },
+	{ "$I___error", 0 },
+	{ "$I_strerror", 1 },
+	{ "$I_perror", 1 },
+	{ "$I_open", 2 },
+	{ "$I_close", 1 },
+	{ "$I_read", 3 },
+	{ "$I_write", 3 },
+	{ "$I_lseek", 3 },
+	{ "$I_isatty", 1 },
+	{ "$I_puts", 1 },
+	{ "$I_putchar", 1 },
+	{ "$I_exit", 1 },
+	{ "$I_abort", 0 },
+	{ BUILTIN_ARGC, 0 },
+	{ BUILTIN_ARGV, 0 },
+};
+
+#endif
@@ -2,12 +2,20 @@
 #define TEA_BYTE_CODE_HEADER
 
 #include <cstdint>
+#include <cstring>
 #include <vector>
 
+#include "Executable/superinstructions.hpp"
+
 /**
  * @brief An enum containing all valid opcodes.
+ * Opcodes are a single byte, all instructions and superinstructions
+ * must fit in it, see `OPCODE_COUNT`.
+ * The opcodes are stored in executables. New instructions are added
+ * after the others, see `MAP_HAS`. Renumbering the opcodes needs a new
+ * `EXECUTABLE_VERSION` and a table for the older opcodes in `CodeUpgrader`.
  */
-enum Instruction : uint16_t
+enum Instruction : uint8_t
 {
 	// ===========================
 	// === Memory instructions ===
@@ -16,6 +24,11 @@ enum Instruction : uint16_t
 	// Moves a 64-bit literal into a register.
 	MOVE_LIT,
 
+	// Moves a sign-extended 8-bit or 32-bit literal into a register.
+	// Shorter encodings of MOVE_LIT for small literals.
+	MOVE_LIT_8,
+	MOVE_LIT_32,
+
 	// Moves the contents of a 64-bit register into a 64-bit register.
 	MOVE,
 
@@ -194,6 +207,12 @@ enum Instruction : uint16_t
 	// Returns from a function.
 	RETURN,
 
+	// Calls a native host function from the import table.
+	// The arguments are popped off the stack, the result is stored in R_RET.
+	// Executables of version 1 have no CALL_NATIVE, their opcodes
+	// are mapped by `CodeUpgrader::VERSION_1_OPCODES`.
+	CALL_NATIVE,
+
 	// Allocate a number of bytes on the stack.
 	ALLOCATE_STACK,
 
@@ -218,9 +237,169 @@ enum Instruction : uint16_t
 	PRINT_CHAR,
 
 	// Reads a character from stdin.
-	GET_CHAR
+	GET_CHAR,
+
+	// Formatted output. The integer instructions take the byte size of
+	// the value, which is zero- or sign-extended to 64 bits first.
+
+	// Prints an unsigned integer in decimal.
+	PRINT_U64,
+
+	// Prints a signed integer in decimal.
+	PRINT_I64,
+
+	// Prints a float with a number of digits after the decimal point.
+	// Takes the byte size of the float, 4 or 8.
+	PRINT_F64,
+
+	// Prints an unsigned integer in hexadecimal.
+	PRINT_HEX,
+
+	// Prints a null-terminated string.
+	PRINT_STR,
+
+	// ============
+	// === Maps ===
+	// ============
+
+	// Map keys are passed in two registers: the key and its length.
+	// A length of HASH_MAP_INT_KEY (all ones) marks an integer key,
+	// otherwise the key is a pointer to a byte string.
+
+	// Creates a native hash map and stores its handle in a register.
+	MAP_NEW,
+
+	// Frees a native hash map.
+	MAP_FREE,
+
+	// Sets the value of a key in a map.
+	MAP_PUT,
+
+	// Gets the value of a key in a map, or 0 if the key is absent.
+	// Use MAP_HAS to tell an absent key from a stored 0.
+	MAP_GET,
+
+	// Removes a key from a map.
+	MAP_DEL,
+
+	// Gets the next entry of a map, starting at a cursor.
+	// Updates the cursor, which becomes 0 after the last entry.
+	MAP_ITER,
+
+	// =============
+	// === Files ===
+	// =============
+
+	// File instructions operate on host file descriptors. Their last
+	// register receives the result, or the negated errno value on failure.
+
+	// Opens a file with a path and FILE_MODE_* bits.
+	// Writes the file descriptor.
+	FILE_OPEN,
+
+	// Reads from a file into a buffer. Writes the number of read bytes.
+	FILE_READ,
+
+	// Writes a buffer to a file. Writes the number of written bytes.
+	FILE_WRITE,
+
+	// Reads from a file at an offset into a buffer.
+	// Writes the number of read bytes.
+	FILE_PREAD,
+
+	// Moves the position of a file. Writes the new position.
+	FILE_SEEK,
+
+	// Closes a file.
+	FILE_CLOSE,
+
+	// Writes the size, the mode bits and the modification time of a file
+	// to three 64-bit values.
+	FILE_STAT,
+
+	// Maps a part of a file into memory, copy-on-write.
+	// Writes the address of the mapping.
+	MMAP_FILE,
+
+	// Unmaps memory mapped with MMAP_FILE.
+	MUNMAP_FILE,
+
+	// Queues an asynchronous read or write of a file at an offset, tagged
+	// with a value chosen by the program. Writes 0 or the negated errno value.
+	AIO_SUBMIT,
+
+	// Takes up to a maximum number of completions of asynchronous requests,
+	// after waiting for at least a minimum number. Writes the tag and result
+	// of each completion to two 64-bit values, and the number of completions
+	// to a register.
+	AIO_POLL,
+
+	// ===============
+	// === Threads ===
+	// ===============
+
+	// Starts a guest thread that calls a function with a 64-bit argument.
+	// Writes the handle of the thread.
+	THREAD_SPAWN,
+
+	// Waits for a guest thread to finish.
+	// Writes the return value of its function.
+	THREAD_JOIN,
+
+	// Creates a bounded channel of 64-bit messages with a capacity and
+	// a kind, CHANNEL_MPMC or CHANNEL_SPSC. Writes the handle of the channel.
+	CHAN_NEW,
+
+	// Frees a channel.
+	CHAN_FREE,
+
+	// Sends a message on a channel, waits while the channel is full.
+	CHAN_SEND,
+
+	// Receives a message from a channel, waits while the channel is empty.
+	CHAN_RECV,
+
+	// Receives a message from a channel if it is not empty.
+	// Writes the message, and 1 if a message was received or 0 otherwise.
+	CHAN_TRY_RECV,
+
+	// ==================
+	// === Benchmarks ===
+	// ==================
+
+	// Starts a run of a benchmark region with a 64-bit id.
+	// The VM times every run and summarises the regions at exit.
+	BENCH_BEGIN,
+
+	// Ends a run of a benchmark region with a 64-bit id.
+	BENCH_END,
+
+	// ===================
+	// === Maps, later ===
+	// ===================
+
+	// Checks whether a map has a key. Writes 1 if it has, 0 otherwise.
+	// Added after the other instructions, so the opcodes of executables
+	// that were compiled before keep their meaning.
+	MAP_HAS,
+
+	// The number of instructions. Not an instruction itself.
+	// New instructions must be added before this entry.
+	INSTRUCTION_COUNT,
+
+	// Superinstructions, see `Executable/superinstructions.hpp`.
+	// Created by the VM when it loads a program, never stored in executables.
+
+#define SUPERINSTRUCTION(name, ...) name,
+	SUPERINSTRUCTIONS(SUPERINSTRUCTION)
+#undef SUPERINSTRUCTION
+
+	// The number of opcodes, including superinstructions.
+	OPCODE_COUNT
 };
 
+static_assert(OPCODE_COUNT <= 256, "Opcodes must fit in a single byte");
+
 /**
  * @brief Converts an instruction to a string.
  * @param instruction The instruction to convert.
@@ -233,6 +412,10 @@ instruction_to_str(Instruction instruction)
 	{
 	case MOVE_LIT:
 		return "MOVE_LIT";
+	case MOVE_LIT_8:
+		return "MOVE_LIT_8";
+	case MOVE_LIT_32:
+		return "MOVE_LIT_32";
 	case MOVE:
 		return "MOVE";
 	case LOAD_PTR_8:
@@ -447,6 +630,8 @@ instruction_to_str(Instruction instruction)
 		return "CALL";
 	case RETURN:
 		return "RETURN";
+	case CALL_NATIVE:
+		return "CALL_NATIVE";
 	case ALLOCATE_STACK:
 		return "ALLOCATE_STACK";
 	case DEALLOCATE_STACK:
@@ -459,18 +644,104 @@ instruction_to_str(Instruction instruction)
 		return "PRINT_CHAR";
 	case GET_CHAR:
 		return "GET_CHAR";
+	case PRINT_U64:
+		return "PRINT_U64";
+	case PRINT_I64:
+		return "PRINT_I64";
+	case PRINT_F64:
+		return "PRINT_F64";
+	case PRINT_HEX:
+		return "PRINT_HEX";
+	case PRINT_STR:
+		return "PRINT_STR";
+	case MAP_NEW:
+		return "MAP_NEW";
+	case MAP_FREE:
+		return "MAP_FREE";
+	case MAP_PUT:
+		return "MAP_PUT";
+	case MAP_GET:
+		return "MAP_GET";
+	case MAP_DEL:
+		return "MAP_DEL";
+	case MAP_ITER:
+		return "MAP_ITER";
+	case MAP_HAS:
+		return "MAP_HAS";
+	case FILE_OPEN:
+		return "FILE_OPEN";
+	case FILE_READ:
+		return "FILE_READ";
+	case FILE_WRITE:
+		return "FILE_WRITE";
+	case FILE_PREAD:
+		return "FILE_PREAD";
+	case FILE_SEEK:
+		return "FILE_SEEK";
+	case FILE_CLOSE:
+		return "FILE_CLOSE";
+	case FILE_STAT:
+		return "FILE_STAT";
+	case MMAP_FILE:
+		return "MMAP_FILE";
+	case MUNMAP_FILE:
+		return "MUNMAP_FILE";
+	case AIO_SUBMIT:
+		return "AIO_SUBMIT";
+	case AIO_POLL:
+		return "AIO_POLL";
+	case THREAD_SPAWN:
+		return "THREAD_SPAWN";
+	case THREAD_JOIN:
+		return "THREAD_JOIN";
+	case CHAN_NEW:
+		return "CHAN_NEW";
+	case CHAN_FREE:
+		return "CHAN_FREE";
+	case CHAN_SEND:
+		return "CHAN_SEND";
+	case CHAN_RECV:
+		return "CHAN_RECV";
+	case CHAN_TRY_RECV:
+		return "CHAN_TRY_RECV";
+	case BENCH_BEGIN:
+		return "BENCH_BEGIN";
+	case BENCH_END:
+		return "BENCH_END";
+
+#define SUPERINSTRUCTION(name, ...) \
+	case name:                  \
+		return #name;
+		SUPERINSTRUCTIONS(SUPERINSTRUCTION)
+#undef SUPERINSTRUCTION
+
 	default:
 		return "UNDEFINED";
 	}
 }
 
+// The number of general purpose registers (R_0, R_1, ...)
+#define GENERAL_PURPOSE_REGISTER_COUNT 16
+
+// The number of return value registers (R_RET, R_RET_1, ...)
+// Values of up to this many words are returned in registers.
+#define RETURN_REGISTER_COUNT 4
+
+// The number of registers, including the special registers.
+// Register arguments refer to one of these.
+#define TOTAL_REGISTER_COUNT           GENERAL_PURPOSE_REGISTER_COUNT + 4 + RETURN_REGISTER_COUNT
+
 /**
  * @brief An enum of all valid argument types.
  */
 enum ArgumentType : uint8_t
 {
 	REG,
+
+	// A signed 32-bit offset to another instruction,
+	// relative to the start of the instruction that holds it.
 	REL_ADDR,
+
 	LIT_8,
 	LIT_16,
 	LIT_32,
@@ -489,6 +760,10 @@ instruction_arg_types(Instruction instruction)
 	{
 	case MOVE_LIT:
 		return { LIT_64, REG };
+	case MOVE_LIT_8:
+		return { LIT_8, REG };
+	case MOVE_LIT_32:
+		return { LIT_32, REG };
 	case MOVE:
 	case LOAD_PTR_8:
 	case LOAD_PTR_16:
@@ -606,6 +881,8 @@ instruction_arg_types(Instruction instruction)
 		return { REL_ADDR };
 	case RETURN:
 		return {};
+	case CALL_NATIVE:
+		return { LIT_32 };
 	case ALLOCATE_STACK:
 	case DEALLOCATE_STACK:
 		return { LIT_64 };
@@ -614,10 +891,103 @@ instruction_arg_types(Instruction instruction)
 		return { NULL_TERMINATED_STRING };
 	case PRINT_CHAR:
 	case GET_CHAR:
+	case PRINT_STR:
+	case MAP_NEW:
+	case MAP_FREE:
+	case CHAN_FREE:
+	case BENCH_BEGIN:
+	case BENCH_END:
 		return { REG };
+	case PRINT_U64:
+	case PRINT_I64:
+	case PRINT_HEX:
+		return { REG, LIT_8 };
+	case PRINT_F64:
+		return { REG, REG, LIT_8 };
+	case FILE_CLOSE:
+	case THREAD_JOIN:
+	case CHAN_SEND:
+	case CHAN_RECV:
+		return { REG, REG };
+	case THREAD_SPAWN:
+		return { REL_ADDR, REG, REG };
+	case MAP_DEL:
+	case FILE_OPEN:
+	case FILE_STAT:
+	case MUNMAP_FILE:
+	case CHAN_NEW:
+	case CHAN_TRY_RECV:
+		return { REG, REG, REG };
+	case MAP_PUT:
+	case MAP_GET:
+	case MAP_HAS:
+	case MAP_ITER:
+	case FILE_READ:
+	case FILE_WRITE:
+	case FILE_SEEK:
+	case MMAP_FILE:
+	case AIO_POLL:
+		return { REG, REG, REG, REG };
+	case FILE_PREAD:
+		return { REG, REG, REG, REG, REG };
+	case AIO_SUBMIT:
+		return { REG, REG, REG, REG, REG, REG, REG };
+
+		// A superinstruction replaces the opcode of the first instruction
+		// of its sequence and takes over its arguments. The other
+		// instructions of the sequence are left as they were.
+
+#define SUPERINSTRUCTION(name, first, ...) \
+	case name:                         \
+		return instruction_arg_types(first);
+		SUPERINSTRUCTIONS(SUPERINSTRUCTION)
+#undef SUPERINSTRUCTION
+
 	default:
 		return {};
 	}
 }
 
-#endif
\ No newline at end of file
+/**
+ * @brief Computes the size of an instruction, including its arguments.
+ * @param instr A pointer to the opcode of the instruction.
+ * @returns The size of the instruction in bytes.
+ */
+size_t
+instruction_size(const uint8_t *instr)
+{
+	Instruction opcode = (Instruction) *instr;
+	size_t size        = sizeof(opcode);
+
+	for (ArgumentType arg : instruction_arg_types(opcode))
+	{
+		switch (arg)
+		{
+		case REG:
+		case LIT_8:
+			size += 1;
+			break;
+
+		case LIT_16:
+			size += 2;
+			break;
+
+		case REL_ADDR:
+		case LIT_32:
+			size += 4;
+			break;
+
+		case LIT_64:
+			size += 8;
+			break;
+
+		case NULL_TERMINATED_STRING:
+			size += strlen((const char *) instr + size) + 1;
+			break;
+		}
+	}
+
+	return size;
+}
+
+#endif
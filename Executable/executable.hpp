@@ -2,7 +2,13 @@
 #define TEA_EXECUTABLE_HEADER
 
 #include <cstring>
+#include <vector>
 #include "Shared/buffer.hpp"
+#include "Executable/native-import.hpp"
+#include "Executable/export-table.hpp"
+#include "Executable/sections.hpp"
+#include "Executable/upgrader.hpp"
+#include "Executable/verifier.hpp"
 
 /**
  * @brief Class that represents an executable.
@@ -16,36 +22,345 @@ struct Executable : public Buffer
 	// The size of the program segment.
 	uint64_t program_size;
 
+	// The native functions imported by the program.
+	// Read from the import table.
+	std::vector<NativeImport> native_imports;
+
+	// The functions exported by the program.
+	// Read from the export table.
+	ExportTable export_table;
+
+	// Whether the program was checked by `verify()`.
+	// The VM only runs verified programs.
+	bool verified = false;
+
+	// The largest number of bytes allocated or deallocated
+	// on the stack by a single instruction. Set by `verify()`.
+	uint64_t max_stack_allocation = 0;
+
 	/**
 	 * @brief Constructs a new `Executable` object.
 	 * @param buffer A pointer to the buffer that contains the executable.
 	 * @param size The size of the buffer that contains the executable.
 	 * @param static_data_size The size of the static data segment.
 	 * @param program_size The size of the program segment.
+	 * @param native_imports The native functions imported by the program.
+	 * @param export_table The functions exported by the program.
 	 */
 	Executable(uint8_t *buffer, size_t size,
-		uint64_t static_data_size, uint64_t program_size)
+		uint64_t static_data_size, uint64_t program_size,
+		std::vector<NativeImport> &&native_imports = {},
+		ExportTable &&export_table = {})
 		: Buffer(buffer, size),
 		  static_data_size(static_data_size),
-		  program_size(program_size) {}
+		  program_size(program_size),
+		  native_imports(std::move(native_imports)),
+		  export_table(std::move(export_table)) {}
 
 	/**
 	 * @brief Constructs an `Executable` object from a file.
-	 * @param file_name The file name of the executable. Must exist.
+	 * Throws an error message if the file cannot be read
+	 * or is too small to hold its segments.
+	 * @param file_name The file name of the executable.
 	 * @returns An `Executable` object of the file.
 	 */
 	static Executable
 	from_file(const char *file_name)
 	{
-		Buffer buffer             = Buffer::from_file(file_name);
-		size_t static_data_size   = buffer.get<uint64_t>(0);
-		size_t program_size       = buffer.get<uint64_t>(8);
-		size_t size_of_executable = buffer.size - 16;
-		uint8_t *executable       = new uint8_t[size_of_executable];
-		std::memcpy(executable, buffer.data + 16, size_of_executable);
-
-		return Executable(executable, size_of_executable,
-			static_data_size, program_size);
+		Buffer buffer = Buffer::from_file(file_name);
+		return from_buffer(buffer, file_name);
+	}
+
+	/**
+	 * @brief Constructs an `Executable` object from the contents
+	 * of an executable file. Both sectioned executables, see
+	 * `SectionTable`, and executables of version 1 are accepted.
+	 * Executables of version 1 were written by the first compiler. They
+	 * consist of the sizes of the static data and program segments,
+	 * followed by the segments. They have no import or export table.
+	 * Their program is upgraded, see `CodeUpgrader`.
+	 * Throws an error message if the buffer is too small to hold its segments.
+	 * @param buffer The contents of the executable file.
+	 * @param file_name The name of the executable, for error messages.
+	 * @returns An `Executable` object of the buffer.
+	 */
+	static Executable
+	from_buffer(Buffer &buffer, const char *file_name)
+	{
+		if (SectionTable::is_sectioned(buffer))
+		{
+			return from_sections(buffer, file_name);
+		}
+
+		if (buffer.size < 16
+			|| buffer.get<uint64_t>(0) > buffer.size
+			|| buffer.get<uint64_t>(8) > buffer.size - 16 - buffer.get<uint64_t>(0))
+		{
+			throw std::string("Invalid executable ") + file_name + "\n";
+		}
+
+		size_t static_data_size = buffer.get<uint64_t>(0);
+		size_t program_size     = buffer.get<uint64_t>(8);
+
+		return from_segments(buffer.data + 16, static_data_size,
+			buffer.data + 16 + static_data_size, program_size, 1, {}, {}, file_name);
+	}
+
+	/**
+	 * @brief Constructs an `Executable` object from the contents
+	 * of a sectioned executable file. The program of an executable
+	 * of version 2 is upgraded, see `CodeUpgrader`.
+	 * Throws an error message if the executable has no code section,
+	 * or has sections the VM does not support.
+	 * @param buffer The contents of the executable file.
+	 * @param file_name The name of the executable, for error messages.
+	 * @returns An `Executable` object of the buffer.
+	 */
+	static Executable
+	from_sections(Buffer &buffer, const char *file_name)
+	{
+		SectionTable table;
+
+		try
+		{
+			table = SectionTable::read(buffer);
+
+			for (const Section &section : table.sections)
+			{
+				if ((section.type == SECTION_DATA || section.type == SECTION_RELOCATIONS)
+					&& section.size != 0)
+				{
+					throw std::string("Unsupported section ")
+						+ section_type_to_str(section.type) + "\n";
+				}
+			}
+
+			if (table.find(SECTION_CODE) == nullptr)
+			{
+				throw std::string("No code section\n");
+			}
+		}
+		catch (const std::string &err_message)
+		{
+			throw std::string("Invalid executable ") + file_name + ": " + err_message;
+		}
+
+		const Section *code   = table.find(SECTION_CODE);
+		const Section *rodata = table.find(SECTION_RODATA);
+
+		std::vector<NativeImport> native_imports;
+		ExportTable export_table;
+
+		if (const Section *imports = table.find(SECTION_IMPORTS))
+		{
+			size_t offset  = imports->offset;
+			native_imports = read_import_table(buffer, offset);
+		}
+
+		if (const Section *exports = table.find(SECTION_EXPORTS))
+		{
+			export_table = read_export_table(buffer, exports->offset);
+		}
+
+		return from_segments(rodata != nullptr ? buffer.data + rodata->offset : nullptr,
+			rodata != nullptr ? rodata->size : 0, buffer.data + code->offset, code->size,
+			table.version, std::move(native_imports), std::move(export_table), file_name);
+	}
+
+	/**
+	 * @brief Constructs an `Executable` object from its segments.
+	 * The static data is copied in front of the program.
+	 * Programs in the older encoding of versions 1 and 2 are upgraded,
+	 * and the offsets of the export table are moved along.
+	 * Throws an error message if the program is invalid.
+	 * @param static_data The static data segment.
+	 * @param static_data_size The size of the static data segment.
+	 * @param program The program segment.
+	 * @param program_size The size of the program segment.
+	 * @param version The version of the executable.
+	 * @param native_imports The native functions imported by the program.
+	 * @param export_table The functions exported by the program.
+	 * @param file_name The name of the executable, for error messages.
+	 * @returns The verified executable.
+	 */
+	static Executable
+	from_segments(const uint8_t *static_data, size_t static_data_size,
+		const uint8_t *program, size_t program_size, uint32_t version,
+		std::vector<NativeImport> &&native_imports, ExportTable &&export_table,
+		const char *file_name)
+	{
+		std::vector<uint8_t> upgraded;
+
+		if (version < EXECUTABLE_VERSION)
+		{
+			CodeUpgrader upgrader(program, program_size, version);
+
+			try
+			{
+				upgrader.upgrade();
+			}
+			catch (const std::string &err_message)
+			{
+				throw std::string("Invalid executable ") + file_name + ": " + err_message;
+			}
+
+			export_table.init_end = upgrader.upgrade_offset(export_table.init_end);
+
+			for (ExportedFunction &function : export_table.functions)
+			{
+				function.offset = upgrader.upgrade_offset(function.offset);
+			}
+
+			upgraded     = std::move(upgrader.code);
+			program      = upgraded.data();
+			program_size = upgraded.size();
+		}
+
+		uint8_t *executable = new uint8_t[static_data_size + program_size];
+
+		if (static_data_size != 0)
+		{
+			std::memcpy(executable, static_data, static_data_size);
+		}
+
+		std::memcpy(executable + static_data_size, program, program_size);
+
+		Executable result(executable, static_data_size + program_size,
+			static_data_size, program_size,
+			std::move(native_imports), std::move(export_table));
+
+		result.verify(file_name);
+		return result;
+	}
+
+	/**
+	 * @brief Verifies the program and the exported functions of the
+	 * executable and marks it verified, see `Verifier`.
+	 * Throws an error message if the executable is invalid.
+	 * @param file_name The name of the executable, for error messages.
+	 */
+	void
+	verify(const char *file_name)
+	{
+		Verifier verifier(data + static_data_size, program_size, native_imports.size());
+
+		try
+		{
+			verifier.verify();
+
+			if (!export_table.functions.empty() && !verifier.is_instruction_start(export_table.init_end))
+			{
+				throw std::string("The initialiser does not end at an instruction\n");
+			}
+
+			for (const ExportedFunction &function : export_table.functions)
+			{
+				if (!verifier.is_instruction_start(function.offset))
+				{
+					throw "Exported function " + function.name
+						+ " does not start at an instruction\n";
+				}
+			}
+		}
+		catch (const std::string &err_message)
+		{
+			throw std::string("Invalid executable ") + file_name + ": " + err_message;
+		}
+
+		max_stack_allocation = verifier.max_stack_allocation;
+		verified             = true;
+	}
+
+	/**
+	 * @brief Reads the import table of an executable.
+	 * Executables without an import table have no native imports.
+	 * See `NativeImport` for the layout of the import table.
+	 * @param buffer The buffer containing the executable file.
+	 * @param offset The offset of the import table in the buffer.
+	 * Is moved past the end of the import table.
+	 * @returns The native imports of the executable.
+	 */
+	static std::vector<NativeImport>
+	read_import_table(Buffer &buffer, size_t &offset)
+	{
+		std::vector<NativeImport> native_imports;
+
+		if (offset + 8 > buffer.size)
+		{
+			return native_imports;
+		}
+
+		uint64_t import_count = buffer.get<uint64_t>(offset);
+		offset += 8;
+
+		for (uint64_t i = 0; i < import_count; i++)
+		{
+			NativeImport import;
+
+			import.library = (const char *) buffer.data + offset;
+			offset += import.library.size() + 1;
+			import.symbol = (const char *) buffer.data + offset;
+			offset += import.symbol.size() + 1;
+
+			import.return_type  = (NativeType) buffer.get<uint8_t>(offset++);
+			uint8_t param_count = buffer.get<uint8_t>(offset++);
+
+			for (uint8_t j = 0; j < param_count; j++)
+			{
+				import.param_types.push_back(
+					(NativeType) buffer.get<uint8_t>(offset++));
+			}
+
+			native_imports.push_back(std::move(import));
+		}
+
+		return native_imports;
+	}
+
+	/**
+	 * @brief Reads the export table of an executable.
+	 * Executables without an export table export nothing.
+	 * See `ExportTable` for the layout of the export table.
+	 * @param buffer The buffer containing the executable file.
+	 * @param offset The offset of the export table in the buffer.
+	 * @returns The export table of the executable.
+	 */
+	static ExportTable
+	read_export_table(Buffer &buffer, size_t offset)
+	{
+		ExportTable export_table;
+
+		if (offset + 16 > buffer.size)
+		{
+			return export_table;
+		}
+
+		export_table.init_end = buffer.get<uint64_t>(offset);
+		uint64_t export_count = buffer.get<uint64_t>(offset + 8);
+		offset += 16;
+
+		for (uint64_t i = 0; i < export_count; i++)
+		{
+			ExportedFunction function;
+
+			function.name = (const char *) buffer.data + offset;
+			offset += function.name.size() + 1;
+			function.offset = buffer.get<uint64_t>(offset);
+			offset += 8;
+
+			function.return_type = (NativeType) buffer.get<uint8_t>(offset++);
+			uint8_t param_count  = buffer.get<uint8_t>(offset++);
+
+			for (uint8_t j = 0; j < param_count; j++)
+			{
+				function.param_types.push_back(
+					(NativeType) buffer.get<uint8_t>(offset++));
+			}
+
+			export_table.functions.push_back(std::move(function));
+		}
+
+		return export_table;
 	}
 };
 
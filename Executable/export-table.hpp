@@ -0,0 +1,111 @@
+#ifndef TEA_EXPORT_TABLE_HEADER
+#define TEA_EXPORT_TABLE_HEADER
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Executable/native-import.hpp"
+
+/**
+ * @brief A function of the program that can be called by a host
+ * that embeds the VM. Only functions whose parameters and return
+ * value can cross the boundary to native code are exported.
+ */
+struct ExportedFunction
+{
+	// The name of the function.
+	std::string name;
+
+	// The offset of the entry of the function in the program segment.
+	uint64_t offset;
+
+	// The return type of the function.
+	NativeType return_type;
+
+	// The types of the parameters of the function.
+	std::vector<NativeType> param_types;
+};
+
+/**
+ * @brief The export table of an executable.
+ * Describes where the initialisation of the global variables ends
+ * and which functions can be called by a host.
+ *
+ * The export table is stored after the import table.
+ * Executables with an export table always contain an import table,
+ * which may be empty.
+ *
+ *   u64 offset of the end of the initialisation code
+ *   u64 export count
+ *   for each export:
+ *     null-terminated function name
+ *     u64 offset of the function entry
+ *     u8 return type
+ *     u8 parameter count
+ *     u8 parameter types[parameter count]
+ */
+struct ExportTable
+{
+	// The offset of the first instruction after the initialisation
+	// of the global variables. The program calls `main` from there.
+	// Zero if the executable has no export table.
+	uint64_t init_end = 0;
+
+	// The exported functions.
+	std::vector<ExportedFunction> functions;
+
+	/**
+	 * @brief Finds an exported function by name.
+	 * @param name The name of the function.
+	 * @returns A pointer to the function, or nullptr if it is not exported.
+	 */
+	const ExportedFunction *
+	find(const std::string &name) const
+	{
+		for (const ExportedFunction &function : functions)
+		{
+			if (function.name == name)
+			{
+				return &function;
+			}
+		}
+
+		return nullptr;
+	}
+
+	/**
+	 * @brief Encodes the export table as the contents
+	 * of the exports section of an executable.
+	 * @returns The contents of the section.
+	 */
+	std::vector<uint8_t>
+	to_section() const
+	{
+		std::vector<uint8_t> section;
+
+		auto push_u64 = [&](uint64_t value)
+		{
+			section.insert(section.end(), (uint8_t *) &value,
+				(uint8_t *) &value + sizeof(value));
+		};
+
+		push_u64(init_end);
+		push_u64(functions.size());
+
+		for (const ExportedFunction &function : functions)
+		{
+			section.insert(section.end(), function.name.begin(), function.name.end());
+			section.push_back('\0');
+			push_u64(function.offset);
+			section.push_back(function.return_type);
+			section.push_back(function.param_types.size());
+			section.insert(section.end(), function.param_types.begin(),
+				function.param_types.end());
+		}
+
+		return section;
+	}
+};
+
+#endif
@@ -0,0 +1,212 @@
+#ifndef TEA_LINE_TABLE_HEADER
+#define TEA_LINE_TABLE_HEADER
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Maps offsets in the program segment to lines of the source file.
+ * The table consists of runs. A run starts at an offset and covers all
+ * instructions up to the start of the next run, which were all generated
+ * for the same source line.
+ *
+ * In the debugger symbols file, the runs are stored delta-encoded as a
+ * single line of numbers: for each run, the offset relative to the
+ * previous run, followed by the line relative to the previous run.
+ * The lines section of an executable holds the path of the source file
+ * on the first line and the delta-encoded runs on the second line.
+ */
+struct LineTable
+{
+	/**
+	 * @brief A sequence of instructions generated for one source line.
+	 */
+	struct Run
+	{
+		// The offset of the first instruction of the run.
+		uint64_t offset;
+
+		// The source line of the instructions.
+		uint64_t line;
+	};
+
+	// The path of the source file.
+	std::string source_file;
+
+	// All runs, sorted by offset.
+	std::vector<Run> runs;
+
+	/**
+	 * @brief Records that the instructions starting at an offset
+	 * were generated for a source line. Runs must be added in order
+	 * of increasing offset.
+	 * @param offset The offset of the instruction.
+	 * @param line The source line, or 0 if the instructions
+	 * have no source line.
+	 */
+	void
+	add(uint64_t offset, uint64_t line)
+	{
+		if (runs.size() ? runs.back().line == line : line == 0)
+		{
+			return;
+		}
+
+		// A run that did not cover any instructions is replaced.
+
+		if (runs.size() && runs.back().offset == offset)
+		{
+			runs.pop_back();
+
+			if (runs.size() && runs.back().line == line)
+			{
+				return;
+			}
+		}
+
+		runs.push_back({ offset, line });
+	}
+
+	/**
+	 * @param offset The offset of an instruction in the program segment.
+	 * @returns The source line of the instruction,
+	 * or 0 if the instruction has no source line.
+	 */
+	uint64_t
+	line_of(uint64_t offset) const
+	{
+		auto it = std::upper_bound(runs.begin(), runs.end(), offset,
+			[](uint64_t offset, const Run &run) { return offset < run.offset; });
+
+		if (it == runs.begin())
+		{
+			return 0;
+		}
+
+		return (it - 1)->line;
+	}
+
+	/**
+	 * @returns The delta-encoded runs, separated by spaces.
+	 */
+	std::string
+	encode() const
+	{
+		std::string str;
+		uint64_t prev_offset = 0;
+		uint64_t prev_line   = 0;
+
+		for (const Run &run : runs)
+		{
+			if (str.size())
+			{
+				str += ' ';
+			}
+
+			str += std::to_string(run.offset - prev_offset);
+			str += ' ';
+			str += std::to_string((int64_t) (run.line - prev_line));
+			prev_offset = run.offset;
+			prev_line   = run.line;
+		}
+
+		return str;
+	}
+
+	/**
+	 * @brief Decodes delta-encoded runs and appends them to the table.
+	 * @param str The delta-encoded runs, separated by spaces.
+	 */
+	void
+	decode(const std::string &str)
+	{
+		std::istringstream stream(str);
+		uint64_t offset = 0;
+		uint64_t line   = 0;
+		uint64_t offset_delta;
+		int64_t line_delta;
+
+		while (stream >> offset_delta >> line_delta)
+		{
+			offset += offset_delta;
+			line += line_delta;
+			runs.push_back({ offset, line });
+		}
+	}
+
+	/**
+	 * @returns The contents of the lines section of an executable.
+	 */
+	std::string
+	to_section() const
+	{
+		return source_file + '\n' + encode() + '\n';
+	}
+
+	/**
+	 * @brief Reads the contents of the lines section of an executable.
+	 * @param section The contents of the section.
+	 * @returns The line table.
+	 */
+	static LineTable
+	from_section(const std::string &section)
+	{
+		LineTable table;
+		size_t end = section.find('\n');
+
+		if (end == std::string::npos)
+		{
+			return table;
+		}
+
+		table.source_file = section.substr(0, end);
+		table.decode(section.substr(end + 1));
+		return table;
+	}
+
+	/**
+	 * @brief Reads all lines of the source file.
+	 * @returns The lines of the source file, or an empty
+	 * vector if the source file cannot be read.
+	 */
+	std::vector<std::string>
+	read_source() const
+	{
+		std::vector<std::string> lines;
+		std::ifstream stream(source_file);
+		std::string line;
+
+		while (getline(stream, line))
+		{
+			lines.push_back(line);
+		}
+
+		return lines;
+	}
+
+	/**
+	 * @param source The lines of the source file, see `read_source()`.
+	 * @param line A source line.
+	 * @returns The text of the source line without leading
+	 * whitespace, or an empty string if it is not available.
+	 */
+	static std::string
+	source_text(const std::vector<std::string> &source, uint64_t line)
+	{
+		if (line == 0 || line > source.size())
+		{
+			return "";
+		}
+
+		const std::string &text = source[line - 1];
+		size_t start            = text.find_first_not_of(" \t");
+
+		return start == std::string::npos ? "" : text.substr(start);
+	}
+};
+
+#endif
@@ -0,0 +1,101 @@
+#ifndef TEA_NATIVE_IMPORT_HEADER
+#define TEA_NATIVE_IMPORT_HEADER
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @brief An enum of all types that can cross the boundary
+ * between a Tea program and a native host function.
+ */
+enum NativeType : uint8_t
+{
+	NATIVE_VOID,
+	NATIVE_U8,
+	NATIVE_I8,
+	NATIVE_U16,
+	NATIVE_I16,
+	NATIVE_U32,
+	NATIVE_I32,
+	NATIVE_U64,
+	NATIVE_I64,
+	NATIVE_F32,
+	NATIVE_F64,
+	NATIVE_PTR
+};
+
+/**
+ * @brief Converts a native type to a string.
+ * @param type The native type to convert.
+ * @returns A string representation of the native type.
+ */
+const char *
+native_type_to_str(NativeType type)
+{
+	switch (type)
+	{
+	case NATIVE_VOID:
+		return "v0";
+	case NATIVE_U8:
+		return "u8";
+	case NATIVE_I8:
+		return "i8";
+	case NATIVE_U16:
+		return "u16";
+	case NATIVE_I16:
+		return "i16";
+	case NATIVE_U32:
+		return "u32";
+	case NATIVE_I32:
+		return "i32";
+	case NATIVE_U64:
+		return "u64";
+	case NATIVE_I64:
+		return "i64";
+	case NATIVE_F32:
+		return "f32";
+	case NATIVE_F64:
+		return "f64";
+	case NATIVE_PTR:
+		return "ptr";
+	default:
+		return "UNDEFINED";
+	}
+}
+
+/**
+ * @brief An entry of the import table of an executable.
+ * Describes a function that lives in a native shared library
+ * and is called from the program with the CALL_NATIVE instruction.
+ * The index of the entry in the import table is the operand
+ * of the CALL_NATIVE instruction.
+ *
+ * The import table is stored after the program segment:
+ *
+ *   u64 import count
+ *   for each import:
+ *     null-terminated library name (empty for the host process)
+ *     null-terminated symbol name
+ *     u8 return type
+ *     u8 parameter count
+ *     u8 parameter types[parameter count]
+ */
+struct NativeImport
+{
+	// The name of the shared library that contains the function.
+	// An empty library name refers to the VM process itself,
+	// which includes the C standard library.
+	std::string library;
+
+	// The name of the symbol of the function.
+	std::string symbol;
+
+	// The return type of the function.
+	NativeType return_type;
+
+	// The types of the parameters of the function.
+	std::vector<NativeType> param_types;
+};
+
+#endif
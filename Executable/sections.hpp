@@ -0,0 +1,305 @@
+#ifndef TEA_SECTIONS_HEADER
+#define TEA_SECTIONS_HEADER
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "Shared/buffer.hpp"
+
+// Identifies a sectioned executable, "TEAEXEC" in little endian.
+// Executables of version 1, written by the first compiler, have no header.
+// They start with the size of their static data, which is never this large.
+#define EXECUTABLE_MAGIC 0x0043455845414554
+
+// The version of the layout of a sectioned executable.
+// Version 3 uses one-byte opcodes and 32-bit relative addresses.
+// Version 2 uses the older encoding, its code is upgraded when it is
+// loaded, see `CodeUpgrader`.
+#define EXECUTABLE_VERSION 3
+
+// The alignment of the sections in the file, so every section
+// can be mapped into memory directly.
+#define SECTION_ALIGNMENT 4096
+
+/**
+ * @brief Enum for the sections of an executable.
+ */
+enum SectionType : uint32_t
+{
+	// The program segment, executable code.
+	SECTION_CODE = 1,
+
+	// The static data segment, read-only data that is copied
+	// in front of the stack. Stored in memory order.
+	SECTION_RODATA,
+
+	// Pre-initialised writable data.
+	// Not produced by the compiler yet.
+	SECTION_DATA,
+
+	// Zero-initialised data. Has a size, but no contents in the file.
+	// Holds the global variables, which the program allocates
+	// on the stack before it calls `main`.
+	SECTION_BSS,
+
+	// The native functions imported by the program, see `NativeImport`.
+	SECTION_IMPORTS,
+
+	// The symbol table: the functions exported to a host, see `ExportTable`.
+	SECTION_EXPORTS,
+
+	// Relocations of the code. The code is position-independent,
+	// so this is not produced by the compiler yet.
+	SECTION_RELOCATIONS,
+
+	// The line table, see `LineTable`. Only in debug builds.
+	SECTION_LINES,
+
+	// The debugger symbols, see `DebuggerSymbols`. Only in debug builds.
+	SECTION_DEBUG,
+};
+
+/**
+ * @param type A section type.
+ * @returns The name of the section type.
+ */
+const char *
+section_type_to_str(uint32_t type)
+{
+	switch (type)
+	{
+	case SECTION_CODE:
+		return "code";
+	case SECTION_RODATA:
+		return "rodata";
+	case SECTION_DATA:
+		return "data";
+	case SECTION_BSS:
+		return "bss";
+	case SECTION_IMPORTS:
+		return "imports";
+	case SECTION_EXPORTS:
+		return "exports";
+	case SECTION_RELOCATIONS:
+		return "relocations";
+	case SECTION_LINES:
+		return "lines";
+	case SECTION_DEBUG:
+		return "debug";
+	default:
+		return "unknown";
+	}
+}
+
+/**
+ * @brief An entry of the section table.
+ */
+struct Section
+{
+	// The type of the section, see `SectionType`.
+	uint32_t type;
+
+	// Reserved, must be 0.
+	uint32_t flags;
+
+	// The offset of the contents of the section in the file.
+	// A multiple of `SECTION_ALIGNMENT`, or 0 if the section
+	// has no contents in the file.
+	uint64_t offset;
+
+	// The size of the section in bytes.
+	uint64_t size;
+};
+
+/**
+ * @brief The section table of a sectioned executable.
+ *
+ * A sectioned executable consists of a header, a section table
+ * and the contents of the sections. Every section starts at
+ * a multiple of `SECTION_ALIGNMENT`.
+ *
+ *   u64 magic, EXECUTABLE_MAGIC
+ *   u32 version, EXECUTABLE_VERSION
+ *   u32 section count
+ *   for each section:
+ *     u32 type
+ *     u32 flags
+ *     u64 offset
+ *     u64 size
+ *   padding
+ *   section contents, each padded to SECTION_ALIGNMENT
+ */
+struct SectionTable
+{
+	// The version of the executable that was read.
+	uint32_t version = EXECUTABLE_VERSION;
+
+	// The sections, in the order of the file.
+	std::vector<Section> sections;
+
+	// The contents of the sections while the executable is built.
+	// Indexed like `sections`.
+	std::vector<std::vector<uint8_t>> contents;
+
+	/**
+	 * @param buffer The contents of an executable file.
+	 * @returns Whether the executable is sectioned, version 2 or later.
+	 */
+	static bool
+	is_sectioned(const Buffer &buffer)
+	{
+		uint64_t magic = 0;
+
+		if (buffer.size >= sizeof(magic))
+		{
+			memcpy(&magic, buffer.data, sizeof(magic));
+		}
+
+		return magic == EXECUTABLE_MAGIC;
+	}
+
+	/**
+	 * @brief Reads the section table of a sectioned executable.
+	 * Throws an error message if the executable has an unknown version,
+	 * or if a section lies outside of the file.
+	 * @param buffer The contents of the executable file.
+	 * @returns The section table.
+	 */
+	static SectionTable
+	read(const Buffer &buffer)
+	{
+		SectionTable table;
+
+		if (buffer.size < 16)
+		{
+			throw std::string("Truncated header\n");
+		}
+
+		uint32_t section_count;
+		memcpy(&table.version, buffer.data + 8, sizeof(table.version));
+		memcpy(&section_count, buffer.data + 12, sizeof(section_count));
+
+		if (table.version != 2 && table.version != EXECUTABLE_VERSION)
+		{
+			throw "Unsupported version " + std::to_string(table.version) + "\n";
+		}
+
+		if (section_count > (buffer.size - 16) / sizeof(Section))
+		{
+			throw std::string("Truncated section table\n");
+		}
+
+		table.sections.resize(section_count);
+		memcpy(table.sections.data(), buffer.data + 16, section_count * sizeof(Section));
+
+		for (const Section &section : table.sections)
+		{
+			if (section.offset == 0 && section.type == SECTION_BSS)
+			{
+				continue;
+			}
+
+			if (section.offset > buffer.size || section.size > buffer.size - section.offset)
+			{
+				throw std::string("Section ") + section_type_to_str(section.type)
+					+ " lies outside of the file\n";
+			}
+		}
+
+		return table;
+	}
+
+	/**
+	 * @param type A section type.
+	 * @returns The first section of the type, or nullptr if there is none.
+	 */
+	const Section *
+	find(SectionType type) const
+	{
+		for (const Section &section : sections)
+		{
+			if (section.type == type)
+			{
+				return &section;
+			}
+		}
+
+		return nullptr;
+	}
+
+	/**
+	 * @brief Adds a section to the executable that is built.
+	 * @param type The type of the section.
+	 * @param data A pointer to the contents of the section.
+	 * @param size The size of the section in bytes.
+	 */
+	void
+	add(SectionType type, const uint8_t *data, size_t size)
+	{
+		sections.push_back({ type, 0, 0, size });
+		contents.emplace_back(data, data + size);
+	}
+
+	/**
+	 * @brief Adds a section without contents in the file,
+	 * like `SECTION_BSS`, to the executable that is built.
+	 * @param type The type of the section.
+	 * @param size The size of the section in bytes.
+	 */
+	void
+	add_empty(SectionType type, size_t size)
+	{
+		sections.push_back({ type, 0, 0, size });
+		contents.emplace_back();
+	}
+
+	/**
+	 * @brief Lays out the added sections and writes the executable.
+	 * @returns The contents of the executable file.
+	 */
+	Buffer
+	build()
+	{
+		size_t offset = align(16 + sections.size() * sizeof(Section));
+
+		for (size_t i = 0; i < sections.size(); i++)
+		{
+			if (!contents[i].empty())
+			{
+				sections[i].offset = offset;
+				offset             = align(offset + contents[i].size());
+			}
+		}
+
+		Buffer buffer(new uint8_t[offset](), offset);
+		uint64_t magic         = EXECUTABLE_MAGIC;
+		uint32_t version       = EXECUTABLE_VERSION;
+		uint32_t section_count = sections.size();
+
+		memcpy(buffer.data, &magic, sizeof(magic));
+		memcpy(buffer.data + 8, &version, sizeof(version));
+		memcpy(buffer.data + 12, &section_count, sizeof(section_count));
+		memcpy(buffer.data + 16, sections.data(), sections.size() * sizeof(Section));
+
+		for (size_t i = 0; i < sections.size(); i++)
+		{
+			memcpy(buffer.data + sections[i].offset, contents[i].data(), contents[i].size());
+		}
+
+		return buffer;
+	}
+
+	/**
+	 * @param offset An offset in the file.
+	 * @returns The offset, rounded up to `SECTION_ALIGNMENT`.
+	 */
+	static size_t
+	align(size_t offset)
+	{
+		return (offset + SECTION_ALIGNMENT - 1) / SECTION_ALIGNMENT * SECTION_ALIGNMENT;
+	}
+};
+
+#endif
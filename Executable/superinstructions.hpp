@@ -0,0 +1,28 @@
+// Generated by Superinstructions/synthesize from 11 profiles.
+// Regenerate with ./synthesize-superinstructions.sh, do not edit.
+
+#ifndef TEA_SUPERINSTRUCTIONS_HEADER
+#define TEA_SUPERINSTRUCTIONS_HEADER
+
+// The superinstructions, most profitable first. Expanded with a macro
+// X(name, instructions...) that takes the name of a superinstruction
+// and the sequence of instructions it executes.
+#define SUPERINSTRUCTIONS(X) \
+	X(SUPER_MOVE_LIT_8_ADD_INT_64_LOAD_PTR_64, MOVE_LIT_8, ADD_INT_64, LOAD_PTR_64) \
+	X(SUPER_MOVE_LIT_8_ADD_INT_64, MOVE_LIT_8, ADD_INT_64) \
+	X(SUPER_ADD_INT_64_LOAD_PTR_64_MOVE_LIT_8, ADD_INT_64, LOAD_PTR_64, MOVE_LIT_8) \
+	X(SUPER_ADD_INT_64_LOAD_PTR_64, ADD_INT_64, LOAD_PTR_64) \
+	X(SUPER_MOVE_LIT_8_ADD_INT_64_STORE_PTR_64, MOVE_LIT_8, ADD_INT_64, STORE_PTR_64) \
+	X(SUPER_LOAD_PTR_64_MOVE_LIT_8_ADD_INT_64, LOAD_PTR_64, MOVE_LIT_8, ADD_INT_64) \
+	X(SUPER_LOAD_PTR_64_MOVE_LIT_8, LOAD_PTR_64, MOVE_LIT_8) \
+	X(SUPER_MOVE_LIT_8_CMP_INT_8_JUMP_IF_EQ, MOVE_LIT_8, CMP_INT_8, JUMP_IF_EQ) \
+	X(SUPER_ADD_INT_64_STORE_PTR_64, ADD_INT_64, STORE_PTR_64) \
+	X(SUPER_ADD_INT_64_STORE_PTR_64_MOVE_LIT_8, ADD_INT_64, STORE_PTR_64, MOVE_LIT_8) \
+	X(SUPER_STORE_PTR_64_MOVE_LIT_8_ADD_INT_64, STORE_PTR_64, MOVE_LIT_8, ADD_INT_64) \
+	X(SUPER_ADD_INT_64_MOVE_LIT_8_ADD_INT_64, ADD_INT_64, MOVE_LIT_8, ADD_INT_64) \
+	X(SUPER_ADD_INT_64_STORE_PTR_64_JUMP, ADD_INT_64, STORE_PTR_64, JUMP) \
+	X(SUPER_LOAD_PTR_64_MOVE_LIT_8_CMP_INT_64_U, LOAD_PTR_64, MOVE_LIT_8, CMP_INT_64_U) \
+	X(SUPER_ADD_INT_64_LOAD_PTR_64_ADD_INT_64, ADD_INT_64, LOAD_PTR_64, ADD_INT_64) \
+	X(SUPER_MOVE_LIT_8_CMP_INT_64_U_SET_IF_NEQ, MOVE_LIT_8, CMP_INT_64_U, SET_IF_NEQ)
+
+#endif
@@ -0,0 +1,380 @@
+#ifndef TEA_UPGRADER_HEADER
+#define TEA_UPGRADER_HEADER
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "Executable/byte-code.hpp"
+#include "Executable/line-table.hpp"
+
+/**
+ * @brief Re-encodes the program of an executable of version 1 or 2
+ * in the current bytecode encoding, so older executables can still be run.
+ *
+ * Version 1 is the headerless format of the first compiler, see
+ * `Executable::from_buffer()`. Version 2 is the first sectioned format.
+ * Both differ from the current encoding in three ways:
+ * - Opcodes are 16 bits wide.
+ * - Relative addresses are 64 bits wide. Like now, they are relative
+ *   to the start of the instruction that holds them.
+ * - Opcodes are numbered differently. Version 1 opcodes are mapped with
+ *   `VERSION_1_OPCODES`. Version 2 has no MOVE_LIT_8 or MOVE_LIT_32,
+ *   so every opcode after MOVE_LIT is two lower than now.
+ *
+ * MOVE_LIT instructions whose literal fits in a shorter form are
+ * re-encoded as MOVE_LIT_8 or MOVE_LIT_32.
+ */
+struct CodeUpgrader
+{
+	// The instructions of version 1, indexed by their opcode in that version.
+	static constexpr Instruction VERSION_1_OPCODES[] = {
+		MOVE_LIT, MOVE,
+		LOAD_PTR_8, LOAD_PTR_16, LOAD_PTR_32, LOAD_PTR_64,
+		STORE_PTR_8, STORE_PTR_16, STORE_PTR_32, STORE_PTR_64,
+		MEM_COPY,
+		ADD_INT_8, ADD_INT_16, ADD_INT_32, ADD_INT_64, ADD_FLT_32, ADD_FLT_64,
+		SUB_INT_8, SUB_INT_16, SUB_INT_32, SUB_INT_64, SUB_FLT_32, SUB_FLT_64,
+		MUL_INT_8, MUL_INT_16, MUL_INT_32, MUL_INT_64, MUL_FLT_32, MUL_FLT_64,
+		DIV_INT_8, DIV_INT_16, DIV_INT_32, DIV_INT_64, DIV_FLT_32, DIV_FLT_64,
+		MOD_INT_8, MOD_INT_16, MOD_INT_32, MOD_INT_64,
+		AND_INT_8, AND_INT_16, AND_INT_32, AND_INT_64,
+		OR_INT_8, OR_INT_16, OR_INT_32, OR_INT_64,
+		XOR_INT_8, XOR_INT_16, XOR_INT_32, XOR_INT_64,
+		SHL_INT_8, SHL_INT_16, SHL_INT_32, SHL_INT_64,
+		SHR_INT_8, SHR_INT_16, SHR_INT_32, SHR_INT_64,
+		INC_INT_8, INC_INT_16, INC_INT_32, INC_INT_64,
+		DEC_INT_8, DEC_INT_16, DEC_INT_32, DEC_INT_64,
+		NEG_INT_8, NEG_INT_16, NEG_INT_32, NEG_INT_64,
+		CAST_INT_TO_FLT_32, CAST_INT_TO_FLT_64, CAST_FLT_32_TO_INT, CAST_FLT_64_TO_INT,
+		CMP_INT_8, CMP_INT_8_U, CMP_INT_16, CMP_INT_16_U,
+		CMP_INT_32, CMP_INT_32_U, CMP_INT_64, CMP_INT_64_U, CMP_FLT_32, CMP_FLT_64,
+		SET_IF_GT, SET_IF_GEQ, SET_IF_LT, SET_IF_LEQ, SET_IF_EQ, SET_IF_NEQ,
+		JUMP, JUMP_IF_GT, JUMP_IF_GEQ, JUMP_IF_LT, JUMP_IF_LEQ, JUMP_IF_EQ, JUMP_IF_NEQ,
+		PUSH_REG_8, PUSH_REG_16, PUSH_REG_32, PUSH_REG_64,
+		POP_8_INTO_REG, POP_16_INTO_REG, POP_32_INTO_REG, POP_64_INTO_REG,
+		CALL, RETURN, ALLOCATE_STACK, DEALLOCATE_STACK,
+		COMMENT, LABEL,
+		PRINT_CHAR, GET_CHAR,
+	};
+
+	// The number of instructions of version 2. It ends at BENCH_END,
+	// and lacks MOVE_LIT_8 and MOVE_LIT_32.
+	static constexpr uint16_t VERSION_2_INSTRUCTION_COUNT = BENCH_END + 1 - 2;
+
+	// The program in the older encoding.
+	const uint8_t *program;
+
+	// The size of the program in bytes.
+	uint64_t program_size;
+
+	// The version of the executable the program belongs to, 1 or 2.
+	uint32_t version;
+
+	// The offset of every instruction in the upgraded program,
+	// indexed by its offset in the older program.
+	// UINT64_MAX for offsets that are not the start of an instruction.
+	// Has one extra entry for the end of the program.
+	std::vector<uint64_t> new_offsets;
+
+	// The upgraded program. Set by `upgrade()`.
+	std::vector<uint8_t> code;
+
+	/**
+	 * @brief Constructs a new CodeUpgrader object.
+	 * @param program The program in the older encoding.
+	 * @param program_size The size of the program in bytes.
+	 * @param version The version of the executable, 1 or 2.
+	 */
+	CodeUpgrader(const uint8_t *program, uint64_t program_size, uint32_t version)
+		: program(program), program_size(program_size), version(version),
+		  new_offsets(program_size + 1, UINT64_MAX) {}
+
+	/**
+	 * @brief Throws an error message about an instruction.
+	 * @param offset The offset of the instruction in the older program.
+	 * @param message What is wrong with the instruction.
+	 */
+	[[noreturn]] static void
+	reject(uint64_t offset, const std::string &message)
+	{
+		char location[64];
+		snprintf(location, sizeof(location), "Instruction at offset 0x%04lx: ", offset);
+		throw location + message + "\n";
+	}
+
+	/**
+	 * @brief Reads a little-endian literal from the older program.
+	 * Throws an error message if it runs past the end of the program.
+	 * @param instr The offset of the instruction the literal belongs to.
+	 * @param offset The offset of the literal.
+	 * @param size The size of the literal in bytes.
+	 * @returns The literal, zero-extended.
+	 */
+	uint64_t
+	read_literal(uint64_t instr, uint64_t offset, size_t size)
+	{
+		if (offset > program_size || program_size - offset < size)
+		{
+			reject(instr, "runs past the end of the program");
+		}
+
+		uint64_t value = 0;
+		memcpy(&value, program + offset, size);
+		return value;
+	}
+
+	/**
+	 * @brief Converts an opcode of the older encoding to the current one.
+	 * Throws an error message if the opcode is unknown.
+	 * @param offset The offset of the instruction in the older program.
+	 * @param opcode An opcode of the older encoding.
+	 * @returns The opcode in the current encoding.
+	 */
+	Instruction
+	upgrade_opcode(uint64_t offset, uint16_t opcode) const
+	{
+		if (version == 1 && opcode < std::size(VERSION_1_OPCODES))
+		{
+			return VERSION_1_OPCODES[opcode];
+		}
+
+		if (version == 2 && opcode < VERSION_2_INSTRUCTION_COUNT)
+		{
+			return (Instruction) (opcode == MOVE_LIT ? MOVE_LIT : opcode + 2);
+		}
+
+		reject(offset, "unknown opcode " + std::to_string(opcode));
+	}
+
+	/**
+	 * @param opcode An opcode of the current encoding.
+	 * @param lit The literal of a MOVE_LIT instruction.
+	 * @returns The shortest form of the instruction.
+	 */
+	static Instruction
+	shorten(Instruction opcode, uint64_t lit)
+	{
+		if (opcode != MOVE_LIT)
+		{
+			return opcode;
+		}
+
+		if ((int64_t) lit == (int8_t) lit)
+		{
+			return MOVE_LIT_8;
+		}
+
+		if ((int64_t) lit == (int32_t) lit)
+		{
+			return MOVE_LIT_32;
+		}
+
+		return MOVE_LIT;
+	}
+
+	/**
+	 * @brief Walks over the older program and calls a function
+	 * for every instruction.
+	 * Throws an error message on an unknown opcode, or an instruction
+	 * that runs past the end of the program.
+	 * @param on_instruction Called with the offset of the instruction,
+	 * its upgraded opcode, and the offsets and sizes of its arguments.
+	 */
+	template <typename Function>
+	void
+	for_each_instruction(Function on_instruction)
+	{
+		uint64_t offset = 0;
+
+		while (offset < program_size)
+		{
+			Instruction opcode = upgrade_opcode(offset, read_literal(offset, offset, 2));
+			uint64_t arg       = offset + 2;
+			std::vector<std::pair<uint64_t, size_t>> args;
+
+			for (ArgumentType type : instruction_arg_types(opcode))
+			{
+				size_t size = 0;
+
+				switch (type)
+				{
+				case REG:
+				case LIT_8:
+					size = 1;
+					break;
+
+				case LIT_16:
+					size = 2;
+					break;
+
+				case LIT_32:
+					size = 4;
+					break;
+
+				case REL_ADDR:
+				case LIT_64:
+					size = 8;
+					break;
+
+				case NULL_TERMINATED_STRING:
+				{
+					const void *end = arg < program_size
+						? memchr(program + arg, '\0', program_size - arg)
+						: nullptr;
+
+					if (end == nullptr)
+					{
+						reject(offset, "unterminated string");
+					}
+
+					size = (const uint8_t *) end - (program + arg) + 1;
+					break;
+				}
+
+				default:
+					reject(offset, "unknown argument type");
+				}
+
+				read_literal(offset, arg, type == NULL_TERMINATED_STRING ? 0 : size);
+				args.push_back({ arg, size });
+				arg += size;
+			}
+
+			on_instruction(offset, opcode, args);
+			offset = arg;
+		}
+	}
+
+	/**
+	 * @brief Re-encodes the program.
+	 * Throws an error message if the program is invalid.
+	 */
+	void
+	upgrade()
+	{
+		// Find the new offset of every instruction first,
+		// so relative addresses that point forward can be re-encoded.
+
+		uint64_t new_offset = 0;
+
+		for_each_instruction([&](uint64_t offset, Instruction opcode,
+			const std::vector<std::pair<uint64_t, size_t>> &args)
+		{
+			new_offsets[offset] = new_offset;
+			new_offset += sizeof(Instruction);
+
+			if (opcode == MOVE_LIT)
+			{
+				opcode = shorten(opcode, read_literal(offset, args[0].first, 8));
+				new_offset += opcode == MOVE_LIT_8 ? 1 : opcode == MOVE_LIT_32 ? 4 : 8;
+				new_offset += 1;
+				return;
+			}
+
+			std::vector<ArgumentType> types = instruction_arg_types(opcode);
+
+			for (size_t i = 0; i < args.size(); i++)
+			{
+				new_offset += types[i] == REL_ADDR ? 4 : args[i].second;
+			}
+		});
+
+		new_offsets[program_size] = new_offset;
+		code.reserve(new_offset);
+
+		for_each_instruction([&](uint64_t offset, Instruction opcode,
+			const std::vector<std::pair<uint64_t, size_t>> &args)
+		{
+			std::vector<ArgumentType> types = instruction_arg_types(opcode);
+
+			if (opcode == MOVE_LIT)
+			{
+				uint64_t lit = read_literal(offset, args[0].first, 8);
+				opcode       = shorten(opcode, lit);
+				size_t size  = opcode == MOVE_LIT_8 ? 1 : opcode == MOVE_LIT_32 ? 4 : 8;
+
+				code.push_back(opcode);
+				code.insert(code.end(), (uint8_t *) &lit, (uint8_t *) &lit + size);
+				code.push_back(program[args[1].first]);
+				return;
+			}
+
+			code.push_back(opcode);
+
+			for (size_t i = 0; i < args.size(); i++)
+			{
+				auto [arg, size] = args[i];
+
+				if (types[i] != REL_ADDR)
+				{
+					code.insert(code.end(), program + arg, program + arg + size);
+					continue;
+				}
+
+				uint64_t target  = offset + (int64_t) read_literal(offset, arg, 8);
+				int64_t relative = upgrade_offset(target) - new_offsets[offset];
+
+				if (target > program_size || new_offsets[target] == UINT64_MAX
+					|| relative != (int32_t) relative)
+				{
+					reject(offset, "target " + std::to_string((int64_t) (target - offset))
+						+ " is not the start of an instruction");
+				}
+
+				int32_t new_relative = relative;
+				code.insert(code.end(), (uint8_t *) &new_relative,
+					(uint8_t *) &new_relative + sizeof(new_relative));
+			}
+		});
+	}
+
+	/**
+	 * @param offset An offset in the older program.
+	 * @returns The offset in the upgraded program, or UINT64_MAX if the
+	 * offset is not the start of an instruction or the end of the program.
+	 * Only valid after `upgrade()`.
+	 */
+	uint64_t
+	upgrade_offset(uint64_t offset) const
+	{
+		return offset <= program_size ? new_offsets[offset] : UINT64_MAX;
+	}
+
+	/**
+	 * @brief Moves the runs of the line table of a program in the older
+	 * encoding to the offsets of the upgraded program.
+	 * Throws an error message if the program is invalid.
+	 * @param program The program in the older encoding.
+	 * @param program_size The size of the program in bytes.
+	 * @param version The version of the executable, 1 or 2.
+	 * @param lines The line table of the program.
+	 */
+	static void
+	upgrade_line_table(const uint8_t *program, uint64_t program_size, uint32_t version,
+		LineTable &lines)
+	{
+		CodeUpgrader upgrader(program, program_size, version);
+		upgrader.upgrade();
+
+		LineTable upgraded;
+		upgraded.source_file = lines.source_file;
+
+		for (const LineTable::Run &run : lines.runs)
+		{
+			uint64_t offset = upgrader.upgrade_offset(run.offset);
+
+			if (offset != UINT64_MAX)
+			{
+				upgraded.add(offset, run.line);
+			}
+		}
+
+		lines = std::move(upgraded);
+	}
+};
+
+#endif
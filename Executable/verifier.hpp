@@ -0,0 +1,209 @@
+#ifndef TEA_VERIFIER_HEADER
+#define TEA_VERIFIER_HEADER
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "Executable/byte-code.hpp"
+
+/**
+ * @brief Checks that a program only contains well-formed instructions,
+ * so the interpreter can run it without checking anything itself.
+ * A program is valid if:
+ * - Every opcode is a known instruction. Superinstructions are not
+ *   allowed, they are only introduced by the VM when it loads a program.
+ * - Every instruction, including its literals and strings,
+ *   lies within the program.
+ * - Every register argument refers to an existing register.
+ * - Every jump, call and thread target is the start of an instruction
+ *   or the end of the program.
+ * - Every native call refers to an import of the executable.
+ */
+struct Verifier
+{
+	// The program.
+	const uint8_t *program;
+
+	// The size of the program in bytes.
+	uint64_t program_size;
+
+	// The number of native functions imported by the executable.
+	size_t import_count;
+
+	// Whether each offset of the program is the start of an instruction.
+	// Has one extra entry for the end of the program.
+	std::vector<bool> instruction_starts;
+
+	// The largest number of bytes allocated or deallocated
+	// on the stack by a single instruction.
+	uint64_t max_stack_allocation = 0;
+
+	/**
+	 * @brief Constructs a new Verifier object.
+	 * @param program The program.
+	 * @param program_size The size of the program in bytes.
+	 * @param import_count The number of native functions imported by the executable.
+	 */
+	Verifier(const uint8_t *program, uint64_t program_size, size_t import_count)
+		: program(program), program_size(program_size), import_count(import_count),
+		  instruction_starts(program_size + 1, false) {}
+
+	/**
+	 * @brief Throws an error message about an instruction.
+	 * @param offset The offset of the instruction.
+	 * @param message What is wrong with the instruction.
+	 */
+	[[noreturn]] static void
+	reject(uint64_t offset, const std::string &message)
+	{
+		char location[64];
+		snprintf(location, sizeof(location), "Instruction at offset 0x%04lx: ", offset);
+		throw location + message + "\n";
+	}
+
+	/**
+	 * @brief Reads a little-endian literal from the program.
+	 * @param offset The offset of the literal.
+	 * @param size The size of the literal in bytes.
+	 * @returns The literal, zero-extended.
+	 */
+	uint64_t
+	read_literal(uint64_t offset, size_t size)
+	{
+		uint64_t value = 0;
+		memcpy(&value, program + offset, size);
+		return value;
+	}
+
+	/**
+	 * @brief Verifies the program.
+	 * Throws an error message on the first invalid instruction.
+	 */
+	void
+	verify()
+	{
+		// Jump targets can point forward, they are checked after
+		// all instructions were found.
+
+		std::vector<std::pair<uint64_t, uint64_t>> targets;
+		uint64_t offset = 0;
+
+		while (offset < program_size)
+		{
+			Instruction opcode = (Instruction) program[offset];
+
+			if (opcode >= INSTRUCTION_COUNT)
+			{
+				reject(offset, "unknown opcode " + std::to_string(opcode));
+			}
+
+			instruction_starts[offset] = true;
+			uint64_t arg               = offset + sizeof(Instruction);
+
+			for (ArgumentType type : instruction_arg_types(opcode))
+			{
+				size_t size = 0;
+
+				switch (type)
+				{
+				case REG:
+				case LIT_8:
+					size = 1;
+					break;
+
+				case LIT_16:
+					size = 2;
+					break;
+
+				case REL_ADDR:
+				case LIT_32:
+					size = 4;
+					break;
+
+				case LIT_64:
+					size = 8;
+					break;
+
+				case NULL_TERMINATED_STRING:
+				{
+					const void *end = memchr(program + arg, '\0', program_size - arg);
+
+					if (end == nullptr)
+					{
+						reject(offset, "unterminated string");
+					}
+
+					size = (const uint8_t *) end - (program + arg) + 1;
+					break;
+				}
+
+				default:
+					reject(offset, std::string(instruction_to_str(opcode))
+						+ " has an unknown argument type");
+				}
+
+				if (program_size - arg < size)
+				{
+					reject(offset, std::string(instruction_to_str(opcode))
+						+ " runs past the end of the program");
+				}
+
+				uint64_t value = type == NULL_TERMINATED_STRING ? 0 : read_literal(arg, size);
+
+				if (type == REG && value >= TOTAL_REGISTER_COUNT)
+				{
+					reject(offset, "register " + std::to_string(value) + " does not exist");
+				}
+
+				if (type == REL_ADDR)
+				{
+					targets.push_back({ offset, offset + (int32_t) value });
+				}
+
+				arg += size;
+			}
+
+			if (opcode == CALL_NATIVE && read_literal(offset + sizeof(Instruction), 4) >= import_count)
+			{
+				reject(offset, "CALL_NATIVE to undefined import "
+					+ std::to_string(read_literal(offset + sizeof(Instruction), 4)));
+			}
+
+			if (opcode == ALLOCATE_STACK || opcode == DEALLOCATE_STACK)
+			{
+				max_stack_allocation = std::max(max_stack_allocation,
+					read_literal(offset + sizeof(Instruction), 8));
+			}
+
+			offset = arg;
+		}
+
+		instruction_starts[program_size] = true;
+
+		for (auto [source, target] : targets)
+		{
+			if (!is_instruction_start(target))
+			{
+				reject(source, "target " + std::to_string((int64_t) (target - source))
+					+ " is not the start of an instruction");
+			}
+		}
+	}
+
+	/**
+	 * @param offset An offset into the program.
+	 * @returns Whether the offset is the start of an instruction
+	 * or the end of the program. Only valid after `verify()`.
+	 */
+	bool
+	is_instruction_start(uint64_t offset)
+	{
+		return offset <= program_size && instruction_starts[offset];
+	}
+};
+
+#endif
@@ -0,0 +1,503 @@
+#include <cstring>
+#include <unordered_map>
+
+#include "Library/libtea.hpp"
+#include "VM/cpu.hpp"
+
+namespace tea
+{
+const char *
+status_to_str(Status status)
+{
+	switch (status)
+	{
+	case Status::OK:
+		return "OK";
+	case Status::FILE_ERROR:
+		return "FILE_ERROR";
+	case Status::INVALID_EXECUTABLE:
+		return "INVALID_EXECUTABLE";
+	case Status::NATIVE_ERROR:
+		return "NATIVE_ERROR";
+	case Status::FUNCTION_NOT_FOUND:
+		return "FUNCTION_NOT_FOUND";
+	case Status::ARGUMENT_MISMATCH:
+		return "ARGUMENT_MISMATCH";
+	case Status::RUNTIME_ERROR:
+		return "RUNTIME_ERROR";
+	case Status::CONTEXT_FAULTED:
+		return "CONTEXT_FAULTED";
+	case Status::OUT_OF_FUEL:
+		return "OUT_OF_FUEL";
+	case Status::NOT_INTERRUPTED:
+		return "NOT_INTERRUPTED";
+	default:
+		return "UNDEFINED";
+	}
+}
+
+/**
+ * @brief The implementation of a program.
+ * The program segment and the native functions are shared by all contexts.
+ */
+struct Program::Impl
+{
+	// The loaded executable.
+	Executable executable;
+
+	// The program segment, shared by the CPUs of all contexts.
+	uint8_t *program_region;
+
+	// The resolved native functions, copied into the CPUs of all contexts.
+	std::vector<NativeFunction> native_functions;
+
+	// Maps the names of the exported functions to their export table entry.
+	std::unordered_map<std::string, const ExportedFunction *> functions;
+
+	// The fuel costs of the program, shared by the CPUs of all contexts.
+	std::shared_ptr<const FuelCosts> fuel_costs;
+
+	/**
+	 * @brief Loads an executable and resolves its native functions.
+	 * Throws an error message if the executable cannot be read.
+	 * @param file_path The path of the executable.
+	 */
+	Impl(const char *file_path)
+		: executable(Executable::from_file(file_path)),
+		  program_region(nullptr)
+	{
+		program_region = placement::allocate_region(executable.program_size, false);
+		memcpy(program_region, executable.data + executable.static_data_size,
+			executable.program_size);
+		rewrite_superinstructions(program_region, executable.program_size);
+		fuel_costs = std::make_shared<const FuelCosts>(program_region,
+			executable.program_size);
+
+		for (const ExportedFunction &function : executable.export_table.functions)
+		{
+			functions[function.name] = &function;
+		}
+	}
+
+	~Impl()
+	{
+		placement::free_region(program_region, executable.program_size);
+	}
+};
+
+Program::Program() {}
+Program::~Program() {}
+
+Status
+Program::load(const char *file_path, std::shared_ptr<Program> &program,
+	std::string *error_message)
+{
+	std::shared_ptr<Program> loaded = std::make_shared<Program>();
+
+	try
+	{
+		loaded->impl = std::make_unique<Program::Impl>(file_path);
+	}
+	catch (const std::string &err_message)
+	{
+		if (error_message != nullptr)
+			*error_message = err_message;
+
+		return err_message.rfind("Could not open", 0) == 0
+			? Status::FILE_ERROR
+			: Status::INVALID_EXECUTABLE;
+	}
+
+	if (loaded->impl->executable.export_table.init_end == 0)
+	{
+		if (error_message != nullptr)
+			*error_message = std::string("Executable ") + file_path
+				+ " has no export table\n";
+
+		return Status::INVALID_EXECUTABLE;
+	}
+
+	try
+	{
+		loaded->impl->native_functions = NativeFunction::resolve_all(
+			loaded->impl->executable.native_imports);
+	}
+	catch (const std::string &err_message)
+	{
+		if (error_message != nullptr)
+			*error_message = err_message;
+
+		return Status::NATIVE_ERROR;
+	}
+
+	program = std::move(loaded);
+	return Status::OK;
+}
+
+bool
+Program::has_function(const char *name) const
+{
+	return impl->functions.count(name);
+}
+
+std::vector<std::string>
+Program::function_names() const
+{
+	std::vector<std::string> names;
+
+	for (const ExportedFunction &function : impl->executable.export_table.functions)
+	{
+		names.push_back(function.name);
+	}
+
+	return names;
+}
+
+/**
+ * @brief The implementation of a context.
+ * Holds a CPU and a snapshot of its stack region,
+ * taken right after the global variables were initialised.
+ */
+struct Context::Impl
+{
+	// The program this context executes.
+	std::shared_ptr<Program> program;
+
+	// The CPU that executes the program.
+	MeteredCPU cpu;
+
+	// A copy of the static data and the global variables,
+	// taken after the initialisation code ran.
+	std::vector<uint8_t> snapshot;
+
+	// The stack pointer after the initialisation code ran.
+	uint8_t *init_stack_ptr;
+
+	// The frame pointer after the initialisation code ran.
+	uint8_t *init_frame_ptr;
+
+	// Whether a call failed and the context must be reset.
+	bool faulted = false;
+
+	// The call that ran out of fuel, or nullptr.
+	const ExportedFunction *interrupted = nullptr;
+
+	// A description of the last error.
+	std::string error_message;
+
+	/**
+	 * @brief Creates a CPU that shares the code of the program,
+	 * runs the initialisation code and takes a snapshot.
+	 * Throws an error message if the initialisation code fails.
+	 * @param program The program to execute.
+	 * @param stack_size The stack size in bytes.
+	 */
+	Impl(const std::shared_ptr<Program> &program, size_t stack_size)
+		: program(program),
+		  cpu(program->impl->executable, program->impl->program_region,
+			  program->impl->native_functions, stack_size)
+	{
+		uint8_t *init_end    = cpu.program_location + program->impl->executable.export_table.init_end;
+		uint8_t *program_end = cpu.program_location + cpu.program_size;
+
+		while (cpu.get_instr_ptr() != init_end)
+		{
+			if (cpu.get_instr_ptr() >= program_end)
+			{
+				throw std::string("Initialisation code ended unexpectedly\n");
+			}
+
+			cpu.step();
+		}
+
+		init_stack_ptr = cpu.get_stack_ptr();
+		init_frame_ptr = cpu.get_frame_ptr();
+		snapshot.assign(cpu.static_data_location, init_stack_ptr);
+	}
+
+	/**
+	 * @brief Pushes an argument onto the stack,
+	 * in the size of the parameter it is passed to.
+	 * @param type The type of the parameter.
+	 * @param value The argument.
+	 * @returns The number of pushed bytes.
+	 */
+	size_t
+	push_arg(NativeType type, Value value)
+	{
+		switch (type)
+		{
+		case NATIVE_U8:
+		case NATIVE_I8:
+			cpu.push<uint8_t>(value.u64);
+			return 1;
+
+		case NATIVE_U16:
+		case NATIVE_I16:
+			cpu.push<uint16_t>(value.u64);
+			return 2;
+
+		case NATIVE_U32:
+		case NATIVE_I32:
+			cpu.push<uint32_t>(value.u64);
+			return 4;
+
+		case NATIVE_F32:
+		{
+			float f = value.f64;
+			uint32_t bits;
+			memcpy(&bits, &f, 4);
+			cpu.push<uint32_t>(bits);
+			return 4;
+		}
+
+		default:
+			cpu.push<uint64_t>(value.u64);
+			return 8;
+		}
+	}
+
+	/**
+	 * @brief Runs the CPU until the current call returns,
+	 * fails or runs out of fuel.
+	 * @param function The called function.
+	 * @param result Is set to the return value on success, if not null.
+	 * @returns The status of the call.
+	 */
+	Status
+	run(const ExportedFunction &function, Value *result)
+	{
+		try
+		{
+			cpu.run();
+		}
+		catch (const std::string &err_message)
+		{
+			faulted       = true;
+			error_message = err_message;
+			return Status::RUNTIME_ERROR;
+		}
+
+		// A call that exits the program cannot return a value,
+		// the context has to be reset before it can be used again.
+
+		if (cpu.exited)
+		{
+			faulted       = true;
+			error_message = "Program exited with exit code "
+				+ std::to_string((int64_t) cpu.regs[R_RET]) + "\n";
+			return Status::RUNTIME_ERROR;
+		}
+
+		if (cpu.out_of_fuel)
+		{
+			interrupted   = &function;
+			error_message = "Out of fuel\n";
+			return Status::OUT_OF_FUEL;
+		}
+
+		if (result != nullptr)
+		{
+			*result = convert_result(function.return_type, cpu.regs[R_RET]);
+		}
+
+		return Status::OK;
+	}
+
+	/**
+	 * @brief Converts the raw value of the return register
+	 * to the value that is returned to the host.
+	 * @param type The return type of the function.
+	 * @param raw The raw value of the return register.
+	 * @returns The converted value.
+	 */
+	static Value
+	convert_result(NativeType type, uint64_t raw)
+	{
+		switch (type)
+		{
+		case NATIVE_VOID:
+			return Value::of_u64(0);
+		case NATIVE_U8:
+			return Value::of_u64((uint8_t) raw);
+		case NATIVE_I8:
+			return Value::of_i64((int8_t) raw);
+		case NATIVE_U16:
+			return Value::of_u64((uint16_t) raw);
+		case NATIVE_I16:
+			return Value::of_i64((int16_t) raw);
+		case NATIVE_U32:
+			return Value::of_u64((uint32_t) raw);
+		case NATIVE_I32:
+			return Value::of_i64((int32_t) raw);
+		case NATIVE_F32:
+		{
+			uint32_t bits = raw;
+			float f;
+			memcpy(&f, &bits, 4);
+			return Value::of_f64(f);
+		}
+		default:
+			return Value::of_u64(raw);
+		}
+	}
+};
+
+Context::Context() {}
+Context::~Context() {}
+
+Status
+Context::create(const std::shared_ptr<Program> &program, std::unique_ptr<Context> &context,
+	size_t stack_size, std::string *error_message)
+{
+	std::unique_ptr<Context> created = std::make_unique<Context>();
+
+	try
+	{
+		created->impl = std::make_unique<Context::Impl>(program, stack_size);
+	}
+	catch (const std::string &err_message)
+	{
+		if (error_message != nullptr)
+			*error_message = err_message;
+
+		return Status::RUNTIME_ERROR;
+	}
+
+	context = std::move(created);
+	return Status::OK;
+}
+
+Status
+Context::call(const char *function_name, const Value *args, size_t arg_count, Value *result)
+{
+	if (impl->faulted)
+	{
+		return Status::CONTEXT_FAULTED;
+	}
+
+	auto it = impl->program->impl->functions.find(function_name);
+
+	if (it == impl->program->impl->functions.end())
+	{
+		impl->error_message = std::string("Function ") + function_name + " is not exported\n";
+		return Status::FUNCTION_NOT_FOUND;
+	}
+
+	const ExportedFunction &function = *it->second;
+
+	if (arg_count != function.param_types.size())
+	{
+		impl->error_message = std::string("Function ") + function_name + " takes "
+			+ std::to_string(function.param_types.size()) + " arguments, got "
+			+ std::to_string(arg_count) + "\n";
+		return Status::ARGUMENT_MISMATCH;
+	}
+
+	MeteredCPU &cpu   = impl->cpu;
+	cpu.out_of_fuel   = false;
+	impl->interrupted = nullptr;
+
+	// Start from an empty stack above the global variables.
+
+	cpu.set_stack_ptr(impl->init_stack_ptr);
+	cpu.set_frame_ptr(impl->init_frame_ptr);
+
+	// Push the arguments and their total size, like the CALL
+	// instruction expects them, and push a stack frame with the end
+	// of the program as return address. The function returns to the
+	// end of the program, which makes `run()` return.
+
+	size_t args_size = 0;
+
+	for (size_t i = 0; i < arg_count; i++)
+	{
+		args_size += impl->push_arg(function.param_types[i], args[i]);
+	}
+
+	cpu.push<uint64_t>(args_size);
+	cpu.set_instr_ptr(cpu.program_location + cpu.program_size);
+	cpu.push_stack_frame();
+	cpu.set_instr_ptr(cpu.program_location + function.offset);
+	cpu.regs[R_RET] = 0;
+
+	return impl->run(function, result);
+}
+
+Status
+Context::call(const char *function_name, std::initializer_list<Value> args, Value *result)
+{
+	return call(function_name, args.begin(), args.size(), result);
+}
+
+void
+Context::set_fuel(uint64_t fuel)
+{
+	if (!impl->cpu.fuel_enabled)
+	{
+		impl->cpu.enable_fuel(fuel, impl->program->impl->fuel_costs);
+	}
+
+	impl->cpu.fuel = fuel;
+}
+
+uint64_t
+Context::fuel() const
+{
+	return impl->cpu.fuel;
+}
+
+Status
+Context::resume(uint64_t fuel, Value *result)
+{
+	if (impl->faulted)
+	{
+		return Status::CONTEXT_FAULTED;
+	}
+
+	if (impl->interrupted == nullptr)
+	{
+		impl->error_message = "No call ran out of fuel\n";
+		return Status::NOT_INTERRUPTED;
+	}
+
+	const ExportedFunction &function = *impl->interrupted;
+	impl->interrupted                = nullptr;
+	impl->cpu.add_fuel(fuel);
+
+	return impl->run(function, result);
+}
+
+void
+Context::reset()
+{
+	MeteredCPU &cpu = impl->cpu;
+
+	memcpy(cpu.static_data_location, impl->snapshot.data(), impl->snapshot.size());
+	cpu.set_stack_ptr(impl->init_stack_ptr);
+	cpu.set_frame_ptr(impl->init_frame_ptr);
+	cpu.set_stack_top_ptr(cpu.stack_top);
+	cpu.overflow_flag       = false;
+	cpu.division_error_flag = false;
+	cpu.equal_flag          = false;
+	cpu.greater_flag        = false;
+	cpu.out_of_fuel         = false;
+	cpu.exited              = false;
+	impl->faulted           = false;
+	impl->interrupted       = nullptr;
+}
+
+void
+Context::set_io(const IOCallbacks &callbacks)
+{
+	impl->cpu.print_char_callback = callbacks.print_char;
+	impl->cpu.get_char_callback   = callbacks.get_char;
+	impl->cpu.io_context          = callbacks.user_data;
+}
+
+const std::string &
+Context::error_message() const
+{
+	return impl->error_message;
+}
+}
@@ -0,0 +1,285 @@
+#ifndef TEA_LIBTEA_HEADER
+#define TEA_LIBTEA_HEADER
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * Public API of libtea, which embeds the Tea virtual machine into a host
+ * program. Link against `Library/libtea.a` (together with `-ldl -pthread`)
+ * or `Library/libtea.so`.
+ *
+ * A `Program` is loaded once and is immutable afterwards. Any number of
+ * `Context`s can be created from it. Each context has its own stack and
+ * global variables, but shares the code of the program. Different contexts
+ * can be used from different threads at the same time, a single context
+ * can only be used by one thread at a time.
+ *
+ * Programs must be compiled by a compiler that emits an export table.
+ * All functions whose parameters and return value are numbers or pointers
+ * are exported and can be called by name.
+ */
+namespace tea
+{
+/**
+ * @brief The result of an operation of the API.
+ */
+enum class Status
+{
+	// The operation succeeded.
+	OK,
+
+	// The executable file could not be read.
+	FILE_ERROR,
+
+	// The executable file is malformed, or has no export table.
+	INVALID_EXECUTABLE,
+
+	// A native function imported by the program could not be resolved.
+	NATIVE_ERROR,
+
+	// The called function does not exist or is not exported.
+	FUNCTION_NOT_FOUND,
+
+	// The number of arguments does not match the number of parameters.
+	ARGUMENT_MISMATCH,
+
+	// The VM encountered an error while running the program.
+	RUNTIME_ERROR,
+
+	// A previous call failed, the context must be reset first.
+	CONTEXT_FAULTED,
+
+	// The call ran out of fuel. It can be resumed with more fuel.
+	OUT_OF_FUEL,
+
+	// There is no call that ran out of fuel to resume.
+	NOT_INTERRUPTED
+};
+
+/**
+ * @brief Converts a status to a string.
+ * @param status The status to convert.
+ * @returns A string representation of the status.
+ */
+const char *
+status_to_str(Status status);
+
+/**
+ * @brief An argument or return value of a function.
+ * Integers are truncated to the size of the parameter they are passed to.
+ * 32-bit float parameters are converted from `f64`, and 32-bit float return
+ * values are converted to `f64`. Small signed integer return values are
+ * sign-extended to `i64`, small unsigned integer return values are
+ * zero-extended to `u64`.
+ */
+union Value
+{
+	uint64_t u64;
+	int64_t i64;
+	double f64;
+	void *ptr;
+
+	static Value
+	of_u64(uint64_t value)
+	{
+		Value v;
+		v.u64 = value;
+		return v;
+	}
+
+	static Value
+	of_i64(int64_t value)
+	{
+		Value v;
+		v.i64 = value;
+		return v;
+	}
+
+	static Value
+	of_f64(double value)
+	{
+		Value v;
+		v.f64 = value;
+		return v;
+	}
+
+	static Value
+	of_ptr(void *value)
+	{
+		Value v;
+		v.ptr = value;
+		return v;
+	}
+};
+
+/**
+ * @brief Callbacks through which a context performs character I/O.
+ * Callbacks that are not set fall back to stdout and stdin.
+ * Builtin and native functions that write to file descriptors
+ * are not redirected.
+ */
+struct IOCallbacks
+{
+	// Called for every character printed by the program.
+	void (*print_char)(void *user_data, uint8_t c) = nullptr;
+
+	// Called for every character read by the program.
+	// Must return EOF at the end of the input.
+	int (*get_char)(void *user_data) = nullptr;
+
+	// Passed to the callbacks.
+	void *user_data = nullptr;
+};
+
+/**
+ * @brief A loaded Tea executable.
+ * Holds the code, the resolved native functions and the export table.
+ */
+struct Program
+{
+	// The implementation of the program. Opaque to the host.
+	struct Impl;
+	std::unique_ptr<Impl> impl;
+
+	/**
+	 * @brief Loads a program from an executable file.
+	 * @param file_path The path of the executable.
+	 * @param program Is set to the loaded program on success.
+	 * @param error_message Is set to a description of the error on
+	 * failure, if not null.
+	 * @returns The status of the operation.
+	 */
+	static Status
+	load(const char *file_path, std::shared_ptr<Program> &program,
+		std::string *error_message = nullptr);
+
+	/**
+	 * @param name The name of a function.
+	 * @returns Whether the program exports a function with this name.
+	 */
+	bool
+	has_function(const char *name) const;
+
+	/**
+	 * @returns The names of all exported functions.
+	 */
+	std::vector<std::string>
+	function_names() const;
+
+	Program();
+	~Program();
+};
+
+/**
+ * @brief An execution context of a program.
+ * Holds the stack and the global variables of one instance of the program.
+ * Creating a context runs the initialisers of the global variables.
+ * Global variables keep their values between calls until the context is reset.
+ *
+ * Calls can be given a fuel budget, which bounds the number of executed
+ * instructions. Fuel is only checked at backward jumps and calls. A call
+ * that runs out of fuel returns `OUT_OF_FUEL` and can be resumed later.
+ */
+struct Context
+{
+	// The default stack size of a context in bytes.
+	static constexpr size_t DEFAULT_STACK_SIZE = 1024 * 1024;
+
+	// The implementation of the context. Opaque to the host.
+	struct Impl;
+	std::unique_ptr<Impl> impl;
+
+	/**
+	 * @brief Creates a new execution context of a program.
+	 * @param program The program to execute.
+	 * @param context Is set to the created context on success.
+	 * @param stack_size The stack size of the context in bytes.
+	 * @param error_message Is set to a description of the error on
+	 * failure, if not null.
+	 * @returns The status of the operation.
+	 */
+	static Status
+	create(const std::shared_ptr<Program> &program, std::unique_ptr<Context> &context,
+		size_t stack_size = DEFAULT_STACK_SIZE, std::string *error_message = nullptr);
+
+	/**
+	 * @brief Calls an exported function of the program.
+	 * @param function_name The name of the function.
+	 * @param args The arguments, one for each parameter.
+	 * @param arg_count The number of arguments.
+	 * @param result Is set to the return value on success, if not null.
+	 * @returns The status of the operation. After a `RUNTIME_ERROR`,
+	 * the context must be reset before it can be used again.
+	 */
+	Status
+	call(const char *function_name, const Value *args, size_t arg_count,
+		Value *result = nullptr);
+
+	/**
+	 * @brief Calls an exported function of the program.
+	 * @param function_name The name of the function.
+	 * @param args The arguments, one for each parameter.
+	 * @param result Is set to the return value on success, if not null.
+	 * @returns The status of the operation.
+	 */
+	Status
+	call(const char *function_name, std::initializer_list<Value> args,
+		Value *result = nullptr);
+
+	/**
+	 * @brief Enables fuel metering for all following calls
+	 * and sets the remaining fuel. The initialisers of the
+	 * global variables are not metered.
+	 * @param fuel The amount of fuel.
+	 */
+	void
+	set_fuel(uint64_t fuel);
+
+	/**
+	 * @returns The remaining fuel.
+	 */
+	uint64_t
+	fuel() const;
+
+	/**
+	 * @brief Resumes the last call, which ran out of fuel.
+	 * Starting another call or resetting the context abandons it.
+	 * @param fuel The amount of fuel to add.
+	 * @param result Is set to the return value on success, if not null.
+	 * @returns The status of the operation.
+	 */
+	Status
+	resume(uint64_t fuel, Value *result = nullptr);
+
+	/**
+	 * @brief Restores the global variables and the stack to the state
+	 * right after the context was created. Much cheaper than creating
+	 * a new context, since the initialisers are not run again.
+	 */
+	void
+	reset();
+
+	/**
+	 * @brief Redirects the character I/O of the program.
+	 * @param callbacks The I/O callbacks.
+	 */
+	void
+	set_io(const IOCallbacks &callbacks);
+
+	/**
+	 * @returns A description of the last error.
+	 */
+	const std::string &
+	error_message() const;
+
+	Context();
+	~Context();
+};
+}
+
+#endif
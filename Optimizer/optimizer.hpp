@@ -0,0 +1,1377 @@
+#ifndef TEA_OPTIMIZER_HEADER
+#define TEA_OPTIMIZER_HEADER
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "VM/cpu.hpp"
+#include "Executable/byte-code.hpp"
+#include "Executable/executable.hpp"
+#include "Executable/line-table.hpp"
+#include "Executable/sections.hpp"
+
+/**
+ * @brief A decoded instruction of a program that is optimised.
+ */
+struct DecodedInstruction
+{
+	// The opcode of the instruction.
+	Instruction opcode;
+
+	// The arguments, one for each of `instruction_arg_types()`.
+	// Relative addresses are stored in `target` and strings in `str`,
+	// their entries are 0.
+	std::vector<uint64_t> args;
+
+	// The null-terminated string argument, without the terminator.
+	std::string str;
+
+	// The block the relative address argument points to,
+	// or `Optimizer::END` for the end of the program.
+	size_t target = 0;
+
+	// The offset of the instruction in the original program.
+	// New instructions take the offset of the instruction they replace.
+	uint64_t origin;
+};
+
+/**
+ * @brief A basic block. Control only enters a block at its first
+ * instruction, and only jumps or returns at its last instruction.
+ * Blocks that do not end in a JUMP or RETURN fall through to the
+ * next block of the original program.
+ */
+struct BasicBlock
+{
+	// The instructions of the block. Empty if all of them were removed.
+	std::vector<DecodedInstruction> instructions;
+
+	// The offset of the block in the original program.
+	uint64_t origin;
+
+	// Whether the block is the entry of a function: the start of the program,
+	// the end of the initialisation, an exported function or the target
+	// of a CALL or THREAD_SPAWN.
+	bool is_entry = false;
+
+	// Whether control can reach the block.
+	bool reachable = false;
+
+	// The function the block belongs to, numbered in order of the program.
+	size_t function;
+};
+
+/**
+ * @brief Optimises the program of an executable as a whole, without
+ * the source code, and writes it to a new executable.
+ *
+ * The program is split into basic blocks and functions. The passes are:
+ * - Jump threading: jumps to a JUMP jump to its target instead,
+ *   JUMPs to a RETURN are replaced by the RETURN.
+ * - Unreachable blocks and functions that are never called are removed.
+ * - Constant propagation within a block: MOVE_LIT of a value a register
+ *   already holds and MOVE of a register to itself are removed, MOVE of
+ *   a known value and arithmetic on known values become a MOVE_LIT_8,
+ *   arithmetic with 0 or 1 that does not change a register is removed.
+ * - Instructions without side effects whose result is never read
+ *   are removed, using the liveness of the general purpose registers.
+ * - Blocks of a function are reordered so that blocks that end in
+ *   a JUMP are followed by its target. Jumps to the next instruction are
+ *   removed and conditional jumps over a JUMP are inverted.
+ *
+ * Registers are only tracked if they are general purpose registers.
+ * Instructions that are not modelled are assumed to read every register.
+ * Programs that use the instruction pointer as an operand are rejected,
+ * their behaviour depends on the offsets of the instructions.
+ */
+struct Optimizer
+{
+	// The target of an instruction that jumps to the end of the program.
+	static constexpr size_t END = SIZE_MAX;
+
+	// A mask of all general purpose registers.
+	static constexpr uint16_t ALL_REGISTERS = (1 << GENERAL_PURPOSE_REGISTER_COUNT) - 1;
+
+	// The contents of the executable file.
+	Buffer &file;
+
+	// The executable.
+	Executable executable;
+
+	// The sections of the executable.
+	SectionTable sections;
+
+	// The line table of the executable, empty if it has none.
+	LineTable lines;
+
+	// The blocks of the program, in the order of the original program.
+	std::vector<BasicBlock> blocks;
+
+	// The order of the blocks in the optimised program.
+	std::vector<size_t> order;
+
+	// The size of the code of the original and of the optimised program.
+	uint64_t original_size;
+	uint64_t optimised_size = 0;
+
+	// The number of jumps that were threaded.
+	size_t threaded_jumps = 0;
+
+	// The number of unreachable blocks and unused functions that were removed.
+	size_t removed_blocks    = 0;
+	size_t removed_functions = 0;
+
+	// The number of instructions that were removed by constant propagation.
+	size_t redundant_instructions = 0;
+
+	// The number of instructions that were replaced by a MOVE_LIT_8
+	// or a MOVE by constant propagation.
+	size_t folded_instructions = 0;
+
+	// The number of instructions that were removed because
+	// their result is never read.
+	size_t dead_instructions = 0;
+
+	// The number of blocks that were moved.
+	size_t moved_blocks = 0;
+
+	// The number of jumps to the next instruction that were removed.
+	size_t removed_jumps = 0;
+
+	// The number of conditional jumps over a JUMP that were inverted.
+	size_t inverted_jumps = 0;
+
+	/**
+	 * @brief Constructs a new Optimizer object and decodes the program.
+	 * Throws an error message if the executable is invalid
+	 * or cannot be optimised.
+	 * @param file The contents of the executable file.
+	 * @param file_name The name of the executable, for error messages.
+	 */
+	Optimizer(Buffer &file, const char *file_name)
+		: file(file),
+		  executable(Executable::from_buffer(file, file_name)),
+		  sections(read_sections(file)),
+		  original_size(executable.program_size)
+	{
+		if (const Section *section = sections.find(SECTION_LINES))
+		{
+			lines = LineTable::from_section(std::string(
+				(const char *) file.data + section->offset, section->size));
+
+			if (sections.version < EXECUTABLE_VERSION)
+			{
+				const Section *code = sections.find(SECTION_CODE);
+				CodeUpgrader::upgrade_line_table(file.data + code->offset, code->size,
+					sections.version, lines);
+			}
+		}
+
+		decode();
+	}
+
+	/**
+	 * @brief Reads the section table of the executable.
+	 * Executables of version 1 have no section table, they are described
+	 * by one with their static data and program segments, so they are
+	 * written as a sectioned executable.
+	 * @param file The contents of the executable file.
+	 * @returns The section table.
+	 */
+	static SectionTable
+	read_sections(const Buffer &file)
+	{
+		if (SectionTable::is_sectioned(file))
+		{
+			return SectionTable::read(file);
+		}
+
+		SectionTable table;
+		table.version = 1;
+
+		uint64_t static_data_size, program_size;
+		memcpy(&static_data_size, file.data, sizeof(static_data_size));
+		memcpy(&program_size, file.data + 8, sizeof(program_size));
+
+		if (static_data_size != 0)
+		{
+			table.sections.push_back({ SECTION_RODATA, 0, 16, static_data_size });
+		}
+
+		table.sections.push_back({ SECTION_CODE, 0, 16 + static_data_size, program_size });
+		return table;
+	}
+
+	/**
+	 * @brief Runs all passes.
+	 */
+	void
+	optimise()
+	{
+		thread_jumps();
+		remove_unreachable_blocks();
+
+		// Constant propagation and the removal of unused results
+		// enable each other, they are run until neither changes anything.
+
+		for (size_t round = 0; round < 8; round++)
+		{
+			size_t removed = redundant_instructions + folded_instructions + dead_instructions;
+
+			propagate_constants();
+			remove_dead_instructions();
+
+			if (redundant_instructions + folded_instructions + dead_instructions == removed)
+			{
+				break;
+			}
+		}
+
+		reorder_blocks();
+		remove_jumps_to_next();
+	}
+
+	/**
+	 * @param opcode An opcode.
+	 * @returns Whether the opcode is a JUMP or a conditional jump.
+	 */
+	static bool
+	is_jump(Instruction opcode)
+	{
+		return opcode >= JUMP && opcode <= JUMP_IF_NEQ;
+	}
+
+	/**
+	 * @param opcode The opcode of a conditional jump.
+	 * @returns The conditional jump that jumps if the opcode does not.
+	 */
+	static Instruction
+	invert_jump(Instruction opcode)
+	{
+		switch (opcode)
+		{
+		case JUMP_IF_GT:
+			return JUMP_IF_LEQ;
+		case JUMP_IF_GEQ:
+			return JUMP_IF_LT;
+		case JUMP_IF_LT:
+			return JUMP_IF_GEQ;
+		case JUMP_IF_LEQ:
+			return JUMP_IF_GT;
+		case JUMP_IF_EQ:
+			return JUMP_IF_NEQ;
+		default:
+			return JUMP_IF_EQ;
+		}
+	}
+
+	/**
+	 * @param reg_id A register.
+	 * @returns A mask with the bit of the register set,
+	 * or 0 if it is not a general purpose register.
+	 */
+	static uint16_t
+	register_mask(uint64_t reg_id)
+	{
+		return reg_id < GENERAL_PURPOSE_REGISTER_COUNT ? 1 << reg_id : 0;
+	}
+
+	/**
+	 * @brief The general purpose registers an instruction reads and writes.
+	 */
+	struct Effects
+	{
+		// The registers that are read.
+		uint16_t uses;
+
+		// The registers that are written.
+		uint16_t defs;
+
+		// Whether the instruction is modelled. Other instructions
+		// are assumed to read and clobber every register.
+		bool known;
+	};
+
+	/**
+	 * @param instr An instruction.
+	 * @returns The registers the instruction reads and writes.
+	 */
+	static Effects
+	effects_of(const DecodedInstruction &instr)
+	{
+		Instruction op                    = instr.opcode;
+		const std::vector<uint64_t> &args = instr.args;
+
+		if (op == MOVE_LIT || op == MOVE_LIT_8 || op == MOVE_LIT_32)
+		{
+			return { 0, register_mask(args[1]), true };
+		}
+
+		if (op == MOVE || (op >= LOAD_PTR_8 && op <= LOAD_PTR_64))
+		{
+			return { register_mask(args[0]), register_mask(args[1]), true };
+		}
+
+		if ((op >= STORE_PTR_8 && op <= STORE_PTR_64) || (op >= CMP_INT_8 && op <= CMP_FLT_64))
+		{
+			return { (uint16_t) (register_mask(args[0]) | register_mask(args[1])), 0, true };
+		}
+
+		// Arithmetic on two registers stores the result in the second one.
+		// Division by zero leaves it unchanged, it is read anyway.
+
+		if (op >= ADD_INT_8 && op <= SHR_INT_64)
+		{
+			return { (uint16_t) (register_mask(args[0]) | register_mask(args[1])),
+				register_mask(args[1]), true };
+		}
+
+		if ((op >= INC_INT_8 && op <= NEG_INT_64) || (op >= CAST_INT_TO_FLT_32 && op <= CAST_FLT_64_TO_INT))
+		{
+			return { register_mask(args[0]), register_mask(args[0]), true };
+		}
+
+		if ((op >= SET_IF_GT && op <= SET_IF_NEQ) || (op >= POP_8_INTO_REG && op <= POP_64_INTO_REG))
+		{
+			return { 0, register_mask(args[0]), true };
+		}
+
+		if (op >= PUSH_REG_8 && op <= PUSH_REG_64)
+		{
+			return { register_mask(args[0]), 0, true };
+		}
+
+		if (is_jump(op) || op == RETURN || op == LABEL || op == COMMENT
+			|| op == ALLOCATE_STACK || op == DEALLOCATE_STACK)
+		{
+			return { 0, 0, true };
+		}
+
+		return { ALL_REGISTERS, 0, false };
+	}
+
+	/**
+	 * @param opcode An opcode.
+	 * @returns Whether the instruction only writes a register,
+	 * so it can be removed if the register is never read.
+	 */
+	static bool
+	is_pure(Instruction opcode)
+	{
+		return opcode == MOVE_LIT || opcode == MOVE_LIT_8 || opcode == MOVE_LIT_32
+			|| opcode == MOVE
+			|| (opcode >= ADD_INT_8 && opcode <= ADD_INT_64)
+			|| (opcode >= SUB_INT_8 && opcode <= SUB_INT_64)
+			|| (opcode >= MUL_INT_8 && opcode <= MUL_INT_64)
+			|| (opcode >= AND_INT_8 && opcode <= NEG_INT_64)
+			|| (opcode >= SET_IF_GT && opcode <= SET_IF_NEQ);
+	}
+
+	/**
+	 * @param instr A MOVE_LIT, MOVE_LIT_8 or MOVE_LIT_32 instruction.
+	 * @returns The literal it moves, sign-extended.
+	 */
+	static uint64_t
+	literal_of(const DecodedInstruction &instr)
+	{
+		switch (instr.opcode)
+		{
+		case MOVE_LIT_8:
+			return (int8_t) instr.args[0];
+		case MOVE_LIT_32:
+			return (int32_t) instr.args[0];
+		default:
+			return instr.args[0];
+		}
+	}
+
+	/**
+	 * @param opcode ADD_INT_64, SUB_INT_64, MUL_INT_64,
+	 * AND_INT_64, OR_INT_64 or XOR_INT_64.
+	 * @param a The value of the first register.
+	 * @param b The value of the second register.
+	 * @returns The value the instruction stores in the second register.
+	 */
+	static uint64_t
+	fold(Instruction opcode, uint64_t a, uint64_t b)
+	{
+		switch (opcode)
+		{
+		case ADD_INT_64:
+			return b + a;
+		case SUB_INT_64:
+			return b - a;
+		case MUL_INT_64:
+			return b * a;
+		case AND_INT_64:
+			return b & a;
+		case OR_INT_64:
+			return b | a;
+		default:
+			return b ^ a;
+		}
+	}
+
+	/**
+	 * @param value A value.
+	 * @returns Whether the value fits in the literal of a MOVE_LIT_8.
+	 */
+	static bool
+	fits_move_lit_8(uint64_t value)
+	{
+		return (int64_t) value == (int8_t) value;
+	}
+
+	/**
+	 * @param block The index of a block.
+	 * @returns Whether the block falls through to the next block
+	 * of the original program.
+	 */
+	bool
+	falls_through(size_t block) const
+	{
+		const std::vector<DecodedInstruction> &instructions = blocks[block].instructions;
+		return instructions.empty()
+			|| (instructions.back().opcode != JUMP && instructions.back().opcode != RETURN);
+	}
+
+	/**
+	 * @param block The index of a block.
+	 * @returns The blocks control can pass to from the block.
+	 * The end of the program is `END`.
+	 */
+	std::vector<size_t>
+	successors(size_t block) const
+	{
+		std::vector<size_t> result;
+		const std::vector<DecodedInstruction> &instructions = blocks[block].instructions;
+
+		if (!instructions.empty() && is_jump(instructions.back().opcode))
+		{
+			result.push_back(instructions.back().target);
+		}
+
+		if (falls_through(block))
+		{
+			result.push_back(block + 1 < blocks.size() ? block + 1 : END);
+		}
+
+		return result;
+	}
+
+	/**
+	 * @brief Splits the program into basic blocks and functions.
+	 * Throws an error message if an instruction uses the
+	 * instruction pointer as an operand.
+	 */
+	void
+	decode()
+	{
+		const uint8_t *program = executable.data + executable.static_data_size;
+		uint64_t program_size  = executable.program_size;
+
+		std::vector<bool> starts_block(program_size + 1, false);
+		std::vector<bool> starts_function(program_size + 1, false);
+		std::vector<std::pair<uint64_t, DecodedInstruction>> instructions;
+
+		starts_block[0] = starts_function[0] = true;
+
+		if (executable.export_table.init_end != 0)
+		{
+			starts_block[executable.export_table.init_end]    = true;
+			starts_function[executable.export_table.init_end] = true;
+		}
+
+		for (const ExportedFunction &function : executable.export_table.functions)
+		{
+			starts_block[function.offset] = starts_function[function.offset] = true;
+		}
+
+		// Decode the instructions, the program was verified when it was loaded.
+
+		std::vector<uint64_t> targets;
+
+		for (uint64_t offset = 0; offset < program_size;)
+		{
+			DecodedInstruction instr;
+			instr.opcode    = (Instruction) program[offset];
+			instr.origin    = offset;
+			uint64_t arg    = offset + sizeof(Instruction);
+			uint64_t target = program_size;
+
+			for (ArgumentType type : instruction_arg_types(instr.opcode))
+			{
+				uint64_t value = 0;
+
+				switch (type)
+				{
+				case REG:
+				case LIT_8:
+					value = program[arg];
+					arg += 1;
+					break;
+
+				case LIT_16:
+					memcpy(&value, program + arg, 2);
+					arg += 2;
+					break;
+
+				case LIT_32:
+					memcpy(&value, program + arg, 4);
+					arg += 4;
+					break;
+
+				case REL_ADDR:
+				{
+					int32_t relative;
+					memcpy(&relative, program + arg, 4);
+					target = offset + relative;
+					arg += 4;
+					break;
+				}
+
+				case LIT_64:
+					memcpy(&value, program + arg, 8);
+					arg += 8;
+					break;
+
+				case NULL_TERMINATED_STRING:
+					instr.str = (const char *) program + arg;
+					arg += instr.str.size() + 1;
+					break;
+				}
+
+				if (type == REG && value == R_INSTR_PTR)
+				{
+					char message[128];
+					snprintf(message, sizeof(message), "Instruction at offset 0x%04lx "
+						"uses the instruction pointer, the program cannot be optimised\n", offset);
+					throw std::string(message);
+				}
+
+				instr.args.push_back(value);
+			}
+
+			starts_block[target] = true;
+
+			if (instr.opcode == CALL || instr.opcode == THREAD_SPAWN)
+			{
+				starts_function[target] = true;
+			}
+
+			if (is_jump(instr.opcode) || instr.opcode == RETURN)
+			{
+				starts_block[arg] = true;
+			}
+
+			targets.push_back(target);
+			instructions.push_back({ offset, std::move(instr) });
+			offset = arg;
+		}
+
+		// Split the instructions into blocks.
+
+		std::vector<size_t> block_of(program_size + 1, END);
+		size_t function = 0;
+
+		for (auto &[offset, instr] : instructions)
+		{
+			if (starts_block[offset])
+			{
+				if (starts_function[offset] && offset != 0)
+				{
+					function++;
+				}
+
+				block_of[offset] = blocks.size();
+				blocks.emplace_back();
+				blocks.back().origin   = offset;
+				blocks.back().is_entry = starts_function[offset];
+				blocks.back().function = function;
+			}
+
+			blocks.back().instructions.push_back(std::move(instr));
+		}
+
+		// Point relative addresses to blocks.
+
+		size_t i = 0;
+
+		for (BasicBlock &block : blocks)
+		{
+			for (DecodedInstruction &instr : block.instructions)
+			{
+				instr.target = block_of[targets[i++]];
+			}
+		}
+	}
+
+	/**
+	 * @brief Lets jumps to a JUMP jump to its target instead,
+	 * and replaces JUMPs to a RETURN by the RETURN.
+	 */
+	void
+	thread_jumps()
+	{
+		for (BasicBlock &block : blocks)
+		{
+			for (DecodedInstruction &instr : block.instructions)
+			{
+				if (!is_jump(instr.opcode))
+				{
+					continue;
+				}
+
+				// Follow the JUMPs, loops of JUMPs are followed once around.
+
+				size_t target = instr.target;
+
+				for (size_t steps = 0; target != END && steps < blocks.size(); steps++)
+				{
+					const DecodedInstruction &first = blocks[target].instructions.front();
+
+					if (first.opcode != JUMP || first.target == target)
+					{
+						break;
+					}
+
+					target = first.target;
+				}
+
+				if (target != instr.target)
+				{
+					instr.target = target;
+					threaded_jumps++;
+				}
+
+				if (instr.opcode == JUMP && target != END
+					&& blocks[target].instructions.front().opcode == RETURN)
+				{
+					instr.opcode = RETURN;
+					instr.args.clear();
+					threaded_jumps++;
+				}
+			}
+		}
+	}
+
+	/**
+	 * @brief Removes the blocks that control cannot reach from the start
+	 * of the program, the end of the initialisation or an exported function.
+	 */
+	void
+	remove_unreachable_blocks()
+	{
+		std::vector<size_t> worklist;
+
+		for (size_t i = 0; i < blocks.size(); i++)
+		{
+			if (blocks[i].origin == 0 || blocks[i].origin == executable.export_table.init_end
+				|| std::any_of(executable.export_table.functions.begin(),
+					executable.export_table.functions.end(),
+					[&](const ExportedFunction &function)
+					{ return function.offset == blocks[i].origin; }))
+			{
+				worklist.push_back(i);
+			}
+		}
+
+		while (!worklist.empty())
+		{
+			size_t block = worklist.back();
+			worklist.pop_back();
+
+			if (block == END || blocks[block].reachable)
+			{
+				continue;
+			}
+
+			blocks[block].reachable = true;
+
+			for (size_t successor : successors(block))
+			{
+				worklist.push_back(successor);
+			}
+
+			for (const DecodedInstruction &instr : blocks[block].instructions)
+			{
+				if (instr.opcode == CALL || instr.opcode == THREAD_SPAWN)
+				{
+					worklist.push_back(instr.target);
+				}
+			}
+		}
+
+		for (BasicBlock &block : blocks)
+		{
+			if (!block.reachable)
+			{
+				removed_blocks++;
+				removed_functions += block.is_entry;
+				block.instructions.clear();
+			}
+		}
+	}
+
+	/**
+	 * @brief Propagates the values of MOVE_LIT instructions within each block.
+	 * The values of the registers are forgotten at the start of a block
+	 * and after every instruction that is not modelled.
+	 */
+	void
+	propagate_constants()
+	{
+		for (BasicBlock &block : blocks)
+		{
+			std::optional<uint64_t> values[GENERAL_PURPOSE_REGISTER_COUNT];
+			std::vector<DecodedInstruction> instructions;
+
+			auto value_of = [&](uint64_t reg_id) -> std::optional<uint64_t>
+			{
+				return register_mask(reg_id) ? values[reg_id] : std::nullopt;
+			};
+
+			auto set_value = [&](uint64_t reg_id, std::optional<uint64_t> value)
+			{
+				if (register_mask(reg_id))
+				{
+					values[reg_id] = value;
+				}
+			};
+
+			for (DecodedInstruction &instr : block.instructions)
+			{
+				Instruction op = instr.opcode;
+
+				if (op == MOVE_LIT || op == MOVE_LIT_8 || op == MOVE_LIT_32)
+				{
+					uint64_t value = literal_of(instr);
+
+					if (value_of(instr.args[1]) == value)
+					{
+						redundant_instructions++;
+						continue;
+					}
+
+					set_value(instr.args[1], value);
+				}
+				else if (op == MOVE)
+				{
+					std::optional<uint64_t> value = value_of(instr.args[0]);
+
+					if (instr.args[0] == instr.args[1]
+						|| (value && value_of(instr.args[1]) == value))
+					{
+						redundant_instructions++;
+						continue;
+					}
+
+					if (value && fits_move_lit_8(*value))
+					{
+						instr.opcode = MOVE_LIT_8;
+						instr.args   = { (uint8_t) *value, instr.args[1] };
+						folded_instructions++;
+					}
+
+					set_value(instr.args[1], value);
+				}
+				else if (op == ADD_INT_64 || op == SUB_INT_64 || op == MUL_INT_64
+					|| op == AND_INT_64 || op == OR_INT_64 || op == XOR_INT_64)
+				{
+					// The result is stored in the second register.
+
+					std::optional<uint64_t> a = value_of(instr.args[0]);
+					std::optional<uint64_t> b = value_of(instr.args[1]);
+					uint64_t identity         = op == MUL_INT_64 ? 1 : 0;
+
+					if (a && b)
+					{
+						uint64_t result = fold(op, *a, *b);
+
+						if (fits_move_lit_8(result))
+						{
+							instr.opcode = MOVE_LIT_8;
+							instr.args   = { (uint8_t) result, instr.args[1] };
+							folded_instructions++;
+						}
+
+						set_value(instr.args[1], result);
+					}
+					else if (a == identity && op != AND_INT_64)
+					{
+						// The second register is left unchanged,
+						// even if it is not a general purpose register.
+
+						redundant_instructions++;
+						continue;
+					}
+					else if (b == identity && op != AND_INT_64 && op != SUB_INT_64)
+					{
+						instr.opcode = MOVE;
+						folded_instructions++;
+						set_value(instr.args[1], a);
+					}
+					else
+					{
+						set_value(instr.args[1], std::nullopt);
+					}
+				}
+				else
+				{
+					Effects effects = effects_of(instr);
+
+					for (size_t reg_id = 0; reg_id < GENERAL_PURPOSE_REGISTER_COUNT; reg_id++)
+					{
+						if (!effects.known || (effects.defs & register_mask(reg_id)))
+						{
+							values[reg_id] = std::nullopt;
+						}
+					}
+				}
+
+				instructions.push_back(std::move(instr));
+			}
+
+			block.instructions = std::move(instructions);
+		}
+	}
+
+	/**
+	 * @brief Removes instructions without side effects whose result is never
+	 * read. The general purpose registers are live at the end of the program
+	 * and dead after a RETURN, which restores them from the stack frame.
+	 */
+	void
+	remove_dead_instructions()
+	{
+		// Compute the registers that are live at the start of each block
+		// until they do not change any more.
+
+		std::vector<uint16_t> live_in(blocks.size(), 0);
+		bool changed = true;
+
+		auto live_out = [&](size_t block)
+		{
+			uint16_t live = 0;
+
+			for (size_t successor : successors(block))
+			{
+				live |= successor == END ? ALL_REGISTERS : live_in[successor];
+			}
+
+			return live;
+		};
+
+		while (changed)
+		{
+			changed = false;
+
+			for (size_t i = blocks.size(); i-- > 0;)
+			{
+				uint16_t live = live_out(i);
+
+				for (size_t j = blocks[i].instructions.size(); j-- > 0;)
+				{
+					Effects effects = effects_of(blocks[i].instructions[j]);
+					live            = effects.known ? (live & ~effects.defs) | effects.uses : ALL_REGISTERS;
+				}
+
+				if (live != live_in[i])
+				{
+					live_in[i] = live;
+					changed    = true;
+				}
+			}
+		}
+
+		for (size_t i = 0; i < blocks.size(); i++)
+		{
+			std::vector<DecodedInstruction> &instructions = blocks[i].instructions;
+			std::vector<DecodedInstruction> kept;
+			uint16_t live = live_out(i);
+
+			for (size_t j = instructions.size(); j-- > 0;)
+			{
+				Effects effects = effects_of(instructions[j]);
+
+				if (is_pure(instructions[j].opcode) && effects.defs && !(effects.defs & live))
+				{
+					dead_instructions++;
+					continue;
+				}
+
+				live = effects.known ? (live & ~effects.defs) | effects.uses : ALL_REGISTERS;
+				kept.push_back(std::move(instructions[j]));
+			}
+
+			std::reverse(kept.begin(), kept.end());
+			instructions = std::move(kept);
+		}
+	}
+
+	/**
+	 * @brief Orders the blocks of every function so that blocks that end
+	 * in a JUMP are followed by its target where possible.
+	 * Blocks that fall through stay together in chains. The chain with the
+	 * entry of the function stays first, the chain that falls through to
+	 * the next function or the end of the program stays last.
+	 */
+	void
+	reorder_blocks()
+	{
+		size_t first = 0;
+
+		while (first < blocks.size())
+		{
+			size_t end = first + 1;
+
+			while (end < blocks.size() && blocks[end].function == blocks[first].function)
+			{
+				end++;
+			}
+
+			reorder_function(first, end);
+			first = end;
+		}
+	}
+
+	/**
+	 * @brief Orders the blocks of a function and appends them to `order`.
+	 * @param first The first block of the function.
+	 * @param end The block after the last block of the function.
+	 */
+	void
+	reorder_function(size_t first, size_t end)
+	{
+		// Split the reachable blocks into chains of blocks that fall through.
+
+		std::vector<std::vector<size_t>> chains;
+		std::vector<size_t> chain_of(end - first, END);
+		size_t exit_chain = END;
+
+		for (size_t i = first; i < end; i++)
+		{
+			if (!blocks[i].reachable)
+			{
+				continue;
+			}
+
+			if (i == first || !blocks[i - 1].reachable || !falls_through(i - 1))
+			{
+				chains.emplace_back();
+			}
+
+			chains.back().push_back(i);
+			chain_of[i - first] = chains.size() - 1;
+
+			if (i + 1 == end && falls_through(i))
+			{
+				exit_chain = chains.size() - 1;
+			}
+		}
+
+		// A function whose entry falls through to the next function is kept as is.
+
+		if (chains.empty() || (exit_chain == 0 && chains.size() > 1))
+		{
+			for (const std::vector<size_t> &chain : chains)
+			{
+				order.insert(order.end(), chain.begin(), chain.end());
+			}
+
+			return;
+		}
+
+		std::vector<bool> placed(chains.size(), false);
+		size_t chain = 0;
+
+		for (size_t count = 0; count < chains.size(); count++)
+		{
+			placed[chain] = true;
+			order.insert(order.end(), chains[chain].begin(), chains[chain].end());
+
+			if (chain != count)
+			{
+				moved_blocks += chains[chain].size();
+			}
+
+			// Continue with the target of the JUMP at the end of the chain,
+			// if it starts a chain, or else with the next chain.
+
+			const std::vector<DecodedInstruction> &last = blocks[chains[chain].back()].instructions;
+			size_t next                                 = END;
+
+			if (!last.empty() && last.back().opcode == JUMP)
+			{
+				size_t target = last.back().target;
+
+				if (target != END && target >= first && target < end
+					&& chains[chain_of[target - first]].front() == target
+					&& !placed[chain_of[target - first]]
+					&& (chain_of[target - first] != exit_chain || count + 2 == chains.size()))
+				{
+					next = chain_of[target - first];
+				}
+			}
+
+			for (size_t i = 0; next == END && i < chains.size(); i++)
+			{
+				if (!placed[i] && (i != exit_chain || count + 2 == chains.size()))
+				{
+					next = i;
+				}
+			}
+
+			chain = next;
+		}
+	}
+
+	/**
+	 * @brief Computes the offsets of the blocks in the optimised program.
+	 * Blocks that are not placed start at the end of the program.
+	 * @returns The offsets of the blocks, followed by the
+	 * size of the optimised program.
+	 */
+	std::vector<uint64_t>
+	layout() const
+	{
+		std::vector<uint64_t> offsets(blocks.size() + 1, 0);
+		uint64_t offset = 0;
+
+		for (size_t block : order)
+		{
+			offsets[block] = offset;
+
+			for (const DecodedInstruction &instr : blocks[block].instructions)
+			{
+				offset += encoded_size(instr);
+			}
+		}
+
+		for (size_t i = 0; i < blocks.size(); i++)
+		{
+			offsets[i] = blocks[i].reachable ? offsets[i] : offset;
+		}
+
+		offsets[blocks.size()] = offset;
+		return offsets;
+	}
+
+	/**
+	 * @param offsets The offsets of the blocks, see `layout()`.
+	 * @param target A block or `END`.
+	 * @returns The offset of the block in the optimised program.
+	 */
+	uint64_t
+	offset_of(const std::vector<uint64_t> &offsets, size_t target) const
+	{
+		return target == END ? offsets.back() : offsets[target];
+	}
+
+	/**
+	 * @brief Removes jumps to the next instruction and inverts
+	 * conditional jumps over a JUMP that is only jumped over.
+	 */
+	void
+	remove_jumps_to_next()
+	{
+		// Count the references to every block, a JUMP can only be
+		// removed from a block that is not jumped to.
+
+		std::vector<size_t> references(blocks.size(), 0);
+
+		for (const BasicBlock &block : blocks)
+		{
+			for (const DecodedInstruction &instr : block.instructions)
+			{
+				if (instr.target != END && (is_jump(instr.opcode)
+					|| instr.opcode == CALL || instr.opcode == THREAD_SPAWN))
+				{
+					references[instr.target]++;
+				}
+			}
+		}
+
+		bool changed = true;
+
+		while (changed)
+		{
+			changed                        = false;
+			std::vector<uint64_t> offsets = layout();
+
+			for (size_t i = 0; i < order.size(); i++)
+			{
+				std::vector<DecodedInstruction> &instructions = blocks[order[i]].instructions;
+
+				if (instructions.empty() || !is_jump(instructions.back().opcode))
+				{
+					continue;
+				}
+
+				DecodedInstruction &jump = instructions.back();
+				uint64_t next            = offsets[order[i]];
+
+				for (const DecodedInstruction &instr : instructions)
+				{
+					next += encoded_size(instr);
+				}
+
+				if (offset_of(offsets, jump.target) == next)
+				{
+					references[jump.target] -= jump.target != END;
+					instructions.pop_back();
+					removed_jumps++;
+					changed = true;
+					break;
+				}
+
+				// A conditional jump over a block that only holds a JUMP:
+				//   JUMP_IF_EQ a; JUMP b; a:  becomes  JUMP_IF_NEQ b; a:
+
+				if (jump.opcode == JUMP || i + 1 == order.size())
+				{
+					continue;
+				}
+
+				BasicBlock &over = blocks[order[i + 1]];
+
+				if (over.instructions.size() == 1 && over.instructions[0].opcode == JUMP
+					&& !over.is_entry && references[order[i + 1]] == 0
+					&& offset_of(offsets, jump.target) == next + encoded_size(over.instructions[0]))
+				{
+					references[jump.target] -= jump.target != END;
+					jump.opcode = invert_jump(jump.opcode);
+					jump.target = over.instructions[0].target;
+					over.instructions.clear();
+					inverted_jumps++;
+					changed = true;
+					break;
+				}
+			}
+		}
+	}
+
+	/**
+	 * @param instr An instruction.
+	 * @returns The size of the instruction in bytes.
+	 */
+	static size_t
+	encoded_size(const DecodedInstruction &instr)
+	{
+		size_t size = sizeof(Instruction);
+
+		for (ArgumentType type : instruction_arg_types(instr.opcode))
+		{
+			switch (type)
+			{
+			case REG:
+			case LIT_8:
+				size += 1;
+				break;
+
+			case LIT_16:
+				size += 2;
+				break;
+
+			case REL_ADDR:
+			case LIT_32:
+				size += 4;
+				break;
+
+			case LIT_64:
+				size += 8;
+				break;
+
+			case NULL_TERMINATED_STRING:
+				size += instr.str.size() + 1;
+				break;
+			}
+		}
+
+		return size;
+	}
+
+	/**
+	 * @brief Encodes the optimised program.
+	 * @param offsets The offsets of the blocks, see `layout()`.
+	 * @param new_lines The line table of the optimised program is added to this.
+	 * @returns The code of the optimised program.
+	 */
+	std::vector<uint8_t>
+	encode(const std::vector<uint64_t> &offsets, LineTable &new_lines) const
+	{
+		std::vector<uint8_t> code;
+
+		for (size_t block : order)
+		{
+			for (const DecodedInstruction &instr : blocks[block].instructions)
+			{
+				uint64_t offset = code.size();
+				size_t i        = 0;
+
+				new_lines.add(offset, lines.line_of(instr.origin));
+				code.push_back(instr.opcode);
+
+				for (ArgumentType type : instruction_arg_types(instr.opcode))
+				{
+					uint64_t value = instr.args[i++];
+					size_t size    = 0;
+
+					switch (type)
+					{
+					case REG:
+					case LIT_8:
+						size = 1;
+						break;
+
+					case LIT_16:
+						size = 2;
+						break;
+
+					case REL_ADDR:
+						value = (int32_t) (offset_of(offsets, instr.target) - offset);
+						size  = 4;
+						break;
+
+					case LIT_32:
+						size = 4;
+						break;
+
+					case LIT_64:
+						size = 8;
+						break;
+
+					case NULL_TERMINATED_STRING:
+						code.insert(code.end(), instr.str.begin(), instr.str.end());
+						code.push_back('\0');
+						break;
+					}
+
+					// Only works on little-endian systems.
+
+					for (size_t byte = 0; byte < size; byte++)
+					{
+						code.push_back(value >> (byte * 8));
+					}
+				}
+			}
+		}
+
+		return code;
+	}
+
+	/**
+	 * @param offsets The offsets of the blocks, see `layout()`.
+	 * @param offset The offset of the start of a block in the original program.
+	 * @returns The offset of the block in the optimised program.
+	 */
+	uint64_t
+	new_offset(const std::vector<uint64_t> &offsets, uint64_t offset) const
+	{
+		auto block = std::lower_bound(blocks.begin(), blocks.end(), offset,
+			[](const BasicBlock &block, uint64_t offset) { return block.origin < offset; });
+
+		return block == blocks.end() ? offsets.back() : offsets[block - blocks.begin()];
+	}
+
+	/**
+	 * @brief Copies the export table with the offsets of the optimised program.
+	 * See `ExportTable` for its layout. The offsets are taken from the loaded
+	 * executable, whose program may have been upgraded from an older encoding.
+	 * @param offsets The offsets of the blocks, see `layout()`.
+	 * @param section The export section of the original executable.
+	 * @returns The export section of the optimised executable.
+	 */
+	std::vector<uint8_t>
+	relocate_exports(const std::vector<uint64_t> &offsets, const Section &section) const
+	{
+		std::vector<uint8_t> exports(file.data + section.offset,
+			file.data + section.offset + section.size);
+
+		auto relocate = [&](size_t position, uint64_t offset)
+		{
+			offset = new_offset(offsets, offset);
+			memcpy(exports.data() + position, &offset, sizeof(offset));
+		};
+
+		const ExportTable &export_table = executable.export_table;
+		relocate(0, export_table.init_end);
+
+		size_t position = 16;
+
+		for (const ExportedFunction &function : export_table.functions)
+		{
+			position += strlen((const char *) exports.data() + position) + 1;
+			relocate(position, function.offset);
+			position += 8;
+			position += 2 + exports[position + 1];
+		}
+
+		return exports;
+	}
+
+	/**
+	 * @brief Writes the optimised executable. The sections other than the
+	 * code, exports and lines are copied. Throws an error message if the
+	 * optimised program does not pass verification.
+	 * @param file_name The name of the optimised executable.
+	 * @returns The contents of the optimised executable.
+	 */
+	Buffer
+	build(const char *file_name)
+	{
+		std::vector<uint64_t> offsets = layout();
+		LineTable new_lines;
+		new_lines.source_file = lines.source_file;
+
+		std::vector<uint8_t> code = encode(offsets, new_lines);
+		optimised_size            = code.size();
+
+		SectionTable new_sections;
+
+		for (const Section &section : sections.sections)
+		{
+			switch (section.type)
+			{
+			case SECTION_CODE:
+				new_sections.add(SECTION_CODE, code.data(), code.size());
+				break;
+
+			case SECTION_EXPORTS:
+			{
+				std::vector<uint8_t> exports = relocate_exports(offsets, section);
+				new_sections.add(SECTION_EXPORTS, exports.data(), exports.size());
+				break;
+			}
+
+			case SECTION_LINES:
+			{
+				std::string new_section = new_lines.to_section();
+				new_sections.add(SECTION_LINES, (const uint8_t *) new_section.data(),
+					new_section.size());
+				break;
+			}
+
+			case SECTION_BSS:
+				new_sections.add_empty(SECTION_BSS, section.size);
+				break;
+
+			default:
+				new_sections.add((SectionType) section.type,
+					file.data + section.offset, section.size);
+				break;
+			}
+		}
+
+		Buffer result = new_sections.build();
+		Executable::from_buffer(result, file_name);
+		return result;
+	}
+};
+
+#endif
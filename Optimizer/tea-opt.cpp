@@ -0,0 +1,49 @@
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "Optimizer/optimizer.hpp"
+#include "Shared/buffer.hpp"
+
+void
+print_usage()
+{
+	fprintf(stderr, "Usage: ./tea-opt input.teax output.teax\n");
+	exit(1);
+}
+
+int
+main(int argc, char **argv)
+{
+	if (argc != 3)
+	{
+		print_usage();
+	}
+
+	try
+	{
+		Buffer file = Buffer::from_file(argv[1]);
+		Optimizer optimizer(file, argv[1]);
+
+		optimizer.optimise();
+		Buffer output = optimizer.build(argv[2]);
+		output.write_to_file(argv[2]);
+
+		printf("Threaded %zu jumps\n", optimizer.threaded_jumps);
+		printf("Removed %zu unreachable blocks, %zu unused functions\n",
+			optimizer.removed_blocks, optimizer.removed_functions);
+		printf("Removed %zu redundant instructions, folded %zu instructions\n",
+			optimizer.redundant_instructions, optimizer.folded_instructions);
+		printf("Removed %zu instructions with unused results\n", optimizer.dead_instructions);
+		printf("Moved %zu blocks, removed %zu jumps, inverted %zu jumps\n",
+			optimizer.moved_blocks, optimizer.removed_jumps, optimizer.inverted_jumps);
+		printf("Code size: %lu -> %lu bytes\n", optimizer.original_size, optimizer.optimised_size);
+		printf("Wrote %s\n", argv[2]);
+	}
+	catch (const std::string &err_message)
+	{
+		std::cerr << err_message << std::flush;
+		return 1;
+	}
+}
@@ -2,6 +2,9 @@
 #define TEA_BUFFER_HEADER
 
 #include <cstdint>
+#include <cstdio>
+#include <string>
+#include <sys/stat.h>
 
 struct Buffer
 {
@@ -19,6 +22,19 @@ struct Buffer
 	Buffer(uint8_t *data, size_t size)
 		: data(data), size(size) {}
 
+	/**
+	 * @brief Moves a Buffer object.
+	 * The moved-from buffer is left empty. A buffer owns its data,
+	 * so it cannot be copied.
+	 * @param other The buffer to move.
+	 */
+	Buffer(Buffer &&other)
+		: data(other.data), size(other.size)
+	{
+		other.data = nullptr;
+		other.size = 0;
+	}
+
 	/**
 	 * @brief Destroys the Buffer object.
 	 * Frees the underlying buffer.
@@ -56,6 +72,7 @@ struct Buffer
 
 	/**
 	 * @brief Writes the buffer to a file.
+	 * Throws an error message if the file cannot be written.
 	 * @param file_path The file path of the file to write to.
 	 * If the file does not exist, a file is created.
 	 * If the file does exist, it is overwritten.
@@ -64,13 +81,24 @@ struct Buffer
 	write_to_file(const char *file_path)
 	{
 		FILE *file = fopen(file_path, "w");
-		fwrite(data, size, 1, file);
-		fclose(file);
+
+		if (file == nullptr)
+		{
+			throw std::string("Could not open file ") + file_path + "\n";
+		}
+
+		size_t written = fwrite(data, 1, size, file);
+
+		if (fclose(file) != 0 || written != size)
+		{
+			throw std::string("Could not write file ") + file_path + "\n";
+		}
 	}
 
 	/**
 	 * @brief Constructs a `Buffer` from a file.
-	 * @param file_path The path to the file to read. Must exist.
+	 * Throws an error message if the file cannot be opened or read.
+	 * @param file_path The path to the file to read.
 	 * @returns A buffer containing the data from the file.
 	 */
 	static Buffer
@@ -78,15 +106,32 @@ struct Buffer
 	{
 		FILE *file = fopen(file_path, "r");
 
-		fseek(file, 0, SEEK_END);
-		size_t size = ftell(file);
-		fseek(file, 0, SEEK_SET);
+		if (file == nullptr)
+		{
+			throw std::string("Could not open file ") + file_path + "\n";
+		}
 
-		uint8_t *buffer = new uint8_t[size];
+		// Directories can be opened, but not read.
+
+		struct stat file_stat;
 
-		fread(buffer, 1, size, file);
+		if (fstat(fileno(file), &file_stat) != 0 || !S_ISREG(file_stat.st_mode))
+		{
+			fclose(file);
+			throw std::string("Could not read file ") + file_path + "\n";
+		}
+
+		size_t size     = file_stat.st_size;
+		uint8_t *buffer = new uint8_t[size];
+		size_t read     = fread(buffer, 1, size, file);
 		fclose(file);
 
+		if (read != size)
+		{
+			delete[] buffer;
+			throw std::string("Could not read file ") + file_path + "\n";
+		}
+
 		return Buffer(buffer, size);
 	}
 
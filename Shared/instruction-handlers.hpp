@@ -0,0 +1,112 @@
+#ifndef TEA_INSTRUCTION_HANDLERS_HEADER
+#define TEA_INSTRUCTION_HANDLERS_HEADER
+
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Executable/byte-code.hpp"
+
+// The lines of the body of the handler of each instruction,
+// without the braces around it.
+using InstructionHandlers = std::unordered_map<uint16_t, std::vector<std::string>>;
+
+/**
+ * @brief Reads the handlers of all instructions from the switch
+ * statement of `BasicCPU::execute()`, for tools that generate code
+ * from them. Every handler is a run of case labels followed by a block.
+ * Throws an error message if the file cannot be read or has no handlers.
+ * @param file_path The path of the CPU header.
+ * @returns The handlers.
+ */
+InstructionHandlers
+read_instruction_handlers(const std::string &file_path)
+{
+	std::ifstream file(file_path);
+
+	if (!file)
+	{
+		throw "Could not open " + file_path + "\n";
+	}
+
+	std::unordered_map<std::string, Instruction> opcodes;
+
+	for (uint16_t opcode = 0; opcode < INSTRUCTION_COUNT; opcode++)
+	{
+		opcodes[instruction_to_str((Instruction) opcode)] = (Instruction) opcode;
+	}
+
+	std::vector<std::string> lines;
+	std::string line;
+
+	while (std::getline(file, line))
+	{
+		lines.push_back(line);
+	}
+
+	// Find the switch statement.
+
+	size_t i = 0;
+
+	while (i < lines.size() && lines[i] != "\t\tswitch (instruction)")
+	{
+		i++;
+	}
+
+	i += 2;
+
+	InstructionHandlers handlers;
+
+	while (i < lines.size())
+	{
+		std::vector<Instruction> labels;
+
+		while (i < lines.size() && lines[i].rfind("\t\tcase ", 0) == 0
+			&& lines[i].back() == ':')
+		{
+			std::string name = lines[i].substr(7, lines[i].size() - 8);
+			auto it          = opcodes.find(name);
+
+			if (it != opcodes.end())
+			{
+				labels.push_back(it->second);
+			}
+
+			i++;
+		}
+
+		if (labels.empty() || lines[i] != "\t\t{")
+		{
+			break;
+		}
+
+		size_t end = i + 1;
+
+		while (end < lines.size() && lines[end] != "\t\t}")
+		{
+			end++;
+		}
+
+		for (Instruction label : labels)
+		{
+			handlers[label].assign(lines.begin() + i + 1, lines.begin() + end);
+		}
+
+		i = end + 1;
+
+		while (i < lines.size() && lines[i].empty())
+		{
+			i++;
+		}
+	}
+
+	if (handlers.empty())
+	{
+		throw "Could not find the instruction handlers in " + file_path + "\n";
+	}
+
+	return handlers;
+}
+
+#endif
@@ -0,0 +1,125 @@
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "Superinstructions/synthesizer.hpp"
+
+// The default number of superinstructions.
+#define DEFAULT_SUPERINSTRUCTION_COUNT 16
+
+void
+print_usage()
+{
+	fprintf(stderr, "Usage: ./synthesize [--count count] [--root repository_root] "
+		"profile.sequences...\n");
+	exit(1);
+}
+
+/**
+ * @brief Writes a generated file.
+ * Throws an error message if the file cannot be created.
+ * @param file_path The path of the file.
+ * @param write Called with the file to write its contents.
+ */
+template <typename Writer>
+void
+write_file(const std::string &file_path, Writer write)
+{
+	FILE *file = fopen(file_path.c_str(), "w");
+
+	if (file == nullptr)
+	{
+		throw "Could not open " + file_path + "\n";
+	}
+
+	write(file);
+	fclose(file);
+	printf("Wrote %s\n", file_path.c_str());
+}
+
+int
+main(int argc, char **argv)
+{
+	size_t count     = DEFAULT_SUPERINSTRUCTION_COUNT;
+	std::string root = ".";
+	std::vector<std::string> profile_paths;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+
+		if (arg == "--count")
+		{
+			if (i + 1 == argc)
+				print_usage();
+
+			count = strtoull(argv[++i], nullptr, 10);
+		}
+		else if (arg == "--root")
+		{
+			if (i + 1 == argc)
+				print_usage();
+
+			root = argv[++i];
+		}
+		else
+		{
+			profile_paths.push_back(arg);
+		}
+	}
+
+	if (profile_paths.empty())
+	{
+		print_usage();
+	}
+
+	try
+	{
+		Synthesizer synthesizer;
+		synthesizer.load_handlers(root + "/VM/cpu.hpp");
+
+		for (const std::string &profile_path : profile_paths)
+		{
+			synthesizer.load_profile(profile_path);
+		}
+
+		std::vector<Synthesizer::Candidate> candidates = synthesizer.select(count);
+		std::vector<std::string> names                 = Synthesizer::names(candidates);
+		uint64_t total_dispatches                      = 0;
+
+		for (const std::pair<const std::vector<Instruction>, uint64_t> &sequence :
+			synthesizer.sequence_counts)
+		{
+			if (sequence.first.size() == 2)
+			{
+				total_dispatches += sequence.second;
+			}
+		}
+
+		printf("%16s %8s    %s\n", "saved dispatches", "%", "superinstruction");
+
+		for (size_t i = 0; i < candidates.size(); i++)
+		{
+			printf("%16lu %7.2f%%    %s\n", candidates[i].saved_dispatches(),
+				total_dispatches ? 100.0 * candidates[i].saved_dispatches() / total_dispatches : 0.0,
+				names[i].c_str());
+		}
+
+		write_file(root + "/Executable/superinstructions.hpp", [&](FILE *file)
+		{
+			synthesizer.write_list(file, candidates);
+		});
+
+		write_file(root + "/VM/superinstruction-handlers.hpp", [&](FILE *file)
+		{
+			synthesizer.write_handlers(file, candidates);
+		});
+	}
+	catch (const std::string &err_message)
+	{
+		std::cerr << err_message << std::flush;
+		return 1;
+	}
+}
@@ -0,0 +1,361 @@
+#ifndef TEA_SYNTHESIZER_HEADER
+#define TEA_SYNTHESIZER_HEADER
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Executable/byte-code.hpp"
+#include "Shared/instruction-handlers.hpp"
+
+/**
+ * @brief Synthesizes superinstructions from the opcode sequence profiles
+ * written by the profiler of the VM, see `Profiler::write_sequences()`.
+ *
+ * The sequences of all profiles are summed, and the sequences that save
+ * the most dispatches are turned into superinstructions. Their handlers
+ * are composed from the handlers of their instructions, which are copied
+ * from the switch statement of `BasicCPU::execute()`.
+ *
+ * A superinstruction replaces the opcode of the first instruction of its
+ * sequence and leaves the other instructions as they are, so only its
+ * last instruction may change the flow of control. Instructions that
+ * jump, call or return are only used as the last instruction.
+ */
+struct Synthesizer
+{
+	/**
+	 * @brief A candidate superinstruction.
+	 */
+	struct Candidate
+	{
+		// The instructions of the sequence.
+		std::vector<Instruction> components;
+
+		// The number of times the sequence was executed.
+		uint64_t count;
+
+		/**
+		 * @returns The number of dispatches the superinstruction saves.
+		 */
+		uint64_t
+		saved_dispatches() const
+		{
+			return count * (components.size() - 1);
+		}
+	};
+
+	// The execution counts of all opcode sequences of all profiles.
+	std::map<std::vector<Instruction>, uint64_t> sequence_counts;
+
+	// The number of loaded profiles.
+	size_t profile_count = 0;
+
+	// The handlers of the instructions.
+	InstructionHandlers handlers;
+
+	// Maps instruction names to opcodes.
+	std::unordered_map<std::string, Instruction> opcodes;
+
+	Synthesizer()
+	{
+		for (uint16_t opcode = 0; opcode < INSTRUCTION_COUNT; opcode++)
+		{
+			opcodes[instruction_to_str((Instruction) opcode)] = (Instruction) opcode;
+		}
+	}
+
+	/**
+	 * @brief Adds the opcode sequences of a profile.
+	 * Sequences with instructions that don't exist anymore are skipped.
+	 * Throws an error message if the profile cannot be read.
+	 * @param file_path The path of the ".sequences" file of the profile.
+	 */
+	void
+	load_profile(const std::string &file_path)
+	{
+		std::ifstream file(file_path);
+
+		if (!file)
+		{
+			throw "Could not open profile " + file_path + "\n";
+		}
+
+		std::string line;
+
+		while (std::getline(file, line))
+		{
+			std::istringstream words(line);
+			std::vector<Instruction> sequence;
+			uint64_t count;
+			std::string name;
+			bool known = true;
+
+			if (!(words >> count))
+			{
+				continue;
+			}
+
+			while (words >> name)
+			{
+				auto it = opcodes.find(name);
+				known   = known && it != opcodes.end();
+
+				if (known)
+				{
+					sequence.push_back(it->second);
+				}
+			}
+
+			if (known && sequence.size() >= 2)
+			{
+				sequence_counts[sequence] += count;
+			}
+		}
+
+		profile_count++;
+	}
+
+	/**
+	 * @brief Reads the handlers of all instructions from the switch
+	 * statement of `BasicCPU::execute()`.
+	 * Throws an error message if the file cannot be read.
+	 * @param file_path The path of the CPU header.
+	 */
+	void
+	load_handlers(const std::string &file_path)
+	{
+		handlers = read_instruction_handlers(file_path);
+	}
+
+	/**
+	 * @param instruction An instruction.
+	 * @returns Whether the handler of the instruction always continues
+	 * with the next instruction, so it can be followed by another handler.
+	 */
+	bool
+	falls_through(Instruction instruction) const
+	{
+		for (const std::string &line : handlers.at(instruction))
+		{
+			if (line.find("jump_instruction_p") != std::string::npos
+				|| line.find("set_instr_ptr") != std::string::npos
+				|| line.find("stack_frame") != std::string::npos)
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	/**
+	 * @param components The instructions of a sequence.
+	 * @returns Whether the sequence can be turned into a superinstruction.
+	 */
+	bool
+	is_fusable(const std::vector<Instruction> &components) const
+	{
+		for (size_t i = 0; i < components.size(); i++)
+		{
+			if (!handlers.count(components[i]))
+			{
+				return false;
+			}
+
+			if (i + 1 < components.size() && !falls_through(components[i]))
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	/**
+	 * @brief Selects the sequences that save the most dispatches.
+	 * @param max_count The maximum number of superinstructions.
+	 * @returns The selected sequences, most profitable first.
+	 */
+	std::vector<Candidate>
+	select(size_t max_count) const
+	{
+		std::vector<Candidate> candidates;
+
+		for (const std::pair<const std::vector<Instruction>, uint64_t> &sequence : sequence_counts)
+		{
+			if (is_fusable(sequence.first))
+			{
+				candidates.push_back({ sequence.first, sequence.second });
+			}
+		}
+
+		std::stable_sort(candidates.begin(), candidates.end(),
+			[](const Candidate &a, const Candidate &b)
+			{ return a.saved_dispatches() > b.saved_dispatches(); });
+
+		if (candidates.size() > max_count)
+		{
+			candidates.resize(max_count);
+		}
+
+		return candidates;
+	}
+
+	/**
+	 * @param candidates The selected sequences.
+	 * @returns The names of the superinstructions of the sequences.
+	 */
+	static std::vector<std::string>
+	names(const std::vector<Candidate> &candidates)
+	{
+		std::vector<std::string> names;
+
+		for (const Candidate &candidate : candidates)
+		{
+			std::string name = "SUPER";
+
+			for (Instruction component : candidate.components)
+			{
+				name += "_";
+				name += instruction_to_str(component);
+			}
+
+			// Names of different sequences may coincide,
+			// since instruction names contain underscores.
+
+			if (std::find(names.begin(), names.end(), name) != names.end())
+			{
+				name += "_" + std::to_string(names.size());
+			}
+
+			names.push_back(name);
+		}
+
+		return names;
+	}
+
+	/**
+	 * @brief Writes the header that lists the superinstructions,
+	 * see `Executable/superinstructions.hpp`.
+	 * @param file The file to write to.
+	 * @param candidates The selected sequences.
+	 */
+	void
+	write_list(FILE *file, const std::vector<Candidate> &candidates) const
+	{
+		std::vector<std::string> super_names = names(candidates);
+
+		fprintf(file, "// Generated by Superinstructions/synthesize from %lu profiles.\n",
+			profile_count);
+		fprintf(file, "// Regenerate with ./synthesize-superinstructions.sh, do not edit.\n\n");
+		fprintf(file, "#ifndef TEA_SUPERINSTRUCTIONS_HEADER\n");
+		fprintf(file, "#define TEA_SUPERINSTRUCTIONS_HEADER\n\n");
+		fprintf(file, "// The superinstructions, most profitable first. Expanded with a macro\n");
+		fprintf(file, "// X(name, instructions...) that takes the name of a superinstruction\n");
+		fprintf(file, "// and the sequence of instructions it executes.\n");
+		fprintf(file, "#define SUPERINSTRUCTIONS(X)");
+
+		for (size_t i = 0; i < candidates.size(); i++)
+		{
+			fprintf(file, " \\\n\tX(%s", super_names[i].c_str());
+
+			for (Instruction component : candidates[i].components)
+			{
+				fprintf(file, ", %s", instruction_to_str(component));
+			}
+
+			fprintf(file, ")");
+		}
+
+		fprintf(file, "\n\n#endif\n");
+	}
+
+	/**
+	 * @brief Writes the handlers of the superinstructions,
+	 * see `VM/superinstruction-handlers.hpp`.
+	 * @param file The file to write to.
+	 * @param candidates The selected sequences.
+	 */
+	void
+	write_handlers(FILE *file, const std::vector<Candidate> &candidates) const
+	{
+		std::vector<std::string> super_names = names(candidates);
+
+		fprintf(file, "// Generated by Superinstructions/synthesize from %lu profiles.\n",
+			profile_count);
+		fprintf(file, "// Regenerate with ./synthesize-superinstructions.sh, do not edit.\n\n");
+		fprintf(file, "// The handlers of the superinstructions. Included in the switch statement\n");
+		fprintf(file, "// of `BasicCPU::execute()`, so this file has no include guard.\n");
+		fprintf(file, "// Each handler runs copies of the handlers of its instructions. Before\n");
+		fprintf(file, "// each instruction after the first, `cur_instr_addr` is moved to it\n");
+		fprintf(file, "// and its opcode is skipped, like `step()` does.\n");
+
+		for (size_t i = 0; i < candidates.size(); i++)
+		{
+			fprintf(file, "\n\t\tcase %s:\n\t\t{\n", super_names[i].c_str());
+
+			const std::vector<Instruction> &components = candidates[i].components;
+
+			for (size_t j = 0; j < components.size(); j++)
+			{
+				if (j != 0)
+				{
+					fprintf(file, "\n");
+				}
+
+				fprintf(file, "\t\t\t// %s\n\n", instruction_to_str(components[j]));
+
+				if (j != 0)
+				{
+					fprintf(file, "\t\t\tcur_instr_addr = get_instr_ptr();\n");
+					fprintf(file, "\t\t\tfetch<Instruction>();\n\n");
+				}
+
+				write_component(file, handlers.at(components[j]));
+			}
+
+			fprintf(file, "\n\t\t\tbreak;\n\t\t}\n");
+		}
+	}
+
+	/**
+	 * @brief Writes the body of a handler as a block of a superinstruction.
+	 * The `break` at the end of the handler is dropped. Handlers that
+	 * break out early are wrapped in a loop that runs once, so their
+	 * `break` statements leave the handler instead of the superinstruction.
+	 * @param file The file to write to.
+	 * @param body The lines of the body of the handler.
+	 */
+	static void
+	write_component(FILE *file, std::vector<std::string> body)
+	{
+		while (!body.empty() && (body.back().empty() || body.back() == "\t\t\tbreak;"))
+		{
+			body.pop_back();
+		}
+
+		bool breaks_early = false;
+
+		for (const std::string &line : body)
+		{
+			breaks_early = breaks_early || line.find("break;") != std::string::npos;
+		}
+
+		fprintf(file, breaks_early ? "\t\t\tdo\n\t\t\t{\n" : "\t\t\t{\n");
+
+		for (const std::string &line : body)
+		{
+			fprintf(file, line.empty() ? "\n" : "\t%s\n", line.c_str());
+		}
+
+		fprintf(file, breaks_early ? "\t\t\t}\n\t\t\twhile (false);\n" : "\t\t\t}\n");
+	}
+};
+
+#endif
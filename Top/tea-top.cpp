@@ -0,0 +1,254 @@
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "VM/stats.hpp"
+#include "Shared/ansi.hpp"
+
+// The default time between two redraws in milliseconds.
+#define DEFAULT_INTERVAL_MS 1000
+
+void
+print_usage()
+{
+	fprintf(stderr, "Usage: ./tea-top [--interval milliseconds] [--once] name\n");
+	exit(1);
+}
+
+/**
+ * @brief Maps the stats page of a VM that was started with --stats-shm.
+ * Waits for the VM to write its first snapshot.
+ * Throws an error message if the page cannot be mapped.
+ * @param name The name of the page.
+ * @returns The page, mapped read-only.
+ */
+const StatsPage *
+map_stats_page(const std::string &name)
+{
+	std::string shm_name = stats_shm_name(name);
+	int fd               = shm_open(shm_name.c_str(), O_RDONLY, 0);
+
+	if (fd == -1)
+	{
+		throw "Could not open stats page " + shm_name + ": " + strerror(errno)
+			+ "\nIs a VM running with --stats-shm " + name + "?\n";
+	}
+
+	struct stat info;
+
+	if (fstat(fd, &info) == -1 || (size_t) info.st_size < sizeof(StatsPage))
+	{
+		close(fd);
+		throw "Stats page " + shm_name + " is too small\n";
+	}
+
+	void *mapping = mmap(nullptr, sizeof(StatsPage), PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (mapping == MAP_FAILED)
+	{
+		throw "Could not map stats page " + shm_name + ": " + strerror(errno) + "\n";
+	}
+
+	const StatsPage *page = (const StatsPage *) mapping;
+
+	for (size_t i = 0; page->magic.load(std::memory_order_acquire) != STATS_MAGIC; i++)
+	{
+		if (i == 100)
+		{
+			throw "Stats page " + shm_name + " was never initialised\n";
+		}
+
+		usleep(10000);
+	}
+
+	if (page->version.load(std::memory_order_relaxed) != STATS_VERSION)
+	{
+		throw "Stats page " + shm_name + " has version "
+			+ std::to_string(page->version.load(std::memory_order_relaxed))
+			+ ", expected " + std::to_string(STATS_VERSION) + "\n";
+	}
+
+	return page;
+}
+
+/**
+ * @param value A number.
+ * @param unit The unit of the number, empty for plain counts
+ * or "B" for bytes, which are scaled by 1024.
+ * @returns The number, scaled to at most four digits with a suffix.
+ */
+std::string
+humanise(double value, const char *unit)
+{
+	static const char *const suffixes[] = { "", "K", "M", "G", "T", "P" };
+	double base                        = unit[0] == 'B' ? 1024 : 1000;
+	size_t suffix                      = 0;
+
+	while (value >= base && suffix + 1 < sizeof(suffixes) / sizeof(suffixes[0]))
+	{
+		value /= base;
+		suffix++;
+	}
+
+	// Binary prefixes for bytes, like "KiB".
+
+	const char *binary = unit[0] == 'B' && suffix != 0 ? "i" : "";
+
+	char buf[32];
+	snprintf(buf, sizeof(buf), suffix == 0 ? "%.0f %s%s%s" : "%.1f %s%s%s",
+		value, suffixes[suffix], binary, unit);
+	return buf;
+}
+
+/**
+ * @brief Prints a snapshot of a stats page, with the rates
+ * since the previous snapshot.
+ * @param name The name of the page.
+ * @param cur The current snapshot.
+ * @param prev The previous snapshot, or the current one
+ * if there is no previous snapshot.
+ */
+void
+draw(const std::string &name, const StatsSnapshot &cur, const StatsSnapshot &prev)
+{
+	double elapsed = (cur.update_time_ns - prev.update_time_ns) / 1e9;
+	double uptime  = (cur.update_time_ns - cur.start_time_ns) / 1e9;
+
+	auto rate = [&](uint64_t cur_value, uint64_t prev_value, const char *unit)
+	{
+		if (elapsed <= 0)
+		{
+			return std::string("-");
+		}
+
+		return humanise((cur_value - prev_value) / elapsed, unit) + "/s";
+	};
+
+	printf("tea-top %s    pid %lu    %s    uptime %.1fs\n\n", name.c_str(), cur.pid,
+		cur.running ? "running" : "exited", uptime);
+
+	printf("%-14s %14lu %16s\n", "instructions", cur.instructions,
+		rate(cur.instructions, prev.instructions, "").c_str());
+	printf("%-14s %14lu %16s\n", "calls", cur.calls,
+		rate(cur.calls, prev.calls, "").c_str());
+	printf("%-14s %14lu %16s\n", "returns", cur.returns,
+		rate(cur.returns, prev.returns, "").c_str());
+	printf("%-14s %14s %16s\n", "i/o read", humanise(cur.io_bytes_read, "B").c_str(),
+		rate(cur.io_bytes_read, prev.io_bytes_read, "B").c_str());
+	printf("%-14s %14s %16s\n", "i/o written", humanise(cur.io_bytes_written, "B").c_str(),
+		rate(cur.io_bytes_written, prev.io_bytes_written, "B").c_str());
+	printf("%-14s %14s\n", "heap", humanise(cur.heap_bytes, "B").c_str());
+	printf("%-14s %14s    peak %s of %s\n\n", "stack", humanise(cur.stack_depth, "B").c_str(),
+		humanise(cur.peak_stack_depth, "B").c_str(), humanise(cur.stack_size, "B").c_str());
+
+	uint64_t interval_instructions = cur.instructions - prev.instructions;
+
+	printf("%-14s %14s %9s %9s\n", "class", "instructions", "total", "now");
+
+	for (size_t i = 0; i < OPCODE_CLASS_COUNT; i++)
+	{
+		uint64_t interval_count = cur.class_counts[i] - prev.class_counts[i];
+
+		printf("%-14s %14lu %8.1f%% %8.1f%%\n", opcode_class_to_str((OpcodeClass) i),
+			cur.class_counts[i],
+			cur.instructions ? 100.0 * cur.class_counts[i] / cur.instructions : 0.0,
+			interval_instructions ? 100.0 * interval_count / interval_instructions : 0.0);
+	}
+
+	fflush(stdout);
+}
+
+int
+main(int argc, char **argv)
+{
+	const char *name     = nullptr;
+	uint64_t interval_ms = DEFAULT_INTERVAL_MS;
+	bool once            = false;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+
+		if (arg == "--interval")
+		{
+			if (i + 1 == argc)
+				print_usage();
+
+			interval_ms = strtoull(argv[++i], nullptr, 10);
+
+			if (interval_ms == 0)
+				print_usage();
+		}
+		else if (arg == "--once")
+		{
+			once = true;
+		}
+		else if (name == nullptr)
+		{
+			name = argv[i];
+		}
+		else
+		{
+			print_usage();
+		}
+	}
+
+	if (name == nullptr)
+	{
+		print_usage();
+	}
+
+	try
+	{
+		// The page stays mapped after the VM removes it,
+		// so the final statistics are shown when it exits.
+
+		const StatsPage *page = map_stats_page(name);
+		StatsSnapshot prev    = page->read();
+		bool interactive      = isatty(STDOUT_FILENO) && !once;
+
+		if (!once)
+		{
+			usleep(interval_ms * 1000);
+		}
+
+		while (true)
+		{
+			StatsSnapshot cur = page->read();
+
+			if (interactive)
+			{
+				printf(ANSI_CURSOR_TO(1, 1) ANSI_ERASE_DISPLAY(2));
+			}
+
+			draw(name, cur, prev);
+
+			if (once || !cur.running)
+			{
+				return 0;
+			}
+
+			if (!interactive)
+			{
+				printf("\n");
+			}
+
+			prev = cur;
+			usleep(interval_ms * 1000);
+		}
+	}
+	catch (const std::string &err_message)
+	{
+		std::cerr << err_message << std::flush;
+		return 1;
+	}
+}
@@ -0,0 +1,310 @@
+#ifndef TEA_AIO_HEADER
+#define TEA_AIO_HEADER
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "VM/file-io.hpp"
+
+// The operations of the AIO_SUBMIT instruction.
+
+// Read from a file at an offset.
+#define AIO_OP_READ 0
+
+// Write to a file at an offset.
+#define AIO_OP_WRITE 1
+
+// The number of threads that perform asynchronous I/O.
+#define AIO_WORKERS 4
+
+// The number of slots of the completion ring.
+// Also the maximum number of requests in flight. A power of two.
+#define AIO_RING_SIZE 256
+
+/**
+ * @brief Asynchronous I/O for the AIO_SUBMIT and AIO_POLL instructions.
+ * Requests are queued for a small pool of I/O threads, which perform
+ * them with blocking pread and pwrite calls. Finished requests are
+ * published on a lock-free completion ring that is drained by the CPU.
+ *
+ * The ring is a bounded multi-producer single-consumer queue. Every slot
+ * carries a sequence number, which tells the consumer whether the slot
+ * holds a completion of the current lap. Submissions are refused while
+ * AIO_RING_SIZE requests are in flight or unpolled, so the I/O threads
+ * never wait for a free slot.
+ * The I/O threads are started on the first submission.
+ */
+struct AsyncIO
+{
+	/**
+	 * @brief An I/O request.
+	 */
+	struct Request
+	{
+		// AIO_OP_READ or AIO_OP_WRITE.
+		uint64_t op;
+
+		// The file descriptor.
+		int64_t fd;
+
+		// The buffer to read into or write from.
+		uint8_t *buf;
+
+		// The number of bytes to read or write.
+		uint64_t len;
+
+		// The offset in the file.
+		uint64_t offset;
+
+		// A value chosen by the program to identify the request.
+		uint64_t tag;
+	};
+
+	/**
+	 * @brief A slot of the completion ring.
+	 */
+	struct Slot
+	{
+		// The number of completions published before the completion
+		// in this slot, plus one once the completion is written.
+		std::atomic<uint64_t> seq;
+
+		// The tag of the request.
+		uint64_t tag;
+
+		// The number of bytes read or written, or the negated errno value.
+		int64_t result;
+	};
+
+	// The completion ring.
+	Slot ring[AIO_RING_SIZE];
+
+	// The number of reserved slots of the ring. Written by the I/O threads.
+	std::atomic<uint64_t> ring_tail = 0;
+
+	// The number of consumed slots of the ring. Only used by the CPU.
+	uint64_t ring_head = 0;
+
+	// The number of submitted requests that were not polled yet.
+	// Only used by the CPU.
+	uint64_t outstanding = 0;
+
+	// Protects the submission queue.
+	std::mutex mutex;
+
+	// Signalled when a request is submitted.
+	std::condition_variable submitted;
+
+	// Signalled when a request completes while the CPU sleeps.
+	std::condition_variable completed;
+
+	// Set while the CPU waits for completions.
+	std::atomic<bool> sleeping = false;
+
+	// The requests that were not picked up by an I/O thread yet.
+	std::deque<Request> queue;
+
+	// Set when the I/O threads must exit.
+	bool stopping = false;
+
+	// The I/O threads.
+	std::vector<std::thread> workers;
+
+	AsyncIO()
+	{
+		for (uint64_t i = 0; i < AIO_RING_SIZE; i++)
+		{
+			ring[i].seq.store(i, std::memory_order_relaxed);
+		}
+	}
+
+	AsyncIO(const AsyncIO &) = delete;
+	AsyncIO &operator=(const AsyncIO &) = delete;
+
+	/**
+	 * @brief Waits for all submitted requests to finish,
+	 * then stops the I/O threads.
+	 */
+	~AsyncIO()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+
+		submitted.notify_all();
+
+		for (std::thread &worker : workers)
+		{
+			worker.join();
+		}
+	}
+
+	/**
+	 * @brief Queues a request.
+	 * @param request The request.
+	 * @returns 0, or -EAGAIN if too many requests are in flight
+	 * or unpolled, or -EINVAL if the operation is unknown.
+	 */
+	int64_t
+	submit(const Request &request)
+	{
+		if (request.op != AIO_OP_READ && request.op != AIO_OP_WRITE)
+		{
+			return -EINVAL;
+		}
+
+		if (outstanding == AIO_RING_SIZE)
+		{
+			return -EAGAIN;
+		}
+
+		if (workers.empty())
+		{
+			for (size_t i = 0; i < AIO_WORKERS; i++)
+			{
+				workers.emplace_back(&AsyncIO::work, this);
+			}
+		}
+
+		outstanding++;
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			queue.push_back(request);
+		}
+
+		submitted.notify_one();
+		return 0;
+	}
+
+	/**
+	 * @brief Takes completions off the ring.
+	 * @param out The pairs of 64-bit values to write the tags and results to.
+	 * The values need not be aligned.
+	 * @param max The maximum number of completions to take.
+	 * @param min The number of completions to wait for. Clamped to the
+	 * number of requests in flight, so polling never waits forever.
+	 * @returns The number of taken completions.
+	 */
+	uint64_t
+	poll(uint8_t *out, uint64_t max, uint64_t min)
+	{
+		min = std::min(std::min(min, max), outstanding);
+		uint64_t n = 0;
+
+		while (n < max)
+		{
+			Slot &slot = ring[ring_head % AIO_RING_SIZE];
+
+			if (slot.seq.load(std::memory_order_acquire) != ring_head + 1)
+			{
+				if (n >= min)
+				{
+					break;
+				}
+
+				wait_for(slot, ring_head + 1);
+				continue;
+			}
+
+			memcpy(out + n * 16, &slot.tag, 8);
+			memcpy(out + n * 16 + 8, &slot.result, 8);
+
+			// Free the slot for the next lap of the ring.
+
+			slot.seq.store(ring_head + AIO_RING_SIZE, std::memory_order_release);
+			ring_head++;
+			outstanding--;
+			n++;
+		}
+
+		return n;
+	}
+
+	/**
+	 * @brief Sleeps until a slot of the ring is published.
+	 * @param slot The slot.
+	 * @param seq The sequence number of the slot once it is published.
+	 */
+	void
+	wait_for(Slot &slot, uint64_t seq)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		sleeping.store(true);
+
+		// The I/O thread publishes the slot before it checks `sleeping`,
+		// and the slot is checked after `sleeping` is set, so a wakeup
+		// can't be missed.
+
+		while (slot.seq.load() != seq)
+		{
+			completed.wait(lock);
+		}
+
+		sleeping.store(false);
+	}
+
+	/**
+	 * @brief Performs a request and publishes its completion.
+	 * @param request The request.
+	 */
+	void
+	perform(const Request &request)
+	{
+		int64_t result = request.op == AIO_OP_READ
+			? file_io::pread(request.fd, request.buf, request.len, request.offset)
+			: file_io::pwrite(request.fd, request.buf, request.len, request.offset);
+
+		uint64_t pos = ring_tail.fetch_add(1);
+		Slot &slot   = ring[pos % AIO_RING_SIZE];
+
+		// Submissions are limited to the size of the ring,
+		// so the slot is always free by now.
+
+		slot.tag    = request.tag;
+		slot.result = result;
+		slot.seq.store(pos + 1);
+
+		if (sleeping.load())
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			completed.notify_one();
+		}
+	}
+
+	/**
+	 * @brief The main loop of an I/O thread.
+	 */
+	void
+	work()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+
+		while (true)
+		{
+			submitted.wait(lock, [this] { return stopping || !queue.empty(); });
+
+			if (queue.empty())
+			{
+				return;
+			}
+
+			Request request = queue.front();
+			queue.pop_front();
+
+			lock.unlock();
+			perform(request);
+			lock.lock();
+		}
+	}
+};
+
+#endif
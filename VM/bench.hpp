@@ -0,0 +1,346 @@
+#ifndef TEA_BENCH_HEADER
+#define TEA_BENCH_HEADER
+
+#if defined(__linux__) && defined(CALLGRIND)
+	#include <valgrind/callgrind.h>
+#else
+#define CALLGRIND_TOGGLE_COLLECT
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/**
+ * @brief The measurements of a benchmark region, marked by the program
+ * with BENCH_BEGIN and BENCH_END instructions.
+ */
+struct BenchRegion
+{
+	// The number of times the region was run.
+	uint64_t runs = 0;
+
+	// The total, shortest and longest wall time of a run in nanoseconds.
+	uint64_t total_ns = 0;
+	uint64_t min_ns   = UINT64_MAX;
+	uint64_t max_ns   = 0;
+
+	// The total number of host instructions retired by all runs.
+	// Only valid if `counts_instructions` is set.
+	uint64_t instructions = 0;
+
+	// Whether the instructions of every run were counted.
+	// Not set if the host does not provide a counter.
+	bool counts_instructions = true;
+};
+
+/**
+ * @brief The benchmark regions of a program, identified by the 64-bit
+ * id passed to BENCH_BEGIN and BENCH_END.
+ * Shared by the main CPU and the CPUs of all its threads.
+ */
+struct BenchRegions
+{
+	// Protects `regions`.
+	std::mutex mutex;
+
+	// The regions by id, ordered so the summary is stable.
+	std::map<uint64_t, BenchRegion> regions;
+
+	// The number of regions that are being run by any thread.
+	// Callgrind collects events while this is not 0.
+	std::atomic<uint64_t> open_count = 0;
+
+	/**
+	 * @brief Adds a run of a region.
+	 * @param id The id of the region.
+	 * @param ns The wall time of the run in nanoseconds.
+	 * @param instructions The number of retired instructions,
+	 * or UINT64_MAX if they could not be counted.
+	 */
+	void
+	record(uint64_t id, uint64_t ns, uint64_t instructions)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		BenchRegion &region = regions[id];
+
+		region.runs++;
+		region.total_ns += ns;
+		region.min_ns = std::min(region.min_ns, ns);
+		region.max_ns = std::max(region.max_ns, ns);
+
+		if (instructions == UINT64_MAX)
+		{
+			region.counts_instructions = false;
+		}
+		else
+		{
+			region.instructions += instructions;
+		}
+	}
+
+	/**
+	 * @brief Writes a table of all regions.
+	 * @param file The file to write to.
+	 */
+	void
+	write_table(FILE *file)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		fprintf(file, "%20s %10s %14s %14s %14s %14s %16s\n", "region", "runs",
+			"total ms", "mean us", "min us", "max us", "instructions");
+
+		for (auto &[id, region] : regions)
+		{
+			fprintf(file, "%20lu %10lu %14.3f %14.3f %14.3f %14.3f ", id, region.runs,
+				region.total_ns / 1e6, region.total_ns / 1e3 / region.runs,
+				region.min_ns / 1e3, region.max_ns / 1e3);
+
+			if (region.counts_instructions)
+			{
+				fprintf(file, "%16lu\n", region.instructions);
+			}
+			else
+			{
+				fprintf(file, "%16s\n", "-");
+			}
+		}
+	}
+
+	/**
+	 * @brief Writes all regions as a JSON array.
+	 * Instructions are null if they could not be counted.
+	 * @param file The file to write to.
+	 */
+	void
+	write_json(FILE *file)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		bool first = true;
+
+		fprintf(file, "[");
+
+		for (auto &[id, region] : regions)
+		{
+			fprintf(file, "%s\n  { \"region\": %lu, \"runs\": %lu, \"total_ns\": %lu, "
+				"\"min_ns\": %lu, \"max_ns\": %lu, \"instructions\": ",
+				first ? "" : ",", id, region.runs, region.total_ns,
+				region.min_ns, region.max_ns);
+
+			if (region.counts_instructions)
+			{
+				fprintf(file, "%lu }", region.instructions);
+			}
+			else
+			{
+				fprintf(file, "null }");
+			}
+
+			first = false;
+		}
+
+		fprintf(file, "\n]\n");
+	}
+
+	/**
+	 * @brief Writes the summary of all regions at the end of a program.
+	 * Writes nothing if the program did not mark any region.
+	 * @param json_path The path of a JSON file to write to,
+	 * or nullptr to write a table to stderr.
+	 */
+	void
+	write_summary(const char *json_path)
+	{
+		if (regions.empty())
+		{
+			return;
+		}
+
+		if (json_path == nullptr)
+		{
+			write_table(stderr);
+			return;
+		}
+
+		FILE *file = fopen(json_path, "w");
+
+		if (file == nullptr)
+		{
+			throw std::string("Could not open ") + json_path + "\n";
+		}
+
+		write_json(file);
+		fclose(file);
+	}
+};
+
+/**
+ * @brief Times the benchmark regions that are being run by one CPU.
+ * Wall time is read from the monotonic clock. Instructions are counted
+ * by a hardware counter of the host thread, if the host allows it,
+ * so they include the instructions of the interpreter itself.
+ */
+struct BenchTimer
+{
+	/**
+	 * @brief The start of a run of a region.
+	 */
+	struct Start
+	{
+		// The monotonic time in nanoseconds.
+		uint64_t ns;
+
+		// The value of the instruction counter.
+		uint64_t instructions;
+	};
+
+	// The regions being run, by id.
+	std::unordered_map<uint64_t, Start> open;
+
+	// The regions the runs are added to.
+	BenchRegions &regions;
+
+	// The file descriptor of the instruction counter, -1 if there is none.
+	int counter_fd = -1;
+
+	/**
+	 * @brief Constructs a new BenchTimer object
+	 * and opens the instruction counter of the calling thread.
+	 * @param regions The regions the runs are added to.
+	 */
+	BenchTimer(BenchRegions &regions)
+		: regions(regions)
+	{
+#ifdef __linux__
+		struct perf_event_attr attr;
+		memset(&attr, 0, sizeof(attr));
+		attr.size           = sizeof(attr);
+		attr.type           = PERF_TYPE_HARDWARE;
+		attr.config         = PERF_COUNT_HW_INSTRUCTIONS;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv     = 1;
+
+		counter_fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+	}
+
+	BenchTimer(const BenchTimer &) = delete;
+
+	/**
+	 * @brief Destroys the BenchTimer object.
+	 * Closes the instruction counter.
+	 */
+	~BenchTimer()
+	{
+#ifdef __linux__
+		if (counter_fd != -1)
+		{
+			close(counter_fd);
+		}
+#endif
+	}
+
+	/**
+	 * @returns The monotonic time in nanoseconds.
+	 */
+	static uint64_t
+	now_ns()
+	{
+		struct timespec now;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		return now.tv_sec * 1000000000ull + now.tv_nsec;
+	}
+
+	/**
+	 * @returns The value of the instruction counter,
+	 * or UINT64_MAX if there is no counter.
+	 */
+	uint64_t
+	read_instructions()
+	{
+#ifdef __linux__
+		uint64_t count;
+
+		if (counter_fd != -1 && read(counter_fd, &count, sizeof(count)) == sizeof(count))
+		{
+			return count;
+		}
+#endif
+
+		return UINT64_MAX;
+	}
+
+	/**
+	 * @brief Starts a run of a region.
+	 * Throws an error message if the region is already being run.
+	 * @param id The id of the region.
+	 */
+	void
+	begin(uint64_t id)
+	{
+		if (open.count(id))
+		{
+			throw "BENCH_BEGIN of region " + std::to_string(id)
+				+ ", which was already begun\n";
+		}
+
+		if (regions.open_count++ == 0)
+		{
+			CALLGRIND_TOGGLE_COLLECT;
+		}
+
+		// Read the clock last, so the bookkeeping above is not timed.
+
+		Start &start       = open[id];
+		start.instructions = read_instructions();
+		start.ns           = now_ns();
+	}
+
+	/**
+	 * @brief Ends a run of a region and records it.
+	 * Throws an error message if the region is not being run.
+	 * @param id The id of the region.
+	 */
+	void
+	end(uint64_t id)
+	{
+		uint64_t end_ns           = now_ns();
+		uint64_t end_instructions = read_instructions();
+		auto start                = open.find(id);
+
+		if (start == open.end())
+		{
+			throw "BENCH_END of region " + std::to_string(id) + ", which was not begun\n";
+		}
+
+		if (--regions.open_count == 0)
+		{
+			CALLGRIND_TOGGLE_COLLECT;
+		}
+
+		uint64_t instructions = end_instructions == UINT64_MAX
+				|| start->second.instructions == UINT64_MAX
+			? UINT64_MAX
+			: end_instructions - start->second.instructions;
+
+		regions.record(id, end_ns - start->second.ns, instructions);
+		open.erase(start);
+	}
+};
+
+#endif
@@ -0,0 +1,355 @@
+#ifndef TEA_BUILTINS_HEADER
+#define TEA_BUILTINS_HEADER
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "Executable/builtin-names.hpp"
+#include "VM/placement.hpp"
+
+// Runtime implementations of the builtin libc functions.
+// Guest pointers are host pointers, so they are passed through as-is.
+// All integers are widened to 64 bits by the caller, according to the
+// parameter types of the declaration in the program.
+// Functions that write to a file descriptor flush the VM output first,
+// so their output is ordered with the output of PRINT_CHAR.
+
+static void *
+builtin_malloc(uint64_t size)
+{
+	void *block = malloc(size);
+	placement::place_heap_block(block, size);
+	return block;
+}
+
+static void *
+builtin_calloc(uint64_t nmemb, uint64_t size)
+{
+	void *block = calloc(nmemb, size);
+	placement::place_heap_block(block, nmemb * size);
+	return block;
+}
+
+static void *
+builtin_realloc(void *ptr, uint64_t size)
+{
+	void *block = realloc(ptr, size);
+	placement::place_heap_block(block, size);
+	return block;
+}
+
+static void
+builtin_free(void *ptr)
+{
+	free(ptr);
+}
+
+static void *
+builtin_memcpy(void *dest, const void *src, uint64_t n)
+{
+	return memcpy(dest, src, n);
+}
+
+static void *
+builtin_memmove(void *dest, const void *src, uint64_t n)
+{
+	return memmove(dest, src, n);
+}
+
+static void *
+builtin_memset(void *s, int64_t c, uint64_t n)
+{
+	return memset(s, c, n);
+}
+
+static int64_t
+builtin_memcmp(const void *s1, const void *s2, uint64_t n)
+{
+	return memcmp(s1, s2, n);
+}
+
+static const void *
+builtin_memchr(const void *s, int64_t c, uint64_t n)
+{
+	return memchr(s, c, n);
+}
+
+static uint64_t
+builtin_strlen(const char *s)
+{
+	return strlen(s);
+}
+
+static uint64_t
+builtin_strnlen(const char *s, uint64_t n)
+{
+	return strnlen(s, n);
+}
+
+static int64_t
+builtin_strcmp(const char *s1, const char *s2)
+{
+	return strcmp(s1, s2);
+}
+
+static int64_t
+builtin_strncmp(const char *s1, const char *s2, uint64_t n)
+{
+	return strncmp(s1, s2, n);
+}
+
+static char *
+builtin_strcpy(char *dest, const char *src)
+{
+	return strcpy(dest, src);
+}
+
+static char *
+builtin_strncpy(char *dest, const char *src, uint64_t n)
+{
+	return strncpy(dest, src, n);
+}
+
+static char *
+builtin_strcat(char *dest, const char *src)
+{
+	return strcat(dest, src);
+}
+
+static char *
+builtin_strncat(char *dest, const char *src, uint64_t n)
+{
+	return strncat(dest, src, n);
+}
+
+static const char *
+builtin_strchr(const char *s, int64_t c)
+{
+	return strchr(s, c);
+}
+
+static const char *
+builtin_strrchr(const char *s, int64_t c)
+{
+	return strrchr(s, c);
+}
+
+static const char *
+builtin_strstr(const char *haystack, const char *needle)
+{
+	return strstr(haystack, needle);
+}
+
+static char *
+builtin_strdup(const char *s)
+{
+	return strdup(s);
+}
+
+static char *
+builtin_strndup(const char *s, uint64_t n)
+{
+	return strndup(s, n);
+}
+
+static int64_t
+builtin_strtol(const char *nptr, char **endptr, int64_t base)
+{
+	return strtoll(nptr, endptr, base);
+}
+
+static uint64_t
+builtin_strtoul(const char *nptr, char **endptr, int64_t base)
+{
+	return strtoull(nptr, endptr, base);
+}
+
+static int64_t
+builtin_atoi(const char *nptr)
+{
+	return atoll(nptr);
+}
+
+static int64_t
+builtin_abs(int64_t x)
+{
+	return x < 0 ? -x : x;
+}
+
+static char *
+builtin_getenv(const char *name)
+{
+	return getenv(name);
+}
+
+static int *
+builtin_errno_location()
+{
+	return &errno;
+}
+
+static const char *
+builtin_strerror(int64_t errnum)
+{
+	return strerror(errnum);
+}
+
+static void
+builtin_perror(const char *s)
+{
+	fflush(stdout);
+	perror(s);
+}
+
+// Programs declare open() without its variadic mode parameter,
+// so files are created with the default mode, masked by the umask.
+static int64_t
+builtin_open(const char *file, int64_t oflag)
+{
+	return open(file, oflag, 0666);
+}
+
+static int64_t
+builtin_close(int64_t fd)
+{
+	return close(fd);
+}
+
+static int64_t
+builtin_read(int64_t fd, void *buf, uint64_t n)
+{
+	return read(fd, buf, n);
+}
+
+static int64_t
+builtin_write(int64_t fd, const void *buf, uint64_t n)
+{
+	fflush(stdout);
+	return write(fd, buf, n);
+}
+
+static int64_t
+builtin_lseek(int64_t fd, int64_t offset, int64_t whence)
+{
+	return lseek(fd, offset, whence);
+}
+
+static int64_t
+builtin_isatty(int64_t fd)
+{
+	return isatty(fd);
+}
+
+static int64_t
+builtin_puts(const char *s)
+{
+	return puts(s);
+}
+
+static int64_t
+builtin_putchar(int64_t c)
+{
+	return putchar(c);
+}
+
+// The arguments of the program, terminated by a null pointer like the
+// argv of C. The first argument is the path of the executable.
+// Set by the VM before the program runs.
+std::vector<char *> program_args = { nullptr };
+
+static int64_t
+builtin_argc()
+{
+	return program_args.size() - 1;
+}
+
+static char **
+builtin_argv()
+{
+	return program_args.data();
+}
+
+/**
+ * @brief Thrown by the exit builtin. The CPU catches it and stops the
+ * program with the exit status, so the host process keeps running.
+ */
+struct ProgramExit
+{
+	// The exit status that was passed to exit().
+	int64_t status;
+};
+
+static void
+builtin_exit(int64_t status)
+{
+	throw ProgramExit { status };
+}
+
+static void
+builtin_abort()
+{
+	throw std::string("Program aborted\n");
+}
+
+/**
+ * @brief The runtime implementations of the builtin functions,
+ * keyed like `builtin_arities`.
+ */
+std::unordered_map<std::string, void *> builtin_addresses = {
+	{ "$I_malloc", (void *) builtin_malloc },
+	{ "$I_calloc", (void *) builtin_calloc },
+	{ "$I_realloc", (void *) builtin_realloc },
+	{ "$I_free", (void *) builtin_free },
+	{ "$I_memcpy", (void *) builtin_memcpy },
+	{ "$I_memmove", (void *) builtin_memmove },
+	{ "$I_memset", (void *) builtin_memset },
+	{ "$I_memcmp", (void *) builtin_memcmp },
+	{ "$I_memchr", (void *) builtin_memchr },
+	{ "$I_strlen", (void *) builtin_strlen },
+	{ "$I_strnlen", (void *) builtin_strnlen },
+	{ "$I_strcmp", (void *) builtin_strcmp },
+	{ "$I_strncmp", (void *) builtin_strncmp },
+	{ "$I_strcpy", (void *) builtin_strcpy },
+	{ "$I_strncpy", (void *) builtin_strncpy },
+	{ "$I_strcat", (void *) builtin_strcat },
+	{ "$I_strncat", (void *) builtin_strncat },
+	{ "$I_strchr", (void *) builtin_strchr },
+	{ "$I_strrchr", (void *) builtin_strrchr },
+	{ "$I_strstr", (void *) builtin_strstr },
+	{ "$I_strdup", (void *) builtin_strdup },
+	{ "$I_strndup", (void *) builtin_strndup },
+	{ "$I_strtol", (void *) builtin_strtol },
+	{ "$I_strtoll", (void *) builtin_strtol },
+	{ "$I_strtoul", (void *) builtin_strtoul },
+	{ "$I_strtoull", (void *) builtin_strtoul },
+	{ "$I_atoi", (void *) builtin_atoi },
+	{ "$I_atol", (void *) builtin_atoi },
+	{ "$I_abs", (void *) builtin_abs },
+	{ "$I_labs", (void *) builtin_abs },
+	{ "$I_getenv", (void *) builtin_getenv },
+	{ "$I___errno_location", (void *) builtin_errno_location },
+	{ "$I___error", (void *) builtin_errno_location },
+	{ "$I_strerror", (void *) builtin_strerror },
+	{ "$I_perror", (void *) builtin_perror },
+	{ "$I_open", (void *) builtin_open },
+	{ "$I_close", (void *) builtin_close },
+	{ "$I_read", (void *) builtin_read },
+	{ "$I_write", (void *) builtin_write },
+	{ "$I_lseek", (void *) builtin_lseek },
+	{ "$I_isatty", (void *) builtin_isatty },
+	{ "$I_puts", (void *) builtin_puts },
+	{ "$I_putchar", (void *) builtin_putchar },
+	{ "$I_exit", (void *) builtin_exit },
+	{ "$I_abort", (void *) builtin_abort },
+	{ BUILTIN_ARGC, (void *) builtin_argc },
+	{ BUILTIN_ARGV, (void *) builtin_argv },
+};
+
+#endif
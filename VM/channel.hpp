@@ -0,0 +1,331 @@
+#ifndef TEA_CHANNEL_HEADER
+#define TEA_CHANNEL_HEADER
+
+#include <atomic>
+#include <climits>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// The kinds of channels created by the CHAN_NEW instruction.
+
+// Any number of threads may send and receive.
+#define CHANNEL_MPMC 0
+
+// At most one thread sends and at most one thread receives at a time.
+#define CHANNEL_SPSC 1
+
+// The size of a cache line. Indices written by different threads
+// are kept on different cache lines, so they don't false-share.
+#define CHANNEL_CACHE_LINE 64
+
+// The number of times a blocking operation retries before it sleeps.
+#define CHANNEL_SPIN_COUNT 128
+
+/**
+ * @brief Sleeps while a futex word has a value.
+ * May return spuriously.
+ * @param word The futex word.
+ * @param value The value.
+ */
+static void
+futex_wait(std::atomic<uint32_t> &word, uint32_t value)
+{
+#ifdef __linux__
+	syscall(SYS_futex, &word, FUTEX_WAIT_PRIVATE, value, nullptr, nullptr, 0);
+#else
+	if (word.load() == value)
+	{
+		std::this_thread::yield();
+	}
+#endif
+}
+
+/**
+ * @brief Wakes all threads that sleep on a futex word.
+ * @param word The futex word.
+ */
+static void
+futex_wake_all(std::atomic<uint32_t> &word)
+{
+#ifdef __linux__
+	syscall(SYS_futex, &word, FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+#else
+	(void) word;
+#endif
+}
+
+/**
+ * @brief A bounded channel of 64-bit messages between guest threads,
+ * behind the CHAN_* instructions.
+ *
+ * The channel is a ring buffer in the style of Dmitry Vyukov's bounded
+ * queue. Every cell has a sequence number that tells whether it is free
+ * for the sender or full for the receiver of the current lap, so senders
+ * and receivers never touch each other's index. Multi-producer
+ * multi-consumer channels claim cells with a compare-and-swap on their
+ * index; single-producer single-consumer channels own their index and
+ * claim cells with a plain store.
+ *
+ * Blocking operations spin briefly, then sleep on a futex. The futex
+ * words count the sends and receives, and are only woken when a thread
+ * announced that it sleeps, so the fast path makes no syscalls.
+ */
+struct Channel
+{
+	/**
+	 * @brief A cell of the ring buffer.
+	 */
+	struct Cell
+	{
+		// The index of the send that may fill this cell, or that index
+		// plus one once the cell is full.
+		std::atomic<uint64_t> seq;
+
+		// The message.
+		uint64_t value;
+	};
+
+	// The index of the next send.
+	alignas(CHANNEL_CACHE_LINE) std::atomic<uint64_t> send_pos;
+
+	// The index of the next receive.
+	alignas(CHANNEL_CACHE_LINE) std::atomic<uint64_t> recv_pos;
+
+	// Incremented after every send. Receivers sleep on it.
+	alignas(CHANNEL_CACHE_LINE) std::atomic<uint32_t> sends;
+
+	// The number of receivers that sleep or are about to.
+	std::atomic<uint32_t> sleeping_receivers;
+
+	// Incremented after every receive. Senders sleep on it.
+	alignas(CHANNEL_CACHE_LINE) std::atomic<uint32_t> receives;
+
+	// The number of senders that sleep or are about to.
+	std::atomic<uint32_t> sleeping_senders;
+
+	// The cells. Read-only after construction, except for their contents.
+	alignas(CHANNEL_CACHE_LINE) std::unique_ptr<Cell[]> cells;
+
+	// The number of cells minus one. The number of cells is a power of two.
+	uint64_t mask;
+
+	// CHANNEL_MPMC or CHANNEL_SPSC.
+	uint64_t kind;
+
+	/**
+	 * @brief Creates a channel.
+	 * @param capacity The maximum number of unreceived messages.
+	 * Rounded up to a power of two of at least 2.
+	 * @param kind CHANNEL_MPMC or CHANNEL_SPSC.
+	 */
+	Channel(uint64_t capacity, uint64_t kind)
+		: send_pos(0), recv_pos(0), sends(0), sleeping_receivers(0),
+		  receives(0), sleeping_senders(0), kind(kind)
+	{
+		uint64_t size = 2;
+
+		while (size < capacity)
+		{
+			size *= 2;
+		}
+
+		cells.reset(new Cell[size]);
+		mask = size - 1;
+
+		for (uint64_t i = 0; i < size; i++)
+		{
+			cells[i].seq.store(i, std::memory_order_relaxed);
+		}
+	}
+
+	/**
+	 * @brief Claims an index for a cell.
+	 * @param pos The index to claim from.
+	 * @param expected The index that was read.
+	 * @returns Whether the index was claimed. On failure, `expected`
+	 * is updated to the current index.
+	 */
+	bool
+	claim(std::atomic<uint64_t> &pos, uint64_t &expected)
+	{
+		if (kind == CHANNEL_SPSC)
+		{
+			pos.store(expected + 1, std::memory_order_relaxed);
+			return true;
+		}
+
+		return pos.compare_exchange_weak(expected, expected + 1,
+			std::memory_order_relaxed);
+	}
+
+	/**
+	 * @brief Sends a message if the channel is not full.
+	 * @param value The message.
+	 * @returns Whether the message was sent.
+	 */
+	bool
+	try_send(uint64_t value)
+	{
+		uint64_t pos = send_pos.load(std::memory_order_relaxed);
+
+		while (true)
+		{
+			Cell &cell   = cells[pos & mask];
+			uint64_t seq = cell.seq.load(std::memory_order_acquire);
+			int64_t diff = (int64_t) (seq - pos);
+
+			if (diff == 0)
+			{
+				if (claim(send_pos, pos))
+				{
+					cell.value = value;
+					cell.seq.store(pos + 1, std::memory_order_release);
+					break;
+				}
+			}
+			else if (diff < 0)
+			{
+				// The cell still holds a message of the previous lap.
+
+				return false;
+			}
+			else
+			{
+				pos = send_pos.load(std::memory_order_relaxed);
+			}
+		}
+
+		sends.fetch_add(1);
+
+		if (sleeping_receivers.load() != 0)
+		{
+			futex_wake_all(sends);
+		}
+
+		return true;
+	}
+
+	/**
+	 * @brief Receives a message if the channel is not empty.
+	 * @param value The message is written here.
+	 * @returns Whether a message was received.
+	 */
+	bool
+	try_recv(uint64_t &value)
+	{
+		uint64_t pos = recv_pos.load(std::memory_order_relaxed);
+
+		while (true)
+		{
+			Cell &cell   = cells[pos & mask];
+			uint64_t seq = cell.seq.load(std::memory_order_acquire);
+			int64_t diff = (int64_t) (seq - (pos + 1));
+
+			if (diff == 0)
+			{
+				if (claim(recv_pos, pos))
+				{
+					value = cell.value;
+					cell.seq.store(pos + mask + 1, std::memory_order_release);
+					break;
+				}
+			}
+			else if (diff < 0)
+			{
+				// The cell was not filled yet.
+
+				return false;
+			}
+			else
+			{
+				pos = recv_pos.load(std::memory_order_relaxed);
+			}
+		}
+
+		receives.fetch_add(1);
+
+		if (sleeping_senders.load() != 0)
+		{
+			futex_wake_all(receives);
+		}
+
+		return true;
+	}
+
+	/**
+	 * @brief Sends a message, waits while the channel is full.
+	 * @param value The message.
+	 */
+	void
+	send(uint64_t value)
+	{
+		for (size_t i = 0; i < CHANNEL_SPIN_COUNT; i++)
+		{
+			if (try_send(value))
+			{
+				return;
+			}
+		}
+
+		while (true)
+		{
+			// Announce the sleep before the last attempt, so a receive
+			// after the attempt either wakes this thread or changes
+			// the futex word before it sleeps.
+
+			uint32_t seen = receives.load();
+			sleeping_senders.fetch_add(1);
+
+			if (try_send(value))
+			{
+				sleeping_senders.fetch_sub(1);
+				return;
+			}
+
+			futex_wait(receives, seen);
+			sleeping_senders.fetch_sub(1);
+		}
+	}
+
+	/**
+	 * @brief Receives a message, waits while the channel is empty.
+	 * @returns The message.
+	 */
+	uint64_t
+	recv()
+	{
+		uint64_t value;
+
+		for (size_t i = 0; i < CHANNEL_SPIN_COUNT; i++)
+		{
+			if (try_recv(value))
+			{
+				return value;
+			}
+		}
+
+		while (true)
+		{
+			uint32_t seen = sends.load();
+			sleeping_receivers.fetch_add(1);
+
+			if (try_recv(value))
+			{
+				sleeping_receivers.fetch_sub(1);
+				return value;
+			}
+
+			futex_wait(sends, seen);
+			sleeping_receivers.fetch_sub(1);
+		}
+	}
+};
+
+#endif
@@ -1,15 +1,34 @@
 #ifndef TEA_CPU_HEADER
 #define TEA_CPU_HEADER
 
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+
+#include "VM/aio.hpp"
+#include "VM/bench.hpp"
+#include "VM/channel.hpp"
+#include "VM/file-io.hpp"
+#include "VM/format.hpp"
+#include "VM/fuel.hpp"
+#include "VM/hash-map.hpp"
+#include "VM/hooks.hpp"
 #include "VM/memory.hpp"
+#include "VM/native.hpp"
+#include "VM/placement.hpp"
+#include "VM/superinstruction-rewriter.hpp"
 #include "Executable/executable.hpp"
 #include "Executable/byte-code.hpp"
 
 /**
  * @brief The class that represents a CPU of the virtual machine.
  * Contains methods to run an executable.
+ * @tparam Hooks The hooks that are called during execution, see `NoHooks`.
+ * Tools like the debugger and the profiler instantiate their own CPU type.
  */
-struct CPU
+template <typename Hooks>
+struct BasicCPU
 {
 	// ===== Program segment sizes =====
 
@@ -36,13 +55,117 @@ struct CPU
 	// A pointer to the top (end) of the stack.
 	uint8_t *stack_top;
 
-	// The number of general purpose registers (R_0, R_1, ...)
-#define GENERAL_PURPOSE_REGISTER_COUNT 16
-#define TOTAL_REGISTER_COUNT           GENERAL_PURPOSE_REGISTER_COUNT + 5
+	// The native functions imported by the executable.
+	// Indexed by the operand of the CALL_NATIVE instruction.
+	std::vector<NativeFunction> native_functions;
+
+	// Whether the program segment was allocated by this CPU.
+	// CPUs that share a program segment don't free it.
+	bool owns_program;
+
+	// ===== I/O =====
+
+	// Called for every character printed by the program.
+	// Characters are written to stdout if not set.
+	void (*print_char_callback)(void *io_context, uint8_t c) = nullptr;
+
+	// Called for every character read by the program.
+	// Must return EOF at the end of the input.
+	// Characters are read from stdin if not set.
+	int (*get_char_callback)(void *io_context) = nullptr;
+
+	// Passed to the I/O callbacks.
+	void *io_context = nullptr;
+
+	// The asynchronous I/O of the program. Created on the first AIO_SUBMIT.
+	std::unique_ptr<AsyncIO> aio;
+
+	// ===== Threads =====
+
+	/**
+	 * @brief A guest thread, started by the THREAD_SPAWN instruction.
+	 * The handle of the thread in the program is a pointer to this struct.
+	 */
+	struct Thread
+	{
+		// The CPU that runs the thread.
+		std::unique_ptr<BasicCPU> cpu;
+
+		// The host thread.
+		std::thread thread;
+
+		// The return value of the thread function.
+		uint64_t result = 0;
+
+		// The error message if the thread crashed, empty otherwise.
+		std::string error;
+	};
+
+	/**
+	 * @brief The guest threads of a program that were not joined yet.
+	 * Shared by the main CPU and the CPUs of all its threads.
+	 */
+	struct ThreadGroup
+	{
+		// Protects `threads`.
+		std::mutex mutex;
+
+		// The threads that were not joined yet.
+		std::unordered_set<Thread *> threads;
+	};
+
+	// The guest threads of the program. Created on the first THREAD_SPAWN.
+	std::shared_ptr<ThreadGroup> thread_group;
+
+	// Whether this CPU runs a guest thread. Guest threads have no static
+	// data of their own, their stack top register points at the static
+	// data of the main CPU, so they share its global variables.
+	bool is_guest_thread = false;
+
+	// ===== Benchmarks =====
+
+	// The benchmark regions of the program. Created on the first
+	// BENCH_BEGIN or THREAD_SPAWN, and shared with all threads.
+	std::shared_ptr<BenchRegions> bench_regions;
+
+	// Times the benchmark regions run by this CPU.
+	// Created on its first BENCH_BEGIN.
+	std::unique_ptr<BenchTimer> bench_timer;
+
+	// ===== Hooks =====
+
+	// The hooks that are called during execution.
+	Hooks hooks;
+
+	// ===== Fuel =====
+
+	// Whether fuel metering is enabled.
+	// Can only be set if the hooks meter fuel.
+	bool fuel_enabled = false;
+
+	// The remaining fuel.
+	uint64_t fuel = 0;
+
+	// The fuel costs of the program. Shared by CPUs that share a program.
+	std::shared_ptr<const FuelCosts> fuel_costs;
+
+	// Set when the program stopped because it ran out of fuel.
+	bool out_of_fuel = false;
+
+	// The address of the instruction that ran out of fuel.
+	// Execution resumes there when fuel is added.
+	uint8_t *fuel_trap_addr = nullptr;
+
+	// ===== Exit =====
+
+	// Set when the program stopped because it called exit().
+	// The exit status is stored in R_RET.
+	bool exited = false;
 
 	// ===== Registers =====
 
 	// An array that contains the registers of the virtual machine.
+	// See `TOTAL_REGISTER_COUNT` in Executable/byte-code.hpp.
 	uint64_t regs[TOTAL_REGISTER_COUNT];
 
 	// === General purpose registers ===
@@ -161,14 +284,20 @@ struct CPU
 		return (uint8_t *) regs[R_FRAME_PTR];
 	}
 
-	// Return value register
+	// Return value registers
+	// Small class values are returned in R_RET, R_RET_1, ... in order
+	// of their words. The return value registers are not saved in stack
+	// frames, so they survive the RETURN instruction.
 
-#define R_RET GENERAL_PURPOSE_REGISTER_COUNT + 4
+#define R_RET   GENERAL_PURPOSE_REGISTER_COUNT + 4
+#define R_RET_1 GENERAL_PURPOSE_REGISTER_COUNT + 5
+#define R_RET_2 GENERAL_PURPOSE_REGISTER_COUNT + 6
+#define R_RET_3 GENERAL_PURPOSE_REGISTER_COUNT + 7
 
 // The size of a stack frame. This consists of the old values of the
 // general purpose registers, the old instruction pointer
 // (used as return address), and the size parameters in bytes.
-#define STACK_FRAME_SIZE (GENERAL_PURPOSE_REGISTER_COUNT + 5) * 8
+#define STACK_FRAME_SIZE (GENERAL_PURPOSE_REGISTER_COUNT + 2) * 8
 
 	// Holds the address of the current instruction being executed.
 	uint8_t *cur_instr_addr;
@@ -229,6 +358,12 @@ struct CPU
 
 		case R_RET:
 			return "R_RET";
+		case R_RET_1:
+			return "R_RET_1";
+		case R_RET_2:
+			return "R_RET_2";
+		case R_RET_3:
+			return "R_RET_3";
 		}
 	}
 
@@ -242,22 +377,178 @@ struct CPU
 	/**
 	 * @brief Constructs a new CPU object.
 	 * Creates RAM and initialises locations and registers.
+	 * Resolves the native functions imported by the executable,
+	 * throws an error message if one of them cannot be resolved.
 	 * @param executable A reference to the executable to run.
 	 * @param stack_size The stack size of the virtual machine.
 	 */
-	CPU(Executable &executable, size_t stack_size)
+	BasicCPU(Executable &executable, size_t stack_size)
 		: static_data_size(executable.static_data_size),
 		  program_size(executable.program_size),
-		  stack_size(stack_size)
+		  stack_size(stack_size),
+		  native_functions(NativeFunction::resolve_all(executable.native_imports)),
+		  owns_program(true)
 	{
+		check_executable(executable, stack_size);
+
 		// Initialise the memory regions
 
 		// 1. Program region, contains the executable code.
-		uint8_t *program_region = memory::allocate(program_size);
+		uint8_t *program_region = placement::allocate_region(program_size);
 		memcpy(program_region, executable.data + static_data_size, program_size);
 
-		// 2. Stack region, contains the stack, prepended by the static data.
-		uint8_t *stack_region = memory::allocate(static_data_size + stack_size);
+		if constexpr (Hooks::USES_SUPERINSTRUCTIONS)
+		{
+			rewrite_superinstructions(program_region, program_size);
+		}
+
+		init(executable, program_region, stack_size);
+	}
+
+	/**
+	 * @brief Constructs a new CPU object that shares the program segment
+	 * and the resolved native functions with other CPUs.
+	 * Only the stack region is created.
+	 * @param executable A reference to the executable to run.
+	 * @param program_region The program segment of the executable.
+	 * Must outlive the CPU. It is not rewritten to use superinstructions,
+	 * that is left to the owner of the program segment.
+	 * @param native_functions The resolved native functions of the executable.
+	 * @param stack_size The stack size of the virtual machine.
+	 */
+	BasicCPU(Executable &executable, uint8_t *program_region,
+		const std::vector<NativeFunction> &native_functions, size_t stack_size)
+		: static_data_size(executable.static_data_size),
+		  program_size(executable.program_size),
+		  stack_size(stack_size),
+		  native_functions(native_functions),
+		  owns_program(false)
+	{
+		check_executable(executable, stack_size);
+		init(executable, program_region, stack_size);
+	}
+
+	/**
+	 * @brief Constructs a new CPU object for a guest thread.
+	 * Shares the program segment, the native functions, the global
+	 * variables and the I/O callbacks with another CPU.
+	 * Only the stack is created.
+	 * @param parent The CPU that starts the thread. Its global variables
+	 * must outlive the thread.
+	 */
+	BasicCPU(BasicCPU &parent)
+		: static_data_size(0),
+		  program_size(parent.program_size),
+		  stack_size(parent.stack_size),
+		  native_functions(parent.native_functions),
+		  owns_program(false),
+		  print_char_callback(parent.print_char_callback),
+		  get_char_callback(parent.get_char_callback),
+		  io_context(parent.io_context),
+		  thread_group(parent.thread_group),
+		  is_guest_thread(true),
+		  bench_regions(parent.bench_regions)
+	{
+		program_location     = parent.program_location;
+		static_data_location = placement::allocate_region(stack_size);
+		stack_top            = static_data_location;
+		stack_bottom         = stack_top + stack_size;
+
+		set_instr_ptr(program_location + program_size);
+		set_stack_ptr(stack_top);
+		set_frame_ptr(stack_top);
+		set_stack_top_ptr(parent.get_stack_top_ptr());
+		regs[R_RET] = 0;
+	}
+
+	// A CPU owns its stack region, so it cannot be copied.
+	BasicCPU(const BasicCPU &) = delete;
+	BasicCPU &operator=(const BasicCPU &) = delete;
+
+	/**
+	 * @brief Destroys the CPU object.
+	 * Frees the stack region, and the program region if it is owned.
+	 */
+	~BasicCPU()
+	{
+		// Pending asynchronous requests may still write to the stack,
+		// and threads that were not joined still use the global variables.
+
+		aio.reset();
+
+		// Threads that are still running can spawn more threads, so the
+		// threads are taken out of the group under its lock until none are left.
+
+		if (!is_guest_thread && thread_group != nullptr)
+		{
+			while (true)
+			{
+				std::unordered_set<Thread *> threads;
+
+				{
+					std::lock_guard<std::mutex> lock(thread_group->mutex);
+					threads.swap(thread_group->threads);
+				}
+
+				if (threads.empty())
+				{
+					break;
+				}
+
+				for (Thread *thread : threads)
+				{
+					thread->thread.join();
+					delete thread;
+				}
+			}
+		}
+
+		placement::free_region(static_data_location, static_data_size + stack_size);
+
+		if (owns_program)
+		{
+			placement::free_region(program_location, program_size);
+		}
+	}
+
+	/**
+	 * @brief Checks that an executable can be run, before any memory is
+	 * allocated for it. The handlers in `execute()` trust the program, so
+	 * it must be verified, see `Executable::verify()`. Executables that
+	 * were not loaded from a file are verified here.
+	 * Throws an error message if the executable is invalid, or if it
+	 * allocates more stack at once than the stack can hold.
+	 * @param executable A reference to the executable to run.
+	 * @param stack_size The stack size of the virtual machine.
+	 */
+	static void
+	check_executable(Executable &executable, size_t stack_size)
+	{
+		if (!executable.verified)
+		{
+			executable.verify("in memory");
+		}
+
+		if (executable.max_stack_allocation > stack_size)
+		{
+			throw "The program allocates " + std::to_string(executable.max_stack_allocation)
+				+ " bytes of stack at once, but the stack is only "
+				+ std::to_string(stack_size) + " bytes\n";
+		}
+	}
+
+	/**
+	 * @brief Creates the stack region and initialises
+	 * the common memory locations and the registers.
+	 * @param executable A reference to the executable to run.
+	 * @param program_region The program segment of the executable.
+	 * @param stack_size The stack size of the virtual machine.
+	 */
+	void
+	init(Executable &executable, uint8_t *program_region, size_t stack_size)
+	{
+		// Stack region, contains the stack, prepended by the static data.
+		uint8_t *stack_region = placement::allocate_region(static_data_size + stack_size);
 		memcpy(stack_region, executable.data, static_data_size);
 
 		// Initialise the common memory locations
@@ -317,21 +608,25 @@ struct CPU
 	{
 		cur_instr_addr = get_instr_ptr();
 
-		Instruction instruction = (Instruction) fetch<uint16_t>();
+		Instruction instruction = fetch<Instruction>();
+		hooks.on_instruction(*this, instruction);
 
-#ifdef RESTORE_INSTRUCTION_POINTER_ON_THROW
-		try
+		if constexpr (Hooks::HANDLES_TRAPS)
 		{
-			execute(instruction);
+			try
+			{
+				execute(instruction);
+			}
+			catch (const std::string &err_message)
+			{
+				hooks.on_trap(*this, err_message);
+				throw;
+			}
 		}
-		catch (const std::string &err_message)
+		else
 		{
-			set_instr_ptr(cur_instr_addr);
-			throw err_message;
+			execute(instruction);
 		}
-#else
-		execute(instruction);
-#endif
 
 		return instruction;
 	}
@@ -348,6 +643,67 @@ struct CPU
 		}
 	}
 
+	/**
+	 * @brief Enables fuel metering. The program stops when it runs
+	 * out of fuel, see `consume_fuel()`.
+	 * @param fuel The initial amount of fuel.
+	 * @param costs The fuel costs of the program. Computed if not given.
+	 */
+	void
+	enable_fuel(uint64_t fuel, std::shared_ptr<const FuelCosts> costs = nullptr)
+	{
+		static_assert(Hooks::METERS_FUEL, "The hooks of this CPU don't meter fuel");
+
+		fuel_costs = costs != nullptr
+			? std::move(costs)
+			: std::make_shared<const FuelCosts>(program_location, program_size);
+		fuel_enabled = true;
+		this->fuel   = fuel;
+	}
+
+	/**
+	 * @brief Adds fuel. If the program ran out of fuel, it is resumed
+	 * at the instruction that ran out of fuel on the next `run()`.
+	 * @param amount The amount of fuel to add.
+	 */
+	void
+	add_fuel(uint64_t amount)
+	{
+		fuel += amount;
+
+		if (out_of_fuel)
+		{
+			out_of_fuel = false;
+			set_instr_ptr(fuel_trap_addr);
+		}
+	}
+
+	/**
+	 * @brief Consumes the fuel cost of the current instruction.
+	 * Only called by backward jumps and calls when fuel metering is
+	 * enabled. If there is not enough fuel, the instruction is not
+	 * executed: the instruction pointer is moved to the end of the
+	 * program, which makes `run()` return. The state of the program
+	 * is left intact, so it can be resumed with `add_fuel()`.
+	 * @returns True if the instruction can be executed.
+	 */
+	bool
+	consume_fuel()
+	{
+		uint32_t cost = fuel_costs->costs[cur_instr_addr - program_location];
+
+		if (fuel < cost)
+		{
+			out_of_fuel    = true;
+			fuel_trap_addr = cur_instr_addr;
+			set_instr_ptr(program_location + program_size);
+			return false;
+		}
+
+		fuel -= cost;
+		return true;
+	}
+
 	/**
 	 * @brief Fetches a value from the current instruction pointer.
 	 * Increments the instruction pointer by the size of the read.
@@ -393,69 +749,48 @@ struct CPU
 	/**
 	 * @brief Pushes a stack frame.
 	 * Executed when a function is called.
-	 * A stack frame consists of the old values of the four
-	 * general purpose registers,
-	 * the old instruction pointer (used as return address),
-	 * and the size parameters in bytes.
+	 * A stack frame consists of the old values of the
+	 * general purpose registers, the old instruction pointer
+	 * (used as return address) and the old frame pointer.
+	 * It is preceded by the size of the arguments in bytes.
+	 *
+	 * The general purpose registers lie next to each other in `regs`,
+	 * in the order they are pushed in, so they are copied in one go.
+	 * The stack pointer is kept in a local until the frame is written,
+	 * instead of being updated in `regs` for every value.
 	 */
 	void
 	push_stack_frame()
 	{
-		push(get_reg_by_id(R_0));
-		push(get_reg_by_id(R_1));
-		push(get_reg_by_id(R_2));
-		push(get_reg_by_id(R_3));
-		push(get_reg_by_id(R_4));
-		push(get_reg_by_id(R_5));
-		push(get_reg_by_id(R_6));
-		push(get_reg_by_id(R_7));
-		push(get_reg_by_id(R_8));
-		push(get_reg_by_id(R_9));
-		push(get_reg_by_id(R_10));
-		push(get_reg_by_id(R_11));
-		push(get_reg_by_id(R_12));
-		push(get_reg_by_id(R_13));
-		push(get_reg_by_id(R_14));
-		push(get_reg_by_id(R_15));
-		push(get_instr_ptr());
-		push(get_frame_ptr());
-
-		set_frame_ptr(get_stack_ptr());
+		uint8_t *sp = get_stack_ptr();
+
+		memcpy(sp, &regs[R_0], GENERAL_PURPOSE_REGISTER_COUNT * 8);
+		sp += GENERAL_PURPOSE_REGISTER_COUNT * 8;
+		memory::set(sp, get_instr_ptr());
+		memory::set(sp + 8, get_frame_ptr());
+		sp += 16;
+
+		set_stack_ptr(sp);
+		set_frame_ptr(sp);
 	}
 
 	/**
-	 * @brief Pops a stack frame.
+	 * @brief Pops a stack frame, see `push_stack_frame()`.
 	 * Executed when a function returns.
-	 * A stack frame consists of the old values of the four
-	 * general purpose registers,
-	 * the old instruction pointer (used as return address),
-	 * and the size parameters in bytes.
+	 * Also pops the arguments and their size.
 	 */
 	void
 	pop_stack_frame()
 	{
-		set_stack_ptr(get_frame_ptr());
-
-		set_frame_ptr(pop<uint8_t *>());
-		set_instr_ptr(pop<uint8_t *>());
-		set_reg_by_id(R_15, pop<uint64_t>());
-		set_reg_by_id(R_14, pop<uint64_t>());
-		set_reg_by_id(R_13, pop<uint64_t>());
-		set_reg_by_id(R_12, pop<uint64_t>());
-		set_reg_by_id(R_11, pop<uint64_t>());
-		set_reg_by_id(R_10, pop<uint64_t>());
-		set_reg_by_id(R_9, pop<uint64_t>());
-		set_reg_by_id(R_8, pop<uint64_t>());
-		set_reg_by_id(R_7, pop<uint64_t>());
-		set_reg_by_id(R_6, pop<uint64_t>());
-		set_reg_by_id(R_5, pop<uint64_t>());
-		set_reg_by_id(R_4, pop<uint64_t>());
-		set_reg_by_id(R_3, pop<uint64_t>());
-		set_reg_by_id(R_2, pop<uint64_t>());
-		set_reg_by_id(R_1, pop<uint64_t>());
-		set_reg_by_id(R_0, pop<uint64_t>());
-
-		regs[R_STACK_PTR] -= pop<uint64_t>(); // Args size
+		uint8_t *sp = get_frame_ptr() - 16;
+
+		set_frame_ptr(memory::get<uint8_t *>(sp + 8));
+		set_instr_ptr(memory::get<uint8_t *>(sp));
+		sp -= GENERAL_PURPOSE_REGISTER_COUNT * 8;
+		memcpy(&regs[R_0], sp, GENERAL_PURPOSE_REGISTER_COUNT * 8);
+		sp -= 8;
+
+		set_stack_ptr(sp - memory::get<uint64_t>(sp)); // Args size
 	}
 
 	/**
@@ -466,15 +801,249 @@ struct CPU
 	void
 	jump_instruction_p(int64_t offset)
 	{
+		if constexpr (Hooks::METERS_FUEL)
+		{
+			if (offset <= 0 && fuel_enabled && !consume_fuel())
+			{
+				return;
+			}
+		}
+
 		set_instr_ptr(cur_instr_addr + offset);
 	}
 
+	/**
+	 * @returns The timer of the benchmark regions run by this CPU.
+	 * Creates the timer, and the regions, if they don't exist yet.
+	 */
+	BenchTimer &
+	get_bench_timer()
+	{
+		if (bench_timer == nullptr)
+		{
+			if (bench_regions == nullptr)
+			{
+				bench_regions = std::make_shared<BenchRegions>();
+			}
+
+			bench_timer = std::make_unique<BenchTimer>(*bench_regions);
+		}
+
+		return *bench_timer;
+	}
+
+	/**
+	 * @brief Starts a guest thread that calls a function.
+	 * The function takes a single 64-bit argument and returns
+	 * a 64-bit value, which is collected by `join_thread()`.
+	 * @param function A pointer to the function.
+	 * @param arg The argument of the function.
+	 * @returns The thread.
+	 */
+	Thread *
+	spawn_thread(uint8_t *function, uint64_t arg)
+	{
+		if (thread_group == nullptr)
+		{
+			thread_group = std::make_shared<ThreadGroup>();
+		}
+
+		// The thread adds its benchmark regions to ours.
+
+		if (bench_regions == nullptr)
+		{
+			bench_regions = std::make_shared<BenchRegions>();
+		}
+
+		Thread *thread = new Thread;
+		thread->cpu    = std::make_unique<BasicCPU>(*this);
+		BasicCPU &cpu  = *thread->cpu;
+
+		// Call the function like the CALL instruction does, with the end
+		// of the program as return address, so `run()` returns with it.
+
+		cpu.push<uint64_t>(arg);
+		cpu.push<uint64_t>(sizeof(arg));
+		cpu.push_stack_frame();
+		cpu.set_instr_ptr(function);
+
+		thread->thread = std::thread([thread]()
+		{
+			try
+			{
+				thread->cpu->run();
+				thread->result = thread->cpu->regs[R_RET];
+			}
+			catch (const std::string &err_message)
+			{
+				thread->error = err_message;
+			}
+		});
+
+		// The thread is only added once it is started,
+		// so the destructor never joins a thread that has not started yet.
+
+		{
+			std::lock_guard<std::mutex> lock(thread_group->mutex);
+			thread_group->threads.insert(thread);
+		}
+
+		return thread;
+	}
+
+	/**
+	 * @brief Waits for a guest thread to finish and frees it.
+	 * Throws an error message if the handle is null, if the thread
+	 * was already joined, or if the thread crashed.
+	 * @param handle The handle of the thread.
+	 * @returns The return value of the thread function.
+	 */
+	uint64_t
+	join_thread(uint64_t handle)
+	{
+		Thread *thread = (Thread *) handle;
+
+		if (thread == nullptr || thread_group == nullptr)
+		{
+			throw std::string("Join of a null thread handle\n");
+		}
+
+		// Take the thread out of the group first, so it is not
+		// joined again by another thread or by the destructor.
+
+		{
+			std::lock_guard<std::mutex> lock(thread_group->mutex);
+
+			if (thread_group->threads.erase(thread) == 0)
+			{
+				throw std::string("Join of a thread that was already joined\n");
+			}
+		}
+
+		std::unique_ptr<Thread> joined(thread);
+		joined->thread.join();
+
+		if (!joined->error.empty())
+		{
+			throw "Guest thread crashed: " + joined->error;
+		}
+
+		return joined->result;
+	}
+
+	/**
+	 * @param reg_id The id of a register that holds a channel handle.
+	 * @returns The channel. Throws an error message if the handle is null.
+	 */
+	Channel *
+	get_channel_by_reg_id(uint8_t reg_id)
+	{
+		Channel *channel = (Channel *) get_reg_by_id(reg_id);
+
+		if (channel == nullptr)
+		{
+			throw std::string("Channel operation on a null channel handle\n");
+		}
+
+		return channel;
+	}
+
+	/**
+	 * @brief Writes characters to the output of the program.
+	 * @param data The characters.
+	 * @param len The number of characters.
+	 */
+	void
+	write_output(const char *data, size_t len)
+	{
+		hooks.on_io(*this, len, true);
+
+		if (print_char_callback == nullptr)
+		{
+			fwrite(data, 1, len, stdout);
+			return;
+		}
+
+		for (size_t i = 0; i < len; i++)
+		{
+			print_char_callback(io_context, data[i]);
+		}
+	}
+
+	/**
+	 * @brief Reads characters from the input callback of the program,
+	 * up to the end of the input.
+	 * @param buf The buffer to read into.
+	 * @param len The maximum number of characters to read.
+	 * @returns The number of read characters.
+	 */
+	uint64_t
+	read_input(uint8_t *buf, uint64_t len)
+	{
+		uint64_t n = 0;
+
+		while (n < len)
+		{
+			int c = get_char_callback(io_context);
+
+			if (c == EOF)
+			{
+				break;
+			}
+
+			buf[n++] = c;
+		}
+
+		hooks.on_io(*this, n, false);
+		return n;
+	}
+
+	/**
+	 * @brief Truncates the value of a register to an integer size.
+	 * @param reg_id The id of the register.
+	 * @param size The byte size of the integer.
+	 * @param is_signed Whether the integer is sign-extended.
+	 * @returns The value extended to 64 bits.
+	 */
+	uint64_t
+	get_int_by_reg_id(uint8_t reg_id, uint8_t size, bool is_signed)
+	{
+		uint64_t value = get_reg_by_id(reg_id);
+
+		if (size >= 8)
+		{
+			return value;
+		}
+
+		uint8_t shift = 64 - size * 8;
+
+		return is_signed ? (uint64_t) ((int64_t) (value << shift) >> shift)
+				 : value << shift >> shift;
+	}
+
+	/**
+	 * @param reg_id The id of a register that holds a map handle.
+	 * @returns The map. Throws an error message if the handle is null.
+	 */
+	HashMap *
+	get_map_by_reg_id(uint8_t reg_id)
+	{
+		HashMap *map = (HashMap *) get_reg_by_id(reg_id);
+
+		if (map == nullptr)
+		{
+			throw std::string("Map operation on a null map handle\n");
+		}
+
+		return map;
+	}
+
 	/**
 	 * @brief Executes an instruction.
 	 * @param instruction The instruction to execute.
 	 */
 	void
-	execute(uint16_t instruction)
+	execute(uint8_t instruction)
 	{
 		// Giant switch statement for all instructions.
 		// If you're unsure about what exactly an instruction
@@ -495,6 +1064,22 @@ struct CPU
 			break;
 		}
 
+		case MOVE_LIT_8:
+		{
+			int8_t lit     = fetch<int8_t>();
+			uint8_t reg_id = fetch<uint8_t>();
+			set_reg_by_id(reg_id, (int64_t) lit);
+			break;
+		}
+
+		case MOVE_LIT_32:
+		{
+			int32_t lit    = fetch<int32_t>();
+			uint8_t reg_id = fetch<uint8_t>();
+			set_reg_by_id(reg_id, (int64_t) lit);
+			break;
+		}
+
 		case MOVE:
 		{
 			uint8_t reg_id_1 = fetch<uint8_t>();
@@ -509,6 +1094,7 @@ struct CPU
 			uint8_t reg_id_1 = fetch<uint8_t>();
 			uint8_t reg_id_2 = fetch<uint8_t>();
 			uint8_t *address = (uint8_t *) get_reg_by_id(reg_id_1);
+			hooks.on_memory_access(*this, address, sizeof(uint8_t), false);
 			uint8_t value    = memory::get<uint8_t>(address);
 			set_reg_by_id(reg_id_2, value);
 			break;
@@ -519,6 +1105,7 @@ struct CPU
 			uint8_t reg_id_1 = fetch<uint8_t>();
 			uint8_t reg_id_2 = fetch<uint8_t>();
 			uint8_t *address = (uint8_t *) get_reg_by_id(reg_id_1);
+			hooks.on_memory_access(*this, address, sizeof(uint16_t), false);
 			uint16_t value   = memory::get<uint16_t>(address);
 			set_reg_by_id(reg_id_2, value);
 			break;
@@ -529,6 +1116,7 @@ struct CPU
 			uint8_t reg_id_1 = fetch<uint8_t>();
 			uint8_t reg_id_2 = fetch<uint8_t>();
 			uint8_t *address = (uint8_t *) get_reg_by_id(reg_id_1);
+			hooks.on_memory_access(*this, address, sizeof(uint32_t), false);
 			uint32_t value   = memory::get<uint32_t>(address);
 			set_reg_by_id(reg_id_2, value);
 			break;
@@ -539,6 +1127,7 @@ struct CPU
 			uint8_t reg_id_1 = fetch<uint8_t>();
 			uint8_t reg_id_2 = fetch<uint8_t>();
 			uint8_t *address = (uint8_t *) get_reg_by_id(reg_id_1);
+			hooks.on_memory_access(*this, address, sizeof(uint64_t), false);
 			uint64_t value   = memory::get<uint64_t>(address);
 			set_reg_by_id(reg_id_2, value);
 			break;
@@ -549,6 +1138,7 @@ struct CPU
 			uint8_t reg_id_1 = fetch<uint8_t>();
 			uint8_t reg_id_2 = fetch<uint8_t>();
 			uint8_t *address = (uint8_t *) get_reg_by_id(reg_id_2);
+			hooks.on_memory_access(*this, address, sizeof(uint8_t), true);
 			uint8_t value    = get_reg_by_id(reg_id_1);
 			memory::set<uint8_t>(address, value);
 			break;
@@ -559,6 +1149,7 @@ struct CPU
 			uint8_t reg_id_1 = fetch<uint8_t>();
 			uint8_t reg_id_2 = fetch<uint8_t>();
 			uint8_t *address = (uint8_t *) get_reg_by_id(reg_id_2);
+			hooks.on_memory_access(*this, address, sizeof(uint16_t), true);
 			uint16_t value   = get_reg_by_id(reg_id_1);
 			memory::set<uint16_t>(address, value);
 			break;
@@ -569,6 +1160,7 @@ struct CPU
 			uint8_t reg_id_1 = fetch<uint8_t>();
 			uint8_t reg_id_2 = fetch<uint8_t>();
 			uint8_t *address = (uint8_t *) get_reg_by_id(reg_id_2);
+			hooks.on_memory_access(*this, address, sizeof(uint32_t), true);
 			uint32_t value   = get_reg_by_id(reg_id_1);
 			memory::set<uint32_t>(address, value);
 			break;
@@ -579,6 +1171,7 @@ struct CPU
 			uint8_t reg_id_1 = fetch<uint8_t>();
 			uint8_t reg_id_2 = fetch<uint8_t>();
 			uint8_t *address = (uint8_t *) get_reg_by_id(reg_id_2);
+			hooks.on_memory_access(*this, address, sizeof(uint64_t), true);
 			uint64_t value   = get_reg_by_id(reg_id_1);
 			memory::set<uint64_t>(address, value);
 			break;
@@ -592,6 +1185,8 @@ struct CPU
 
 			uint8_t *src_address = (uint8_t *) get_reg_by_id(reg_id_src);
 			uint8_t *dst_address = (uint8_t *) get_reg_by_id(reg_id_dst);
+			hooks.on_memory_access(*this, src_address, n_bytes, false);
+			hooks.on_memory_access(*this, dst_address, n_bytes, true);
 
 			for (uint64_t i = 0; i < n_bytes; i++)
 			{
@@ -1626,14 +2221,14 @@ struct CPU
 
 		case JUMP:
 		{
-			int64_t offset = fetch<int64_t>();
+			int32_t offset = fetch<int32_t>();
 			jump_instruction_p(offset);
 			break;
 		}
 
 		case JUMP_IF_GT:
 		{
-			int64_t offset = fetch<int64_t>();
+			int32_t offset = fetch<int32_t>();
 			if (greater_flag)
 				jump_instruction_p(offset);
 			break;
@@ -1641,7 +2236,7 @@ struct CPU
 
 		case JUMP_IF_GEQ:
 		{
-			int64_t offset = fetch<int64_t>();
+			int32_t offset = fetch<int32_t>();
 			if (greater_flag | equal_flag)
 				jump_instruction_p(offset);
 			break;
@@ -1649,7 +2244,7 @@ struct CPU
 
 		case JUMP_IF_LT:
 		{
-			int64_t offset = fetch<int64_t>();
+			int32_t offset = fetch<int32_t>();
 			if (!greater_flag & !equal_flag)
 				jump_instruction_p(offset);
 			break;
@@ -1657,7 +2252,7 @@ struct CPU
 
 		case JUMP_IF_LEQ:
 		{
-			int64_t offset = fetch<int64_t>();
+			int32_t offset = fetch<int32_t>();
 			if (!greater_flag)
 				jump_instruction_p(offset);
 			break;
@@ -1665,7 +2260,7 @@ struct CPU
 
 		case JUMP_IF_EQ:
 		{
-			int64_t offset = fetch<int64_t>();
+			int32_t offset = fetch<int32_t>();
 			if (equal_flag)
 				jump_instruction_p(offset);
 			break;
@@ -1673,7 +2268,7 @@ struct CPU
 
 		case JUMP_IF_NEQ:
 		{
-			int64_t offset = fetch<int64_t>();
+			int32_t offset = fetch<int32_t>();
 			if (!equal_flag)
 				jump_instruction_p(offset);
 			break;
@@ -1745,15 +2340,48 @@ struct CPU
 
 		case CALL:
 		{
-			int64_t offset = fetch<int64_t>();
+			int32_t offset = fetch<int32_t>();
+
+			if constexpr (Hooks::METERS_FUEL)
+			{
+				if (fuel_enabled && !consume_fuel())
+				{
+					break;
+				}
+			}
+
 			push_stack_frame();
-			jump_instruction_p(offset);
+			set_instr_ptr(cur_instr_addr + offset);
+			hooks.on_call(*this, cur_instr_addr + offset);
 			break;
 		}
 
 		case RETURN:
 		{
 			pop_stack_frame();
+			hooks.on_return(*this);
+			break;
+		}
+
+		case CALL_NATIVE:
+		{
+			uint32_t import_id = fetch<uint32_t>();
+			regs[R_STACK_PTR] -= pop<uint64_t>(); // Args size
+
+			try
+			{
+				regs[R_RET] = native_functions[import_id].call(
+					(uint64_t *) get_stack_ptr());
+			}
+			catch (const ProgramExit &program_exit)
+			{
+				// Stop the program like it completed, see `run()`.
+
+				exited      = true;
+				regs[R_RET] = program_exit.status;
+				set_instr_ptr(program_location + program_size);
+			}
+
 			break;
 		}
 
@@ -1783,19 +2411,456 @@ struct CPU
 		{
 			uint8_t reg_id = fetch<uint8_t>();
 			uint64_t value = get_reg_by_id(reg_id);
-			putc(value, stdout);
+
+			if (print_char_callback != nullptr)
+				print_char_callback(io_context, value);
+			else
+				putc(value, stdout);
+
+			hooks.on_io(*this, 1, true);
 			break;
 		}
 
 		case GET_CHAR:
 		{
 			uint8_t reg_id = fetch<uint8_t>();
-			int16_t c      = getc(stdin);
+			int16_t c      = get_char_callback != nullptr
+				     ? get_char_callback(io_context)
+				     : getc(stdin);
 			set_reg_by_id(reg_id, c);
+			hooks.on_io(*this, c != EOF, false);
+			break;
+		}
+
+		case PRINT_U64:
+		{
+			uint8_t reg_id = fetch<uint8_t>();
+			uint8_t size   = fetch<uint8_t>();
+			char buf[FORMAT_BUFFER_SIZE];
+
+			write_output(buf, format::u64(buf, get_int_by_reg_id(reg_id, size, false)));
 			break;
 		}
+
+		case PRINT_I64:
+		{
+			uint8_t reg_id = fetch<uint8_t>();
+			uint8_t size   = fetch<uint8_t>();
+			char buf[FORMAT_BUFFER_SIZE];
+
+			write_output(buf, format::i64(buf, get_int_by_reg_id(reg_id, size, true)));
+			break;
+		}
+
+		case PRINT_F64:
+		{
+			uint8_t reg_id        = fetch<uint8_t>();
+			uint8_t precision_reg = fetch<uint8_t>();
+			uint8_t size          = fetch<uint8_t>();
+			uint64_t bits         = get_reg_by_id(reg_id);
+			double value;
+			char buf[FORMAT_BUFFER_SIZE];
+
+			if (size == 4)
+			{
+				uint32_t float_bits = bits;
+				float float_value;
+				memcpy(&float_value, &float_bits, 4);
+				value = float_value;
+			}
+			else
+			{
+				memcpy(&value, &bits, 8);
+			}
+
+			write_output(buf, format::f64(buf, value, get_reg_by_id(precision_reg)));
+			break;
+		}
+
+		case PRINT_HEX:
+		{
+			uint8_t reg_id = fetch<uint8_t>();
+			uint8_t size   = fetch<uint8_t>();
+			char buf[FORMAT_BUFFER_SIZE];
+
+			write_output(buf, format::hex(buf, get_int_by_reg_id(reg_id, size, false)));
+			break;
+		}
+
+		case PRINT_STR:
+		{
+			uint8_t reg_id  = fetch<uint8_t>();
+			const char *str = (const char *) get_reg_by_id(reg_id);
+
+			write_output(str, strlen(str));
+			break;
+		}
+
+		case MAP_NEW:
+		{
+			uint8_t reg_id = fetch<uint8_t>();
+			set_reg_by_id(reg_id, (uint64_t) new HashMap());
+			break;
+		}
+
+		case MAP_FREE:
+		{
+			uint8_t map_reg = fetch<uint8_t>();
+			delete get_map_by_reg_id(map_reg);
+			break;
+		}
+
+		case MAP_PUT:
+		{
+			uint8_t map_reg   = fetch<uint8_t>();
+			uint8_t key_reg   = fetch<uint8_t>();
+			uint8_t len_reg   = fetch<uint8_t>();
+			uint8_t value_reg = fetch<uint8_t>();
+
+			get_map_by_reg_id(map_reg)->put(get_reg_by_id(key_reg),
+				get_reg_by_id(len_reg), get_reg_by_id(value_reg));
+			break;
+		}
+
+		case MAP_GET:
+		{
+			uint8_t map_reg   = fetch<uint8_t>();
+			uint8_t key_reg   = fetch<uint8_t>();
+			uint8_t len_reg   = fetch<uint8_t>();
+			uint8_t value_reg = fetch<uint8_t>();
+
+			set_reg_by_id(value_reg, get_map_by_reg_id(map_reg)->get(
+				get_reg_by_id(key_reg), get_reg_by_id(len_reg)));
+			break;
+		}
+
+		case MAP_HAS:
+		{
+			uint8_t map_reg    = fetch<uint8_t>();
+			uint8_t key_reg    = fetch<uint8_t>();
+			uint8_t len_reg    = fetch<uint8_t>();
+			uint8_t result_reg = fetch<uint8_t>();
+
+			set_reg_by_id(result_reg, get_map_by_reg_id(map_reg)->has(
+				get_reg_by_id(key_reg), get_reg_by_id(len_reg)));
+			break;
+		}
+
+		case MAP_DEL:
+		{
+			uint8_t map_reg = fetch<uint8_t>();
+			uint8_t key_reg = fetch<uint8_t>();
+			uint8_t len_reg = fetch<uint8_t>();
+
+			get_map_by_reg_id(map_reg)->del(get_reg_by_id(key_reg),
+				get_reg_by_id(len_reg));
+			break;
+		}
+
+		case MAP_ITER:
+		{
+			uint8_t map_reg    = fetch<uint8_t>();
+			uint8_t cursor_reg = fetch<uint8_t>();
+			uint8_t key_reg    = fetch<uint8_t>();
+			uint8_t value_reg  = fetch<uint8_t>();
+
+			// The cursor is the index of the slot after the last entry,
+			// so a cursor of 0 means both "start" and "done".
+
+			HashMap *map = get_map_by_reg_id(map_reg);
+			size_t index = map->next(get_reg_by_id(cursor_reg));
+
+			if (index == map->capacity)
+			{
+				set_reg_by_id(cursor_reg, 0);
+				break;
+			}
+
+			set_reg_by_id(cursor_reg, index + 1);
+			set_reg_by_id(key_reg, map->slots[index].key);
+			set_reg_by_id(value_reg, map->slots[index].value);
+			break;
+		}
+
+		case FILE_OPEN:
+		{
+			uint8_t path_reg   = fetch<uint8_t>();
+			uint8_t mode_reg   = fetch<uint8_t>();
+			uint8_t result_reg = fetch<uint8_t>();
+
+			set_reg_by_id(result_reg, file_io::open(
+				(const char *) get_reg_by_id(path_reg), get_reg_by_id(mode_reg)));
+			break;
+		}
+
+		case FILE_READ:
+		{
+			uint8_t fd_reg     = fetch<uint8_t>();
+			uint8_t buf_reg    = fetch<uint8_t>();
+			uint8_t len_reg    = fetch<uint8_t>();
+			uint8_t result_reg = fetch<uint8_t>();
+			int64_t fd         = get_reg_by_id(fd_reg);
+			uint8_t *buf       = (uint8_t *) get_reg_by_id(buf_reg);
+			uint64_t len       = get_reg_by_id(len_reg);
+
+			if (fd == STDIN_FILENO && get_char_callback != nullptr)
+			{
+				set_reg_by_id(result_reg, read_input(buf, len));
+				break;
+			}
+
+			int64_t result = file_io::read(fd, buf, len);
+			set_reg_by_id(result_reg, result);
+			hooks.on_io(*this, std::max<int64_t>(result, 0), false);
+			break;
+		}
+
+		case FILE_WRITE:
+		{
+			uint8_t fd_reg     = fetch<uint8_t>();
+			uint8_t buf_reg    = fetch<uint8_t>();
+			uint8_t len_reg    = fetch<uint8_t>();
+			uint8_t result_reg = fetch<uint8_t>();
+			int64_t fd         = get_reg_by_id(fd_reg);
+			const char *buf    = (const char *) get_reg_by_id(buf_reg);
+			uint64_t len       = get_reg_by_id(len_reg);
+
+			// Writes to stdout go through the same buffer as
+			// the PRINT_* instructions, so they stay in order.
+
+			if (fd == STDOUT_FILENO)
+			{
+				write_output(buf, len);
+				set_reg_by_id(result_reg, len);
+				break;
+			}
+
+			int64_t result = file_io::write(fd, buf, len);
+			set_reg_by_id(result_reg, result);
+			hooks.on_io(*this, std::max<int64_t>(result, 0), true);
+			break;
+		}
+
+		case FILE_PREAD:
+		{
+			uint8_t fd_reg     = fetch<uint8_t>();
+			uint8_t buf_reg    = fetch<uint8_t>();
+			uint8_t len_reg    = fetch<uint8_t>();
+			uint8_t offset_reg = fetch<uint8_t>();
+			uint8_t result_reg = fetch<uint8_t>();
+
+			int64_t result = file_io::pread(get_reg_by_id(fd_reg),
+				(void *) get_reg_by_id(buf_reg), get_reg_by_id(len_reg),
+				get_reg_by_id(offset_reg));
+			set_reg_by_id(result_reg, result);
+			hooks.on_io(*this, std::max<int64_t>(result, 0), false);
+			break;
+		}
+
+		case FILE_SEEK:
+		{
+			uint8_t fd_reg     = fetch<uint8_t>();
+			uint8_t offset_reg = fetch<uint8_t>();
+			uint8_t whence_reg = fetch<uint8_t>();
+			uint8_t result_reg = fetch<uint8_t>();
+
+			set_reg_by_id(result_reg, file_io::seek(get_reg_by_id(fd_reg),
+				get_reg_by_id(offset_reg), get_reg_by_id(whence_reg)));
+			break;
+		}
+
+		case FILE_CLOSE:
+		{
+			uint8_t fd_reg     = fetch<uint8_t>();
+			uint8_t result_reg = fetch<uint8_t>();
+
+			set_reg_by_id(result_reg, file_io::close(get_reg_by_id(fd_reg)));
+			break;
+		}
+
+		case FILE_STAT:
+		{
+			uint8_t fd_reg     = fetch<uint8_t>();
+			uint8_t stat_reg   = fetch<uint8_t>();
+			uint8_t result_reg = fetch<uint8_t>();
+			uint64_t stat[FILE_STAT_FIELDS];
+			int64_t result = file_io::stat(get_reg_by_id(fd_reg), stat);
+
+			// The output values need not be aligned.
+
+			if (result == 0)
+			{
+				memcpy((void *) get_reg_by_id(stat_reg), stat, sizeof(stat));
+			}
+
+			set_reg_by_id(result_reg, result);
+			break;
+		}
+
+		case MMAP_FILE:
+		{
+			uint8_t fd_reg     = fetch<uint8_t>();
+			uint8_t len_reg    = fetch<uint8_t>();
+			uint8_t offset_reg = fetch<uint8_t>();
+			uint8_t result_reg = fetch<uint8_t>();
+
+			set_reg_by_id(result_reg, file_io::map(get_reg_by_id(fd_reg),
+				get_reg_by_id(len_reg), get_reg_by_id(offset_reg)));
+			break;
+		}
+
+		case MUNMAP_FILE:
+		{
+			uint8_t addr_reg   = fetch<uint8_t>();
+			uint8_t len_reg    = fetch<uint8_t>();
+			uint8_t result_reg = fetch<uint8_t>();
+
+			set_reg_by_id(result_reg, file_io::unmap(
+				(void *) get_reg_by_id(addr_reg), get_reg_by_id(len_reg)));
+			break;
+		}
+
+		case AIO_SUBMIT:
+		{
+			uint8_t op_reg     = fetch<uint8_t>();
+			uint8_t fd_reg     = fetch<uint8_t>();
+			uint8_t buf_reg    = fetch<uint8_t>();
+			uint8_t len_reg    = fetch<uint8_t>();
+			uint8_t offset_reg = fetch<uint8_t>();
+			uint8_t tag_reg    = fetch<uint8_t>();
+			uint8_t result_reg = fetch<uint8_t>();
+
+			if (aio == nullptr)
+			{
+				aio = std::make_unique<AsyncIO>();
+			}
+
+			set_reg_by_id(result_reg, aio->submit({ get_reg_by_id(op_reg),
+				(int64_t) get_reg_by_id(fd_reg), (uint8_t *) get_reg_by_id(buf_reg),
+				get_reg_by_id(len_reg), get_reg_by_id(offset_reg),
+				get_reg_by_id(tag_reg) }));
+			break;
+		}
+
+		case AIO_POLL:
+		{
+			uint8_t out_reg    = fetch<uint8_t>();
+			uint8_t max_reg    = fetch<uint8_t>();
+			uint8_t min_reg    = fetch<uint8_t>();
+			uint8_t result_reg = fetch<uint8_t>();
+
+			set_reg_by_id(result_reg, aio == nullptr ? 0
+				: aio->poll((uint8_t *) get_reg_by_id(out_reg),
+					get_reg_by_id(max_reg), get_reg_by_id(min_reg)));
+			break;
+		}
+
+		case THREAD_SPAWN:
+		{
+			int32_t offset     = fetch<int32_t>();
+			uint8_t arg_reg    = fetch<uint8_t>();
+			uint8_t handle_reg = fetch<uint8_t>();
+
+			Thread *thread = spawn_thread(cur_instr_addr + offset, get_reg_by_id(arg_reg));
+			set_reg_by_id(handle_reg, (uint64_t) thread);
+			break;
+		}
+
+		case THREAD_JOIN:
+		{
+			uint8_t handle_reg = fetch<uint8_t>();
+			uint8_t result_reg = fetch<uint8_t>();
+
+			set_reg_by_id(result_reg, join_thread(get_reg_by_id(handle_reg)));
+			break;
+		}
+
+		case CHAN_NEW:
+		{
+			uint8_t capacity_reg = fetch<uint8_t>();
+			uint8_t kind_reg     = fetch<uint8_t>();
+			uint8_t handle_reg   = fetch<uint8_t>();
+			uint64_t kind        = get_reg_by_id(kind_reg);
+
+			if (kind != CHANNEL_MPMC && kind != CHANNEL_SPSC)
+			{
+				throw std::string("Unknown channel kind ") + std::to_string(kind) + "\n";
+			}
+
+			set_reg_by_id(handle_reg, (uint64_t) new Channel(get_reg_by_id(capacity_reg), kind));
+			break;
+		}
+
+		case CHAN_FREE:
+		{
+			uint8_t chan_reg = fetch<uint8_t>();
+			delete get_channel_by_reg_id(chan_reg);
+			break;
+		}
+
+		case CHAN_SEND:
+		{
+			uint8_t chan_reg  = fetch<uint8_t>();
+			uint8_t value_reg = fetch<uint8_t>();
+
+			get_channel_by_reg_id(chan_reg)->send(get_reg_by_id(value_reg));
+			break;
+		}
+
+		case CHAN_RECV:
+		{
+			uint8_t chan_reg  = fetch<uint8_t>();
+			uint8_t value_reg = fetch<uint8_t>();
+
+			set_reg_by_id(value_reg, get_channel_by_reg_id(chan_reg)->recv());
+			break;
+		}
+
+		case CHAN_TRY_RECV:
+		{
+			uint8_t chan_reg  = fetch<uint8_t>();
+			uint8_t value_reg = fetch<uint8_t>();
+			uint8_t ok_reg    = fetch<uint8_t>();
+			uint64_t value    = 0;
+
+			bool ok = get_channel_by_reg_id(chan_reg)->try_recv(value);
+			set_reg_by_id(value_reg, value);
+			set_reg_by_id(ok_reg, ok);
+			break;
+		}
+
+		case BENCH_BEGIN:
+		{
+			uint8_t id_reg = fetch<uint8_t>();
+			get_bench_timer().begin(get_reg_by_id(id_reg));
+			break;
+		}
+
+		case BENCH_END:
+		{
+			uint8_t id_reg = fetch<uint8_t>();
+			get_bench_timer().end(get_reg_by_id(id_reg));
+			break;
+		}
+
+		// The superinstructions, composed from the handlers above.
+
+#include "VM/superinstruction-handlers.hpp"
+
+		// Programs are verified before they run, so every opcode is
+		// handled above. This lets the compiler drop the range check
+		// of the jump table.
+
+		default:
+			__builtin_unreachable();
 		}
 	}
 };
 
+// The CPU of the production VM. Has no hooks.
+using CPU = BasicCPU<NoHooks>;
+
+// A CPU that supports fuel metering.
+using MeteredCPU = BasicCPU<FuelHooks>;
+
 #endif
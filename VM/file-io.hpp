@@ -0,0 +1,253 @@
+#ifndef TEA_FILE_IO_HEADER
+#define TEA_FILE_IO_HEADER
+
+#include <cerrno>
+#include <cstdint>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// The mode bits of the FILE_OPEN instruction. They are translated
+// to the open flags of the host, so executables stay portable.
+
+// Open the file for reading.
+#define FILE_MODE_READ 1
+
+// Open the file for writing.
+#define FILE_MODE_WRITE 2
+
+// Create the file if it does not exist.
+#define FILE_MODE_CREATE 4
+
+// Truncate the file to length 0.
+#define FILE_MODE_TRUNCATE 8
+
+// Write at the end of the file.
+#define FILE_MODE_APPEND 16
+
+// The number of 64-bit values written by the FILE_STAT instruction:
+// the size, the mode bits and the modification time in seconds.
+#define FILE_STAT_FIELDS 3
+
+// Thin wrappers around the file syscalls of the host, used by the FILE_*
+// and MMAP_FILE instructions. Guest file descriptors are host file
+// descriptors. Like the syscalls of the host, every function returns
+// a non-negative result on success, but on failure it returns the
+// negated errno value instead of setting errno.
+namespace file_io
+{
+/**
+ * @param result The result of a host syscall, -1 on failure.
+ * @returns The result, or the negated errno value on failure.
+ */
+int64_t
+result_or_error(int64_t result)
+{
+	return result < 0 ? -errno : result;
+}
+
+/**
+ * @brief Opens a file.
+ * @param path The null-terminated path of the file.
+ * @param mode The FILE_MODE_* bits.
+ * @returns The file descriptor.
+ */
+int64_t
+open(const char *path, uint64_t mode)
+{
+	int flags;
+
+	if ((mode & FILE_MODE_READ) && (mode & FILE_MODE_WRITE))
+		flags = O_RDWR;
+	else if (mode & FILE_MODE_WRITE)
+		flags = O_WRONLY;
+	else
+		flags = O_RDONLY;
+
+	if (mode & FILE_MODE_CREATE)
+		flags |= O_CREAT;
+	if (mode & FILE_MODE_TRUNCATE)
+		flags |= O_TRUNC;
+	if (mode & FILE_MODE_APPEND)
+		flags |= O_APPEND;
+
+	return result_or_error(::open(path, flags | O_CLOEXEC, 0644));
+}
+
+/**
+ * @brief Reads from a file at its current position.
+ * Retries when interrupted by a signal.
+ * @param fd The file descriptor.
+ * @param buf The buffer to read into.
+ * @param len The maximum number of bytes to read.
+ * @returns The number of read bytes, 0 at the end of the file.
+ */
+int64_t
+read(int64_t fd, void *buf, uint64_t len)
+{
+	ssize_t n;
+
+	do
+	{
+		n = ::read(fd, buf, len);
+	}
+	while (n < 0 && errno == EINTR);
+
+	return result_or_error(n);
+}
+
+/**
+ * @brief Reads from a file at an offset, without moving its position.
+ * Retries when interrupted by a signal.
+ * @param fd The file descriptor.
+ * @param buf The buffer to read into.
+ * @param len The maximum number of bytes to read.
+ * @param offset The offset in the file.
+ * @returns The number of read bytes, 0 at the end of the file.
+ */
+int64_t
+pread(int64_t fd, void *buf, uint64_t len, uint64_t offset)
+{
+	ssize_t n;
+
+	do
+	{
+		n = ::pread(fd, buf, len, offset);
+	}
+	while (n < 0 && errno == EINTR);
+
+	return result_or_error(n);
+}
+
+/**
+ * @brief Writes to a file at its current position.
+ * Retries when interrupted by a signal.
+ * @param fd The file descriptor.
+ * @param buf The bytes to write.
+ * @param len The number of bytes to write.
+ * @returns The number of written bytes.
+ */
+int64_t
+write(int64_t fd, const void *buf, uint64_t len)
+{
+	ssize_t n;
+
+	do
+	{
+		n = ::write(fd, buf, len);
+	}
+	while (n < 0 && errno == EINTR);
+
+	return result_or_error(n);
+}
+
+/**
+ * @brief Writes to a file at an offset, without moving its position.
+ * Retries when interrupted by a signal.
+ * @param fd The file descriptor.
+ * @param buf The bytes to write.
+ * @param len The number of bytes to write.
+ * @param offset The offset in the file.
+ * @returns The number of written bytes.
+ */
+int64_t
+pwrite(int64_t fd, const void *buf, uint64_t len, uint64_t offset)
+{
+	ssize_t n;
+
+	do
+	{
+		n = ::pwrite(fd, buf, len, offset);
+	}
+	while (n < 0 && errno == EINTR);
+
+	return result_or_error(n);
+}
+
+/**
+ * @brief Moves the position of a file.
+ * @param fd The file descriptor.
+ * @param offset The offset relative to `whence`.
+ * @param whence 0 for the start, 1 for the current position
+ * and 2 for the end of the file.
+ * @returns The new position.
+ */
+int64_t
+seek(int64_t fd, int64_t offset, uint64_t whence)
+{
+	static const int whences[] = { SEEK_SET, SEEK_CUR, SEEK_END };
+
+	if (whence > 2)
+	{
+		return -EINVAL;
+	}
+
+	return result_or_error(lseek(fd, offset, whences[whence]));
+}
+
+/**
+ * @brief Closes a file.
+ * @param fd The file descriptor.
+ * @returns 0.
+ */
+int64_t
+close(int64_t fd)
+{
+	return result_or_error(::close(fd));
+}
+
+/**
+ * @brief Gets information about a file.
+ * @param fd The file descriptor.
+ * @param out The FILE_STAT_FIELDS values to write the size,
+ * the mode bits and the modification time to.
+ * @returns 0.
+ */
+int64_t
+stat(int64_t fd, uint64_t *out)
+{
+	struct stat st;
+
+	if (fstat(fd, &st) < 0)
+	{
+		return -errno;
+	}
+
+	out[0] = st.st_size;
+	out[1] = st.st_mode;
+	out[2] = st.st_mtime;
+	return 0;
+}
+
+/**
+ * @brief Maps a part of a file into memory.
+ * The mapping is private and writable: writes are visible to the
+ * program, but are never written back to the file.
+ * @param fd The file descriptor.
+ * @param len The number of bytes to map.
+ * @param offset The offset in the file, a multiple of the page size.
+ * @returns The address of the mapping.
+ */
+int64_t
+map(int64_t fd, uint64_t len, uint64_t offset)
+{
+	void *addr = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, offset);
+	return addr == MAP_FAILED ? -errno : (int64_t) addr;
+}
+
+/**
+ * @brief Unmaps memory mapped with `map()`.
+ * @param addr The address of the mapping.
+ * @param len The number of mapped bytes.
+ * @returns 0.
+ */
+int64_t
+unmap(void *addr, uint64_t len)
+{
+	return result_or_error(munmap(addr, len));
+}
+}
+
+#endif
@@ -0,0 +1,134 @@
+#ifndef TEA_FORMAT_HEADER
+#define TEA_FORMAT_HEADER
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+// The size of a buffer that fits any number formatted by these functions.
+// A 64-bit float printed with the maximum precision is the longest.
+#define FORMAT_BUFFER_SIZE 512
+
+// The maximum number of digits after the decimal point of a float.
+#define FORMAT_MAX_PRECISION 64
+
+// Fast integer to ASCII conversion, used by the PRINT_* instructions.
+// Digits are produced two at a time from a lookup table, which halves
+// the number of divisions compared to a digit-by-digit loop.
+namespace format
+{
+// The two-digit decimal representations of 0 up to 99.
+static const char digit_pairs[201] = "00010203040506070809"
+				     "10111213141516171819"
+				     "20212223242526272829"
+				     "30313233343536373839"
+				     "40414243444546474849"
+				     "50515253545556575859"
+				     "60616263646566676869"
+				     "70717273747576777879"
+				     "80818283848586878889"
+				     "90919293949596979899";
+
+/**
+ * @brief Formats an unsigned integer in decimal.
+ * @param buf The buffer to write to, without null terminator.
+ * @param value The value to format.
+ * @returns The number of written characters.
+ */
+size_t
+u64(char *buf, uint64_t value)
+{
+	char tmp[20];
+	char *end = tmp + sizeof(tmp);
+	char *p   = end;
+
+	while (value >= 100)
+	{
+		uint64_t pair = value % 100;
+		value /= 100;
+		p -= 2;
+		memcpy(p, digit_pairs + pair * 2, 2);
+	}
+
+	if (value >= 10)
+	{
+		p -= 2;
+		memcpy(p, digit_pairs + value * 2, 2);
+	}
+	else
+	{
+		*--p = '0' + value;
+	}
+
+	memcpy(buf, p, end - p);
+	return end - p;
+}
+
+/**
+ * @brief Formats a signed integer in decimal.
+ * @param buf The buffer to write to, without null terminator.
+ * @param value The value to format.
+ * @returns The number of written characters.
+ */
+size_t
+i64(char *buf, int64_t value)
+{
+	if (value >= 0)
+	{
+		return u64(buf, value);
+	}
+
+	// Negate as unsigned, so the minimum value does not overflow.
+
+	buf[0] = '-';
+	return 1 + u64(buf + 1, -(uint64_t) value);
+}
+
+/**
+ * @brief Formats an unsigned integer in lowercase hexadecimal,
+ * without leading zeroes or prefix.
+ * @param buf The buffer to write to, without null terminator.
+ * @param value The value to format.
+ * @returns The number of written characters.
+ */
+size_t
+hex(char *buf, uint64_t value)
+{
+	size_t len = 1;
+
+	while (len < 16 && value >> (len * 4))
+	{
+		len++;
+	}
+
+	for (size_t i = len; i-- > 0;)
+	{
+		buf[i] = "0123456789abcdef"[value & 0xf];
+		value >>= 4;
+	}
+
+	return len;
+}
+
+/**
+ * @brief Formats a float in decimal with a fixed number of digits
+ * after the decimal point.
+ * @param buf The buffer to write to, of at least FORMAT_BUFFER_SIZE bytes.
+ * @param value The value to format.
+ * @param precision The number of digits after the decimal point.
+ * Clamped to FORMAT_MAX_PRECISION.
+ * @returns The number of written characters.
+ */
+size_t
+f64(char *buf, double value, uint64_t precision)
+{
+	if (precision > FORMAT_MAX_PRECISION)
+	{
+		precision = FORMAT_MAX_PRECISION;
+	}
+
+	return snprintf(buf, FORMAT_BUFFER_SIZE, "%.*f", (int) precision, value);
+}
+}
+
+#endif
@@ -0,0 +1,137 @@
+#ifndef TEA_FUEL_HEADER
+#define TEA_FUEL_HEADER
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "VM/memory.hpp"
+#include "Executable/byte-code.hpp"
+
+/**
+ * @brief Precomputed fuel costs of a program, used for fuel metering.
+ * Fuel is only consumed by backward jumps and calls, since every loop
+ * and every recursion passes one of them. Straight-line code and forward
+ * jumps are never checked.
+ *
+ * A taken backward jump costs the number of instructions it jumps back
+ * over, including itself, which is the length of one iteration of the
+ * loop it closes. A call costs the number of instructions of the basic
+ * block that ends at the call. Fuel is therefore measured in
+ * instructions, but it is an estimate: a loop iteration that skips part
+ * of its body is charged for the whole body.
+ */
+struct FuelCosts
+{
+	// The fuel cost of the instruction at each offset
+	// in the program segment. Zero for instructions
+	// that don't consume fuel.
+	std::vector<uint32_t> costs;
+
+	/**
+	 * @brief Computes the fuel costs of a program.
+	 * @param program_location A pointer to the start of the program.
+	 * @param program_size The size of the program in bytes.
+	 */
+	FuelCosts(uint8_t *program_location, size_t program_size)
+		: costs(program_size, 0)
+	{
+		// Find all instructions and the starts of all basic blocks.
+
+		std::vector<uint64_t> offsets;
+		std::vector<bool> block_starts(program_size + 1, false);
+		block_starts[0] = true;
+
+		for (uint64_t offset = 0; offset < program_size;)
+		{
+			uint8_t *instr          = program_location + offset;
+			Instruction instruction = memory::get<Instruction>(instr);
+			uint64_t next_offset    = offset + instruction_size(instr);
+
+			offsets.push_back(offset);
+
+			if (is_branch(instruction))
+			{
+				uint64_t target = offset + memory::get<int32_t>(instr + sizeof(Instruction));
+
+				if (target < program_size)
+				{
+					block_starts[target] = true;
+				}
+			}
+
+			if (is_branch(instruction) || instruction == RETURN)
+			{
+				block_starts[std::min<uint64_t>(next_offset, program_size)] = true;
+			}
+
+			offset = next_offset;
+		}
+
+		// Number the instructions, so the length of a range
+		// of instructions can be computed from its ends.
+
+		std::vector<uint32_t> indices(program_size, UINT32_MAX);
+		uint32_t block_start = 0;
+
+		for (uint32_t i = 0; i < offsets.size(); i++)
+		{
+			uint64_t offset         = offsets[i];
+			uint8_t *instr          = program_location + offset;
+			Instruction instruction = memory::get<Instruction>(instr);
+
+			indices[offset] = i;
+
+			if (block_starts[offset])
+			{
+				block_start = i;
+			}
+
+			if (instruction == CALL)
+			{
+				costs[offset] = i - block_start + 1;
+			}
+			else if (is_branch(instruction))
+			{
+				int64_t jump_offset = memory::get<int32_t>(instr + sizeof(Instruction));
+				uint64_t target     = offset + jump_offset;
+
+				// Backward jumps into the middle of an instruction
+				// are charged as if they jumped to the program start.
+
+				if (jump_offset <= 0)
+				{
+					costs[offset] = target < program_size && indices[target] != UINT32_MAX
+						? i - indices[target] + 1
+						: i + 1;
+				}
+			}
+		}
+	}
+
+	/**
+	 * @param instruction An instruction.
+	 * @returns Whether the instruction is a jump or a call.
+	 */
+	static bool
+	is_branch(Instruction instruction)
+	{
+		switch (instruction)
+		{
+		case JUMP:
+		case JUMP_IF_GT:
+		case JUMP_IF_GEQ:
+		case JUMP_IF_LT:
+		case JUMP_IF_LEQ:
+		case JUMP_IF_EQ:
+		case JUMP_IF_NEQ:
+		case CALL:
+			return true;
+
+		default:
+			return false;
+		}
+	}
+};
+
+#endif
@@ -0,0 +1,430 @@
+#ifndef TEA_HASH_MAP_HEADER
+#define TEA_HASH_MAP_HEADER
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// The number of slots whose control bytes are probed at once.
+#define HASH_MAP_GROUP_SIZE 16
+
+// The key length that marks an integer key.
+#define HASH_MAP_INT_KEY UINT64_MAX
+
+/**
+ * @brief The native hash map behind the MAP_* instructions.
+ * Keys are either 64-bit integers or byte strings, values are 64-bit.
+ * Byte string keys are copied into the map.
+ *
+ * The map is an open-addressing table in the style of a Swiss table.
+ * Every slot has a control byte that is either empty, deleted, or holds
+ * the lowest 7 bits of the hash of its key. Slots are probed in groups
+ * of 16, comparing all control bytes of a group at once with SSE2
+ * (or with a scalar loop on other targets). Only slots whose control
+ * byte matches are compared with the key. The table grows when it is
+ * 7/8 full, counting deleted slots.
+ * All memory is allocated with malloc, from the same heap as the
+ * memory of the program.
+ */
+struct HashMap
+{
+	// The control byte of a slot that was never used.
+	static constexpr int8_t CTRL_EMPTY = -128;
+
+	// The control byte of a slot whose entry was deleted.
+	static constexpr int8_t CTRL_DELETED = -2;
+
+	/**
+	 * @brief An entry of the map.
+	 */
+	struct Slot
+	{
+		// The hash of the key.
+		uint64_t hash;
+
+		// An integer key, or a pointer to the bytes of a byte string key.
+		uint64_t key;
+
+		// The length of a byte string key, or HASH_MAP_INT_KEY.
+		uint64_t key_len;
+
+		// The value.
+		uint64_t value;
+	};
+
+	/**
+	 * @brief The control bytes of a group of slots.
+	 */
+	struct Group
+	{
+#ifdef __SSE2__
+		__m128i ctrl;
+
+		Group(const int8_t *ctrl)
+			: ctrl(_mm_loadu_si128((const __m128i *) ctrl)) {}
+
+		/**
+		 * @param h2 A control byte.
+		 * @returns A bit mask of the slots with this control byte.
+		 */
+		uint32_t
+		match(int8_t h2) const
+		{
+			return _mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(h2)));
+		}
+
+		/**
+		 * @returns A bit mask of the empty and deleted slots.
+		 * Only their control bytes have the highest bit set.
+		 */
+		uint32_t
+		match_free() const
+		{
+			return _mm_movemask_epi8(ctrl);
+		}
+#else
+		const int8_t *ctrl;
+
+		Group(const int8_t *ctrl)
+			: ctrl(ctrl) {}
+
+		uint32_t
+		match(int8_t h2) const
+		{
+			uint32_t mask = 0;
+
+			for (size_t i = 0; i < HASH_MAP_GROUP_SIZE; i++)
+			{
+				mask |= (uint32_t) (ctrl[i] == h2) << i;
+			}
+
+			return mask;
+		}
+
+		uint32_t
+		match_free() const
+		{
+			uint32_t mask = 0;
+
+			for (size_t i = 0; i < HASH_MAP_GROUP_SIZE; i++)
+			{
+				mask |= (uint32_t) (ctrl[i] < 0) << i;
+			}
+
+			return mask;
+		}
+#endif
+	};
+
+	// The control bytes of all slots.
+	int8_t *ctrl;
+
+	// All slots.
+	Slot *slots;
+
+	// The number of slots. A power of two, at least one group.
+	size_t capacity;
+
+	// The number of entries.
+	size_t size = 0;
+
+	// The number of empty slots that can still be filled
+	// before the table must grow.
+	size_t growth_left;
+
+	HashMap()
+	{
+		allocate(HASH_MAP_GROUP_SIZE);
+	}
+
+	HashMap(const HashMap &) = delete;
+	HashMap &operator=(const HashMap &) = delete;
+
+	~HashMap()
+	{
+		for (size_t i = 0; i < capacity; i++)
+		{
+			if (ctrl[i] >= 0 && slots[i].key_len != HASH_MAP_INT_KEY)
+			{
+				free((void *) slots[i].key);
+			}
+		}
+
+		free(ctrl);
+		free(slots);
+	}
+
+	/**
+	 * @brief Allocates empty control bytes and slots.
+	 * @param new_capacity The number of slots.
+	 */
+	void
+	allocate(size_t new_capacity)
+	{
+		capacity    = new_capacity;
+		ctrl        = (int8_t *) malloc(capacity);
+		slots       = (Slot *) malloc(capacity * sizeof(Slot));
+		growth_left = capacity - capacity / 8 - size;
+		memset(ctrl, CTRL_EMPTY, capacity);
+	}
+
+	/**
+	 * @brief Hashes a key.
+	 * @param key An integer key, or a pointer to a byte string key.
+	 * @param key_len The length of a byte string key, or HASH_MAP_INT_KEY.
+	 * @returns The hash of the key.
+	 */
+	static uint64_t
+	hash(uint64_t key, uint64_t key_len)
+	{
+		uint64_t h = 0x9e3779b97f4a7c15;
+
+		if (key_len == HASH_MAP_INT_KEY)
+		{
+			h ^= key;
+		}
+		else
+		{
+			const uint8_t *bytes = (const uint8_t *) key;
+			uint64_t i           = 0;
+
+			for (; i + 8 <= key_len; i += 8)
+			{
+				uint64_t word;
+				memcpy(&word, bytes + i, 8);
+				h = (h ^ word) * 0xff51afd7ed558ccd;
+				h ^= h >> 32;
+			}
+
+			uint64_t tail = 0;
+			memcpy(&tail, bytes + i, key_len - i);
+			h ^= tail ^ (key_len << 56);
+		}
+
+		// Finaliser of MurmurHash3, mixes all bits into the low 7 bits
+		// used by the control bytes and the high bits used for probing.
+
+		h ^= h >> 33;
+		h *= 0xff51afd7ed558ccd;
+		h ^= h >> 33;
+		h *= 0xc4ceb9fe1a85ec53;
+		h ^= h >> 33;
+		return h;
+	}
+
+	/**
+	 * @brief Finds the slot of a key.
+	 * @param h The hash of the key.
+	 * @param key An integer key, or a pointer to a byte string key.
+	 * @param key_len The length of a byte string key, or HASH_MAP_INT_KEY.
+	 * @returns The index of the slot, or `capacity` if the key is absent.
+	 */
+	size_t
+	find(uint64_t h, uint64_t key, uint64_t key_len) const
+	{
+		size_t group_mask = capacity / HASH_MAP_GROUP_SIZE - 1;
+		size_t group      = (h >> 7) & group_mask;
+		int8_t h2         = h & 0x7f;
+
+		// Triangular probing visits every group once.
+
+		for (size_t i = 1;; i++)
+		{
+			size_t base = group * HASH_MAP_GROUP_SIZE;
+			Group g(ctrl + base);
+
+			for (uint32_t mask = g.match(h2); mask != 0; mask &= mask - 1)
+			{
+				size_t index     = base + __builtin_ctz(mask);
+				const Slot &slot = slots[index];
+
+				if (slot.hash == h && slot.key_len == key_len
+					&& (key_len == HASH_MAP_INT_KEY
+						? slot.key == key
+						: memcmp((void *) slot.key, (void *) key, key_len) == 0))
+				{
+					return index;
+				}
+			}
+
+			if (g.match(CTRL_EMPTY) != 0 || i > group_mask)
+			{
+				return capacity;
+			}
+
+			group = (group + i) & group_mask;
+		}
+	}
+
+	/**
+	 * @brief Finds a free slot for a new key.
+	 * The table must have an empty slot.
+	 * @param h The hash of the key.
+	 * @returns The index of the slot.
+	 */
+	size_t
+	find_free(uint64_t h) const
+	{
+		size_t group_mask = capacity / HASH_MAP_GROUP_SIZE - 1;
+		size_t group      = (h >> 7) & group_mask;
+
+		for (size_t i = 1;; i++)
+		{
+			size_t base   = group * HASH_MAP_GROUP_SIZE;
+			uint32_t mask = Group(ctrl + base).match_free();
+
+			if (mask != 0)
+			{
+				return base + __builtin_ctz(mask);
+			}
+
+			group = (group + i) & group_mask;
+		}
+	}
+
+	/**
+	 * @brief Moves all entries into a new table. Deleted slots are dropped.
+	 * @param new_capacity The number of slots of the new table.
+	 */
+	void
+	rehash(size_t new_capacity)
+	{
+		int8_t *old_ctrl    = ctrl;
+		Slot *old_slots     = slots;
+		size_t old_capacity = capacity;
+
+		allocate(new_capacity);
+
+		for (size_t i = 0; i < old_capacity; i++)
+		{
+			if (old_ctrl[i] >= 0)
+			{
+				size_t index = find_free(old_slots[i].hash);
+				ctrl[index]  = old_ctrl[i];
+				slots[index] = old_slots[i];
+			}
+		}
+
+		growth_left = capacity - capacity / 8 - size;
+		free(old_ctrl);
+		free(old_slots);
+	}
+
+	/**
+	 * @brief Gets the value of a key.
+	 * @param key An integer key, or a pointer to a byte string key.
+	 * @param key_len The length of a byte string key, or HASH_MAP_INT_KEY.
+	 * @returns The value, or 0 if the key is absent.
+	 * See `has()` to tell an absent key from a stored 0.
+	 */
+	uint64_t
+	get(uint64_t key, uint64_t key_len) const
+	{
+		size_t index = find(hash(key, key_len), key, key_len);
+		return index == capacity ? 0 : slots[index].value;
+	}
+
+	/**
+	 * @brief Checks whether the map has a key.
+	 * @param key An integer key, or a pointer to a byte string key.
+	 * @param key_len The length of a byte string key, or HASH_MAP_INT_KEY.
+	 * @returns True if the key is present.
+	 */
+	bool
+	has(uint64_t key, uint64_t key_len) const
+	{
+		return find(hash(key, key_len), key, key_len) != capacity;
+	}
+
+	/**
+	 * @brief Sets the value of a key. Adds the key if it is absent.
+	 * @param key An integer key, or a pointer to a byte string key.
+	 * @param key_len The length of a byte string key, or HASH_MAP_INT_KEY.
+	 * @param value The value.
+	 */
+	void
+	put(uint64_t key, uint64_t key_len, uint64_t value)
+	{
+		uint64_t h   = hash(key, key_len);
+		size_t index = find(h, key, key_len);
+
+		if (index != capacity)
+		{
+			slots[index].value = value;
+			return;
+		}
+
+		if (growth_left == 0)
+		{
+			// Grow if the table is mostly full of entries,
+			// otherwise only drop the deleted slots.
+
+			rehash(size * 2 >= capacity ? capacity * 2 : capacity);
+		}
+
+		index = find_free(h);
+
+		if (ctrl[index] == CTRL_EMPTY)
+		{
+			growth_left--;
+		}
+
+		if (key_len != HASH_MAP_INT_KEY)
+		{
+			void *copy = malloc(key_len ? key_len : 1);
+			memcpy(copy, (void *) key, key_len);
+			key = (uint64_t) copy;
+		}
+
+		ctrl[index]  = h & 0x7f;
+		slots[index] = { h, key, key_len, value };
+		size++;
+	}
+
+	/**
+	 * @brief Removes a key. Does nothing if the key is absent.
+	 * @param key An integer key, or a pointer to a byte string key.
+	 * @param key_len The length of a byte string key, or HASH_MAP_INT_KEY.
+	 */
+	void
+	del(uint64_t key, uint64_t key_len)
+	{
+		size_t index = find(hash(key, key_len), key, key_len);
+
+		if (index == capacity)
+		{
+			return;
+		}
+
+		if (key_len != HASH_MAP_INT_KEY)
+		{
+			free((void *) slots[index].key);
+		}
+
+		ctrl[index] = CTRL_DELETED;
+		size--;
+	}
+
+	/**
+	 * @brief Finds the next entry for iteration.
+	 * @param cursor The index of the slot to start searching at.
+	 * @returns The index of the slot of the next entry,
+	 * or `capacity` if there are no more entries.
+	 */
+	size_t
+	next(size_t cursor) const
+	{
+		while (cursor < capacity && ctrl[cursor] < 0)
+		{
+			cursor++;
+		}
+
+		return cursor;
+	}
+};
+
+#endif
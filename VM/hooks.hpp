@@ -0,0 +1,111 @@
+#ifndef TEA_HOOKS_HEADER
+#define TEA_HOOKS_HEADER
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "Executable/byte-code.hpp"
+
+/**
+ * @brief The hooks of a CPU that does not observe its program.
+ * `BasicCPU` is templated on a hooks type and calls the hooks below
+ * at fixed points of execution. Every call is resolved at compile
+ * time, so the empty hooks of this type are inlined away and the
+ * production VM pays nothing for them.
+ *
+ * Tools that observe the program derive their hooks from this type
+ * and override the hooks they need. The hooks are taken by the CPU
+ * type as their first argument, so they can inspect its registers.
+ * The CPUs of guest threads get default-constructed hooks.
+ */
+struct NoHooks
+{
+	// Whether backward jumps and calls consume fuel once
+	// `enable_fuel()` is called. Fuel checks are compiled out otherwise.
+	static constexpr bool METERS_FUEL = false;
+
+	// Whether `on_trap()` is called when an instruction throws.
+	// The exception handler is compiled out otherwise.
+	static constexpr bool HANDLES_TRAPS = false;
+
+	// Whether the CPU rewrites its program to use superinstructions when
+	// it loads it, see `rewrite_superinstructions()`. The instructions
+	// inside a superinstruction are not reported to `on_instruction()`,
+	// so hooks that observe every instruction must clear this.
+	static constexpr bool USES_SUPERINSTRUCTIONS = true;
+
+	/**
+	 * @brief Called before an instruction is executed.
+	 * `cpu.cur_instr_addr` points at the instruction.
+	 * @param cpu The CPU.
+	 * @param instruction The opcode of the instruction.
+	 */
+	template <typename CPU>
+	void
+	on_instruction(CPU &cpu, Instruction instruction) {}
+
+	/**
+	 * @brief Called after a CALL instruction entered a function.
+	 * @param cpu The CPU.
+	 * @param function The address of the first instruction of the function.
+	 */
+	template <typename CPU>
+	void
+	on_call(CPU &cpu, uint8_t *function) {}
+
+	/**
+	 * @brief Called after a RETURN instruction left a function.
+	 * @param cpu The CPU.
+	 */
+	template <typename CPU>
+	void
+	on_return(CPU &cpu) {}
+
+	/**
+	 * @brief Called before an instruction reads or writes memory
+	 * through a pointer. Accesses to the stack by pushes, pops and
+	 * local variables are not reported.
+	 * @param cpu The CPU.
+	 * @param address The address of the first accessed byte.
+	 * @param size The number of accessed bytes.
+	 * @param is_write Whether the memory is written.
+	 */
+	template <typename CPU>
+	void
+	on_memory_access(CPU &cpu, uint8_t *address, size_t size, bool is_write) {}
+
+	/**
+	 * @brief Called after an I/O instruction transferred bytes
+	 * to or from stdin, stdout or a file. Failed transfers
+	 * are reported as zero bytes.
+	 * @param cpu The CPU.
+	 * @param bytes The number of transferred bytes.
+	 * @param is_write Whether the bytes were written.
+	 */
+	template <typename CPU>
+	void
+	on_io(CPU &cpu, uint64_t bytes, bool is_write) {}
+
+	/**
+	 * @brief Called when an instruction throws an error message.
+	 * Only called if `HANDLES_TRAPS` is set. The error message
+	 * is rethrown after the hook returns.
+	 * @param cpu The CPU.
+	 * @param err_message The error message.
+	 */
+	template <typename CPU>
+	void
+	on_trap(CPU &cpu, const std::string &err_message) {}
+};
+
+/**
+ * @brief The hooks of a CPU that supports fuel metering,
+ * used for preemptive scheduling and for embedding.
+ */
+struct FuelHooks : NoHooks
+{
+	static constexpr bool METERS_FUEL = true;
+};
+
+#endif
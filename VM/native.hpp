@@ -0,0 +1,247 @@
+#ifndef TEA_NATIVE_HEADER
+#define TEA_NATIVE_HEADER
+
+#include <dlfcn.h>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "Executable/native-import.hpp"
+#include "VM/builtins.hpp"
+
+// The number of integer and floating point argument registers of the
+// host C calling convention. Arguments that don't fit into these
+// registers are passed on the host stack, in 8-byte slots, in the
+// order in which they appear in the parameter list.
+#if defined(__x86_64__)
+	#define NATIVE_INT_ARG_REGS 6
+	#define NATIVE_FLT_ARG_REGS 8
+	#define NATIVE_INT_PARAMS   uint64_t, uint64_t, uint64_t, uint64_t, uint64_t, uint64_t
+	#define NATIVE_INT_ARGS(n)  n[0], n[1], n[2], n[3], n[4], n[5]
+#elif defined(__aarch64__)
+	#define NATIVE_INT_ARG_REGS 8
+	#define NATIVE_FLT_ARG_REGS 8
+	#define NATIVE_INT_PARAMS   uint64_t, uint64_t, uint64_t, uint64_t, \
+		uint64_t, uint64_t, uint64_t, uint64_t
+	#define NATIVE_INT_ARGS(n)  n[0], n[1], n[2], n[3], n[4], n[5], n[6], n[7]
+#else
+	#error "Native function calls are not supported on this architecture"
+#endif
+
+// The maximum number of arguments passed on the host stack.
+#define NATIVE_STACK_ARG_SLOTS 8
+
+#define NATIVE_FLT_PARAMS double, double, double, double, double, double, double, double
+#define NATIVE_FLT_ARGS(f) f[0], f[1], f[2], f[3], f[4], f[5], f[6], f[7]
+#define NATIVE_STACK_PARAMS \
+	uint64_t, uint64_t, uint64_t, uint64_t, uint64_t, uint64_t, uint64_t, uint64_t
+#define NATIVE_STACK_ARGS(s) s[0], s[1], s[2], s[3], s[4], s[5], s[6], s[7]
+
+// Prototypes through which native functions are called. They occupy every
+// argument register, followed by the stack slots. Surplus arguments are
+// ignored by the callee.
+typedef uint64_t (*NativeIntFn)(NATIVE_INT_PARAMS, NATIVE_FLT_PARAMS, NATIVE_STACK_PARAMS);
+typedef double (*NativeFltFn)(NATIVE_INT_PARAMS, NATIVE_FLT_PARAMS, NATIVE_STACK_PARAMS);
+
+/**
+ * @brief A native function that has been resolved
+ * from the import table of an executable.
+ */
+struct NativeFunction
+{
+	// The address of the function in the host process.
+	void *address;
+
+	// The import table entry this function was resolved from.
+	NativeImport import;
+
+	// Whether the function returns its value in a floating point register.
+	bool returns_float;
+
+	/**
+	 * @brief Resolves all imports of an executable.
+	 * Builtin functions resolve to their runtime implementation.
+	 * Each library is loaded once with `dlopen()`, each symbol is
+	 * looked up with `dlsym()`. Throws an error message if a library
+	 * or symbol cannot be found, or if a signature cannot be called.
+	 * @param imports The import table of the executable.
+	 * @returns The resolved native functions, in import table order.
+	 */
+	static std::vector<NativeFunction>
+	resolve_all(const std::vector<NativeImport> &imports)
+	{
+		std::vector<NativeFunction> functions;
+		std::unordered_map<std::string, void *> libraries;
+
+		for (const NativeImport &import : imports)
+		{
+			NativeFunction function;
+			function.import        = import;
+			function.returns_float = import.return_type == NATIVE_F32
+				|| import.return_type == NATIVE_F64;
+
+			// Builtin functions are provided by the VM runtime.
+
+			auto builtin = builtin_addresses.find(import.symbol);
+
+			if (import.library.empty() && builtin != builtin_addresses.end())
+			{
+				function.address = builtin->second;
+				functions.push_back(std::move(function));
+				continue;
+			}
+
+			// Load the library if it was not loaded before.
+			// The empty library name refers to the VM process itself.
+
+			if (!libraries.count(import.library))
+			{
+				void *handle = dlopen(import.library.empty()
+					? nullptr : import.library.c_str(), RTLD_NOW);
+
+				if (handle == nullptr)
+				{
+					throw std::string("Could not load native library \"")
+						+ import.library + "\": " + dlerror() + "\n";
+				}
+
+				libraries[import.library] = handle;
+			}
+
+			void *address = dlsym(libraries[import.library], import.symbol.c_str());
+
+			if (address == nullptr)
+			{
+				throw std::string("Could not resolve native function \"")
+					+ import.symbol + "\"\n";
+			}
+
+			function.address = address;
+
+			if (function.stack_slots_needed() > NATIVE_STACK_ARG_SLOTS)
+			{
+				throw std::string("Native function \"") + import.symbol
+					+ "\" has too many parameters\n";
+			}
+
+			functions.push_back(std::move(function));
+		}
+
+		return functions;
+	}
+
+	/**
+	 * @returns The number of arguments of this function
+	 * that are passed on the host stack.
+	 */
+	size_t
+	stack_slots_needed() const
+	{
+		size_t int_args = 0;
+		size_t flt_args = 0;
+
+		for (NativeType type : import.param_types)
+		{
+			if (type == NATIVE_F32 || type == NATIVE_F64)
+				flt_args++;
+			else
+				int_args++;
+		}
+
+		return (int_args > NATIVE_INT_ARG_REGS ? int_args - NATIVE_INT_ARG_REGS : 0)
+			+ (flt_args > NATIVE_FLT_ARG_REGS ? flt_args - NATIVE_FLT_ARG_REGS : 0);
+	}
+
+	/**
+	 * @brief Converts a value of a Tea register to the value that
+	 * the host calling convention expects for a native type.
+	 * Small integers are sign- or zero-extended to 64 bits.
+	 * @param type The native type of the value.
+	 * @param value The raw register value.
+	 * @returns The normalised value.
+	 */
+	static uint64_t
+	normalise(NativeType type, uint64_t value)
+	{
+		switch (type)
+		{
+		case NATIVE_U8:
+			return (uint8_t) value;
+		case NATIVE_I8:
+			return (int64_t) (int8_t) value;
+		case NATIVE_U16:
+			return (uint16_t) value;
+		case NATIVE_I16:
+			return (int64_t) (int16_t) value;
+		case NATIVE_U32:
+		case NATIVE_F32:
+			return (uint32_t) value;
+		case NATIVE_I32:
+			return (int64_t) (int32_t) value;
+		default:
+			return value;
+		}
+	}
+
+	/**
+	 * @brief Calls the native function.
+	 * Integer and pointer arguments are assigned to the integer argument
+	 * registers, floating point arguments to the floating point argument
+	 * registers. Arguments that don't fit are passed on the host stack.
+	 * 32-bit floats are passed in the low half of a floating point register.
+	 * @param args The arguments, one 8-byte slot per parameter.
+	 * @returns The return value, as it should be stored in R_RET.
+	 */
+	uint64_t
+	call(const uint64_t *args) const
+	{
+		uint64_t int_regs[NATIVE_INT_ARG_REGS]       = {};
+		uint64_t flt_regs[NATIVE_FLT_ARG_REGS]       = {};
+		uint64_t stack_slots[NATIVE_STACK_ARG_SLOTS] = {};
+		size_t int_i   = 0;
+		size_t flt_i   = 0;
+		size_t stack_i = 0;
+
+		for (size_t i = 0; i < import.param_types.size(); i++)
+		{
+			NativeType type = import.param_types[i];
+			uint64_t value  = normalise(type, args[i]);
+
+			if (type == NATIVE_F32 || type == NATIVE_F64)
+			{
+				if (flt_i < NATIVE_FLT_ARG_REGS)
+					flt_regs[flt_i++] = value;
+				else
+					stack_slots[stack_i++] = value;
+			}
+			else
+			{
+				if (int_i < NATIVE_INT_ARG_REGS)
+					int_regs[int_i++] = value;
+				else
+					stack_slots[stack_i++] = value;
+			}
+		}
+
+		double flt_args[NATIVE_FLT_ARG_REGS];
+		memcpy(flt_args, flt_regs, sizeof(flt_args));
+
+		if (returns_float)
+		{
+			double ret = ((NativeFltFn) address)(NATIVE_INT_ARGS(int_regs),
+				NATIVE_FLT_ARGS(flt_args), NATIVE_STACK_ARGS(stack_slots));
+
+			uint64_t ret_bits = 0;
+			memcpy(&ret_bits, &ret, import.return_type == NATIVE_F32 ? 4 : 8);
+			return ret_bits;
+		}
+
+		uint64_t ret = ((NativeIntFn) address)(NATIVE_INT_ARGS(int_regs),
+			NATIVE_FLT_ARGS(flt_args), NATIVE_STACK_ARGS(stack_slots));
+
+		return normalise(import.return_type, ret);
+	}
+};
+
+#endif
@@ -0,0 +1,341 @@
+#ifndef TEA_PLACEMENT_HEADER
+#define TEA_PLACEMENT_HEADER
+
+#include <cctype>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <linux/mempolicy.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "VM/memory.hpp"
+
+// The size of a huge page in bytes.
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024) // 2MB
+
+// The sysfs directory that describes the NUMA nodes of the host.
+#define NUMA_NODE_DIR "/sys/devices/system/node"
+
+/**
+ * @brief How the memory regions of guest programs are backed by huge pages.
+ */
+enum HugePageMode
+{
+	// Regions are allocated on the host heap.
+	HUGE_PAGES_OFF,
+
+	// Regions are mapped and advised to use transparent huge pages.
+	HUGE_PAGES_TRANSPARENT,
+
+	// Regions are mapped from the hugetlbfs pool,
+	// see /proc/sys/vm/nr_hugepages.
+	HUGE_PAGES_EXPLICIT
+};
+
+/**
+ * @brief Where the memory regions of guest programs are placed.
+ * Configured once per run, before the first region is allocated.
+ */
+struct MemoryPlacement
+{
+	// How regions are backed by huge pages.
+	HugePageMode huge_pages = HUGE_PAGES_OFF;
+
+	// Whether the memory of a guest program is bound to the NUMA node
+	// of the thread that creates it. Large heap allocations are bound
+	// to the node of the thread that makes them.
+	bool bind_to_local_node = false;
+
+	/**
+	 * @returns Whether regions are mapped, rather than allocated on the heap.
+	 */
+	bool
+	maps_regions() const
+	{
+		return huge_pages != HUGE_PAGES_OFF || bind_to_local_node;
+	}
+};
+
+namespace placement
+{
+// The placement of this run.
+inline MemoryPlacement config;
+
+/**
+ * @returns The NUMA node of the CPU the calling thread runs on.
+ */
+unsigned
+current_node()
+{
+	unsigned cpu;
+	unsigned node;
+
+	if (getcpu(&cpu, &node) == -1)
+	{
+		return 0;
+	}
+
+	return node;
+}
+
+/**
+ * @brief Parses a list of ranges like "0-3,8,10-11", as used by sysfs.
+ * @param list The list.
+ * @returns The numbers in the list.
+ */
+std::vector<unsigned>
+parse_range_list(const std::string &list)
+{
+	std::vector<unsigned> numbers;
+	std::istringstream ranges(list);
+	std::string range;
+
+	while (std::getline(ranges, range, ','))
+	{
+		if (range.empty() || !isdigit(range[0]))
+		{
+			continue;
+		}
+
+		size_t dash    = range.find('-');
+		unsigned first = std::stoul(range.substr(0, dash));
+		unsigned last  = dash == std::string::npos ? first : std::stoul(range.substr(dash + 1));
+
+		for (unsigned number = first; number <= last; number++)
+		{
+			numbers.push_back(number);
+		}
+	}
+
+	return numbers;
+}
+
+/**
+ * @returns The online NUMA nodes of the host,
+ * only node 0 if the host does not report its nodes.
+ */
+std::vector<unsigned>
+online_nodes()
+{
+	std::ifstream file(NUMA_NODE_DIR "/online");
+	std::string list;
+
+	if (!std::getline(file, list) || parse_range_list(list).empty())
+	{
+		return { 0 };
+	}
+
+	return parse_range_list(list);
+}
+
+/**
+ * @param node A NUMA node.
+ * @returns The CPUs of the node, empty if they are unknown.
+ */
+std::vector<unsigned>
+node_cpus(unsigned node)
+{
+	std::ifstream file(NUMA_NODE_DIR "/node" + std::to_string(node) + "/cpulist");
+	std::string list;
+
+	if (!std::getline(file, list))
+	{
+		return {};
+	}
+
+	return parse_range_list(list);
+}
+
+/**
+ * @brief Restricts the calling thread to the CPUs of a NUMA node,
+ * so the memory it binds to its node stays local to it.
+ * @param node The NUMA node.
+ * @returns Whether the thread was moved to the node.
+ */
+bool
+pin_thread_to_node(unsigned node)
+{
+	std::vector<unsigned> cpus = node_cpus(node);
+	cpu_set_t set;
+	CPU_ZERO(&set);
+
+	for (unsigned cpu : cpus)
+	{
+		CPU_SET(cpu, &set);
+	}
+
+	return !cpus.empty() && sched_setaffinity(0, sizeof(set), &set) == 0;
+}
+
+/**
+ * @brief Binds the pages of a range of memory to the NUMA node of the
+ * calling thread. Pages that are already in memory are not moved.
+ * Binding is best effort, hosts without NUMA support ignore it.
+ * @param addr The start of the range, page-aligned.
+ * @param size The size of the range in bytes.
+ */
+void
+bind_to_current_node(void *addr, size_t size)
+{
+	unsigned long node_mask = 1ul << current_node();
+	syscall(SYS_mbind, addr, size, MPOL_BIND, &node_mask, sizeof(node_mask) * 8, 0);
+}
+
+/**
+ * @param size A size in bytes.
+ * @param alignment A power of two.
+ * @returns The size, rounded up to a multiple of the alignment.
+ */
+size_t
+align_up(size_t size, size_t alignment)
+{
+	return (size + alignment - 1) & ~(alignment - 1);
+}
+
+/**
+ * @param size The size of a region in bytes.
+ * @returns The size of the mapping of the region.
+ */
+size_t
+mapped_size(size_t size)
+{
+	return align_up(size, config.huge_pages == HUGE_PAGES_OFF
+		? sysconf(_SC_PAGESIZE) : HUGE_PAGE_SIZE);
+}
+
+/**
+ * @brief Allocates a memory region of a guest program according
+ * to the placement of this run. Mapped regions start out zeroed.
+ * Throws an error message if huge pages are requested but not available.
+ * @param size The size of the region in bytes.
+ * @param bind Whether the region belongs to a single instance of the
+ * program, so it may be bound to the NUMA node of the calling thread.
+ * Regions that are shared by the instances of many threads are not bound.
+ * @returns A pointer to the region. Must be freed with `free_region()`.
+ */
+uint8_t *
+allocate_region(size_t size, bool bind = true)
+{
+	if (!config.maps_regions())
+	{
+		return memory::allocate(size);
+	}
+
+	size_t length = mapped_size(size);
+	int flags     = MAP_PRIVATE | MAP_ANONYMOUS;
+	uint8_t *region;
+
+	if (config.huge_pages == HUGE_PAGES_EXPLICIT)
+	{
+		void *mapping = mmap(nullptr, length, PROT_READ | PROT_WRITE, flags | MAP_HUGETLB, -1, 0);
+
+		if (mapping == MAP_FAILED)
+		{
+			throw "Could not allocate " + std::to_string(length) + " bytes of huge pages: "
+				+ strerror(errno) + ", reserve more in /proc/sys/vm/nr_hugepages\n";
+		}
+
+		region = (uint8_t *) mapping;
+	}
+	else
+	{
+		// Transparent huge pages need a region aligned to the huge page size.
+		// Map more than needed and unmap the unaligned ends.
+
+		size_t alignment = config.huge_pages == HUGE_PAGES_TRANSPARENT ? HUGE_PAGE_SIZE : 0;
+		void *mapping    = mmap(nullptr, length + alignment, PROT_READ | PROT_WRITE, flags, -1, 0);
+
+		if (mapping == MAP_FAILED)
+		{
+			throw "Could not map " + std::to_string(length) + " bytes: " + strerror(errno) + "\n";
+		}
+
+		region      = (uint8_t *) align_up((size_t) mapping, alignment ? alignment : 1);
+		size_t head = region - (uint8_t *) mapping;
+		size_t tail = alignment - head;
+
+		if (head != 0)
+			munmap(mapping, head);
+
+		if (tail != 0)
+			munmap(region + length, tail);
+
+		if (config.huge_pages == HUGE_PAGES_TRANSPARENT)
+			madvise(region, length, MADV_HUGEPAGE);
+	}
+
+	if (bind && config.bind_to_local_node)
+	{
+		bind_to_current_node(region, length);
+	}
+
+	return region;
+}
+
+/**
+ * @brief Frees a region allocated with `allocate_region()`.
+ * @param region The region, or nullptr.
+ * @param size The size the region was allocated with.
+ */
+void
+free_region(uint8_t *region, size_t size)
+{
+	if (!config.maps_regions())
+	{
+		delete[] region;
+		return;
+	}
+
+	if (region != nullptr)
+	{
+		munmap(region, mapped_size(size));
+	}
+}
+
+/**
+ * @brief Applies the placement of this run to a large block of the host
+ * heap, allocated by the guest program. Its huge page aligned part is
+ * advised to use transparent huge pages, also with HUGE_PAGES_EXPLICIT,
+ * since heap memory cannot be moved to hugetlbfs. It is bound to the
+ * NUMA node of the calling thread if requested.
+ * Smaller blocks share pages with other blocks, so they are left alone.
+ * @param block The block, or nullptr.
+ * @param size The size of the block in bytes.
+ */
+void
+place_heap_block(void *block, size_t size)
+{
+	if (block == nullptr || size < HUGE_PAGE_SIZE || !config.maps_regions())
+	{
+		return;
+	}
+
+	uint8_t *start = (uint8_t *) align_up((size_t) block, HUGE_PAGE_SIZE);
+	uint8_t *end   = (uint8_t *) (((size_t) block + size) & ~(size_t) (HUGE_PAGE_SIZE - 1));
+
+	if (start >= end)
+	{
+		return;
+	}
+
+	if (config.huge_pages != HUGE_PAGES_OFF)
+	{
+		madvise(start, end - start, MADV_HUGEPAGE);
+	}
+
+	if (config.bind_to_local_node)
+	{
+		bind_to_current_node(start, end - start);
+	}
+}
+}
+
+#endif
@@ -0,0 +1,553 @@
+#ifndef TEA_PROFILER_HEADER
+#define TEA_PROFILER_HEADER
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "VM/cpu.hpp"
+#include "VM/symbolizer.hpp"
+
+struct Profiler;
+
+/**
+ * @brief The hooks of a CPU that is profiled by a `Profiler`.
+ * Fuel metering is supported, so a profiled program can be stopped
+ * like an unprofiled one. Guest threads are not profiled.
+ */
+struct ProfilerHooks : FuelHooks
+{
+	static constexpr bool USES_SUPERINSTRUCTIONS = false;
+
+	// The profiler to report to, or nullptr.
+	Profiler *profiler = nullptr;
+
+	template <typename CPU>
+	void
+	on_instruction(CPU &cpu, Instruction instruction);
+
+	template <typename CPU>
+	void
+	on_call(CPU &cpu, uint8_t *function);
+
+	template <typename CPU>
+	void
+	on_return(CPU &cpu);
+};
+
+// A CPU that is profiled by a `Profiler`.
+using ProfiledCPU = BasicCPU<ProfilerHooks>;
+
+/**
+ * @brief An instrumenting profiler for the virtual machine.
+ * Observes a CPU through its hooks and records per-function
+ * call counts, instruction counts and wall time, a per-opcode
+ * histogram, opcode pair and triple frequencies and folded call stacks.
+ * When a line table is loaded, instructions are also attributed
+ * to the source lines they were generated for.
+ */
+struct Profiler
+{
+	/**
+	 * @brief The profile of a single function.
+	 */
+	struct FunctionProfile
+	{
+		// The name of the function.
+		std::string name;
+
+		// The number of times the function was called.
+		uint64_t calls = 0;
+
+		// The number of instructions executed inside the function,
+		// including the functions it called.
+		uint64_t inclusive_instructions = 0;
+
+		// The number of instructions executed inside the function itself.
+		uint64_t exclusive_instructions = 0;
+
+		// The wall time spent inside the function in nanoseconds,
+		// including the functions it called.
+		uint64_t inclusive_ns = 0;
+
+		// The wall time spent inside the function itself in nanoseconds.
+		uint64_t exclusive_ns = 0;
+
+		// The number of active calls to the function.
+		// Inclusive counts of recursive calls are only recorded
+		// for the outermost call.
+		size_t active = 0;
+	};
+
+	/**
+	 * @brief A function call that is currently being executed.
+	 */
+	struct Frame
+	{
+		// The index of the function in `functions`.
+		size_t function_id;
+
+		// The instruction count at the start of the call.
+		uint64_t start_instructions;
+
+		// The number of instructions executed by callees.
+		uint64_t callee_instructions;
+
+		// The wall time at the start of the call.
+		std::chrono::steady_clock::time_point start_time;
+
+		// The wall time spent in callees, in nanoseconds.
+		uint64_t callee_ns;
+
+		// The length of the folded stack before this call was entered.
+		size_t parent_stack_length;
+	};
+
+	// The CPU to profile.
+	ProfiledCPU &cpu;
+
+	// Maps instruction addresses to function names.
+	Symbolizer symbolizer;
+
+	// The profiles of all called functions.
+	std::vector<FunctionProfile> functions;
+
+	// Maps function entry addresses to indices in `functions`.
+	std::unordered_map<uint8_t *, size_t> function_ids;
+
+	// The current call stack.
+	std::vector<Frame> frames;
+
+	// The current call stack, folded into a string of
+	// function names separated by semicolons.
+	std::string folded_stack;
+
+	// The number of instructions executed in each folded call stack.
+	std::map<std::string, uint64_t> folded_stacks;
+
+	// The instruction count at the last change of the call stack.
+	uint64_t folded_stack_start = 0;
+
+	// The total number of executed instructions.
+	uint64_t instructions = 0;
+
+	// The number of times each instruction was executed.
+	// Indexed by the offset of the instruction in the program.
+	std::vector<uint64_t> instruction_counts;
+
+	// The number of times each opcode was executed.
+	std::vector<uint64_t> opcode_counts;
+
+	// The number of times each opcode was followed by each opcode.
+	// Indexed by `first * INSTRUCTION_COUNT + second`.
+	std::vector<uint64_t> opcode_pair_counts;
+
+	// The number of times each pair of opcodes was followed by each opcode.
+	// Indexed by `(first * INSTRUCTION_COUNT + second) * INSTRUCTION_COUNT + third`.
+	std::unordered_map<uint64_t, uint64_t> opcode_triple_counts;
+
+	// The opcode of the previous instruction,
+	// or INSTRUCTION_COUNT before the first instruction.
+	uint16_t prev_instruction = INSTRUCTION_COUNT;
+
+	// The opcode of the instruction before the previous instruction,
+	// or INSTRUCTION_COUNT before the second instruction.
+	uint16_t prev_prev_instruction = INSTRUCTION_COUNT;
+
+	/**
+	 * @brief Constructs a new Profiler object.
+	 * @param cpu The CPU to profile. Reports to this profiler
+	 * while the profiler exists.
+	 */
+	Profiler(ProfiledCPU &cpu)
+		: cpu(cpu),
+		  symbolizer(cpu.program_location, cpu.program_size),
+		  instruction_counts(cpu.program_size, 0),
+		  opcode_counts(INSTRUCTION_COUNT, 0),
+		  opcode_pair_counts(INSTRUCTION_COUNT * INSTRUCTION_COUNT, 0)
+	{
+		cpu.hooks.profiler = this;
+	}
+
+	~Profiler()
+	{
+		cpu.hooks.profiler = nullptr;
+	}
+
+	/**
+	 * @brief Runs the executable until it crashes or completes,
+	 * while recording the profile.
+	 */
+	void
+	run()
+	{
+		if (frames.empty())
+		{
+			enter(cpu.program_location);
+		}
+
+		cpu.run();
+	}
+
+	/**
+	 * @brief Records the execution of an instruction.
+	 * @param instruction The opcode of the instruction.
+	 */
+	void
+	count(Instruction instruction)
+	{
+		instructions++;
+		instruction_counts[cpu.cur_instr_addr - cpu.program_location]++;
+		opcode_counts[instruction]++;
+
+		if (prev_instruction != INSTRUCTION_COUNT)
+		{
+			opcode_pair_counts[prev_instruction * INSTRUCTION_COUNT + instruction]++;
+		}
+
+		if (prev_prev_instruction != INSTRUCTION_COUNT)
+		{
+			opcode_triple_counts[((uint64_t) prev_prev_instruction * INSTRUCTION_COUNT
+				+ prev_instruction) * INSTRUCTION_COUNT + instruction]++;
+		}
+
+		prev_prev_instruction = prev_instruction;
+		prev_instruction      = instruction;
+	}
+
+	/**
+	 * @brief Records the entry of a function.
+	 * @param entry The address of the first instruction of the function.
+	 */
+	void
+	enter(uint8_t *entry)
+	{
+		auto it = function_ids.find(entry);
+		size_t function_id;
+
+		if (it == function_ids.end())
+		{
+			function_id         = functions.size();
+			function_ids[entry] = function_id;
+			functions.emplace_back();
+			functions.back().name = entry == cpu.program_location
+				? "[program]" : symbolizer.name_of_entry(entry);
+		}
+		else
+		{
+			function_id = it->second;
+		}
+
+		FunctionProfile &function = functions[function_id];
+		function.calls++;
+		function.active++;
+
+		fold_stack();
+		size_t parent_stack_length = folded_stack.size();
+
+		if (!folded_stack.empty())
+		{
+			folded_stack += ';';
+		}
+
+		folded_stack += function.name;
+
+		frames.push_back({ function_id, instructions, 0,
+			std::chrono::steady_clock::now(), 0, parent_stack_length });
+	}
+
+	/**
+	 * @brief Records the return from the current function.
+	 */
+	void
+	leave()
+	{
+		Frame frame               = frames.back();
+		FunctionProfile &function = functions[frame.function_id];
+		frames.pop_back();
+
+		std::chrono::nanoseconds elapsed_time = std::chrono::steady_clock::now() - frame.start_time;
+		uint64_t elapsed_ns                   = elapsed_time.count();
+		uint64_t elapsed_instructions         = instructions - frame.start_instructions;
+
+		function.exclusive_instructions += elapsed_instructions - frame.callee_instructions;
+		function.exclusive_ns += elapsed_ns - frame.callee_ns;
+
+		if (--function.active == 0)
+		{
+			function.inclusive_instructions += elapsed_instructions;
+			function.inclusive_ns += elapsed_ns;
+		}
+
+		if (!frames.empty())
+		{
+			frames.back().callee_instructions += elapsed_instructions;
+			frames.back().callee_ns += elapsed_ns;
+		}
+
+		fold_stack();
+		folded_stack.resize(frame.parent_stack_length);
+	}
+
+	/**
+	 * @brief Attributes the instructions executed since the last
+	 * change of the call stack to the current call stack.
+	 */
+	void
+	fold_stack()
+	{
+		if (instructions != folded_stack_start)
+		{
+			folded_stacks[folded_stack] += instructions - folded_stack_start;
+			folded_stack_start = instructions;
+		}
+	}
+
+	/**
+	 * @brief Ends all calls that are still active.
+	 * Must be called before writing the profile.
+	 */
+	void
+	finish()
+	{
+		while (!frames.empty())
+		{
+			leave();
+		}
+	}
+
+	/**
+	 * @brief Writes the profile in a human readable format.
+	 * @param file The file to write to.
+	 */
+	void
+	write_report(FILE *file)
+	{
+		// Functions, sorted by exclusive instruction count.
+
+		std::vector<const FunctionProfile *> sorted_functions;
+
+		for (const FunctionProfile &function : functions)
+		{
+			sorted_functions.push_back(&function);
+		}
+
+		std::sort(sorted_functions.begin(), sorted_functions.end(),
+			[](const FunctionProfile *a, const FunctionProfile *b)
+			{ return a->exclusive_instructions > b->exclusive_instructions; });
+
+		fprintf(file, "Functions (%lu instructions executed)\n\n", instructions);
+		fprintf(file, "%12s %16s %16s %8s %12s %12s    %s\n", "calls",
+			"incl. instrs", "excl. instrs", "excl. %", "incl. ms", "excl. ms",
+			"function");
+
+		for (const FunctionProfile *function : sorted_functions)
+		{
+			fprintf(file, "%12lu %16lu %16lu %7.2f%% %12.3f %12.3f    %s\n",
+				function->calls, function->inclusive_instructions,
+				function->exclusive_instructions,
+				percentage(function->exclusive_instructions),
+				function->inclusive_ns / 1e6, function->exclusive_ns / 1e6,
+				function->name.c_str());
+		}
+
+		// Source lines, sorted by execution count.
+
+		std::unordered_map<uint64_t, uint64_t> line_counts;
+
+		for (size_t offset = 0; offset < instruction_counts.size(); offset++)
+		{
+			if (instruction_counts[offset])
+			{
+				line_counts[symbolizer.lines.line_of(offset)] += instruction_counts[offset];
+			}
+		}
+
+		symbolizer.write_source_lines(file, "Source lines", line_counts, instructions);
+
+		// Opcodes, sorted by execution count.
+
+		std::vector<uint16_t> sorted_opcodes;
+
+		for (uint16_t opcode = 0; opcode < INSTRUCTION_COUNT; opcode++)
+		{
+			if (opcode_counts[opcode])
+			{
+				sorted_opcodes.push_back(opcode);
+			}
+		}
+
+		std::sort(sorted_opcodes.begin(), sorted_opcodes.end(),
+			[this](uint16_t a, uint16_t b)
+			{ return opcode_counts[a] > opcode_counts[b]; });
+
+		fprintf(file, "\nOpcodes\n\n");
+		fprintf(file, "%16s %8s    %s\n", "count", "%", "opcode");
+
+		for (uint16_t opcode : sorted_opcodes)
+		{
+			fprintf(file, "%16lu %7.2f%%    %s\n", opcode_counts[opcode],
+				percentage(opcode_counts[opcode]),
+				instruction_to_str((Instruction) opcode));
+		}
+
+		// Opcode pairs, sorted by execution count.
+
+		std::vector<size_t> sorted_pairs;
+
+		for (size_t pair = 0; pair < opcode_pair_counts.size(); pair++)
+		{
+			if (opcode_pair_counts[pair])
+			{
+				sorted_pairs.push_back(pair);
+			}
+		}
+
+		std::sort(sorted_pairs.begin(), sorted_pairs.end(),
+			[this](size_t a, size_t b)
+			{ return opcode_pair_counts[a] > opcode_pair_counts[b]; });
+
+		fprintf(file, "\nOpcode pairs\n\n");
+		fprintf(file, "%16s %8s    %s\n", "count", "%", "opcodes");
+
+		for (size_t pair : sorted_pairs)
+		{
+			fprintf(file, "%16lu %7.2f%%    %s %s\n", opcode_pair_counts[pair],
+				percentage(opcode_pair_counts[pair]),
+				instruction_to_str((Instruction) (pair / INSTRUCTION_COUNT)),
+				instruction_to_str((Instruction) (pair % INSTRUCTION_COUNT)));
+		}
+	}
+
+	/**
+	 * @brief Writes the folded call stacks, one call stack per line,
+	 * followed by the number of instructions executed in it.
+	 * This format can be read by flamegraph tooling.
+	 * @param file The file to write to.
+	 */
+	void
+	write_folded_stacks(FILE *file)
+	{
+		for (const std::pair<const std::string, uint64_t> &stack : folded_stacks)
+		{
+			fprintf(file, "%s %lu\n", stack.first.c_str(), stack.second);
+		}
+	}
+
+	/**
+	 * @brief Writes the execution counts of all opcode pairs and triples,
+	 * one sequence per line: the count, followed by the names of the opcodes.
+	 * This format is read by the superinstruction synthesizer.
+	 * @param file The file to write to.
+	 */
+	void
+	write_sequences(FILE *file)
+	{
+		for (size_t pair = 0; pair < opcode_pair_counts.size(); pair++)
+		{
+			if (opcode_pair_counts[pair])
+			{
+				fprintf(file, "%lu %s %s\n", opcode_pair_counts[pair],
+					instruction_to_str((Instruction) (pair / INSTRUCTION_COUNT)),
+					instruction_to_str((Instruction) (pair % INSTRUCTION_COUNT)));
+			}
+		}
+
+		for (const std::pair<const uint64_t, uint64_t> &triple : opcode_triple_counts)
+		{
+			fprintf(file, "%lu %s %s %s\n", triple.second,
+				instruction_to_str((Instruction) (triple.first / INSTRUCTION_COUNT / INSTRUCTION_COUNT)),
+				instruction_to_str((Instruction) (triple.first / INSTRUCTION_COUNT % INSTRUCTION_COUNT)),
+				instruction_to_str((Instruction) (triple.first % INSTRUCTION_COUNT)));
+		}
+	}
+
+	/**
+	 * @brief Writes the report to a file, the folded call stacks
+	 * to the same file name with ".folded" appended, and the opcode
+	 * sequences to the same file name with ".sequences" appended.
+	 * @param file_path The path of the report file.
+	 */
+	void
+	write(const std::string &file_path)
+	{
+		finish();
+
+		FILE *report_file = fopen(file_path.c_str(), "w");
+
+		if (report_file == nullptr)
+		{
+			throw std::string("Could not open profile file ") + file_path + "\n";
+		}
+
+		write_report(report_file);
+		fclose(report_file);
+
+		std::string folded_file_path = file_path + ".folded";
+		FILE *folded_file            = fopen(folded_file_path.c_str(), "w");
+
+		if (folded_file == nullptr)
+		{
+			throw std::string("Could not open profile file ") + folded_file_path + "\n";
+		}
+
+		write_folded_stacks(folded_file);
+		fclose(folded_file);
+
+		std::string sequences_file_path = file_path + ".sequences";
+		FILE *sequences_file            = fopen(sequences_file_path.c_str(), "w");
+
+		if (sequences_file == nullptr)
+		{
+			throw std::string("Could not open profile file ") + sequences_file_path + "\n";
+		}
+
+		write_sequences(sequences_file);
+		fclose(sequences_file);
+	}
+
+	/**
+	 * @param count A number of instructions.
+	 * @returns The percentage of all executed instructions.
+	 */
+	double
+	percentage(uint64_t count) const
+	{
+		return instructions ? 100.0 * count / instructions : 0.0;
+	}
+};
+
+template <typename CPU>
+void
+ProfilerHooks::on_instruction(CPU &cpu, Instruction instruction)
+{
+	if (profiler != nullptr)
+	{
+		profiler->count(instruction);
+	}
+}
+
+template <typename CPU>
+void
+ProfilerHooks::on_call(CPU &cpu, uint8_t *function)
+{
+	if (profiler != nullptr)
+	{
+		profiler->enter(function);
+	}
+}
+
+template <typename CPU>
+void
+ProfilerHooks::on_return(CPU &cpu)
+{
+	if (profiler != nullptr && profiler->frames.size() > 1)
+	{
+		profiler->leave();
+	}
+}
+
+#endif
@@ -0,0 +1,478 @@
+#ifndef TEA_SAMPLER_HEADER
+#define TEA_SAMPLER_HEADER
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <pthread.h>
+#include <ctime>
+
+#include "VM/cpu.hpp"
+#include "VM/symbolizer.hpp"
+
+// The maximum number of frames recorded per sample.
+// Deeper call stacks are truncated at their outermost frames.
+#define SAMPLER_MAX_DEPTH 128
+
+// The number of 64-bit words in the sample ring buffer.
+// Must be a power of two.
+#define SAMPLER_RING_SIZE (1 << 20)
+
+// The interval at which the ring buffer is drained, in milliseconds.
+#define SAMPLER_DRAIN_INTERVAL_MS 20
+
+/**
+ * @brief A single-producer single-consumer ring buffer of samples.
+ * The producer is the signal handler, the consumer is the drain thread.
+ * Each sample is stored as its weight and frame count, followed by the
+ * addresses of the frames, innermost frame first.
+ * Samples that don't fit into the buffer are dropped.
+ */
+struct SampleRing
+{
+	static_assert(std::atomic<uint64_t>::is_always_lock_free,
+		"Sampling requires lock-free 64-bit atomics");
+
+	// The sample words.
+	uint64_t *words;
+
+	// The number of words ever written. Only written by the producer.
+	std::atomic<uint64_t> write_pos { 0 };
+
+	// The number of words ever read. Only written by the consumer.
+	std::atomic<uint64_t> read_pos { 0 };
+
+	// The number of samples that were dropped because the buffer was full.
+	std::atomic<uint64_t> dropped { 0 };
+
+	SampleRing()
+		: words(new uint64_t[SAMPLER_RING_SIZE]) {}
+
+	~SampleRing()
+	{
+		delete[] words;
+	}
+
+	/**
+	 * @brief Appends a sample to the buffer.
+	 * Async-signal-safe.
+	 * @param frames The addresses of the frames of the sample.
+	 * @param depth The number of frames.
+	 * @param weight The number of sampling periods the sample stands for.
+	 */
+	void
+	push(uint8_t *const *frames, size_t depth, uint64_t weight)
+	{
+		uint64_t write = write_pos.load(std::memory_order_relaxed);
+		uint64_t read  = read_pos.load(std::memory_order_acquire);
+
+		if (write - read + depth + 2 > SAMPLER_RING_SIZE)
+		{
+			dropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+
+		words[write++ & (SAMPLER_RING_SIZE - 1)] = weight;
+		words[write++ & (SAMPLER_RING_SIZE - 1)] = depth;
+
+		for (size_t i = 0; i < depth; i++)
+		{
+			words[write++ & (SAMPLER_RING_SIZE - 1)] = (uint64_t) frames[i];
+		}
+
+		write_pos.store(write, std::memory_order_release);
+	}
+
+	/**
+	 * @brief Removes all complete samples from the buffer.
+	 * @param callback Called with the frames and the weight of each sample.
+	 */
+	template <typename Callback>
+	void
+	drain(Callback callback)
+	{
+		uint64_t write = write_pos.load(std::memory_order_acquire);
+		uint64_t read  = read_pos.load(std::memory_order_relaxed);
+		std::vector<uint8_t *> frames;
+
+		while (read < write)
+		{
+			uint64_t weight = words[read++ & (SAMPLER_RING_SIZE - 1)];
+			size_t depth    = words[read++ & (SAMPLER_RING_SIZE - 1)];
+			frames.clear();
+
+			for (size_t i = 0; i < depth; i++)
+			{
+				frames.push_back((uint8_t *) words[read++ & (SAMPLER_RING_SIZE - 1)]);
+			}
+
+			callback(frames, weight);
+		}
+
+		read_pos.store(read, std::memory_order_release);
+	}
+};
+
+/**
+ * @brief A statistical profiler for the virtual machine.
+ * A profiling timer periodically interrupts the VM. The signal handler
+ * records the current instruction and walks the chain of frame pointers
+ * to collect the return addresses of all active calls. Samples are
+ * written to a lock-free ring buffer, which is drained by a background
+ * thread that aggregates identical call stacks. Symbolization happens
+ * only when the report is written, so the VM itself is barely slowed down.
+ * @tparam Hooks The hooks of the CPU to sample.
+ */
+template <typename Hooks>
+struct Sampler
+{
+	// The CPU to sample.
+	BasicCPU<Hooks> &cpu;
+
+	// Maps instruction addresses to function names and source lines.
+	Symbolizer symbolizer;
+
+	// The sampling frequency in Hz.
+	uint64_t frequency;
+
+	// The ring buffer the signal handler writes to.
+	SampleRing ring;
+
+	// The number of occurrences of each call stack.
+	// Call stacks are stored innermost frame first.
+	std::map<std::vector<uint8_t *>, uint64_t> stacks;
+
+	// The total number of samples taken, counting the sampling periods
+	// that passed without a signal, see `handle_signal()`.
+	uint64_t samples = 0;
+
+	// The number of signals that took a sample.
+	uint64_t signals = 0;
+
+	// The thread that drains the ring buffer.
+	std::thread drain_thread;
+
+	// Tells the drain thread to stop.
+	std::atomic<bool> stopping { false };
+
+	// The profiling timer, valid if `timer_created` is set.
+	timer_t timer;
+
+	// Whether the profiling timer was created.
+	bool timer_created = false;
+
+	// The sampler the signal handler writes to.
+	static inline Sampler *active_sampler = nullptr;
+
+	/**
+	 * @brief Constructs a new Sampler object.
+	 * @param cpu The CPU to sample.
+	 * @param frequency The sampling frequency in Hz.
+	 */
+	Sampler(BasicCPU<Hooks> &cpu, uint64_t frequency)
+		: cpu(cpu),
+		  symbolizer(cpu.program_location, cpu.program_size),
+		  frequency(frequency) {}
+
+	/**
+	 * @brief Installs the signal handler, starts the drain thread
+	 * and arms the profiling timer.
+	 * Throws an error message if the timer cannot be armed.
+	 */
+	void
+	start()
+	{
+		active_sampler = this;
+
+		struct sigaction action = {};
+		action.sa_handler       = handle_signal;
+		action.sa_flags         = SA_RESTART;
+		sigemptyset(&action.sa_mask);
+		sigaction(SIGPROF, &action, nullptr);
+
+		// The drain thread inherits a signal mask that blocks SIGPROF,
+		// so the signal is always delivered to the thread running the VM.
+
+		sigset_t prof_set, old_set;
+		sigemptyset(&prof_set);
+		sigaddset(&prof_set, SIGPROF);
+		pthread_sigmask(SIG_BLOCK, &prof_set, &old_set);
+
+		drain_thread = std::thread([this]()
+		{
+			while (!stopping.load(std::memory_order_relaxed))
+			{
+				std::this_thread::sleep_for(
+					std::chrono::milliseconds(SAMPLER_DRAIN_INTERVAL_MS));
+				drain();
+			}
+		});
+
+		pthread_sigmask(SIG_SETMASK, &old_set, nullptr);
+
+		// The timer measures the CPU time of the process. Its signal is
+		// process-directed, so it goes to a thread that does not block it.
+
+		struct sigevent event = {};
+		event.sigev_notify    = SIGEV_SIGNAL;
+		event.sigev_signo     = SIGPROF;
+
+		if (timer_create(CLOCK_PROCESS_CPUTIME_ID, &event, &timer) != 0)
+		{
+			int error = errno;
+			stop();
+			throw std::string("Could not start the sampling profiler: ")
+				+ strerror(error) + "\n";
+		}
+
+		timer_created = true;
+
+		// tv_nsec must be below one second, so longer periods
+		// are split into seconds and nanoseconds.
+
+		uint64_t period_ns = std::max<uint64_t>(1000000000 / frequency, 1);
+
+		struct itimerspec spec = {};
+		spec.it_interval.tv_sec  = period_ns / 1000000000;
+		spec.it_interval.tv_nsec = period_ns % 1000000000;
+		spec.it_value            = spec.it_interval;
+
+		if (timer_settime(timer, 0, &spec, nullptr) != 0)
+		{
+			int error = errno;
+			stop();
+			throw std::string("Could not start the sampling profiler: ")
+				+ strerror(error) + "\n";
+		}
+	}
+
+	/**
+	 * @brief Disarms the profiling timer, stops the drain thread
+	 * and collects the remaining samples.
+	 */
+	void
+	stop()
+	{
+		if (timer_created)
+		{
+			timer_delete(timer);
+			timer_created = false;
+		}
+
+		signal(SIGPROF, SIG_IGN);
+		active_sampler = nullptr;
+
+		if (drain_thread.joinable())
+		{
+			stopping.store(true, std::memory_order_relaxed);
+			drain_thread.join();
+		}
+
+		drain();
+	}
+
+	/**
+	 * @brief Moves all samples from the ring buffer into `stacks`.
+	 */
+	void
+	drain()
+	{
+		ring.drain([this](const std::vector<uint8_t *> &frames, uint64_t weight)
+		{
+			stacks[frames] += weight;
+			samples += weight;
+			signals++;
+		});
+	}
+
+	/**
+	 * @brief The handler of the profiling timer signal.
+	 * Takes a sample of the VM of the active sampler.
+	 * The layout of a stack frame is known from `CPU::push_stack_frame()`:
+	 * the frame pointer points right after the saved frame pointer,
+	 * which is preceded by the return address.
+	 */
+	static void
+	handle_signal(int)
+	{
+		Sampler *sampler = active_sampler;
+
+		if (sampler == nullptr)
+		{
+			return;
+		}
+
+		BasicCPU<Hooks> &cpu = sampler->cpu;
+		uint8_t *frames[SAMPLER_MAX_DEPTH];
+		size_t depth = 0;
+
+		frames[depth++]  = cpu.cur_instr_addr;
+		uint8_t *fp      = cpu.get_frame_ptr();
+		uint8_t *program = cpu.program_location;
+
+		while (depth < SAMPLER_MAX_DEPTH && fp >= cpu.stack_top + 16 && fp <= cpu.stack_bottom)
+		{
+			uint8_t *saved_fp = memory::get<uint8_t *>(fp - 8);
+			uint8_t *ret_addr = memory::get<uint8_t *>(fp - 16);
+
+			if (ret_addr <= program || ret_addr > program + cpu.program_size)
+			{
+				break;
+			}
+
+			// The return address points past the CALL instruction,
+			// step back into it so it is attributed to the caller.
+
+			frames[depth++] = ret_addr - 1;
+
+			// Frames only grow upwards, a saved frame pointer that
+			// does not lie below the current one is corrupt.
+
+			if (saved_fp >= fp)
+			{
+				break;
+			}
+
+			fp = saved_fp;
+		}
+
+		// A CPU time timer expires at most once per scheduler tick, which
+		// can be less often than the sampling frequency. The periods that
+		// passed since the previous signal are counted as overruns, they
+		// are attributed to the current call stack.
+
+		int overruns = timer_getoverrun(sampler->timer);
+		sampler->ring.push(frames, depth, 1 + std::max(overruns, 0));
+	}
+
+	/**
+	 * @brief Gets the name of the function that contains an instruction.
+	 * Without debug symbols, the offset of the instruction is used.
+	 * @param addr The address of the instruction.
+	 * @returns The name of the function.
+	 */
+	std::string
+	frame_name(uint8_t *addr) const
+	{
+		if (symbolizer.symbols.empty())
+		{
+			char name[32];
+			snprintf(name, sizeof(name), "0x%lx", (size_t) (addr - cpu.program_location));
+			return name;
+		}
+
+		return symbolizer.name_of(addr);
+	}
+
+	/**
+	 * @brief Writes the profile to a file, and the folded call stacks
+	 * to the same file name with ".folded" appended.
+	 * @param file_path The path of the report file.
+	 */
+	void
+	write(const std::string &file_path)
+	{
+		// Aggregate self and total samples per function.
+		// A function that occurs multiple times in one call stack
+		// is counted once towards its total.
+
+		std::unordered_map<std::string, uint64_t> self_samples;
+		std::unordered_map<std::string, uint64_t> total_samples;
+		std::map<std::string, uint64_t> folded_stacks;
+		std::unordered_map<uint64_t, uint64_t> line_counts;
+
+		for (const auto &[frames, count] : stacks)
+		{
+			std::vector<std::string> names;
+
+			for (uint8_t *frame : frames)
+			{
+				names.push_back(frame_name(frame));
+			}
+
+			self_samples[names.front()] += count;
+			line_counts[symbolizer.line_of(frames.front())] += count;
+
+			std::vector<std::string> unique_names = names;
+			std::sort(unique_names.begin(), unique_names.end());
+			unique_names.erase(std::unique(unique_names.begin(), unique_names.end()),
+				unique_names.end());
+
+			for (const std::string &name : unique_names)
+			{
+				total_samples[name] += count;
+			}
+
+			std::string folded_stack;
+
+			for (size_t i = names.size(); i-- > 0;)
+			{
+				folded_stack += names[i];
+
+				if (i != 0)
+				{
+					folded_stack += ';';
+				}
+			}
+
+			folded_stacks[folded_stack] += count;
+		}
+
+		std::vector<std::pair<std::string, uint64_t>> sorted_functions(
+			total_samples.begin(), total_samples.end());
+
+		std::sort(sorted_functions.begin(), sorted_functions.end(),
+			[&self_samples](const auto &a, const auto &b)
+			{ return self_samples[a.first] > self_samples[b.first]; });
+
+		FILE *report_file = fopen(file_path.c_str(), "w");
+
+		if (report_file == nullptr)
+		{
+			throw std::string("Could not open profile file ") + file_path + "\n";
+		}
+
+		fprintf(report_file, "Functions (%lu samples at %lu Hz from %lu signals, %lu dropped)\n\n",
+			samples, frequency, signals, ring.dropped.load());
+		fprintf(report_file, "%12s %8s %12s %8s    %s\n", "self", "self %",
+			"total", "total %", "function");
+
+		for (const auto &[name, total] : sorted_functions)
+		{
+			uint64_t self = self_samples[name];
+
+			fprintf(report_file, "%12lu %7.2f%% %12lu %7.2f%%    %s\n", self,
+				samples ? 100.0 * self / samples : 0.0, total,
+				samples ? 100.0 * total / samples : 0.0, name.c_str());
+		}
+
+		symbolizer.write_source_lines(report_file, "Source lines", line_counts, samples);
+
+		fclose(report_file);
+
+		std::string folded_file_path = file_path + ".folded";
+		FILE *folded_file            = fopen(folded_file_path.c_str(), "w");
+
+		if (folded_file == nullptr)
+		{
+			throw std::string("Could not open profile file ") + folded_file_path + "\n";
+		}
+
+		for (const auto &[stack, count] : folded_stacks)
+		{
+			fprintf(folded_file, "%s %lu\n", stack.c_str(), count);
+		}
+
+		fclose(folded_file);
+	}
+};
+
+#endif
@@ -0,0 +1,548 @@
+#ifndef TEA_SCHEDULER_HEADER
+#define TEA_SCHEDULER_HEADER
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <cstdio>
+
+#include "VM/cpu.hpp"
+
+// The default amount of fuel a job may consume before
+// it is preempted and the next job of its worker runs.
+#define SCHEDULER_DEFAULT_BUDGET 10000
+
+// The stack size of the CPU of each job in bytes.
+#define SCHEDULER_STACK_SIZE 1024 * 1024 // 1MB
+
+// The maximum number of started jobs per worker.
+// A worker only starts a new job if it has fewer jobs than this.
+#define SCHEDULER_MAX_RESIDENT_JOBS 64
+
+/**
+ * @brief An executable that is loaded once and run by many CPUs.
+ * The program segment and the resolved native functions are shared
+ * read-only by the CPUs of all jobs that run the executable.
+ */
+struct SharedProgram
+{
+	// The loaded executable.
+	Executable executable;
+
+	// The resolved native functions of the executable.
+	std::vector<NativeFunction> native_functions;
+
+	// The program segment, shared by the CPUs of all jobs.
+	uint8_t *program_region;
+
+	// The fuel costs of the program, shared by the CPUs of all jobs.
+	std::shared_ptr<const FuelCosts> fuel_costs;
+
+	/**
+	 * @brief Loads an executable and resolves its native functions.
+	 * Throws an error message if the executable cannot be loaded.
+	 * @param file_path The path of the executable.
+	 */
+	SharedProgram(const char *file_path)
+		: executable(Executable::from_file(file_path)),
+		  native_functions(NativeFunction::resolve_all(executable.native_imports))
+	{
+		program_region = placement::allocate_region(executable.program_size, false);
+		memcpy(program_region, executable.data + executable.static_data_size,
+			executable.program_size);
+		rewrite_superinstructions(program_region, executable.program_size);
+		fuel_costs = std::make_shared<const FuelCosts>(program_region,
+			executable.program_size);
+	}
+
+	SharedProgram(const SharedProgram &) = delete;
+	SharedProgram &operator=(const SharedProgram &) = delete;
+
+	~SharedProgram()
+	{
+		placement::free_region(program_region, executable.program_size);
+	}
+};
+
+/**
+ * @brief A single run of an executable on an input.
+ * The CPU of a job is created when the job first runs.
+ * Its character I/O is redirected to in-memory buffers.
+ */
+struct BatchJob
+{
+	// The position of the job in the job list.
+	size_t index;
+
+	// The path of the executable.
+	std::string executable_path;
+
+	// The executable, or nullptr if it could not be loaded.
+	std::shared_ptr<SharedProgram> program;
+
+	// The input of the job, read by the program through GET_CHAR.
+	std::string input;
+
+	// The number of characters of the input that were read.
+	size_t input_pos = 0;
+
+	// The output of the job, written by the program through PRINT_CHAR.
+	std::string output;
+
+	// The CPU that runs the job, or nullptr if the job has not started.
+	std::unique_ptr<MeteredCPU> cpu;
+
+	// The fuel the job may still consume in later time slices.
+	uint64_t fuel_left;
+
+	// A description of the error if the job failed.
+	std::string error;
+
+	/**
+	 * @brief Appends a character to the output of a job.
+	 * @param job The job.
+	 * @param c The character.
+	 */
+	static void
+	print_char(void *job, uint8_t c)
+	{
+		((BatchJob *) job)->output += c;
+	}
+
+	/**
+	 * @brief Reads the next character of the input of a job.
+	 * @param job The job.
+	 * @returns The character, or EOF at the end of the input.
+	 */
+	static int
+	get_char(void *job)
+	{
+		BatchJob *self = (BatchJob *) job;
+
+		if (self->input_pos == self->input.size())
+		{
+			return EOF;
+		}
+
+		return (uint8_t) self->input[self->input_pos++];
+	}
+};
+
+/**
+ * @brief A thread of the scheduler that runs jobs.
+ * Every job in the run queue of a worker has a CPU. The worker runs the
+ * job at the front of its queue for one time slice, and puts it back at
+ * the end of the queue if it did not complete.
+ */
+struct Worker
+{
+	// Protects the run queue, which other workers steal from.
+	std::mutex mutex;
+
+	// The started jobs of this worker that are waiting for a time slice.
+	std::deque<BatchJob *> run_queue;
+
+	// The number of time slices this worker ran.
+	uint64_t slices = 0;
+
+	// The number of jobs this worker stole from other workers.
+	uint64_t steals = 0;
+
+	// The NUMA node the worker runs on if the memory of jobs is bound
+	// to their node, see `MemoryPlacement::bind_to_local_node`.
+	unsigned node = 0;
+
+	// The OS thread of the worker.
+	std::thread thread;
+};
+
+/**
+ * @brief Runs a batch of jobs on a fixed pool of worker threads.
+ * Each worker multiplexes many CPUs and preempts them when the fuel
+ * of their time slice runs out, so long-running jobs don't starve
+ * short ones. Jobs can be given a hard fuel limit.
+ * New jobs are handed out from a shared queue. A worker that runs
+ * out of jobs steals started jobs from the back of the run queues
+ * of other workers. Executables are loaded only once.
+ * If the memory of jobs is bound to NUMA nodes, the workers are spread
+ * over the nodes and prefer to steal jobs from workers on their own node.
+ */
+struct Scheduler
+{
+	// All jobs, in the order of the job list.
+	std::vector<BatchJob> jobs;
+
+	// The index of the next job that has not been started.
+	std::atomic<size_t> next_job { 0 };
+
+	// The number of jobs that have not completed.
+	std::atomic<size_t> remaining_jobs { 0 };
+
+	// The number of jobs that failed.
+	std::atomic<size_t> failed_jobs { 0 };
+
+	// The workers.
+	std::vector<std::unique_ptr<Worker>> workers;
+
+	// The fuel of a time slice.
+	uint64_t budget;
+
+	// The fuel limit of each job.
+	uint64_t job_fuel;
+
+	// Protects stdout, to which the results of the jobs are written.
+	std::mutex output_mutex;
+
+	/**
+	 * @brief Constructs a new Scheduler object.
+	 * @param worker_count The number of worker threads.
+	 * @param budget The fuel of a time slice.
+	 * @param job_fuel The fuel limit of each job.
+	 */
+	Scheduler(size_t worker_count, uint64_t budget, uint64_t job_fuel = UINT64_MAX)
+		: budget(budget),
+		  job_fuel(job_fuel)
+	{
+		std::vector<unsigned> nodes = placement::online_nodes();
+
+		for (size_t i = 0; i < worker_count; i++)
+		{
+			workers.push_back(std::make_unique<Worker>());
+			workers.back()->node = nodes[i % nodes.size()];
+		}
+	}
+
+	/**
+	 * @brief Reads a job list. Each non-empty line that does not start
+	 * with '#' describes one job: the path of an executable, optionally
+	 * followed by the path of a file that is used as its input.
+	 * Each executable is loaded once, jobs whose executable or input
+	 * cannot be read fail when they are run.
+	 * Throws an error message if the job list cannot be read.
+	 * @param job_list_path The path of the job list, or "-" for stdin.
+	 */
+	void
+	load_jobs(const std::string &job_list_path)
+	{
+		std::ifstream job_list_file;
+		std::istream *job_list = &std::cin;
+
+		if (job_list_path != "-")
+		{
+			job_list_file.open(job_list_path);
+
+			if (!job_list_file)
+			{
+				throw std::string("Could not open job list ") + job_list_path + "\n";
+			}
+
+			job_list = &job_list_file;
+		}
+
+		std::unordered_map<std::string, std::shared_ptr<SharedProgram>> programs;
+		std::unordered_map<std::string, std::string> load_errors;
+		std::string line;
+
+		while (getline(*job_list, line))
+		{
+			std::istringstream line_stream(line);
+			std::string executable_path;
+			std::string input_path;
+
+			if (!(line_stream >> executable_path) || executable_path[0] == '#')
+			{
+				continue;
+			}
+
+			line_stream >> input_path;
+
+			BatchJob &job       = jobs.emplace_back();
+			job.index           = jobs.size() - 1;
+			job.executable_path = executable_path;
+			job.fuel_left       = job_fuel;
+
+			if (!programs.count(executable_path) && !load_errors.count(executable_path))
+			{
+				try
+				{
+					programs[executable_path] = std::make_shared<SharedProgram>(
+						executable_path.c_str());
+				}
+				catch (const std::string &err_message)
+				{
+					load_errors[executable_path] = err_message;
+				}
+			}
+
+			if (programs.count(executable_path))
+			{
+				job.program = programs[executable_path];
+			}
+			else
+			{
+				job.error = load_errors[executable_path];
+			}
+
+			if (input_path.size())
+			{
+				std::ifstream input_file(input_path, std::ios::binary);
+
+				if (!input_file)
+				{
+					job.error = "Could not open input file " + input_path + "\n";
+				}
+
+				job.input.assign(std::istreambuf_iterator<char>(input_file),
+					std::istreambuf_iterator<char>());
+			}
+		}
+
+		remaining_jobs = jobs.size();
+	}
+
+	/**
+	 * @brief Gets the next job a worker should run.
+	 * Starts a new job if the worker has room for one,
+	 * otherwise takes the job at the front of its run queue.
+	 * If the worker has no jobs, steals one from another worker.
+	 * @param worker_id The index of the worker.
+	 * @returns The job, or nullptr if there is nothing to run.
+	 */
+	BatchJob *
+	next_job_for(size_t worker_id)
+	{
+		Worker &worker = *workers[worker_id];
+
+		{
+			std::lock_guard<std::mutex> lock(worker.mutex);
+
+			if (worker.run_queue.size() < SCHEDULER_MAX_RESIDENT_JOBS
+				&& next_job.load(std::memory_order_relaxed) < jobs.size())
+			{
+				size_t index = next_job.fetch_add(1);
+
+				if (index < jobs.size())
+				{
+					return &jobs[index];
+				}
+			}
+
+			if (worker.run_queue.size())
+			{
+				BatchJob *job = worker.run_queue.front();
+				worker.run_queue.pop_front();
+				return job;
+			}
+		}
+
+		// Steal from the back of the queue of another worker,
+		// that job would have been the last to get a time slice there.
+		// Jobs on the same NUMA node are stolen first, their memory
+		// is local to this worker.
+
+		for (bool same_node : { true, false })
+		{
+			for (size_t i = 1; i < workers.size(); i++)
+			{
+				Worker &victim = *workers[(worker_id + i) % workers.size()];
+
+				if ((victim.node == worker.node) != same_node)
+				{
+					continue;
+				}
+
+				std::lock_guard<std::mutex> lock(victim.mutex);
+
+				if (victim.run_queue.size())
+				{
+					BatchJob *job = victim.run_queue.back();
+					victim.run_queue.pop_back();
+					worker.steals++;
+					return job;
+				}
+			}
+		}
+
+		return nullptr;
+	}
+
+	/**
+	 * @brief Runs a job for one time slice.
+	 * Creates the CPU of the job if it has not started yet.
+	 * The job fails when it reaches its fuel limit.
+	 * @param job The job.
+	 * @returns True if the job completed or failed.
+	 */
+	bool
+	run_slice(BatchJob &job)
+	{
+		if (job.error.size())
+		{
+			return true;
+		}
+
+		try
+		{
+			if (job.cpu == nullptr)
+			{
+				job.cpu = std::make_unique<MeteredCPU>(job.program->executable,
+					job.program->program_region, job.program->native_functions,
+					SCHEDULER_STACK_SIZE);
+
+				job.cpu->print_char_callback = BatchJob::print_char;
+				job.cpu->get_char_callback   = BatchJob::get_char;
+				job.cpu->io_context          = &job;
+				job.cpu->enable_fuel(0, job.program->fuel_costs);
+			}
+
+			uint64_t slice_fuel = std::min(budget, job.fuel_left);
+			job.fuel_left -= slice_fuel;
+			job.cpu->add_fuel(slice_fuel);
+			job.cpu->run();
+
+			if (!job.cpu->out_of_fuel)
+			{
+				return true;
+			}
+
+			if (job.fuel_left == 0)
+			{
+				job.error = "Out of fuel\n";
+				return true;
+			}
+
+			return false;
+		}
+		catch (const std::string &err_message)
+		{
+			job.error = err_message;
+			return true;
+		}
+	}
+
+	/**
+	 * @brief Writes the result of a completed job to stdout
+	 * and frees its resources.
+	 * The result line is followed by the output of the job.
+	 * @param job The job.
+	 */
+	void
+	finish(BatchJob &job)
+	{
+		{
+			std::lock_guard<std::mutex> lock(output_mutex);
+
+			if (job.error.size())
+			{
+				failed_jobs++;
+				printf("job %lu %s failed after %lu bytes of output: %s",
+					job.index, job.executable_path.c_str(), job.output.size(),
+					job.error.c_str());
+			}
+			else
+			{
+				printf("job %lu %s exited with exit code %lu, %lu bytes of output\n",
+					job.index, job.executable_path.c_str(), job.cpu->regs[R_RET],
+					job.output.size());
+			}
+
+			fwrite(job.output.data(), 1, job.output.size(), stdout);
+		}
+
+		job.cpu.reset();
+		job.program.reset();
+		std::string().swap(job.input);
+		std::string().swap(job.output);
+	}
+
+	/**
+	 * @brief The main loop of a worker thread.
+	 * Runs jobs until all jobs have completed.
+	 * @param worker_id The index of the worker.
+	 */
+	void
+	work(size_t worker_id)
+	{
+		Worker &worker = *workers[worker_id];
+
+		// The CPUs of the jobs this worker starts are bound to its node.
+
+		if (placement::config.bind_to_local_node)
+		{
+			placement::pin_thread_to_node(worker.node);
+		}
+
+		while (remaining_jobs.load(std::memory_order_acquire) != 0)
+		{
+			BatchJob *job = next_job_for(worker_id);
+
+			if (job == nullptr)
+			{
+				// The remaining jobs are running on other workers.
+
+				std::this_thread::yield();
+				continue;
+			}
+
+			worker.slices++;
+
+			if (run_slice(*job))
+			{
+				finish(*job);
+				remaining_jobs.fetch_sub(1, std::memory_order_release);
+			}
+			else
+			{
+				std::lock_guard<std::mutex> lock(worker.mutex);
+				worker.run_queue.push_back(job);
+			}
+		}
+	}
+
+	/**
+	 * @brief Runs all jobs and waits until they have completed.
+	 * Writes a summary to stderr.
+	 */
+	void
+	run()
+	{
+		auto start = std::chrono::steady_clock::now();
+
+		for (size_t i = 0; i < workers.size(); i++)
+		{
+			workers[i]->thread = std::thread(&Scheduler::work, this, i);
+		}
+
+		uint64_t slices = 0;
+		uint64_t steals = 0;
+
+		for (std::unique_ptr<Worker> &worker : workers)
+		{
+			worker->thread.join();
+			slices += worker->slices;
+			steals += worker->steals;
+		}
+
+		fflush(stdout);
+
+		double seconds = std::chrono::duration<double>(
+			std::chrono::steady_clock::now() - start).count();
+
+		fprintf(stderr, "Ran %lu jobs (%lu failed) on %lu workers in %.3f s, "
+			"%.0f jobs/s, %lu time slices, %lu steals\n", jobs.size(),
+			failed_jobs.load(), workers.size(), seconds,
+			seconds > 0 ? jobs.size() / seconds : 0.0, slices, steals);
+	}
+};
+
+#endif
@@ -0,0 +1,518 @@
+#ifndef TEA_STATS_HEADER
+#define TEA_STATS_HEADER
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <malloc.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "VM/cpu.hpp"
+
+// Identifies a stats page, "TEASTATS" in little endian.
+#define STATS_MAGIC 0x5354415453414554
+
+// The version of the layout of a stats page.
+#define STATS_VERSION 1
+
+// The number of instructions between two checks of the clock.
+#define STATS_BATCH_SIZE (1 << 16)
+
+// The minimum time between two updates of a stats page.
+#define STATS_UPDATE_INTERVAL_NS 10000000 // 10ms
+
+/**
+ * @brief The classes of instructions counted by a stats page.
+ */
+enum OpcodeClass
+{
+	OPCODE_CLASS_MOVE,
+	OPCODE_CLASS_MEMORY,
+	OPCODE_CLASS_ARITHMETIC,
+	OPCODE_CLASS_COMPARE,
+	OPCODE_CLASS_JUMP,
+	OPCODE_CLASS_STACK,
+	OPCODE_CLASS_CALL,
+	OPCODE_CLASS_IO,
+	OPCODE_CLASS_OTHER,
+
+	OPCODE_CLASS_COUNT
+};
+
+/**
+ * @param opcode_class A class of instructions.
+ * @returns The name of the class.
+ */
+const char *
+opcode_class_to_str(OpcodeClass opcode_class)
+{
+	switch (opcode_class)
+	{
+	case OPCODE_CLASS_MOVE:
+		return "move";
+
+	case OPCODE_CLASS_MEMORY:
+		return "memory";
+
+	case OPCODE_CLASS_ARITHMETIC:
+		return "arithmetic";
+
+	case OPCODE_CLASS_COMPARE:
+		return "compare";
+
+	case OPCODE_CLASS_JUMP:
+		return "jump";
+
+	case OPCODE_CLASS_STACK:
+		return "stack";
+
+	case OPCODE_CLASS_CALL:
+		return "call";
+
+	case OPCODE_CLASS_IO:
+		return "i/o";
+
+	default:
+		return "other";
+	}
+}
+
+/**
+ * @param instruction An instruction.
+ * @returns The class of the instruction. Relies on the order of the
+ * `Instruction` enum, which groups instructions by what they do.
+ */
+OpcodeClass
+opcode_class_of(Instruction instruction)
+{
+	if (instruction <= MOVE)
+		return OPCODE_CLASS_MOVE;
+
+	if (instruction <= MEM_COPY)
+		return OPCODE_CLASS_MEMORY;
+
+	if (instruction <= CAST_FLT_64_TO_INT)
+		return OPCODE_CLASS_ARITHMETIC;
+
+	if (instruction <= SET_IF_NEQ)
+		return OPCODE_CLASS_COMPARE;
+
+	if (instruction <= JUMP_IF_NEQ)
+		return OPCODE_CLASS_JUMP;
+
+	if (instruction <= POP_64_INTO_REG)
+		return OPCODE_CLASS_STACK;
+
+	if (instruction <= CALL_NATIVE)
+		return OPCODE_CLASS_CALL;
+
+	if (instruction <= DEALLOCATE_STACK)
+		return OPCODE_CLASS_STACK;
+
+	if (instruction >= PRINT_CHAR && instruction <= PRINT_STR)
+		return OPCODE_CLASS_IO;
+
+	if (instruction >= FILE_OPEN && instruction <= AIO_POLL)
+		return OPCODE_CLASS_IO;
+
+	return OPCODE_CLASS_OTHER;
+}
+
+/**
+ * @param opcode An opcode.
+ * @returns The instructions executed by the opcode: the instruction
+ * itself, or the instructions of a superinstruction.
+ */
+const std::vector<Instruction> &
+instructions_of_opcode(uint16_t opcode)
+{
+	static const std::vector<std::vector<Instruction>> opcodes = []
+	{
+		std::vector<std::vector<Instruction>> opcodes;
+
+		for (uint16_t opcode = 0; opcode <= INSTRUCTION_COUNT; opcode++)
+		{
+			opcodes.push_back({ (Instruction) opcode });
+		}
+
+#define SUPERINSTRUCTION(name, ...) opcodes.push_back({ __VA_ARGS__ });
+		SUPERINSTRUCTIONS(SUPERINSTRUCTION)
+#undef SUPERINSTRUCTION
+
+		return opcodes;
+	}();
+
+	return opcodes[opcode];
+}
+
+/**
+ * @brief The statistics of a running program, as published on a stats page.
+ */
+struct StatsSnapshot
+{
+	// The process id of the VM.
+	uint64_t pid;
+
+	// Whether the program is still running.
+	uint64_t running;
+
+	// The CLOCK_MONOTONIC times in nanoseconds at which
+	// the program started and at which the page was last updated.
+	uint64_t start_time_ns;
+	uint64_t update_time_ns;
+
+	// The number of times the page was updated.
+	uint64_t updates;
+
+	// The number of executed instructions.
+	uint64_t instructions;
+
+	// The number of executed CALL and RETURN instructions.
+	uint64_t calls;
+	uint64_t returns;
+
+	// The used bytes of the stack, the highest number of used bytes
+	// seen so far and the size of the stack. The stack pointer is
+	// sampled at calls and at updates, so short peaks may be missed.
+	uint64_t stack_depth;
+	uint64_t peak_stack_depth;
+	uint64_t stack_size;
+
+	// The bytes allocated on the heap of the VM process.
+	uint64_t heap_bytes;
+
+	// The bytes read and written by I/O instructions.
+	uint64_t io_bytes_read;
+	uint64_t io_bytes_written;
+
+	// The number of executed instructions of each class, see `OpcodeClass`.
+	uint64_t class_counts[OPCODE_CLASS_COUNT];
+};
+
+// The number of 64-bit words of a snapshot.
+#define STATS_WORD_COUNT (sizeof(StatsSnapshot) / sizeof(uint64_t))
+
+/**
+ * @brief A stats page, shared by the VM that writes it and the
+ * processes that read it. The layout is fixed for a version.
+ *
+ * The page is protected by a seqlock: the writer makes the sequence
+ * number odd, writes the words of the snapshot and makes it even again.
+ * A reader retries while the sequence number is odd or has changed
+ * during its read, so it never sees half of an update. Every word is
+ * an atomic, so the concurrent accesses are well-defined.
+ */
+struct StatsPage
+{
+	// STATS_MAGIC once the page is initialised.
+	std::atomic<uint64_t> magic;
+
+	// STATS_VERSION.
+	std::atomic<uint64_t> version;
+
+	// The sequence number of the seqlock.
+	std::atomic<uint64_t> seq;
+
+	// The words of the snapshot.
+	std::atomic<uint64_t> words[STATS_WORD_COUNT];
+
+	/**
+	 * @brief Publishes a snapshot. Must only be called by the writer.
+	 * @param snapshot The snapshot.
+	 */
+	void
+	write(const StatsSnapshot &snapshot)
+	{
+		uint64_t values[STATS_WORD_COUNT];
+		memcpy(values, &snapshot, sizeof(values));
+
+		uint64_t cur_seq = seq.load(std::memory_order_relaxed);
+		seq.store(cur_seq + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		for (size_t i = 0; i < STATS_WORD_COUNT; i++)
+		{
+			words[i].store(values[i], std::memory_order_relaxed);
+		}
+
+		seq.store(cur_seq + 2, std::memory_order_release);
+	}
+
+	/**
+	 * @brief Reads a consistent snapshot, waiting for an update
+	 * that is in progress to complete.
+	 * @returns The snapshot.
+	 */
+	StatsSnapshot
+	read() const
+	{
+		uint64_t values[STATS_WORD_COUNT];
+		uint64_t seq_before;
+		uint64_t seq_after;
+
+		do
+		{
+			seq_before = seq.load(std::memory_order_acquire);
+
+			for (size_t i = 0; i < STATS_WORD_COUNT; i++)
+			{
+				values[i] = words[i].load(std::memory_order_relaxed);
+			}
+
+			std::atomic_thread_fence(std::memory_order_acquire);
+			seq_after = seq.load(std::memory_order_relaxed);
+		}
+		while ((seq_before & 1) || seq_before != seq_after);
+
+		StatsSnapshot snapshot;
+		memcpy(&snapshot, values, sizeof(values));
+		return snapshot;
+	}
+};
+
+/**
+ * @returns The CLOCK_MONOTONIC time in nanoseconds.
+ */
+uint64_t
+stats_now_ns()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000000000ull + now.tv_nsec;
+}
+
+/**
+ * @param name The name of a stats page.
+ * @returns The name of its shared memory object.
+ */
+std::string
+stats_shm_name(const std::string &name)
+{
+	return name[0] == '/' ? name : "/" + name;
+}
+
+/**
+ * @brief The hooks of a CPU whose statistics are published on a stats
+ * page by a `StatsPublisher`. Counts in local variables and publishes
+ * them in batches, so the page is written about every
+ * STATS_UPDATE_INTERVAL_NS. Fuel metering is supported.
+ * Guest threads are not counted.
+ *
+ * Only the executions of each opcode are counted while the program runs.
+ * They are summed into instructions and classes when the page is updated,
+ * which also expands superinstructions, so the CPU keeps using them.
+ */
+struct StatsHooks : FuelHooks
+{
+	// The page to publish to, or nullptr.
+	StatsPage *page = nullptr;
+
+	// The statistics, without the counts of instructions
+	// until the page is updated.
+	StatsSnapshot stats = {};
+
+	// The number of executions of each opcode.
+	uint64_t opcode_counts[OPCODE_COUNT] = {};
+
+	// The number of dispatches until the clock is checked.
+	uint64_t batch_left = STATS_BATCH_SIZE;
+
+	template <typename CPU>
+	void
+	on_instruction(CPU &cpu, Instruction instruction)
+	{
+		opcode_counts[instruction]++;
+
+		if (--batch_left == 0)
+		{
+			batch_left = STATS_BATCH_SIZE;
+			uint64_t now = stats_now_ns();
+
+			if (now - stats.update_time_ns >= STATS_UPDATE_INTERVAL_NS)
+			{
+				publish(cpu, now);
+			}
+		}
+	}
+
+	template <typename CPU>
+	void
+	on_call(CPU &cpu, uint8_t *function)
+	{
+		stats.calls++;
+		update_stack_depth(cpu);
+	}
+
+	template <typename CPU>
+	void
+	on_return(CPU &cpu)
+	{
+		stats.returns++;
+	}
+
+	template <typename CPU>
+	void
+	on_io(CPU &cpu, uint64_t bytes, bool is_write)
+	{
+		if (is_write)
+			stats.io_bytes_written += bytes;
+		else
+			stats.io_bytes_read += bytes;
+	}
+
+	/**
+	 * @brief Samples the stack pointer of a CPU.
+	 * @param cpu The CPU.
+	 */
+	template <typename CPU>
+	void
+	update_stack_depth(CPU &cpu)
+	{
+		stats.stack_depth      = cpu.get_stack_ptr() - cpu.stack_top;
+		stats.peak_stack_depth = std::max(stats.peak_stack_depth, stats.stack_depth);
+	}
+
+	/**
+	 * @brief Publishes the statistics of a CPU to the page.
+	 * @param cpu The CPU.
+	 * @param now The current CLOCK_MONOTONIC time in nanoseconds.
+	 */
+	template <typename CPU>
+	void
+	publish(CPU &cpu, uint64_t now)
+	{
+		update_stack_depth(cpu);
+
+		struct mallinfo2 info = mallinfo2();
+
+		stats.update_time_ns = now;
+		stats.heap_bytes     = info.uordblks + info.hblkhd;
+		stats.instructions   = 0;
+		stats.updates++;
+
+		for (size_t i = 0; i < OPCODE_CLASS_COUNT; i++)
+		{
+			stats.class_counts[i] = 0;
+		}
+
+		for (uint16_t opcode = 0; opcode < OPCODE_COUNT; opcode++)
+		{
+			if (opcode_counts[opcode] == 0)
+			{
+				continue;
+			}
+
+			for (Instruction instruction : instructions_of_opcode(opcode))
+			{
+				stats.class_counts[opcode_class_of(instruction)] += opcode_counts[opcode];
+				stats.instructions += opcode_counts[opcode];
+			}
+		}
+
+		if (page != nullptr)
+		{
+			page->write(stats);
+		}
+	}
+};
+
+// A CPU whose statistics are published by a `StatsPublisher`.
+using StatsCPU = BasicCPU<StatsHooks>;
+
+/**
+ * @brief Publishes the statistics of a running program on a stats page
+ * in shared memory, see `StatsPage`. The page is created in /dev/shm
+ * under the given name and removed when the publisher is destroyed.
+ * Processes that still have the page mapped, like `tea-top`, can
+ * read the final statistics after that.
+ */
+struct StatsPublisher
+{
+	// The CPU whose statistics are published.
+	StatsCPU &cpu;
+
+	// The name of the shared memory object.
+	std::string shm_name;
+
+	// The mapped page.
+	StatsPage *page;
+
+	/**
+	 * @brief Constructs a new StatsPublisher object and publishes
+	 * the first snapshot. Throws an error message if the page
+	 * cannot be created.
+	 * @param cpu The CPU whose statistics are published. Reports to
+	 * this publisher while the publisher exists.
+	 * @param name The name of the page.
+	 */
+	StatsPublisher(StatsCPU &cpu, const std::string &name)
+		: cpu(cpu), shm_name(stats_shm_name(name))
+	{
+		int fd = shm_open(shm_name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+		if (fd == -1)
+		{
+			throw "Could not create stats page " + shm_name + ": " + strerror(errno) + "\n";
+		}
+
+		if (ftruncate(fd, sizeof(StatsPage)) == -1)
+		{
+			close(fd);
+			shm_unlink(shm_name.c_str());
+			throw "Could not resize stats page " + shm_name + ": " + strerror(errno) + "\n";
+		}
+
+		void *mapping = mmap(nullptr, sizeof(StatsPage), PROT_READ | PROT_WRITE,
+			MAP_SHARED, fd, 0);
+		close(fd);
+
+		if (mapping == MAP_FAILED)
+		{
+			shm_unlink(shm_name.c_str());
+			throw "Could not map stats page " + shm_name + ": " + strerror(errno) + "\n";
+		}
+
+		// The new page is zeroed, so readers see no magic
+		// until the first snapshot is written.
+
+		page = new (mapping) StatsPage;
+
+		StatsSnapshot &stats = cpu.hooks.stats;
+		stats.pid            = getpid();
+		stats.running        = true;
+		stats.start_time_ns  = stats_now_ns();
+		stats.stack_size     = cpu.stack_size;
+
+		cpu.hooks.page = page;
+		cpu.hooks.publish(cpu, stats.start_time_ns);
+
+		page->version.store(STATS_VERSION, std::memory_order_relaxed);
+		page->magic.store(STATS_MAGIC, std::memory_order_release);
+	}
+
+	StatsPublisher(const StatsPublisher &) = delete;
+	StatsPublisher &operator=(const StatsPublisher &) = delete;
+
+	/**
+	 * @brief Publishes the final statistics and removes the page.
+	 */
+	~StatsPublisher()
+	{
+		cpu.hooks.stats.running = false;
+		cpu.hooks.publish(cpu, stats_now_ns());
+		cpu.hooks.page = nullptr;
+
+		munmap(page, sizeof(StatsPage));
+		shm_unlink(shm_name.c_str());
+	}
+};
+
+#endif
@@ -0,0 +1,643 @@
+// Generated by Superinstructions/synthesize from 11 profiles.
+// Regenerate with ./synthesize-superinstructions.sh, do not edit.
+
+// The handlers of the superinstructions. Included in the switch statement
+// of `BasicCPU::execute()`, so this file has no include guard.
+// Each handler runs copies of the handlers of its instructions. Before
+// each instruction after the first, `cur_instr_addr` is moved to it
+// and its opcode is skipped, like `step()` does.
+
+		case SUPER_MOVE_LIT_8_ADD_INT_64_LOAD_PTR_64:
+		{
+			// MOVE_LIT_8
+
+			{
+				int8_t lit     = fetch<int8_t>();
+				uint8_t reg_id = fetch<uint8_t>();
+				set_reg_by_id(reg_id, (int64_t) lit);
+			}
+
+			// ADD_INT_64
+
+			cur_instr_addr = get_instr_ptr();
+			fetch<Instruction>();
+
+			{
+				uint8_t reg_id_1 = fetch<uint8_t>();
+				uint8_t reg_id_2 = fetch<uint8_t>();
+				set_reg_by_id(reg_id_2,
+					static_cast<uint64_t>(get_reg_by_id(reg_id_1))
+						+ static_cast<uint64_t>(get_reg_by_id(reg_id_2)));
+			}
+
+			// LOAD_PTR_64
+
+			cur_instr_addr = get_instr_ptr();
+			fetch<Instruction>();
+
+			{
+				uint8_t reg_id_1 = fetch<uint8_t>();
+				uint8_t reg_id_2 = fetch<uint8_t>();
+				uint8_t *address = (uint8_t *) get_reg_by_id(reg_id_1);
+				hooks.on_memory_access(*this, address, sizeof(uint64_t), false);
+				uint64_t value   = memory::get<uint64_t>(address);
+				set_reg_by_id(reg_id_2, value);
+			}
+
+			break;
+		}
+
+		case SUPER_MOVE_LIT_8_ADD_INT_64:
+		{
+			// MOVE_LIT_8
+
+			{
+				int8_t lit     = fetch<int8_t>();
+				uint8_t reg_id = fetch<uint8_t>();
+				set_reg_by_id(reg_id, (int64_t) lit);
+			}
+
+			// ADD_INT_64
+
+			cur_instr_addr = get_instr_ptr();
+			fetch<Instruction>();
+
+			{
+				uint8_t reg_id_1 = fetch<uint8_t>();
+				uint8_t reg_id_2 = fetch<uint8_t>();
+				set_reg_by_id(reg_id_2,
+					static_cast<uint64_t>(get_reg_by_id(reg_id_1))
+						+ static_cast<uint64_t>(get_reg_by_id(reg_id_2)));
+			}
+
+			break;
+		}
+
+		case SUPER_ADD_INT_64_LOAD_PTR_64_MOVE_LIT_8:
+		{
+			// ADD_INT_64
+
+			{
+				uint8_t reg_id_1 = fetch<uint8_t>();
+				uint8_t reg_id_2 = fetch<uint8_t>();
+				set_reg_by_id(reg_id_2,
+					static_cast<uint64_t>(get_reg_by_id(reg_id_1))
+						+ static_cast<uint64_t>(get_reg_by_id(reg_id_2)));
+			}
+
+			// LOAD_PTR_64
+
+			cur_instr_addr = get_instr_ptr();
+			fetch<Instruction>();
+
+			{
+				uint8_t reg_id_1 = fetch<uint8_t>();
+				uint8_t reg_id_2 = fetch<uint8_t>();
+				uint8_t *address = (uint8_t *) get_reg_by_id(reg_id_1);
+				hooks.on_memory_access(*this, address, sizeof(uint64_t), false);
+				uint64_t value   = memory::get<uint64_t>(address);
+				set_reg_by_id(reg_id_2, value);
+			}
+
+			// MOVE_LIT_8
+
+			cur_instr_addr = get_instr_ptr();
+			fetch<Instruction>();
+
+			{
+				int8_t lit     = fetch<int8_t>();
+				uint8_t reg_id = fetch<uint8_t>();
+				set_reg_by_id(reg_id, (int64_t) lit);
+			}
+
+			break;
+		}
+
+		case SUPER_ADD_INT_64_LOAD_PTR_64:
+		{
+			// ADD_INT_64
+
+			{
+				uint8_t reg_id_1 = fetch<uint8_t>();
+				uint8_t reg_id_2 = fetch<uint8_t>();
+				set_reg_by_id(reg_id_2,
+					static_cast<uint64_t>(get_reg_by_id(reg_id_1))
+						+ static_cast<uint64_t>(get_reg_by_id(reg_id_2)));
+			}
+
+			// LOAD_PTR_64
+
+			cur_instr_addr = get_instr_ptr();
+			fetch<Instruction>();
+
+			{
+				uint8_t reg_id_1 = fetch<uint8_t>();
+				uint8_t reg_id_2 = fetch<uint8_t>();
+				uint8_t *address = (uint8_t *) get_reg_by_id(reg_id_1);
+				hooks.on_memory_access(*this, address, sizeof(uint64_t), false);
+				uint64_t value   = memory::get<uint64_t>(address);
+				set_reg_by_id(reg_id_2, value);
+			}
+
+			break;
+		}
+
+		case SUPER_MOVE_LIT_8_ADD_INT_64_STORE_PTR_64:
+		{
+			// MOVE_LIT_8
+
+			{
+				int8_t lit     = fetch<int8_t>();
+				uint8_t reg_id = fetch<uint8_t>();
+				set_reg_by_id(reg_id, (int64_t) lit);
+			}
+
+			// ADD_INT_64
+
+			cur_instr_addr = get_instr_ptr();
+			fetch<Instruction>();
+
+			{
+				uint8_t reg_id_1 = fetch<uint8_t>();
+				uint8_t reg_id_2 = fetch<uint8_t>();
+				set_reg_by_id(reg_id_2,
+					static_cast<uint64_t>(get_reg_by_id(reg_id_1))
+						+ static_cast<uint64_t>(get_reg_by_id(reg_id_2)));
+			}
+
+			// STORE_PTR_64
+
+			cur_instr_addr = get_instr_ptr();
+			fetch<Instruction>();
+
+			{
+				uint8_t reg_id_1 = fetch<uint8_t>();
+				uint8_t reg_id_2 = fetch<uint8_t>();
+				uint8_t *address = (uint8_t *) get_reg_by_id(reg_id_2);
+				hooks.on_memory_access(*this, address, sizeof(uint64_t), true);
+				uint64_t value   = get_reg_by_id(reg_id_1);
+				memory::set<uint64_t>(address, value);
+			}
+
+			break;
+		}
+
+		case SUPER_LOAD_PTR_64_MOVE_LIT_8_ADD_INT_64:
+		{
+			// LOAD_PTR_64
+
+			{
+				uint8_t reg_id_1 = fetch<uint8_t>();
+				uint8_t reg_id_2 = fetch<uint8_t>();
+				uint8_t *address = (uint8_t *) get_reg_by_id(reg_id_1);
+				hooks.on_memory_access(*this, address, sizeof(uint64_t), false);
+				uint64_t value   = memory::get<uint64_t>(address);
+				set_reg_by_id(reg_id_2, value);
+			}
+
+			// MOVE_LIT_8
+
+			cur_instr_addr = get_instr_ptr();
+			fetch<Instruction>();
+
+			{
+				int8_t lit     = fetch<int8_t>();
+				uint8_t reg_id = fetch<uint8_t>();
+				set_reg_by_id(reg_id, (int64_t) lit);
+			}
+
+			// ADD_INT_64
+
+			cur_instr_addr = get_instr_ptr();
+			fetch<Instruction>();
+
+			{
+				uint8_t reg_id_1 = fetch<uint8_t>();
+				uint8_t reg_id_2 = fetch<uint8_t>();
+				set_reg_by_id(reg_id_2,
+					static_cast<uint64_t>(get_reg_by_id(reg_id_1))
+						+ static_cast<uint64_t>(get_reg_by_id(reg_id_2)));
+			}
+
+			break;
+		}
+
+		case SUPER_LOAD_PTR_64_MOVE_LIT_8:
+		{
+			// LOAD_PTR_64
+
+			{
+				uint8_t reg_id_1 = fetch<uint8_t>();
+				uint8_t reg_id_2 = fetch<uint8_t>();
+				uint8_t *address = (uint8_t *) get_reg_by_id(reg_id_1);
+				hooks.on_memory_access(*this, address, sizeof(uint64_t), false);
+				uint64_t value   = memory::get<uint64_t>(address);
+				set_reg_by_id(reg_id_2, value);
+			}
+
+			// MOVE_LIT_8
+
+			cur_instr_addr = get_instr_ptr();
+			fetch<Instruction>();
+
+			{
+				int8_t lit     = fetch<int8_t>();
+				uint8_t reg_id = fetch<uint8_t>();
+				set_reg_by_id(reg_id, (int64_t) lit);
+			}
+
+			break;
+		}
+
+		case SUPER_MOVE_LIT_8_CMP_INT_8_JUMP_IF_EQ:
+		{
+			// MOVE_LIT_8
+
+			{
+				int8_t lit     = fetch<int8_t>();
+				uint8_t reg_id = fetch<uint8_t>();
+				set_reg_by_id(reg_id, (int64_t) lit);
+			}
+
+			// CMP_INT_8
+
+			cur_instr_addr = get_instr_ptr();
+			fetch<Instruction>();
+
+			{
+				uint8_t reg_id_1 = fetch<uint8_t>();
+				uint8_t reg_id_2 = fetch<uint8_t>();
+
+				int8_t value_1 = static_cast<int8_t>(get_reg_by_id(reg_id_1));
+				int8_t value_2 = static_cast<int8_t>(get_reg_by_id(reg_id_2));
+
+				if (value_1 > value_2)
+				{
+					greater_flag = true;
+					equal_flag   = false;
+				}
+				else if (value_1 == value_2)
+				{
+					greater_flag = false;
+					equal_flag   = true;
+				}
+				else
+				{
+					greater_flag = false;
+					equal_flag   = false;
+				}
+			}
+
+			// JUMP_IF_EQ
+
+			cur_instr_addr = get_instr_ptr();
+			fetch<Instruction>();
+
+			{
+				int32_t offset = fetch<int32_t>();
+				if (equal_flag)
+					jump_instruction_p(offset);
+			}
+
+			break;
+		}
+
+		case SUPER_ADD_INT_64_STORE_PTR_64:
+		{
+			// ADD_INT_64
+
+			{
+				uint8_t reg_id_1 = fetch<uint8_t>();
+				uint8_t reg_id_2 = fetch<uint8_t>();
+				set_reg_by_id(reg_id_2,
+					static_cast<uint64_t>(get_reg_by_id(reg_id_1))
+						+ static_cast<uint64_t>(get_reg_by_id(reg_id_2)));
+			}
+
+			// STORE_PTR_64
+
+			cur_instr_addr = get_instr_ptr();
+			fetch<Instruction>();
+
+			{
+				uint8_t reg_id_1 = fetch<uint8_t>();
+				uint8_t reg_id_2 = fetch<uint8_t>();
+				uint8_t *address = (uint8_t *) get_reg_by_id(reg_id_2);
+				hooks.on_memory_access(*this, address, sizeof(uint64_t), true);
+				uint64_t value   = get_reg_by_id(reg_id_1);
+				memory::set<uint64_t>(address, value);
+			}
+
+			break;
+		}
+
+		case SUPER_ADD_INT_64_STORE_PTR_64_MOVE_LIT_8:
+		{
+			// ADD_INT_64
+
+			{
+				uint8_t reg_id_1 = fetch<uint8_t>();
+				uint8_t reg_id_2 = fetch<uint8_t>();
+				set_reg_by_id(reg_id_2,
+					static_cast<uint64_t>(get_reg_by_id(reg_id_1))
+						+ static_cast<uint64_t>(get_reg_by_id(reg_id_2)));
+			}
+
+			// STORE_PTR_64
+
+			cur_instr_addr = get_instr_ptr();
+			fetch<Instruction>();
+
+			{
+				uint8_t reg_id_1 = fetch<uint8_t>();
+				uint8_t reg_id_2 = fetch<uint8_t>();
+				uint8_t *address = (uint8_t *) get_reg_by_id(reg_id_2);
+				hooks.on_memory_access(*this, address, sizeof(uint64_t), true);
+				uint64_t value   = get_reg_by_id(reg_id_1);
+				memory::set<uint64_t>(address, value);
+			}
+
+			// MOVE_LIT_8
+
+			cur_instr_addr = get_instr_ptr();
+			fetch<Instruction>();
+
+			{
+				int8_t lit     = fetch<int8_t>();
+				uint8_t reg_id = fetch<uint8_t>();
+				set_reg_by_id(reg_id, (int64_t) lit);
+			}
+
+			break;
+		}
+
+		case SUPER_STORE_PTR_64_MOVE_LIT_8_ADD_INT_64:
+		{
+			// STORE_PTR_64
+
+			{
+				uint8_t reg_id_1 = fetch<uint8_t>();
+				uint8_t reg_id_2 = fetch<uint8_t>();
+				uint8_t *address = (uint8_t *) get_reg_by_id(reg_id_2);
+				hooks.on_memory_access(*this, address, sizeof(uint64_t), true);
+				uint64_t value   = get_reg_by_id(reg_id_1);
+				memory::set<uint64_t>(address, value);
+			}
+
+			// MOVE_LIT_8
+
+			cur_instr_addr = get_instr_ptr();
+			fetch<Instruction>();
+
+			{
+				int8_t lit     = fetch<int8_t>();
+				uint8_t reg_id = fetch<uint8_t>();
+				set_reg_by_id(reg_id, (int64_t) lit);
+			}
+
+			// ADD_INT_64
+
+			cur_instr_addr = get_instr_ptr();
+			fetch<Instruction>();
+
+			{
+				uint8_t reg_id_1 = fetch<uint8_t>();
+				uint8_t reg_id_2 = fetch<uint8_t>();
+				set_reg_by_id(reg_id_2,
+					static_cast<uint64_t>(get_reg_by_id(reg_id_1))
+						+ static_cast<uint64_t>(get_reg_by_id(reg_id_2)));
+			}
+
+			break;
+		}
+
+		case SUPER_ADD_INT_64_MOVE_LIT_8_ADD_INT_64:
+		{
+			// ADD_INT_64
+
+			{
+				uint8_t reg_id_1 = fetch<uint8_t>();
+				uint8_t reg_id_2 = fetch<uint8_t>();
+				set_reg_by_id(reg_id_2,
+					static_cast<uint64_t>(get_reg_by_id(reg_id_1))
+						+ static_cast<uint64_t>(get_reg_by_id(reg_id_2)));
+			}
+
+			// MOVE_LIT_8
+
+			cur_instr_addr = get_instr_ptr();
+			fetch<Instruction>();
+
+			{
+				int8_t lit     = fetch<int8_t>();
+				uint8_t reg_id = fetch<uint8_t>();
+				set_reg_by_id(reg_id, (int64_t) lit);
+			}
+
+			// ADD_INT_64
+
+			cur_instr_addr = get_instr_ptr();
+			fetch<Instruction>();
+
+			{
+				uint8_t reg_id_1 = fetch<uint8_t>();
+				uint8_t reg_id_2 = fetch<uint8_t>();
+				set_reg_by_id(reg_id_2,
+					static_cast<uint64_t>(get_reg_by_id(reg_id_1))
+						+ static_cast<uint64_t>(get_reg_by_id(reg_id_2)));
+			}
+
+			break;
+		}
+
+		case SUPER_ADD_INT_64_STORE_PTR_64_JUMP:
+		{
+			// ADD_INT_64
+
+			{
+				uint8_t reg_id_1 = fetch<uint8_t>();
+				uint8_t reg_id_2 = fetch<uint8_t>();
+				set_reg_by_id(reg_id_2,
+					static_cast<uint64_t>(get_reg_by_id(reg_id_1))
+						+ static_cast<uint64_t>(get_reg_by_id(reg_id_2)));
+			}
+
+			// STORE_PTR_64
+
+			cur_instr_addr = get_instr_ptr();
+			fetch<Instruction>();
+
+			{
+				uint8_t reg_id_1 = fetch<uint8_t>();
+				uint8_t reg_id_2 = fetch<uint8_t>();
+				uint8_t *address = (uint8_t *) get_reg_by_id(reg_id_2);
+				hooks.on_memory_access(*this, address, sizeof(uint64_t), true);
+				uint64_t value   = get_reg_by_id(reg_id_1);
+				memory::set<uint64_t>(address, value);
+			}
+
+			// JUMP
+
+			cur_instr_addr = get_instr_ptr();
+			fetch<Instruction>();
+
+			{
+				int32_t offset = fetch<int32_t>();
+				jump_instruction_p(offset);
+			}
+
+			break;
+		}
+
+		case SUPER_LOAD_PTR_64_MOVE_LIT_8_CMP_INT_64_U:
+		{
+			// LOAD_PTR_64
+
+			{
+				uint8_t reg_id_1 = fetch<uint8_t>();
+				uint8_t reg_id_2 = fetch<uint8_t>();
+				uint8_t *address = (uint8_t *) get_reg_by_id(reg_id_1);
+				hooks.on_memory_access(*this, address, sizeof(uint64_t), false);
+				uint64_t value   = memory::get<uint64_t>(address);
+				set_reg_by_id(reg_id_2, value);
+			}
+
+			// MOVE_LIT_8
+
+			cur_instr_addr = get_instr_ptr();
+			fetch<Instruction>();
+
+			{
+				int8_t lit     = fetch<int8_t>();
+				uint8_t reg_id = fetch<uint8_t>();
+				set_reg_by_id(reg_id, (int64_t) lit);
+			}
+
+			// CMP_INT_64_U
+
+			cur_instr_addr = get_instr_ptr();
+			fetch<Instruction>();
+
+			{
+				uint8_t reg_id_1 = fetch<uint8_t>();
+				uint8_t reg_id_2 = fetch<uint8_t>();
+
+				uint64_t value_1 = static_cast<uint64_t>(get_reg_by_id(reg_id_1));
+				uint64_t value_2 = static_cast<uint64_t>(get_reg_by_id(reg_id_2));
+
+				if (value_1 > value_2)
+				{
+					greater_flag = true;
+					equal_flag   = false;
+				}
+				else if (value_1 == value_2)
+				{
+					greater_flag = false;
+					equal_flag   = true;
+				}
+				else
+				{
+					greater_flag = false;
+					equal_flag   = false;
+				}
+			}
+
+			break;
+		}
+
+		case SUPER_ADD_INT_64_LOAD_PTR_64_ADD_INT_64:
+		{
+			// ADD_INT_64
+
+			{
+				uint8_t reg_id_1 = fetch<uint8_t>();
+				uint8_t reg_id_2 = fetch<uint8_t>();
+				set_reg_by_id(reg_id_2,
+					static_cast<uint64_t>(get_reg_by_id(reg_id_1))
+						+ static_cast<uint64_t>(get_reg_by_id(reg_id_2)));
+			}
+
+			// LOAD_PTR_64
+
+			cur_instr_addr = get_instr_ptr();
+			fetch<Instruction>();
+
+			{
+				uint8_t reg_id_1 = fetch<uint8_t>();
+				uint8_t reg_id_2 = fetch<uint8_t>();
+				uint8_t *address = (uint8_t *) get_reg_by_id(reg_id_1);
+				hooks.on_memory_access(*this, address, sizeof(uint64_t), false);
+				uint64_t value   = memory::get<uint64_t>(address);
+				set_reg_by_id(reg_id_2, value);
+			}
+
+			// ADD_INT_64
+
+			cur_instr_addr = get_instr_ptr();
+			fetch<Instruction>();
+
+			{
+				uint8_t reg_id_1 = fetch<uint8_t>();
+				uint8_t reg_id_2 = fetch<uint8_t>();
+				set_reg_by_id(reg_id_2,
+					static_cast<uint64_t>(get_reg_by_id(reg_id_1))
+						+ static_cast<uint64_t>(get_reg_by_id(reg_id_2)));
+			}
+
+			break;
+		}
+
+		case SUPER_MOVE_LIT_8_CMP_INT_64_U_SET_IF_NEQ:
+		{
+			// MOVE_LIT_8
+
+			{
+				int8_t lit     = fetch<int8_t>();
+				uint8_t reg_id = fetch<uint8_t>();
+				set_reg_by_id(reg_id, (int64_t) lit);
+			}
+
+			// CMP_INT_64_U
+
+			cur_instr_addr = get_instr_ptr();
+			fetch<Instruction>();
+
+			{
+				uint8_t reg_id_1 = fetch<uint8_t>();
+				uint8_t reg_id_2 = fetch<uint8_t>();
+
+				uint64_t value_1 = static_cast<uint64_t>(get_reg_by_id(reg_id_1));
+				uint64_t value_2 = static_cast<uint64_t>(get_reg_by_id(reg_id_2));
+
+				if (value_1 > value_2)
+				{
+					greater_flag = true;
+					equal_flag   = false;
+				}
+				else if (value_1 == value_2)
+				{
+					greater_flag = false;
+					equal_flag   = true;
+				}
+				else
+				{
+					greater_flag = false;
+					equal_flag   = false;
+				}
+			}
+
+			// SET_IF_NEQ
+
+			cur_instr_addr = get_instr_ptr();
+			fetch<Instruction>();
+
+			{
+				uint8_t reg_id = fetch<uint8_t>();
+				if (!equal_flag)
+					set_reg_by_id(reg_id, 1);
+				else
+					set_reg_by_id(reg_id, 0);
+			}
+
+			break;
+		}
@@ -0,0 +1,96 @@
+#ifndef TEA_SUPERINSTRUCTION_REWRITER_HEADER
+#define TEA_SUPERINSTRUCTION_REWRITER_HEADER
+
+#include <algorithm>
+#include <vector>
+
+#include "VM/memory.hpp"
+#include "Executable/byte-code.hpp"
+#include "Executable/superinstructions.hpp"
+
+/**
+ * @brief Rewrites a program to use superinstructions.
+ * Every sequence of instructions that matches a superinstruction gets
+ * the opcode of the superinstruction in place of the opcode of its first
+ * instruction. Longer sequences are preferred, and sequences don't overlap.
+ *
+ * The other instructions of a sequence are left as they are, so the
+ * layout of the program does not change: jumps into the middle of a
+ * sequence still find the original instructions, and so does a program
+ * that is resumed in the middle of one after it ran out of fuel.
+ * @param program_location A pointer to the start of the program.
+ * @param program_size The size of the program in bytes.
+ */
+void
+rewrite_superinstructions(uint8_t *program_location, size_t program_size)
+{
+	// The opcode of each superinstruction, followed by its instructions.
+
+	static const std::vector<std::vector<Instruction>> patterns = {
+#define SUPERINSTRUCTION(name, ...) { name, __VA_ARGS__ },
+		SUPERINSTRUCTIONS(SUPERINSTRUCTION)
+#undef SUPERINSTRUCTION
+	};
+
+	if (patterns.empty())
+	{
+		return;
+	}
+
+	// The patterns that start with each instruction, longest first.
+
+	std::vector<std::vector<const std::vector<Instruction> *>> patterns_by_first(INSTRUCTION_COUNT);
+
+	for (const std::vector<Instruction> &pattern : patterns)
+	{
+		patterns_by_first[pattern[1]].push_back(&pattern);
+	}
+
+	for (std::vector<const std::vector<Instruction> *> &candidates : patterns_by_first)
+	{
+		std::stable_sort(candidates.begin(), candidates.end(),
+			[](const std::vector<Instruction> *a, const std::vector<Instruction> *b)
+			{ return a->size() > b->size(); });
+	}
+
+	uint8_t *program_end = program_location + program_size;
+	uint8_t *instr       = program_location;
+
+	while (instr < program_end)
+	{
+		Instruction opcode = memory::get<Instruction>(instr);
+		uint8_t *next   = instr + instruction_size(instr);
+
+		if (opcode >= INSTRUCTION_COUNT)
+		{
+			instr = next;
+			continue;
+		}
+
+		for (const std::vector<Instruction> *pattern : patterns_by_first[opcode])
+		{
+			// Match the instructions after the first one.
+
+			uint8_t *cur = next;
+			size_t i     = 2;
+
+			while (i < pattern->size() && cur < program_end
+				&& memory::get<Instruction>(cur) == (*pattern)[i])
+			{
+				cur += instruction_size(cur);
+				i++;
+			}
+
+			if (i == pattern->size() && cur <= program_end)
+			{
+				memory::set<Instruction>(instr, (*pattern)[0]);
+				next = cur;
+				break;
+			}
+		}
+
+		instr = next;
+	}
+}
+
+#endif
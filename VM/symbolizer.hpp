@@ -0,0 +1,259 @@
+#ifndef TEA_SYMBOLIZER_HEADER
+#define TEA_SYMBOLIZER_HEADER
+
+#include <algorithm>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "VM/memory.hpp"
+#include "Executable/byte-code.hpp"
+#include "Executable/line-table.hpp"
+#include "Compiler/debugger-symbols.hpp"
+
+/**
+ * @brief Maps instruction addresses to the names of the functions
+ * they belong to. Function names are taken from the LABEL
+ * instructions that the compiler emits at the entry of every
+ * function when compiling with debug symbols.
+ * Source lines are taken from the line table of the debugger symbols file.
+ */
+struct Symbolizer
+{
+	/**
+	 * @brief A function of the program.
+	 */
+	struct Symbol
+	{
+		// The address of the entry of the function.
+		uint8_t *addr;
+
+		// The name of the function.
+		std::string name;
+	};
+
+	// All functions, sorted by address.
+	std::vector<Symbol> symbols;
+
+	// The start of the program segment.
+	uint8_t *program_location;
+
+	// The line table of the program.
+	// Empty if no debugger symbols were loaded.
+	LineTable lines;
+
+	// The lines of the source file.
+	std::vector<std::string> source;
+
+	/**
+	 * @brief Constructs a Symbolizer for a program.
+	 * Walks over all instructions and records every LABEL.
+	 * @param program_location A pointer to the start of the program.
+	 * @param program_size The size of the program in bytes.
+	 */
+	Symbolizer(uint8_t *program_location, size_t program_size)
+		: program_location(program_location)
+	{
+		memory::Reader reader(program_location);
+		uint8_t *program_end = program_location + program_size;
+
+		while (reader.addr < program_end)
+		{
+			uint8_t *instr_addr     = reader.addr;
+			Instruction instruction = (Instruction) reader.read<Instruction>();
+
+			for (ArgumentType arg : instruction_arg_types(instruction))
+			{
+				switch (arg)
+				{
+				case REG:
+				case LIT_8:
+					reader.addr += 1;
+					break;
+
+				case LIT_16:
+					reader.addr += 2;
+					break;
+
+				case REL_ADDR:
+				case LIT_32:
+					reader.addr += 4;
+					break;
+
+				case LIT_64:
+					reader.addr += 8;
+					break;
+
+				case NULL_TERMINATED_STRING:
+				{
+					std::string str = (char *) reader.addr;
+					reader.addr += str.size() + 1;
+
+					if (instruction == LABEL)
+					{
+						symbols.push_back({ instr_addr, std::move(str) });
+					}
+
+					break;
+				}
+				}
+			}
+		}
+
+		std::sort(symbols.begin(), symbols.end(),
+			[](const Symbol &a, const Symbol &b) { return a.addr < b.addr; });
+	}
+
+	/**
+	 * @brief Finds the function that contains an instruction.
+	 * @param addr The address of the instruction.
+	 * @returns A pointer to the symbol of the function, or nullptr if
+	 * the instruction lies before the first function.
+	 */
+	const Symbol *
+	lookup(uint8_t *addr) const
+	{
+		auto it = std::upper_bound(symbols.begin(), symbols.end(), addr,
+			[](uint8_t *addr, const Symbol &symbol) { return addr < symbol.addr; });
+
+		if (it == symbols.begin())
+		{
+			return nullptr;
+		}
+
+		return &*(it - 1);
+	}
+
+	/**
+	 * @brief Gets the name of the function that contains an instruction.
+	 * Instructions before the first function belong to the program prologue.
+	 * @param addr The address of the instruction.
+	 * @returns The name of the function.
+	 */
+	std::string
+	name_of(uint8_t *addr) const
+	{
+		const Symbol *symbol = lookup(addr);
+		return symbol == nullptr ? "[program]" : symbol->name;
+	}
+
+	/**
+	 * @brief Gets the name of a function from the address of its entry.
+	 * Without debug symbols, the function is named after the offset
+	 * of its entry in the program.
+	 * @param entry The address of the first instruction of the function.
+	 * @returns The name of the function.
+	 */
+	std::string
+	name_of_entry(uint8_t *entry) const
+	{
+		if (symbols.empty())
+		{
+			char name[32];
+			snprintf(name, sizeof(name), "0x%lx", (size_t) (entry - program_location));
+			return name;
+		}
+
+		return name_of(entry);
+	}
+
+	/**
+	 * @brief Loads the line table from the debugger symbols
+	 * of an executable, if it has them, and reads the source file.
+	 * @param exec_file_name The path of the executable.
+	 */
+	void
+	load_debugger_symbols(const std::string &exec_file_name)
+	{
+		std::optional<DebuggerSymbols> debugger_symbols = DebuggerSymbols::load(exec_file_name);
+
+		if (!debugger_symbols.has_value())
+		{
+			return;
+		}
+
+		lines  = std::move(debugger_symbols->lines);
+		source = lines.read_source();
+	}
+
+	/**
+	 * @param addr The address of an instruction.
+	 * @returns The source line of the instruction,
+	 * or 0 if it is not known.
+	 */
+	uint64_t
+	line_of(uint8_t *addr) const
+	{
+		return lines.line_of(addr - program_location);
+	}
+
+	/**
+	 * @param line A source line.
+	 * @returns The source location, formatted as "file:line".
+	 */
+	std::string
+	location_of_line(uint64_t line) const
+	{
+		std::string file_name = lines.source_file;
+		size_t slash          = file_name.find_last_of('/');
+
+		if (slash != std::string::npos)
+		{
+			file_name = file_name.substr(slash + 1);
+		}
+
+		return file_name + ':' + std::to_string(line);
+	}
+
+	/**
+	 * @param line A source line.
+	 * @returns The text of the source line without leading
+	 * whitespace, or an empty string if it is not available.
+	 */
+	std::string
+	source_text(uint64_t line) const
+	{
+		return LineTable::source_text(source, line);
+	}
+
+	/**
+	 * @brief Writes a table of source lines, sorted by count.
+	 * Does nothing if no line table was loaded.
+	 * @param file The file to write to.
+	 * @param title The title of the table.
+	 * @param line_counts Maps source lines to counts.
+	 * Line 0 collects everything that has no source line.
+	 * @param total The sum of all counts.
+	 */
+	void
+	write_source_lines(FILE *file, const char *title,
+		const std::unordered_map<uint64_t, uint64_t> &line_counts, uint64_t total) const
+	{
+		if (lines.runs.empty())
+		{
+			return;
+		}
+
+		std::vector<std::pair<uint64_t, uint64_t>> sorted_lines(
+			line_counts.begin(), line_counts.end());
+
+		std::sort(sorted_lines.begin(), sorted_lines.end(),
+			[](const std::pair<uint64_t, uint64_t> &a, const std::pair<uint64_t, uint64_t> &b)
+			{ return a.second > b.second || (a.second == b.second && a.first < b.first); });
+
+		fprintf(file, "\n%s\n\n", title);
+		fprintf(file, "%16s %8s    %-24s %s\n", "count", "%", "location", "source");
+
+		for (const auto &[line, count] : sorted_lines)
+		{
+			std::string location = line ? location_of_line(line) : "[no source line]";
+
+			fprintf(file, "%16lu %7.2f%%    %-24s %s\n", count,
+				total ? 100.0 * count / total : 0.0, location.c_str(),
+				source_text(line).c_str());
+		}
+	}
+};
+
+#endif
@@ -0,0 +1,134 @@
+#ifndef TEA_TRACER_HEADER
+#define TEA_TRACER_HEADER
+
+#include <cstdio>
+#include <string>
+
+#include "VM/cpu.hpp"
+#include "VM/symbolizer.hpp"
+
+/**
+ * @brief The hooks of a CPU that is traced by a `Tracer`.
+ * Writes a line for every executed instruction, followed by indented
+ * lines for the memory it accesses through pointers, the function
+ * it calls and the error it throws. Fuel metering is supported.
+ * Guest threads are not traced.
+ */
+struct TracerHooks : FuelHooks
+{
+	static constexpr bool HANDLES_TRAPS          = true;
+	static constexpr bool USES_SUPERINSTRUCTIONS = false;
+
+	// The file to write the trace to, or nullptr.
+	FILE *file = nullptr;
+
+	// Names the called functions.
+	const Symbolizer *symbolizer = nullptr;
+
+	template <typename CPU>
+	void
+	on_instruction(CPU &cpu, Instruction instruction)
+	{
+		if (file != nullptr)
+		{
+			fprintf(file, "0x%08lx %s\n", (size_t) (cpu.cur_instr_addr - cpu.program_location),
+				instruction_to_str(instruction));
+		}
+	}
+
+	template <typename CPU>
+	void
+	on_call(CPU &cpu, uint8_t *function)
+	{
+		if (file != nullptr)
+		{
+			fprintf(file, "           call %s\n", symbolizer->name_of_entry(function).c_str());
+		}
+	}
+
+	template <typename CPU>
+	void
+	on_return(CPU &cpu)
+	{
+		if (file != nullptr)
+		{
+			fprintf(file, "           return to 0x%08lx\n",
+				(size_t) (cpu.get_instr_ptr() - cpu.program_location));
+		}
+	}
+
+	template <typename CPU>
+	void
+	on_memory_access(CPU &cpu, uint8_t *address, size_t size, bool is_write)
+	{
+		if (file != nullptr)
+		{
+			fprintf(file, "           %s %lu bytes at %p\n",
+				is_write ? "write" : "read", size, (void *) address);
+		}
+	}
+
+	template <typename CPU>
+	void
+	on_trap(CPU &cpu, const std::string &err_message)
+	{
+		if (file != nullptr)
+		{
+			fprintf(file, "           trap: %s", err_message.c_str());
+			fflush(file);
+		}
+	}
+};
+
+// A CPU that is traced by a `Tracer`.
+using TracedCPU = BasicCPU<TracerHooks>;
+
+/**
+ * @brief An execution tracer for the virtual machine.
+ * Writes every instruction a CPU executes to a file, see `TracerHooks`.
+ * Traces grow quickly, so the tracer is meant for short programs
+ * and for finding the last steps before a crash.
+ */
+struct Tracer
+{
+	// The CPU to trace.
+	TracedCPU &cpu;
+
+	// Maps function entry addresses to function names.
+	Symbolizer symbolizer;
+
+	// The file the trace is written to.
+	FILE *file;
+
+	/**
+	 * @brief Constructs a new Tracer object.
+	 * Throws an error message if the trace file cannot be created.
+	 * @param cpu The CPU to trace. Reports to this tracer
+	 * while the tracer exists.
+	 * @param file_path The path of the trace file.
+	 */
+	Tracer(TracedCPU &cpu, const std::string &file_path)
+		: cpu(cpu),
+		  symbolizer(cpu.program_location, cpu.program_size),
+		  file(fopen(file_path.c_str(), "w"))
+	{
+		if (file == nullptr)
+		{
+			throw "Could not open trace file " + file_path + "\n";
+		}
+
+		cpu.hooks.file       = file;
+		cpu.hooks.symbolizer = &symbolizer;
+	}
+
+	Tracer(const Tracer &) = delete;
+	Tracer &operator=(const Tracer &) = delete;
+
+	~Tracer()
+	{
+		cpu.hooks.file = nullptr;
+		fclose(file);
+	}
+};
+
+#endif
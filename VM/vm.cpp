@@ -1,31 +1,355 @@
 #include <iostream>
 
 #include "VM/cpu.hpp"
+#include "VM/profiler.hpp"
+#include "VM/sampler.hpp"
+#include "VM/scheduler.hpp"
+#include "VM/stats.hpp"
+#include "VM/tracer.hpp"
 
 #define STACK_SIZE 8 * 1024 * 1024 // 8MB
 
+void
+print_usage()
+{
+	fprintf(stderr, "Usage: ./vm [--profile output_file_name] [--sample-profile frequency_hz] "
+		"[--sample-output output_file_name] [--trace output_file_name] [--stats-shm name] [--fuel amount] "
+		"[--bench-json output_file_name] input_file_name.teax [program arguments]\n"
+		"       ./vm --serve-batch job_list_file [--workers count] [--budget amount] "
+		"[--fuel amount]\n"
+		"Memory placement options: [--huge-pages off|transparent|explicit] [--numa-bind]\n"
+		"--profile, --trace and --stats-shm exclude each other. --sample-profile can not\n"
+		"be used with --profile or --trace, --fuel only without all three.\n"
+		"The sampling profiler measures CPU time, which the kernel only samples once\n"
+		"per scheduler tick. Above the tick rate, a sample also counts for the periods\n"
+		"since the previous one. The samples are written to input_file_name.teax.samples,\n"
+		"unless --sample-output is given.\n");
+	exit(1);
+}
+
+/**
+ * @brief Runs an executable on a CPU with the given hooks,
+ * and prints how the program ended.
+ * @param executable The executable to run.
+ * @param fuel The fuel of the program, 0 if fuel is not metered.
+ * @param bench_json_path The path to write the benchmark regions of the
+ * program to as JSON, or nullptr to print them as a table to stderr.
+ * @param run Called with the CPU to run the program on it.
+ * @returns The exit code of the VM.
+ */
+template <typename Hooks, typename Runner>
 int
-main(int argc, char **argv)
+run_with_hooks(Executable &executable, uint64_t fuel, const char *bench_json_path, Runner run)
 {
-	if (argc < 2)
+	BasicCPU<Hooks> cpu(executable, STACK_SIZE);
+
+	if constexpr (Hooks::METERS_FUEL)
+	{
+		if (fuel != 0)
+		{
+			cpu.enable_fuel(fuel);
+		}
+	}
+
+	run(cpu);
+
+	if (cpu.bench_regions != nullptr)
+	{
+		cpu.bench_regions->write_summary(bench_json_path);
+	}
+
+	if (cpu.out_of_fuel)
 	{
-		fprintf(stderr, "Usage: ./vm input_file_name.teax\n");
-		exit(1);
+		printf("VM ran out of fuel at 0x%lx\n",
+			(size_t) (cpu.fuel_trap_addr - cpu.program_location));
+		return 1;
 	}
 
-	const char *file_path = argv[1];
+	printf("VM exited with exit code %llu\n", cpu.regs[R_RET]);
+	return 0;
+}
 
-	Executable executable = Executable::from_file(file_path);
-	CPU cpu(executable, STACK_SIZE);
+/**
+ * @brief Runs the program on a CPU, with the sampling profiler
+ * if a sampling frequency is given.
+ * @param cpu The CPU.
+ * @param file_path The path of the executable.
+ * @param sample_path The path to write the sampled profile to.
+ * @param sample_frequency The sampling frequency in Hz, or 0.
+ */
+template <typename Hooks>
+void
+run_sampled(BasicCPU<Hooks> &cpu, const char *file_path, const std::string &sample_path,
+	uint64_t sample_frequency)
+{
+	if (sample_frequency == 0)
+	{
+		cpu.run();
+		return;
+	}
+
+	Sampler sampler(cpu, sample_frequency);
+	sampler.symbolizer.load_debugger_symbols(file_path);
+	sampler.start();
 
 	try
 	{
 		cpu.run();
-		printf("VM exited with exit code %llu\n", cpu.regs[R_RET]);
 	}
 	catch (const std::string &err_message)
 	{
-		std::cout << err_message;
+		sampler.stop();
+		sampler.write(sample_path);
+		throw;
+	}
+
+	sampler.stop();
+	sampler.write(sample_path);
+}
+
+int
+main(int argc, char **argv)
+{
+	const char *file_path     = nullptr;
+	const char *profile_path  = nullptr;
+	const char *trace_path    = nullptr;
+	const char *stats_name    = nullptr;
+	const char *bench_path    = nullptr;
+	uint64_t sample_frequency = 0;
+	const char *sample_path   = nullptr;
+	const char *job_list_path = nullptr;
+	uint64_t worker_count     = std::thread::hardware_concurrency();
+	uint64_t budget           = SCHEDULER_DEFAULT_BUDGET;
+	uint64_t fuel             = 0;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+
+		if (arg == "--profile")
+		{
+			if (i + 1 == argc)
+				print_usage();
+
+			profile_path = argv[++i];
+		}
+		else if (arg == "--trace")
+		{
+			if (i + 1 == argc)
+				print_usage();
+
+			trace_path = argv[++i];
+		}
+		else if (arg == "--stats-shm")
+		{
+			if (i + 1 == argc)
+				print_usage();
+
+			stats_name = argv[++i];
+		}
+		else if (arg == "--bench-json")
+		{
+			if (i + 1 == argc)
+				print_usage();
+
+			bench_path = argv[++i];
+		}
+		else if (arg == "--sample-profile")
+		{
+			if (i + 1 == argc)
+				print_usage();
+
+			sample_frequency = strtoull(argv[++i], nullptr, 10);
+
+			if (sample_frequency == 0 || sample_frequency > 1000000)
+				print_usage();
+		}
+		else if (arg == "--sample-output")
+		{
+			if (i + 1 == argc)
+				print_usage();
+
+			sample_path = argv[++i];
+		}
+		else if (arg == "--serve-batch")
+		{
+			if (i + 1 == argc)
+				print_usage();
+
+			job_list_path = argv[++i];
+		}
+		else if (arg == "--workers")
+		{
+			if (i + 1 == argc)
+				print_usage();
+
+			worker_count = strtoull(argv[++i], nullptr, 10);
+
+			if (worker_count == 0)
+				print_usage();
+		}
+		else if (arg == "--budget")
+		{
+			if (i + 1 == argc)
+				print_usage();
+
+			budget = strtoull(argv[++i], nullptr, 10);
+
+			if (budget == 0)
+				print_usage();
+		}
+		else if (arg == "--huge-pages")
+		{
+			if (i + 1 == argc)
+				print_usage();
+
+			std::string mode = argv[++i];
+
+			if (mode == "off")
+				placement::config.huge_pages = HUGE_PAGES_OFF;
+			else if (mode == "transparent")
+				placement::config.huge_pages = HUGE_PAGES_TRANSPARENT;
+			else if (mode == "explicit")
+				placement::config.huge_pages = HUGE_PAGES_EXPLICIT;
+			else
+				print_usage();
+		}
+		else if (arg == "--numa-bind")
+		{
+			placement::config.bind_to_local_node = true;
+		}
+		else if (arg == "--fuel")
+		{
+			if (i + 1 == argc)
+				print_usage();
+
+			fuel = strtoull(argv[++i], nullptr, 10);
+
+			if (fuel == 0)
+				print_usage();
+		}
+		else
+		{
+			// The arguments after the executable are passed to the program.
+
+			file_path = argv[i];
+			program_args.assign(argv + i, argv + argc + 1);
+			break;
+		}
+	}
+
+	if (job_list_path != nullptr)
+	{
+		// Batch mode runs the jobs of the job list instead of a single
+		// executable. Their results are written to stdout.
+
+		if (file_path != nullptr || profile_path != nullptr || trace_path != nullptr
+			|| stats_name != nullptr || bench_path != nullptr || sample_frequency != 0
+			|| sample_path != nullptr)
+			print_usage();
+
+		try
+		{
+			Scheduler scheduler(std::max<uint64_t>(worker_count, 1), budget,
+				fuel != 0 ? fuel : UINT64_MAX);
+			scheduler.load_jobs(job_list_path);
+			scheduler.run();
+			return scheduler.failed_jobs != 0;
+		}
+		catch (const std::string &err_message)
+		{
+			std::cout << err_message << std::flush;
+			return 1;
+		}
+	}
+
+	if (file_path == nullptr || (sample_path != nullptr && sample_frequency == 0))
+	{
+		print_usage();
+	}
+
+	// Each tool runs the program on a CPU type of its own, so the tools
+	// can not be combined. Only the plain CPU and the CPU that publishes
+	// statistics can be sampled, and only the plain CPU meters fuel.
+
+	bool tracks_calls = profile_path != nullptr || trace_path != nullptr;
+
+	if ((profile_path != nullptr) + (trace_path != nullptr) + (stats_name != nullptr) > 1
+		|| (tracks_calls && sample_frequency != 0)
+		|| ((tracks_calls || stats_name != nullptr) && fuel != 0))
+	{
+		print_usage();
+	}
+
+	std::string samples_file = sample_path != nullptr
+		? sample_path
+		: std::string(file_path) + ".samples";
+
+	// Each tool runs the program on its own CPU type, so the hooks
+	// it needs don't slow down the others.
+
+	try
+	{
+		Executable executable = Executable::from_file(file_path);
+
+		if (profile_path != nullptr)
+		{
+			return run_with_hooks<ProfilerHooks>(executable, fuel, bench_path, [&](ProfiledCPU &cpu)
+			{
+				// Write the profile even if the program crashes,
+				// so the profile shows where it crashed.
+
+				Profiler profiler(cpu);
+				profiler.symbolizer.load_debugger_symbols(file_path);
+
+				try
+				{
+					profiler.run();
+				}
+				catch (const std::string &err_message)
+				{
+					profiler.write(profile_path);
+					throw;
+				}
+
+				profiler.write(profile_path);
+			});
+		}
+
+		if (trace_path != nullptr)
+		{
+			return run_with_hooks<TracerHooks>(executable, fuel, bench_path, [&](TracedCPU &cpu)
+			{
+				Tracer tracer(cpu, trace_path);
+				cpu.run();
+			});
+		}
+
+		if (stats_name != nullptr)
+		{
+			return run_with_hooks<StatsHooks>(executable, fuel, bench_path, [&](StatsCPU &cpu)
+			{
+				StatsPublisher publisher(cpu, stats_name);
+				run_sampled(cpu, file_path, samples_file, sample_frequency);
+			});
+		}
+
+		if (fuel != 0)
+		{
+			return run_with_hooks<FuelHooks>(executable, fuel, bench_path, [&](MeteredCPU &cpu)
+			{
+				run_sampled(cpu, file_path, samples_file, sample_frequency);
+			});
+		}
+
+		return run_with_hooks<NoHooks>(executable, fuel, bench_path, [&](CPU &cpu)
+		{
+			run_sampled(cpu, file_path, samples_file, sample_frequency);
+		});
+	}
+	catch (const std::string &err_message)
+	{
+		std::cout << err_message << std::flush;
 		abort();
 	}
-}
\ No newline at end of file
+}
@@ -8,11 +8,33 @@ N_TESTS=0
 
 for test in Tests/*/; do
     echo -e "${CYAN}Running $test${END}"
-    Compiler/compile $test/program.tea $test/.program.teax > $test/.compilation-output.txt --debug
+    # Tests with a checked-in program.teax run it as it is, it was compiled by an older compiler.
+    if [ -f $test/program.teax ]; then
+        cp $test/program.teax $test/.program.teax
+    else
+        Compiler/compile $test/program.tea $test/.program.teax > $test/.compilation-output.txt --debug
+    fi
     VM/vm $test/.program.teax > $test/.run-output.txt
     diff $test/output.txt $test/.run-output.txt
+    PASSED=$?
+    # Tests with a bench.txt list the runs of every benchmark region.
+    if [ -f $test/bench.txt ]; then
+        VM/vm --bench-json $test/.bench.json $test/.program.teax > /dev/null \
+            && sed -n 's/.*"region": \([0-9]*\), "runs": \([0-9]*\),.*/\1 \2/p' $test/.bench.json \
+            | diff $test/bench.txt - || PASSED=1
+    fi
+    # Tests with a disassembly.txt list the instructions the program disassembles to,
+    # without colours. Older executables are upgraded by the disassembler.
+    if [ -f $test/disassembly.txt ]; then
+        Disassembler/disassemble $test/.program.teax | sed 's/\x1b\[[0-9;]*m//g' \
+            | diff $test/disassembly.txt - || PASSED=1
+    fi
+    # Tests of runtime errors expect the VM to fail, so only the output is compared.
+    Optimizer/tea-opt $test/.program.teax $test/.program.opt.teax > /dev/null || PASSED=1
+    VM/vm $test/.program.opt.teax > $test/.run-output.opt.txt
+    diff $test/output.txt $test/.run-output.opt.txt || PASSED=1
     N_TESTS=$((N_TESTS+1))
-    if [ $? -eq 0 ]; then
+    if [ $PASSED -eq 0 ]; then
         echo -e "${GREEN}(${N_TESTS}) $test passed${END}"
         N_PASSED=$((N_PASSED+1))
     else
@@ -0,0 +1,37 @@
+#!/bin/bash
+
+# Profiles the sample programs and the test programs, and synthesizes
+# the superinstructions that save the most dispatches from the profiles.
+# Rebuild afterwards to use the new superinstructions.
+
+# first CLI arg is the number of superinstructions, 16 by default
+num_superinstructions=${1:-16}
+
+# the fuel of each program, so long-running programs are cut short
+fuel=${FUEL:-200000000}
+
+profile_dir=$(mktemp -d)
+trap "rm -rf $profile_dir" EXIT
+
+make Compiler/compile VM/vm Superinstructions/synthesize > /dev/null || exit 1
+
+for program in SampleTranspiledPrograms/*.tea Tests/*/program.tea
+do
+    name=$(echo $program | tr '/' '_')
+
+    if ! Compiler/compile $program $profile_dir/$name.teax > /dev/null 2> /dev/null
+    then
+        echo "Skipping $program, it does not compile"
+        continue
+    fi
+
+    VM/vm --profile $profile_dir/$name.profile --fuel $fuel $profile_dir/$name.teax \
+        < /dev/null > /dev/null 2> /dev/null
+
+    if [ -f $profile_dir/$name.profile.sequences ]
+    then
+        echo "Profiled $program"
+    fi
+done
+
+Superinstructions/synthesize --count $num_superinstructions $profile_dir/*.sequences